@@ -327,7 +327,7 @@ void api_init_end(void)
 /** \defgroup api_init Plug-In Initialization Functions
  * 
  * Functions in this group are used to initialize a plug-in. They are always used exclusively from
- * a library's \c init() function, and never from the \c compute() callback. There are five functions,
+ * a library's \c init() function, and never from the \c compute() callback. There are six functions,
  * two of which are mandatory to use in each plug-in.
  * 
  * The most important functions are \c p_init_create() and \c p_init_compute(), they must be used
@@ -335,7 +335,7 @@ void api_init_end(void)
  * vast majority, needs to have them defined using a number of calls to \c p_init_input(). Using
  * \c p_init_meta() to register meta information is a very good idea, but not mandatory at the time
  * of writing. If per-instance persistent state is desired, use the \c p_init_state() function to
- * define it.
+ * define it. Finally, \c p_init_flags() lets the engine know how the \c compute() callback behaves.
  * 
  * Here's an example of a library \c init() function that defines three separate plug-ins that all
  * share the same \c compute() code:
@@ -472,4 +472,26 @@ PURPLEAPI void p_init_compute(PComputeStatus (*compute)(PPInput *input, PPOutput
 	plugin_set_compute(init_info.plugin, compute);
 }
 
+/**
+ * Declare how the current plug-in's \c compute() callback behaves, by or:ing together values
+ * from the \c PPluginFlags enumeration. The Purple engine uses this to decide what it can do
+ * with the plug-in's computations:
+ * - \c P_PLUGIN_PURE means that the output depends only on the inputs. Given the same input values
+ * (and input nodes), \c compute() always produces the same output. It does not read the clock, use
+ * random numbers, or carry data over in its state from one call to the next. Results of a pure
+ * plug-in may be cached, and re-used instead of running \c compute().
+ * - \c P_PLUGIN_REENTRANT means that \c compute() only touches its inputs, output, and state, and
+ * does all of it through the Purple API. It uses no static or global variables. Instances of a
+ * reentrant plug-in may be run in parallel, on different threads.
+ * - \c P_PLUGIN_SIDE_EFFECTS means that \c compute() does something beyond setting its output, such
+ * as printing, talking to the network, or starting timers. Such plug-ins always run on the main
+ * thread and are never cached, regardless of any other flags.
+ * 
+ * Not calling this function at all is the same as passing zero, which is always safe.
+*/
+PURPLEAPI void p_init_flags(uint32 flags /** The flags, or:ed together. */)
+{
+	plugin_set_flags(init_info.plugin, flags);
+}
+
 /** @} */
@@ -76,6 +76,44 @@ PURPLEAPI void p_node_set_name(PONode *node	/** The node whose name is to be cha
 	nodedb_rename(node, name);
 }
 
+/* Adapts a plug-in's callback to the one nodedb_lookup_by_name_glob() expects. */
+typedef struct
+{
+	int	(*func)(PINode *node, void *user);
+	void	*user;
+} FindGlob;
+
+static int cb_find_glob(PNode *node, void *user)
+{
+	const FindGlob	*fg = user;
+
+	return fg->func(node, fg->user);
+}
+
+/**
+ * \brief Find nodes whose names match a pattern.
+ * 
+ * This function calls \c func once for each node whose name matches \c pattern. In the pattern, an asterisk (*)
+ * matches any run of characters, and a question mark (?) matches any single one. Other characters match only
+ * themselves. Nodes are visited in order of their names, with nodes sharing a name in order of ID. The search stops
+ * if \c func returns zero. The number of nodes visited is returned.
+ * 
+ * \note A pattern that starts with some plain characters, such as "box*", is much cheaper to search for than
+ * one that starts with a wildcard, since only names with that prefix need to be looked at.
+*/
+PURPLEAPI unsigned int p_node_find_glob(const char *pattern	/** The pattern that node names must match. */,
+					int (*func)(PINode *node, void *user)	/** Called with each matching node. */,
+					void *user	/** Passed on to \c func. */)
+{
+	FindGlob	fg;
+
+	if(func == NULL)
+		return 0;
+	fg.func = func;
+	fg.user = user;
+	return nodedb_lookup_by_name_glob(pattern, cb_find_glob, &fg);
+}
+
 /* ----------------------------------------------------------------------------------------- */
 
 /**
@@ -612,6 +650,85 @@ PURPLEAPI VNGLayerType p_node_g_layer_get_type(const PNGLayer *layer	/** The lay
 	return -1;
 }
 
+/**
+ * Make room for a number of slots in a geometry layer.
+ * 
+ * This function lets a plug-in that knows how many vertices or polygons it is about to write size the
+ * layer once, up front, rather than having it grow repeatedly as the slots are set. It does not change
+ * the size of the layer as reported by \c p_node_g_layer_get_size(), and reserving is never required.
+*/
+PURPLEAPI void p_node_g_layer_reserve(PNGLayer *layer	/** The layer in which to make room. */,
+				      size_t size	/** The number of slots to make room for. */)
+{
+	nodedb_g_layer_reserve(layer, size);
+}
+
+/** \brief Begin reading all slots of a geometry layer.
+ * 
+ * This function gives a plug-in direct, read-only access to the contents of a geometry layer, so that
+ * it can loop over all vertices or polygons without making a function call for each. The slots are
+ * returned as a single array, whose element type depends on the layer's type:
+ * - \c VN_G_LAYER_VERTEX_XYZ: three \c real64 per vertex (x, y and z). Deleted vertices have all three set
+ *   to \c V_REAL64_MAX.
+ * - \c VN_G_LAYER_VERTEX_UINT32 and \c VN_G_LAYER_POLYGON_FACE_UINT32: one \c uint32 per slot.
+ * - \c VN_G_LAYER_VERTEX_REAL and \c VN_G_LAYER_POLYGON_FACE_REAL: one \c real64 per slot.
+ * - \c VN_G_LAYER_POLYGON_CORNER_UINT32: four \c uint32 per polygon, one for each corner.
+ * - \c VN_G_LAYER_POLYGON_CORNER_REAL: four \c real64 per polygon.
+ * - \c VN_G_LAYER_POLYGON_FACE_UINT8: one \c uint8 per polygon.
+ * 
+ * The number of slots is stored through \a size, and is the same as \c p_node_g_layer_get_size() returns.
+ * If the layer is empty, \c NULL is returned. When done, hand the array back by calling
+ * \c p_node_g_layer_read_end().
+*/
+PURPLEAPI const void * p_node_g_layer_read_begin(PINode *node		/** The node whose layer is to be read. */,
+						 const PNGLayer *layer	/** The layer to read. */,
+						 size_t *size		/** Pointer to a \c size_t that is set to the number of slots. */)
+{
+	return nodedb_g_layer_read_begin((NodeGeometry *) node, layer, size);
+}
+
+/** \brief Stop reading a geometry layer.
+ * 
+ * This function hands an array returned by \c p_node_g_layer_read_begin() back to Purple. After this call, the
+ * array pointer is no longer valid.
+*/
+PURPLEAPI void p_node_g_layer_read_end(PINode *node		/** The node whose layer has been read. */,
+				       const PNGLayer *layer	/** The layer that has been read. */,
+				       const void *data		/** The array pointer. */)
+{
+	nodedb_g_layer_read_end((NodeGeometry *) node, layer, data);
+}
+
+/** \brief Begin writing slots of a geometry layer.
+ * 
+ * This function gives a plug-in direct access to the first \a size slots of a geometry layer in an output
+ * node, for reading and writing. The layer grows to hold \a size slots if it is smaller, with any new slots
+ * set to the layer's default value. Growing the \c vertex layer adds vertices to the node; other vertex
+ * layers can't be accessed beyond the node's number of vertices, and \c NULL is returned if that is tried.
+ * The array is laid out as for \c p_node_g_layer_read_begin().
+ * 
+ * While accessing the layer, don't use any other function to change the node's geometry, since that can move
+ * the array. When done, hand it back by calling \c p_node_g_layer_access_end().
+*/
+PURPLEAPI void * p_node_g_layer_access_begin(PONode *node	/** The node whose layer is to be accessed. */,
+					     PNGLayer *layer	/** The layer to access. */,
+					     size_t size	/** The number of slots to access. */)
+{
+	return nodedb_g_layer_access_begin((NodeGeometry *) node, layer, size);
+}
+
+/** \brief Stop writing a geometry layer.
+ * 
+ * This function hands an array returned by \c p_node_g_layer_access_begin() back to Purple. After this call,
+ * the array pointer is no longer valid.
+*/
+PURPLEAPI void p_node_g_layer_access_end(PONode *node	/** The node whose layer has been accessed. */,
+					 PNGLayer *layer	/** The layer that has been accessed. */,
+					 void *data		/** The array pointer. */)
+{
+	nodedb_g_layer_access_end((NodeGeometry *) node, layer, data);
+}
+
 /**
  * Create a new geometry layer.
  * 
@@ -1906,6 +2023,24 @@ PURPLEAPI uint32 p_node_c_curve_key_get_post(const PNCKey *key	/** The key whose
 	return 0;
 }
 
+/** \brief Evaluate a curve at a given position.
+ * 
+ * This function returns the value of one dimension of a curve at any position. Between two keys, the curve follows
+ * the cubic Bezier segment defined by the keys and their post- and pre-points. Before the first key and after the
+ * last, the curve is flat at that key's value. An empty curve evaluates to zero everywhere.
+ * 
+ * Finding the segment takes time logarithmic in the number of keys. To sample a curve at many positions in order,
+ * pass a pointer to an \c unsigned \c int initialized to zero as \c hint, and keep passing the same one. It then
+ * remembers the segment last used, so that moving along the curve needs no searching at all.
+*/
+PURPLEAPI real64 p_node_c_curve_evaluate(const PNCCurve *curve	/** The curve to evaluate. */,
+					 uint8 dimension	/** The dimension whose value is wanted. */,
+					 real64 pos		/** The position at which to evaluate the curve. */,
+					 unsigned int *hint	/** Optional pointer to a segment hint, for sequential access. */)
+{
+	return nodedb_c_curve_evaluate(curve, dimension, pos, hint);
+}
+
 /** \brief Create a curve key.
  * 
  * This function creates a new key in a curve. The five final arguments are pointers, since they are vectors. Only the
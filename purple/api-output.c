@@ -278,21 +278,20 @@ PURPLEAPI PONode * p_output_node_create(PPOutput out	/** The output to use. */,
 
 		if((l = nodedb_g_layer_find((NodeGeometry *) n, "vertex")) != NULL)
 		{
-			real64	gone[] = { V_REAL64_MAX, V_REAL64_MAX, V_REAL64_MAX };
 			uint32	i, s;
 
-			s = dynarr_size(l->data);
+			s = nodedb_g_layer_get_size(l);
 			for(i = 0; i < s; i++)
-				dynarr_set(l->data, i, gone);
+				nodedb_g_vertex_delete(l, i);
 /*			printf("cleared %u vertex slots\n", i);*/
 		}
 		if((l = nodedb_g_layer_find((NodeGeometry *) n, "polygon")) != NULL)
 		{
-			uint32	gone[] = { ~0u, ~0u, ~0u, ~0u }, i, s;
+			uint32	i, s;
 
-			s = dynarr_size(l->data);
+			s = nodedb_g_layer_get_size(l);
 			for(i = 0; i < s; i++)
-				dynarr_set(l->data, i, gone);
+				nodedb_g_polygon_set_corner_uint32(l, i, ~0u, ~0u, ~0u, ~0u);
 /*			printf("cleared %u polygon slots\n", i);*/
 		}
 		for(i = 2; i < 100; i++)
@@ -3,7 +3,9 @@
  * 
  * Copyright (C) 2005 PDC, KTH. See COPYING for license details.
  * 
- * A binary tree.
+ * A binary tree, kept balanced as a red-black tree so that keys inserted in
+ * order (block indices, sequential IDs) don't degrade it into a list. Uses the
+ * algorithms from Cormen et al, with NULL pointers instead of a sentinel leaf.
 */
 
 #include <stdio.h>
@@ -23,6 +25,7 @@ struct Node
 	const void	*key;
 	void		*element;
 	Node		*left, *right, *parent;	/* Children and parent pointers. */
+	int		red;			/* Color; NULL leaves count as black. */
 };
 
 struct BinTree
@@ -34,6 +37,8 @@ struct BinTree
 
 static MemChunk	*the_chunk = NULL;
 
+#define	IS_RED(n)	((n) != NULL && (n)->red)
+
 /* ----------------------------------------------------------------------------------------- */
 
 void bintree_init(void)
@@ -76,6 +81,55 @@ static Node * tree_successor(const Node *node)
 	return y;
 }
 
+static void tree_rotate_left(BinTree *tree, Node *x)
+{
+	Node	*y = x->right;
+
+	x->right = y->left;
+	if(y->left != NULL)
+		y->left->parent = x;
+	y->parent = x->parent;
+	if(x->parent == NULL)
+		tree->root = y;
+	else if(x == x->parent->left)
+		x->parent->left = y;
+	else
+		x->parent->right = y;
+	y->left = x;
+	x->parent = y;
+}
+
+static void tree_rotate_right(BinTree *tree, Node *x)
+{
+	Node	*y = x->left;
+
+	x->left = y->right;
+	if(y->right != NULL)
+		y->right->parent = x;
+	y->parent = x->parent;
+	if(x->parent == NULL)
+		tree->root = y;
+	else if(x == x->parent->right)
+		x->parent->right = y;
+	else
+		x->parent->left = y;
+	y->right = x;
+	x->parent = y;
+}
+
+/* Put <v> where <u> is in the tree, as far as <u>'s parent is concerned. */
+static void tree_transplant(BinTree *tree, Node *u, Node *v)
+{
+	if(u->parent == NULL)
+		tree->root = v;
+	else if(u == u->parent->left)
+		u->parent->left = v;
+	else
+		u->parent->right = v;
+	if(v != NULL)
+		v->parent = u->parent;
+}
+
 /* ----------------------------------------------------------------------------------------- */
 
 BinTree * bintree_new(int (*compare)(const void *key1, const void *key2))
@@ -108,7 +162,6 @@ BinTree * bintree_new_copy(const BinTree *src, void * (*element_copy)(const void
 	t->compare = src->compare;
 
 	printf("copying binary tree at %p\n", src);
-	/* FIXME: This **really** unbalances the tree, and thus is pessimal. */
 	for(n = tree_minimum(src->root); n != NULL; n = tree_successor(n))
 	{
 		void	*el = element_copy(n->key, n->element, user);
@@ -124,14 +177,13 @@ static const Node * tree_lookup(const BinTree *tree, const Node *root, const voi
 {
 	int	cmp;
 
-	if(root == NULL)
-		return NULL;
-	cmp = tree->compare(key, root->key);
-	if(cmp == 0)
-		return root;
-	else if(cmp < 0)
-		return tree_lookup(tree, root->left, key);
-	return tree_lookup(tree, root->right, key);
+	while(root != NULL)
+	{
+		if((cmp = tree->compare(key, root->key)) == 0)
+			return root;
+		root = cmp < 0 ? root->left : root->right;
+	}
+	return NULL;
 }
 
 void * bintree_lookup(const BinTree *tree, const void *key)
@@ -145,6 +197,61 @@ void * bintree_lookup(const BinTree *tree, const void *key)
 	return NULL;
 }
 
+/* Restore the red-black properties after inserting the red node <z>. */
+static void insert_fixup(BinTree *tree, Node *z)
+{
+	Node	*y;
+
+	while(IS_RED(z->parent))
+	{
+		if(z->parent == z->parent->parent->left)
+		{
+			y = z->parent->parent->right;
+			if(IS_RED(y))
+			{
+				z->parent->red = 0;
+				y->red = 0;
+				z->parent->parent->red = 1;
+				z = z->parent->parent;
+			}
+			else
+			{
+				if(z == z->parent->right)
+				{
+					z = z->parent;
+					tree_rotate_left(tree, z);
+				}
+				z->parent->red = 0;
+				z->parent->parent->red = 1;
+				tree_rotate_right(tree, z->parent->parent);
+			}
+		}
+		else
+		{
+			y = z->parent->parent->left;
+			if(IS_RED(y))
+			{
+				z->parent->red = 0;
+				y->red = 0;
+				z->parent->parent->red = 1;
+				z = z->parent->parent;
+			}
+			else
+			{
+				if(z == z->parent->left)
+				{
+					z = z->parent;
+					tree_rotate_right(tree, z);
+				}
+				z->parent->red = 0;
+				z->parent->parent->red = 1;
+				tree_rotate_left(tree, z->parent->parent);
+			}
+		}
+	}
+	tree->root->red = 0;
+}
+
 void bintree_insert(BinTree *tree, const void *key, void *element)
 {
 	Node	*y, *x, *z;
@@ -165,12 +272,14 @@ void bintree_insert(BinTree *tree, const void *key, void *element)
 	z->element = element;
 	z->left = z->right = NULL;
 	z->parent = y;
+	z->red = 1;
 	if(y == NULL)
 		tree->root = z;
 	else if(tree->compare(key, y->key) < 0)
 		y->left = z;
 	else
 		y->right = z;
+	insert_fixup(tree, z);
 	tree->size++;
 }
 
@@ -190,40 +299,122 @@ static void do_print(const Node *root)
 
 /* ----------------------------------------------------------------------------------------- */
 
+/* Restore the red-black properties after removing a black node. <x> is the node that took its
+ * place, which may be NULL, so its parent is passed in separately.
+*/
+static void remove_fixup(BinTree *tree, Node *x, Node *parent)
+{
+	Node	*w;
+
+	while(x != tree->root && !IS_RED(x))
+	{
+		if(x == parent->left)
+		{
+			w = parent->right;
+			if(w->red)
+			{
+				w->red = 0;
+				parent->red = 1;
+				tree_rotate_left(tree, parent);
+				w = parent->right;
+			}
+			if(!IS_RED(w->left) && !IS_RED(w->right))
+			{
+				w->red = 1;
+				x = parent;
+				parent = x->parent;
+			}
+			else
+			{
+				if(!IS_RED(w->right))
+				{
+					w->left->red = 0;
+					w->red = 1;
+					tree_rotate_right(tree, w);
+					w = parent->right;
+				}
+				w->red = parent->red;
+				parent->red = 0;
+				w->right->red = 0;
+				tree_rotate_left(tree, parent);
+				x = tree->root;
+			}
+		}
+		else
+		{
+			w = parent->left;
+			if(w->red)
+			{
+				w->red = 0;
+				parent->red = 1;
+				tree_rotate_right(tree, parent);
+				w = parent->left;
+			}
+			if(!IS_RED(w->left) && !IS_RED(w->right))
+			{
+				w->red = 1;
+				x = parent;
+				parent = x->parent;
+			}
+			else
+			{
+				if(!IS_RED(w->left))
+				{
+					w->right->red = 0;
+					w->red = 1;
+					tree_rotate_left(tree, w);
+					w = parent->left;
+				}
+				w->red = parent->red;
+				parent->red = 0;
+				w->left->red = 0;
+				tree_rotate_right(tree, parent);
+				x = tree->root;
+			}
+		}
+	}
+	if(x != NULL)
+		x->red = 0;
+}
+
 void bintree_remove(BinTree *tree, const void *key)
 {
-	Node	*x, *y, *z;
+	Node	*x, *x_parent, *y, *z;
+	int	y_red;
 
 	z = (Node *) tree_lookup(tree, tree->root, key);
 	if(z == NULL)
 		return;
+	y = z;
+	y_red = y->red;
 	if(z->left == NULL || z->right == NULL)
-		y = z;
-	else
-		y = tree_successor(z);
-
-	if(y->left != NULL)
-		x = y->left;
-	else
-		x = y->right;
-
-	if(x != NULL)
-		x->parent = y->parent;
-	if(y->parent == NULL)
-		tree->root = x;
-	else
 	{
-		if(y == y->parent->left)
-			y->parent->left = x;
-		else
-			y->parent->right = x;
+		x = z->left != NULL ? z->left : z->right;
+		x_parent = z->parent;
+		tree_transplant(tree, z, x);
 	}
-	if(y != z)
+	else	/* Two children, so move the successor into z's place. */
 	{
-		z->key = y->key;
-		z->element = y->element;
+		y = tree_minimum(z->right);
+		y_red = y->red;
+		x = y->right;
+		if(y->parent == z)
+			x_parent = y;
+		else
+		{
+			x_parent = y->parent;
+			tree_transplant(tree, y, y->right);
+			y->right = z->right;
+			y->right->parent = y;
+		}
+		tree_transplant(tree, z, y);
+		y->left = z->left;
+		y->left->parent = y;
+		y->red = z->red;
 	}
-	memchunk_free(the_chunk, y);
+	if(!y_red)
+		remove_fixup(tree, x, x_parent);
+	memchunk_free(the_chunk, z);
 	tree->size--;
 }
 
@@ -17,6 +17,7 @@
 #include "list.h"
 #include "log.h"
 #include "mem.h"
+#include "outbuf.h"
 #include "textbuf.h"
 #include "timeval.h"
 #include "plugins.h"
@@ -88,16 +89,7 @@ static void cb_node_notify_mine(PNode *node, NodeNotifyEvent e)
 					client_info.plugins.buffer = buf->id;
 					if((text = plugins_build_xml()) != NULL)
 					{
-						char	buf[1024];
-						size_t	len = strlen(text), pos, chunk;
-
-						for(pos = 0; pos < len; pos += chunk)
-						{
-							chunk = (len - pos) > sizeof buf - 1 ? sizeof buf - 1 : len - pos;
-							memcpy(buf, text + pos, chunk);
-							buf[chunk] = '\0';
-							verse_send_t_text_set(client_info.meta, client_info.plugins.buffer, pos, chunk, buf);
-						}
+						outbuf_t_text_set(client_info.meta, client_info.plugins.buffer, 0, 0, text, strlen(text));
 						mem_free(text);
 					}
 				}
@@ -12,32 +12,31 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "purple.h"
+
+#include "hash.h"
+#include "mem.h"
 #include "memchunk.h"
-#include "list.h"
 #include "timeval.h"
 
 #include "cron.h"
 
 /* ----------------------------------------------------------------------------------------- */
 
-#define	PERIODIC_MASK	(1 << 31)
-#define	PERIODIC_SET(i)	((i) | PERIODIC_MASK)
-#define	PERIODIC_CLR(i)	((i) & ~PERIODIC_MASK)
-#define	IS_PERIODIC(i)	((id) & PERIODIC_MASK)
+/* Jobs are kept in a binary min-heap, ordered on when they are next due. Times are in seconds
+ * since cron_init(), from the monotonic clock. A periodic job's next deadline is always its
+ * previous one plus the period, so it doesn't drift no matter how late it gets to run.
+*/
 
-typedef struct
-{
-	double		period, bucket;
-} TimePeriodic;
+#define	SOON_DELAY	0.5	/* Delay before first run of CRON_PERIODIC_SOON jobs. */
 
 typedef struct
 {
 	unsigned int	id;
-	union
-	{
-	TimeVal		oneshot;
-	TimePeriodic	periodic;
-	}		when;
+	boolean		periodic;
+	double		period;
+	double		due;		/* When the job is to run next. */
+	size_t		pos;		/* Index in heap. */
 	int		(*handler)(void *data);
 	void		*data;
 } Job;
@@ -46,166 +45,213 @@ static struct
 {
 	MemChunk	*chunk_job;
 	unsigned int	id_next;
-	List		*id_reuse;
-	TimeVal		epoch, now;
-	List		*oneshot;
-	List		*periodic;
+	Hash		*jobs;		/* Maps ID to job. */
+	TimeVal		epoch;
+	Job		**heap;
+	size_t		heap_size, heap_alloc;
 } cron_info;
 
 /* ----------------------------------------------------------------------------------------- */
 
+#define	JOB_KEY(id)	((const void *) (size_t) (id))
+
 void cron_init(void)
 {
 	cron_info.chunk_job = memchunk_new("cron/job", sizeof (Job), 8);
-	timeval_now(&cron_info.epoch);
-	cron_info.now = cron_info.epoch;
-	cron_info.id_next  = 1;
-	cron_info.id_reuse = NULL;
-	cron_info.oneshot  = NULL;
-	cron_info.periodic = NULL;
+	cron_info.id_next = 1;
+	cron_info.jobs = hash_new_int();
+	timeval_monotonic(&cron_info.epoch);
+	cron_info.heap = NULL;
+	cron_info.heap_size = cron_info.heap_alloc = 0;
 }
 
-unsigned int cron_add(CronTimeType type, double seconds, int (*handler)(void *data), void *data)
+static double now(void)
 {
-	Job	*j;
-	List	*id;
+	TimeVal	t;
 
-	if(type > 2)
-		return 0;
-	if(handler == NULL)
-		return 0;
+	timeval_monotonic(&t);
+	return timeval_elapsed(&cron_info.epoch, &t);
+}
+
+/* ----------------------------------------------------------------------------------------- */
+
+static void heap_put(Job *job, size_t pos)
+{
+	cron_info.heap[pos] = job;
+	job->pos = pos;
+}
 
-	j = memchunk_alloc(cron_info.chunk_job);
-	if((id = cron_info.id_reuse) != NULL)
+static void heap_up(size_t pos)
+{
+	Job	*job = cron_info.heap[pos];
+	size_t	parent;
+
+	for(; pos > 0; pos = parent)
 	{
-		j->id = (unsigned int) list_data(id);
-		cron_info.id_reuse = list_unlink(cron_info.id_reuse, cron_info.id_reuse);
+		parent = (pos - 1) / 2;
+		if(cron_info.heap[parent]->due <= job->due)
+			break;
+		heap_put(cron_info.heap[parent], pos);
 	}
-	else
-		j->id = cron_info.id_next++;
-	j->handler = handler;
-	j->data = data;
+	heap_put(job, pos);
+}
 
-	if(type == CRON_ONESHOT)
+static void heap_down(size_t pos)
+{
+	Job	*job = cron_info.heap[pos];
+	size_t	child;
+
+	for(; (child = 2 * pos + 1) < cron_info.heap_size; pos = child)
 	{
-		timeval_future(&j->when.oneshot, seconds);
-		cron_info.oneshot = list_append(cron_info.oneshot, j);
+		if(child + 1 < cron_info.heap_size && cron_info.heap[child + 1]->due < cron_info.heap[child]->due)
+			child++;
+		if(job->due <= cron_info.heap[child]->due)
+			break;
+		heap_put(cron_info.heap[child], pos);
 	}
-	else if(type == CRON_PERIODIC || type == CRON_PERIODIC_SOON)
+	heap_put(job, pos);
+}
+
+/* Move a job that has changed its due time to where it belongs. */
+static void heap_fix(Job *job)
+{
+	heap_up(job->pos);
+	heap_down(job->pos);
+}
+
+static boolean heap_insert(Job *job)
+{
+	if(cron_info.heap_size >= cron_info.heap_alloc)
 	{
-		j->id = PERIODIC_SET(j->id);
-		j->when.periodic.period = seconds;
-		j->when.periodic.bucket = type == CRON_PERIODIC_SOON ? seconds - 0.5 : 0.0;
-		cron_info.periodic = list_append(cron_info.periodic, j);
+		size_t	na = cron_info.heap_alloc > 0 ? 2 * cron_info.heap_alloc : 16;
+		Job	**nh;
+
+		if((nh = mem_realloc(cron_info.heap, na * sizeof *nh)) == NULL)
+			return FALSE;
+		cron_info.heap = nh;
+		cron_info.heap_alloc = na;
 	}
-	return j->id;
+	heap_put(job, cron_info.heap_size++);
+	heap_up(job->pos);
+	return TRUE;
 }
 
-/* Find a job, given its ID number. Sets <head> to the list containing it. */
-static List * job_find(unsigned int id, List ***head)
+static void heap_remove(Job *job)
 {
-	List	**list, *iter;
-
-	if(IS_PERIODIC(id))
-		list = &cron_info.periodic;
-	else
-		list = &cron_info.oneshot;
+	Job	*last = cron_info.heap[--cron_info.heap_size];
 
-	for(iter = *list; iter != NULL; iter = list_next(iter))
+	if(last != job)
 	{
-		if(((Job *) list_data(iter))->id == id)
-			break;
+		heap_put(last, job->pos);
+		heap_fix(last);
 	}
-	if(head)
-		*head = list;
+}
 
-	return iter;
+/* ----------------------------------------------------------------------------------------- */
+
+unsigned int cron_add(CronTimeType type, double seconds, int (*handler)(void *data), void *data)
+{
+	Job	*j;
+
+	if(type > 2)
+		return 0;
+	if(handler == NULL)
+		return 0;
+	if(type != CRON_ONESHOT && seconds <= 0.0)
+		return 0;
+
+	if((j = memchunk_alloc(cron_info.chunk_job)) == NULL)
+		return 0;
+	do
+		j->id = cron_info.id_next++;
+	while(j->id == 0 || hash_lookup(cron_info.jobs, JOB_KEY(j->id)) != NULL);	/* Only matters after wrap-around. */
+	j->handler = handler;
+	j->data = data;
+	j->periodic = type != CRON_ONESHOT;
+	j->period = seconds;
+	j->due = now() + (type == CRON_PERIODIC_SOON ? SOON_DELAY : seconds);
+	if(!heap_insert(j))
+	{
+		memchunk_free(cron_info.chunk_job, j);
+		return 0;
+	}
+	hash_insert(cron_info.jobs, JOB_KEY(j->id), j);
+	return j->id;
 }
 
 void cron_set(unsigned int id, double seconds, int (*handler)(void *), void *data)
 {
-	List	*j;
+	Job	*job;
 
 	if(id == 0 || seconds <= 0.0 || handler == NULL)
 		return;
-
-	if((j = job_find(id, NULL)) != NULL)
-	{
-		Job	*job = list_data(j);
-
-		if(IS_PERIODIC(id))
-			job->when.periodic.period = seconds;
-		else
-			fprintf(stderr, "cron: Don't know how to set() non-periodic job\n");
-	}
+	if((job = hash_lookup(cron_info.jobs, JOB_KEY(id))) == NULL)
+		return;
+	job->handler = handler;
+	job->data = data;
+	if(job->periodic)		/* Keep phase, i.e. next run is one new period after the last. */
+		job->due += seconds - job->period;
+	else
+		job->due = now() + seconds;
+	job->period = seconds;
+	heap_fix(job);
 }
 
 void cron_remove(unsigned int id)
 {
-	List	*job, **list;
+	Job	*job;
 
-	if((job = job_find(id, &list)) != NULL)
-	{
-		Job	*j = list_data(job);
-
-		*list = list_unlink(*list, job);
-		printf("removing id %u, data='%s'\n", j->id, (const char *) j->data);
-		cron_info.id_reuse = list_prepend(cron_info.id_reuse, (void *) PERIODIC_CLR(j->id));
-		memchunk_free(cron_info.chunk_job, list_data(job));
-		list_destroy(job);
-	}
+	if((job = hash_lookup(cron_info.jobs, JOB_KEY(id))) == NULL)
+		return;
+	hash_remove(cron_info.jobs, JOB_KEY(id));
+	heap_remove(job);
+	memchunk_free(cron_info.chunk_job, job);
 }
 
-/* Remove a job from a list, and free it. Doubly indirect list, since it might re-head. */
-static void job_remove(List **list, List *iter)
+/* Run the job, or print it, if the handler is printf(). Clever? */
+static int job_run(const Job *job)
 {
-	*list = list_unlink(*list, iter);
-	memchunk_free(cron_info.chunk_job, (Job *) list_data(iter));
-	list_destroy(iter);
+	if(job->handler == (int (*)(void *)) printf)
+	{
+		printf("%s\n", (const char *) job->data);
+		return 1;
+	}
+	return job->handler(job->data);
 }
 
 void cron_update(void)
 {
-	TimeVal	now;
-	double	dt;
-	List	*iter, *next;
-
-	timeval_now(&now);
-	dt = timeval_elapsed(&cron_info.now, &now);
+	double		t = now();
+	Job		*job;
+	unsigned int	id;
 
-	for(iter = cron_info.oneshot; iter != NULL; iter = next)
+	while(cron_info.heap_size > 0 && (job = cron_info.heap[0])->due <= t)
 	{
-		Job	*job = list_data(iter);
-
-		next = list_next(iter);
-		if(timeval_passed(&job->when.oneshot, &now))
+		id = job->id;
+		if(!job->periodic)
 		{
-			if(job->handler == (int (*)(void *)) printf)
-				printf("%s\n", (const char *) job->data);
-			else
-				job->handler(job->data);
-			job_remove(&cron_info.oneshot, iter);
+			hash_remove(cron_info.jobs, JOB_KEY(id));	/* Out before running, in case handler adds jobs. */
+			heap_remove(job);
+			job_run(job);
+			memchunk_free(cron_info.chunk_job, job);
+			continue;
 		}
+		job->due += job->period;
+		if(job->due <= t)	/* Fell behind by more than a period; skip, rather than run many times. */
+			job->due += job->period * (1 + (int) ((t - job->due) / job->period));
+		heap_down(0);
+		if(!job_run(job))
+			cron_remove(id);	/* Looked up again, handler might have removed it already. */
 	}
+}
 
-	for(iter = cron_info.periodic; iter != NULL; iter = next)
-	{
-		Job	*job = list_data(iter);
+boolean cron_next(double *seconds)
+{
+	double	left;
 
-		next = list_next(iter);
-		job->when.periodic.bucket += dt;
-		if(job->when.periodic.bucket >= job->when.periodic.period)
-		{
-			if(job->handler == (int (*)(void *)) printf)	/* Clever? */
-				printf("%s\n", (const char *) job->data);
-			else
-			{
-				if(!job->handler(job->data))
-					job_remove(&cron_info.periodic, iter);
-				else
-					job->when.periodic.bucket = 0.0;
-			}
-		}
-	}
-	cron_info.now = now;
+	if(cron_info.heap_size == 0)
+		return FALSE;
+	left = cron_info.heap[0]->due - now();
+	*seconds = left > 0.0 ? left : 0.0;
+	return TRUE;
 }
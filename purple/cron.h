@@ -23,3 +23,8 @@ extern void		cron_set(unsigned int id, double seconds, int (*handler)(void *data
 extern void		cron_remove(unsigned int handle);
 
 extern void		cron_update(void);
+
+/* Find how many seconds remain until the next job is due to run, zero if one is overdue. Returns
+ * FALSE if there are no jobs at all, leaving <seconds> alone.
+*/
+extern boolean		cron_next(double *seconds);
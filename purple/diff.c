@@ -39,6 +39,8 @@
  * - Adopted for use in Purple, heavy edits and support code porting.
  * - Removed ~55% of the total number of code lines by coalescing the
  *   dependencies in the original's mba/ folder (headers).
+ * - Trims equal suffixes as well as prefixes, keeps the paths in a plain
+ *   array, and falls back to a single replace when <dmax> is reached.
  * 
 */
 
@@ -51,14 +53,17 @@
 
 #include "diff.h"
 
-#define FV(k)	v_get(ctx, (k), 0)
-#define RV(k)	v_get(ctx, (k), 1)
+#define	FV(k)	v_get(ctx, (k), 0)
+#define	RV(k)	v_get(ctx, (k), 1)
+
+#define	TRIM_BLOCK	64	/* Bytes compared per memcmp() when trimming, which libc vectorizes. */
 
 typedef struct
 {
-	DynArr	*buf, *ses;
+	DynArr	*ses;
 	int	si;
 	int	dmax;
+	int	*v;		/* Forward and reverse furthest reaching paths, interleaved. */
 } Context;
 
 typedef struct
@@ -66,18 +71,19 @@ typedef struct
 	int	x, y, u, v;
 } Snake;
 
-static void v_set(Context *ctx, int k, int r, int val)
+static int v_index(int k, int r)
 {
-	int	j = (k <= 0) ? -k * 4 + r : k * 4 + (r - 2);	/* Pack -N to N into 0 to N * 2. */
-
-	dynarr_set(ctx->buf, j, &val);
+	return (k <= 0) ? -k * 4 + r : k * 4 + (r - 2);	/* Pack -N to N into 0 to N * 2. */
 }
 
-static int v_get(Context *ctx, int k, int r)
+static void v_set(Context *ctx, int k, int r, int val)
 {
-	int	j = (k <= 0) ? -k * 4 + r : k * 4 + (r - 2);	/* Pack -N to N into 0 to N * 2. */
+	ctx->v[v_index(k, r)] = val;
+}
 
-	return *((int *) dynarr_index(ctx->buf, j));
+static int v_get(const Context *ctx, int k, int r)
+{
+	return ctx->v[v_index(k, r)];
 }
 
 static int find_middle_snake(const unsigned char *a, int aoff, int n, const unsigned char *b, int boff, int m, Context *ctx, Snake *ms)
@@ -249,58 +255,119 @@ static int ses_compute(const void *a, int aoff, int n, const void *b, int boff,
 	return d;
 }
 
-int diff_compare(const unsigned char *a, int aoff, int n, const unsigned char *b, int boff, int m, int dmax, DynArr *edits, DynArr *buf)
+/* Return the number of leading bytes that are equal in <a> and <b>, which are <n> bytes long. */
+static size_t trim_prefix(const unsigned char *a, const unsigned char *b, size_t n)
 {
-	Context			ctx;
-	int			d = 0, x, y;
-	DiffEdit 		*e = NULL;
-	DynArr			*tmp;
-	const unsigned char	*a0, *b0;
+	size_t	i;
+
+	for(i = 0; i + TRIM_BLOCK <= n && memcmp(a + i, b + i, TRIM_BLOCK) == 0; i += TRIM_BLOCK)
+		;
+	for(; i < n && a[i] == b[i]; i++)
+		;
+	return i;
+}
+
+/* Return the number of trailing bytes that are equal in <a> and <b>, which end at <a_end> and <b_end>,
+ * counting no more than <n>.
+*/
+static size_t trim_suffix(const unsigned char *a_end, const unsigned char *b_end, size_t n)
+{
+	size_t	i;
+
+	for(i = 0; i + TRIM_BLOCK <= n && memcmp(a_end - i - TRIM_BLOCK, b_end - i - TRIM_BLOCK, TRIM_BLOCK) == 0; i += TRIM_BLOCK)
+		;
+	for(; i < n && *(a_end - i - 1) == *(b_end - i - 1); i++)
+		;
+	return i;
+}
+
+/* Compare the parts of <a> and <b> that lie between the given number of equal leading and trailing
+ * bytes, which are trusted and not looked at. Returns the edit distance, or -1 on error.
+*/
+static int compare_window(const unsigned char *a, int aoff, int n, const unsigned char *b, int boff, int m,
+			  int head, int tail, int dmax, DynArr *edits, DynArr *buf)
+{
+	Context		ctx;
+	int		d = 0, x, s, mn, delta;
+	size_t		kmax;
+	DiffEdit 	*e;
+	DynArr		*tmp = NULL;
 
-	if(buf != NULL)
-		ctx.buf = buf;
-	else
-	{
-		tmp = dynarr_new(sizeof (int), 32);
-		ctx.buf = tmp;
-	}
 	ctx.ses = edits;
 	ctx.si = 0;
-	ctx.dmax = dmax ? dmax : INT_MAX;
+	ctx.dmax = dmax > 0 ? dmax : INT_MAX;
+	ctx.v = NULL;
 
 	if(edits)
 	{
 		if((e = dynarr_set(edits, 0, NULL)) == NULL)
-		{
-			if(buf == NULL)
-				dynarr_destroy(tmp);
 			return -1;
-		}
 		e->op = 0;
 	}
 
-         /* The ses_compute() function assumes the SES will begin or end with a delete
-          * or insert. The following will insure this is true by eating any initial
-	  * matches. This is also a quick way to process sequences that match entirely.
-          */
-	x = y = 0;
-	for(a0 = a + aoff, b0 = b + boff; x < n && y < m && a0[x] == b0[y]; x++, y++)
-		;
+	/* The ses_compute() function assumes the SES will begin or end with a delete or insert. Eating
+	 * any initial and final matches ensures this, and is a quick way to process sequences that mostly
+	 * match, as large text buffers with a small edit do.
+	*/
+	mn = (n < m ? n : m) - head - tail;
+	x = head + trim_prefix(a + aoff + head, b + boff + head, mn);
+	s = tail + trim_suffix(a + aoff + n - tail, b + boff + m - tail, mn - (x - head));
 	edit(&ctx, DIFF_MATCH, aoff, x);
+	n -= x + s;
+	m -= x + s;
 
-	if((d = ses_compute(a, aoff + x, n - x, b, boff + y, m - y, &ctx)) == -1)
+	delta = n > m ? n - m : m - n;
+	if(n > 0 && m > 0 && delta < ctx.dmax)
 	{
-		if(buf == NULL)
+		/* Paths never leave diagonals further out than the distance plus half of it, in any subproblem. */
+		kmax = (size_t) (n + m < ctx.dmax ? n + m : ctx.dmax) * 3 / 2 + 4;
+		if(buf == NULL && (buf = tmp = dynarr_new(sizeof (int), 32)) == NULL)
+			return -1;
+		if(dynarr_set(buf, 4 * kmax + 3, NULL) == NULL)
+			d = -1;
+		else
+		{
+			ctx.v = dynarr_index(buf, 0);
+			d = ses_compute(a, aoff + x, n, b, boff + x, m, &ctx);
+		}
+		if(tmp != NULL)
 			dynarr_destroy(tmp);
-		return -1;
+		if(d == -1)
+			return -1;
 	}
+	else if(n == 0 || m == 0)
+		d = ses_compute(a, aoff + x, n, b, boff + x, m, &ctx);
+	else
+		d = ctx.dmax;
 
-	if(buf == NULL)
-		dynarr_destroy(tmp);
+	/* If the distance is too great, nothing has been recorded, so just replace all of it. */
+	if(n > 0 && m > 0 && d >= ctx.dmax)
+	{
+		edit(&ctx, DIFF_DELETE, aoff + x, n);
+		edit(&ctx, DIFF_INSERT, boff + x, m);
+		d = n + m;
+	}
+	edit(&ctx, DIFF_MATCH, aoff + x + n, s);
 	return d;
 }
 
+int diff_compare(const unsigned char *a, int aoff, int n, const unsigned char *b, int boff, int m, int dmax, DynArr *edits, DynArr *buf)
+{
+	return compare_window(a, aoff, n, b, boff, m, 0, 0, dmax, edits, buf);
+}
+
 int diff_compare_simple(const void *a, size_t n, const void *b, size_t m, DynArr *edits)
 {
 	return diff_compare(a, 0, n,  b, 0, m,  0, edits, NULL);
 }
+
+int diff_compare_window(const void *a, size_t n, const void *b, size_t m, size_t head, size_t tail, int dmax, DynArr *edits)
+{
+	size_t	mn = n < m ? n : m;
+
+	if(head > mn)
+		head = mn;
+	if(tail > mn - head)
+		tail = mn - head;
+	return compare_window(a, 0, n, b, 0, m, head, tail, dmax, edits, NULL);
+}
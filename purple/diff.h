@@ -20,6 +20,13 @@ typedef struct
 /* Simple comparison, cuts down on number of arguments needed. */
 extern int	diff_compare_simple(const void *a, size_t n, const void *b, size_t m, DynArr *edits);
 
+/* Compare, knowing that the first <head> and last <tail> bytes of <a> and <b> are equal. Those are
+ * not looked at, which saves scanning large texts where only a small window has changed. If the edit
+ * distance reaches <dmax>, the differing part is replaced rather than diffed; 0 means no limit.
+*/
+extern int	diff_compare_window(const void *a, size_t n, const void *b, size_t m, size_t head, size_t tail,
+				    int dmax, DynArr *edits);
+
 /* Expose all bells and whistles of the diffing algorithm. */
 extern int	diff_compare(const unsigned char *a, int aoff, int n,
 			     const unsigned char *b, int boff, int m,
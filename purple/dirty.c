@@ -0,0 +1,219 @@
+/*
+ * dirty.c
+ * 
+ * Copyright (C) 2004 PDC, KTH. See COPYING for license details.
+ * 
+ * Dirty-tracking of blocks of slots. A block is dirty if its bit is set, or if it is at or
+ * beyond the <from> block. Bits are only allocated as far as they're needed, which is up to
+ * the highest block that has been marked or cleaned individually.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "log.h"
+#include "mem.h"
+
+#include "dirty.h"
+
+/* ----------------------------------------------------------------------------------------- */
+
+#define	WORD_BITS	(8 * sizeof (unsigned int))
+#define	NONE		((size_t) ~0)		/* Value of <from> when no trailing blocks are dirty. */
+
+/* Make sure there are bits for blocks up to and including <block>. */
+static int bits_need(Dirty *d, size_t block)
+{
+	size_t		nw = block / WORD_BITS + 1;
+	unsigned int	*nb;
+
+	if(nw <= d->words)
+		return 1;
+	if(nw < 2 * d->words)
+		nw = 2 * d->words;
+	if((nb = mem_realloc(d->bits, nw * sizeof *nb)) == NULL)
+	{
+		LOG_ERR(("Couldn't grow dirty bits to %u words", (unsigned int) nw));
+		return 0;
+	}
+	memset(nb + d->words, 0, (nw - d->words) * sizeof *nb);
+	d->bits  = nb;
+	d->words = nw;
+	return 1;
+}
+
+/* Set or clear the bits for blocks <b0> to <b1>, inclusive. */
+static void bits_put(Dirty *d, size_t b0, size_t b1, int value)
+{
+	size_t	i;
+
+	if(value && !bits_need(d, b1))
+	{
+		d->from = b0 < d->from ? b0 : d->from;	/* Can't remember them separately, so be safe. */
+		return;
+	}
+	for(i = b0; i <= b1 && i / WORD_BITS < d->words; i++)
+	{
+		if(value)
+			d->bits[i / WORD_BITS] |= 1u << (i % WORD_BITS);
+		else
+			d->bits[i / WORD_BITS] &= ~(1u << (i % WORD_BITS));
+	}
+}
+
+/* ----------------------------------------------------------------------------------------- */
+
+void dirty_init(Dirty *d, unsigned int shift)
+{
+	if(d == NULL)
+		return;
+	d->bits  = NULL;
+	d->words = 0;
+	d->from  = 0;
+	d->shift = shift;
+	d->resume = 0;
+}
+
+void dirty_mark(Dirty *d, size_t first, size_t num)
+{
+	size_t	b0, b1;
+
+	if(d == NULL || num == 0)
+		return;
+	b0 = first >> d->shift;
+	b1 = (first + num - 1) >> d->shift;
+	if(b1 >= d->from)
+	{
+		if(b0 >= d->from)
+			return;
+		b1 = d->from - 1;
+	}
+	bits_put(d, b0, b1, 1);
+}
+
+void dirty_mark_all(Dirty *d)
+{
+	if(d == NULL)
+		return;
+	if(d->bits != NULL)
+		memset(d->bits, 0, d->words * sizeof *d->bits);
+	d->from = 0;
+}
+
+void dirty_merge(Dirty *d, const Dirty *src)
+{
+	size_t	i;
+
+	if(d == NULL || src == NULL)
+		return;
+	if(d->shift != src->shift)
+	{
+		dirty_mark_all(d);
+		return;
+	}
+	if(src->from < d->from)
+		d->from = src->from;
+	for(i = 0; i < src->words; i++)
+	{
+		if(src->bits[i] == 0)
+			continue;
+		if(!bits_need(d, i * WORD_BITS + WORD_BITS - 1))
+		{
+			d->from = i * WORD_BITS < d->from ? i * WORD_BITS : d->from;
+			return;
+		}
+		d->bits[i] |= src->bits[i];
+	}
+}
+
+void dirty_clean(Dirty *d, size_t first, size_t num)
+{
+	size_t	b0, b1;
+
+	if(d == NULL || num == 0)
+		return;
+	b0 = first >> d->shift;
+	b1 = (first + num - 1) >> d->shift;
+	if(d->from <= b1)
+	{
+		if(d->from < b0)		/* Blocks between stay dirty, so they need bits now. */
+		{
+			if(!bits_need(d, b0 - 1))
+				return;
+			bits_put(d, d->from, b0 - 1, 1);
+		}
+		d->from = b1 + 1;
+	}
+	bits_put(d, b0, b1, 0);
+}
+
+void dirty_clear(Dirty *d)
+{
+	if(d == NULL)
+		return;
+	if(d->bits != NULL)
+		memset(d->bits, 0, d->words * sizeof *d->bits);
+	d->from = NONE;
+}
+
+int dirty_any(const Dirty *d, size_t size)
+{
+	size_t	end;
+
+	if(d == NULL || size == 0)
+		return 0;
+	return dirty_next(d, 0, size, &end) < size;
+}
+
+size_t dirty_next(const Dirty *d, size_t pos, size_t size, size_t *end)
+{
+	size_t		b, last, w;
+	unsigned int	word;
+
+	if(d == NULL || pos >= size)
+		return size;
+	b    = pos >> d->shift;
+	last = (size - 1) >> d->shift;
+	/* Scan the bits for the first dirty block, skipping whole clean words at a time. A word can
+	 * reach past <from>, and blocks there are dirty whatever their bits say, so never go beyond.
+	*/
+	while(b < d->from && b <= last)
+	{
+		w = b / WORD_BITS;
+		if(w >= d->words)
+		{
+			b = d->from;
+			break;
+		}
+		word = d->bits[w] >> (b % WORD_BITS);
+		if(word == 0)
+		{
+			b = (w + 1) * WORD_BITS;
+			if(b > d->from)
+				b = d->from;
+			continue;
+		}
+		while((word & 1) == 0)
+		{
+			word >>= 1;
+			b++;
+		}
+		if(b > d->from)
+			b = d->from;
+		break;
+	}
+	if(b > last)
+		return size;
+	if(end != NULL)
+		*end = b == last ? size : (b + 1) << d->shift;
+	return (b << d->shift) > pos ? (b << d->shift) : pos;
+}
+
+void dirty_free(Dirty *d)
+{
+	if(d == NULL)
+		return;
+	mem_free(d->bits);
+	d->bits  = NULL;
+	d->words = 0;
+}
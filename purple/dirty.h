@@ -0,0 +1,58 @@
+/*
+ * dirty.h
+ * 
+ * Copyright (C) 2004 PDC, KTH. See COPYING for license details.
+ * 
+ * Dirty-tracking for arrays of slots, such as the elements of a geometry layer or the tiles
+ * of a bitmap. Slots are grouped into blocks of 1 << shift, and a block is either dirty or
+ * clean. Everything at or beyond a certain block is always dirty, which makes a new tracker
+ * (and one that has been marked all dirty) cost nothing, regardless of the array's size.
+ * 
+ * This is used by the synchronizer, to only compare the parts of nodes that may have changed.
+*/
+
+#if !defined DIRTY_H
+#define	DIRTY_H
+
+typedef struct
+{
+	unsigned int	*bits;		/* One bit per block below <from>, set if the block is dirty. */
+	size_t		words;		/* Number of words allocated for <bits>. */
+	size_t		from;		/* Every block from this one on is dirty. */
+	unsigned int	shift;		/* Each block holds 1 << shift slots. */
+	size_t		resume;		/* Slot where the last scan ran out of send budget, see synchronizer. */
+} Dirty;
+
+/* Initialize a tracker for blocks of 1 << <shift> slots, with every slot dirty. */
+extern void	dirty_init(Dirty *d, unsigned int shift);
+
+/* Mark <num> slots starting at <first> as dirty. */
+extern void	dirty_mark(Dirty *d, size_t first, size_t num);
+extern void	dirty_mark_all(Dirty *d);
+
+/* Mark everything that is dirty in <src> as dirty in <d>, too. */
+extern void	dirty_merge(Dirty *d, const Dirty *src);
+
+/* Mark the blocks holding the <num> slots starting at <first> as clean. */
+extern void	dirty_clean(Dirty *d, size_t first, size_t num);
+
+/* Make every slot clean. */
+extern void	dirty_clear(Dirty *d);
+
+/* Returns non-zero if any of the first <size> slots are dirty. */
+extern int	dirty_any(const Dirty *d, size_t size);
+
+/* Find the first dirty slot at or after <pos>, in an array of <size> slots. Returns it, and
+ * sets <end> to the end of its block, or returns <size> if there is none. Use as follows:
+ * 
+ * for(i = dirty_next(d, 0, size, &end); i < size; i = dirty_next(d, end, size, &end))
+ * {
+ * 	Process slots <i> up to, but not including, <end>.
+ * }
+*/
+extern size_t	dirty_next(const Dirty *d, size_t pos, size_t size, size_t *end);
+
+/* Free the memory used by a tracker. It must be initialized again before being reused. */
+extern void	dirty_free(Dirty *d);
+
+#endif		/* DIRTY_H */
@@ -9,6 +9,10 @@
 #include <stdlib.h>
 #include <string.h>
 
+#if !defined _WIN32
+#include <pthread.h>
+#endif
+
 #include "log.h"
 #include "mem.h"
 #include "memchunk.h"
@@ -27,10 +31,29 @@ struct DynArr
 	const void	*def;
 	void		(*def_func)(unsigned int index, void *element, void *user);
 	void		*def_func_user;
+	unsigned int	refs;		/* Number of owners sharing the array, see dynarr_new_share(). */
 };
 
 static MemChunk *the_chunk = NULL;
 
+/* Shared arrays may be referenced from nodes that are used by different worker threads at once,
+ * so reference counts are changed under a lock, once threads are running. One lock for all
+ * arrays is enough, it is only held for the count update itself.
+*/
+#if !defined _WIN32
+static struct
+{
+	int		enabled;
+	pthread_mutex_t	lock;
+} dynarr_sync = { 0, PTHREAD_MUTEX_INITIALIZER };
+
+#define	LOCK()		do { if(dynarr_sync.enabled) pthread_mutex_lock(&dynarr_sync.lock); } while(0)
+#define	UNLOCK()	do { if(dynarr_sync.enabled) pthread_mutex_unlock(&dynarr_sync.lock); } while(0)
+#else
+#define	LOCK()
+#define	UNLOCK()
+#endif
+
 /* ----------------------------------------------------------------------------------------- */
 
 void dynarr_init(void)
@@ -38,6 +61,32 @@ void dynarr_init(void)
 	the_chunk = memchunk_new("DynArr", sizeof (DynArr), 4);
 }
 
+void dynarr_threads_set(int enabled)
+{
+#if !defined _WIN32
+	dynarr_sync.enabled = enabled;
+#endif
+}
+
+/* Drop one reference to <da>, and return the number left. The array is not freed. */
+static unsigned int refs_drop(DynArr *da)
+{
+	unsigned int	refs;
+
+	LOCK();
+	refs = --da->refs;
+	UNLOCK();
+	return refs;
+}
+
+/* Free an array whose last reference has been dropped. */
+static void array_free(DynArr *da)
+{
+	if(da->data != NULL)
+		mem_free(da->data);
+	memchunk_free(the_chunk, da);
+}
+
 /* ----------------------------------------------------------------------------------------- */
 
 DynArr * dynarr_new(size_t elem_size, size_t page_size)
@@ -55,6 +104,7 @@ DynArr * dynarr_new(size_t elem_size, size_t page_size)
 	da->next  = 0;
 	da->def = NULL;
 	da->def_func = NULL;
+	da->refs = 1;
 
 	return da;
 }
@@ -67,10 +117,9 @@ DynArr * dynarr_new_copy(const DynArr *src, void (*element_copy)(void *dst, cons
 	if(src == NULL)
 		return NULL;
 	da = dynarr_new(src->elem_size, src->page_size);
-	dynarr_set_default(da, src->def);
 	dynarr_set_default_func(da, src->def_func, src->def_func_user);
-	if(src->next > 0)		/* Sneakily "pre-warm" the array, to minimize allocations in loop below. */
-		dynarr_set(da, src->next - 1, NULL);
+	dynarr_set_default(da, src->def);	/* After the function, which clears it. */
+	dynarr_reserve(da, src->next);	/* Allocate all at once, rather than in the loop below. */
 	for(i = 0; i < src->next; i++)
 	{
 		void	*dst;
@@ -86,6 +135,61 @@ DynArr * dynarr_new_copy(const DynArr *src, void (*element_copy)(void *dst, cons
 	return da;
 }
 
+DynArr * dynarr_new_share(const DynArr *src)
+{
+	DynArr	*da = (DynArr *) src;
+
+	if(da != NULL)
+	{
+		LOCK();
+		da->refs++;
+		UNLOCK();
+	}
+	return da;
+}
+
+int dynarr_shared(const DynArr *da)
+{
+	int	shared;
+
+	if(da == NULL)
+		return 0;
+	LOCK();
+	shared = da->refs > 1;
+	UNLOCK();
+	return shared;
+}
+
+DynArr * dynarr_unshare(DynArr *da)
+{
+	DynArr	*nda;
+
+	/* Other owners can't modify the array while it's shared, so copying it without the lock held
+	 * is fine. If they all drop their references meanwhile, the last one to go frees it.
+	*/
+	if(!dynarr_shared(da))
+		return da;
+	if((nda = dynarr_new(da->elem_size, da->page_size)) == NULL)
+		return NULL;
+	if(da->alloc > 0)
+	{
+		if((nda->data = mem_alloc(da->alloc * da->elem_size)) == NULL)
+		{
+			memchunk_free(the_chunk, nda);
+			return NULL;
+		}
+		memcpy(nda->data, da->data, da->alloc * da->elem_size);
+	}
+	nda->alloc = da->alloc;
+	nda->next  = da->next;
+	nda->def   = da->def;
+	nda->def_func = da->def_func;
+	nda->def_func_user = da->def_func_user;
+	if(refs_drop(da) == 0)
+		array_free(da);
+	return nda;
+}
+
 size_t dynarr_get_elem_size(const DynArr *da)
 {
 	return da != NULL ? da->elem_size : 0;
@@ -116,45 +220,54 @@ void * dynarr_index(const DynArr *da, unsigned index)
 	return NULL;
 }
 
-void dynarr_grow(DynArr *da, unsigned int index, int default_at_index)
+/* Re-allocate the array to hold exactly <size> elements, which must be more than it holds now.
+ * New elements are defaulted, except the one at <skip> if there is a plain default element.
+*/
+static void resize(DynArr *da, size_t size, size_t skip)
 {
-	size_t	size;
 	void	*nd;
+	size_t	i;
 
-	/* Compute new size, might grow more than one page. */
-	size = da->page_size * ((da->alloc + index + 1 + da->page_size - 1) / da->page_size);
-	nd = mem_realloc(da->data, size * da->elem_size);
-
-	if(nd != NULL)
+	if((nd = mem_realloc(da->data, size * da->elem_size)) == NULL)
+		return;
+/*	LOG_MSG(("Dynarr: Grew array to %u elements of size %u", size, da->elem_size));*/
+	if(da->def != NULL)
 	{
-		unsigned int	i;
-
-/*		LOG_MSG(("Dynarr: Grew array to %u elements of size %u", size, da->elem_size));*/
-		if(da->def != NULL)
+		for(i = da->alloc; i < size; i++)
 		{
-			if(default_at_index)
-			{
-				for(i = da->alloc; i < size; i++)
-					memcpy((char *) nd + i * da->elem_size, da->def, da->elem_size);
-			}
-			else
-			{
-				for(i = da->alloc; i < size; i++)
-				{
-					if(i == index)
-						continue;
-					memcpy((char *) nd + i * da->elem_size, da->def, da->elem_size);
-				}
-			}
+			if(i == skip)
+				continue;
+			memcpy((char *) nd + i * da->elem_size, da->def, da->elem_size);
 		}
-		else if(da->def_func != NULL)	/* FIXME: The semantics here are a bit odd, ignore index_at_default. Entrenched assumption. :/ */
-		{
-			for(i = da->alloc; i < size; i++)
-				da->def_func(i, (char *) nd + i * da->elem_size, da->def_func_user);
-		}
-		da->data  = nd;
-		da->alloc = size;
 	}
+	else if(da->def_func != NULL)	/* FIXME: The semantics here are a bit odd, ignore index_at_default. Entrenched assumption. :/ */
+	{
+		for(i = da->alloc; i < size; i++)
+			da->def_func(i, (char *) nd + i * da->elem_size, da->def_func_user);
+	}
+	da->data  = nd;
+	da->alloc = size;
+}
+
+void dynarr_grow(DynArr *da, unsigned int index, int default_at_index)
+{
+	size_t	size;
+
+	if(index < da->alloc)
+		return;
+	/* Grow geometrically, so filling an array one element at a time is linear. */
+	size = 2 * da->alloc;
+	if(size < (size_t) index + 1)
+		size = (size_t) index + 1;
+	size = da->page_size * ((size + da->page_size - 1) / da->page_size);
+	resize(da, size, default_at_index ? ~(size_t) 0 : index);
+}
+
+void dynarr_reserve(DynArr *da, size_t size)
+{
+	if(da == NULL || size <= da->alloc)
+		return;
+	resize(da, da->page_size * ((size + da->page_size - 1) / da->page_size), ~(size_t) 0);
 }
 
 void * dynarr_set(DynArr *da, unsigned int index, const void *element)
@@ -206,10 +319,6 @@ void dynarr_clear(DynArr *da)
 
 void dynarr_destroy(DynArr *da)
 {
-	if(da != NULL)
-	{
-		if(da->data != NULL)
-			mem_free(da->data);
-		memchunk_free(the_chunk, da);
-	}
+	if(da != NULL && refs_drop(da) == 0)	/* If still shared, just drop this reference. */
+		array_free(da);
 }
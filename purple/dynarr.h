@@ -18,8 +18,14 @@ typedef struct DynArr	DynArr;
 /* Initialize dynarr module. This must be called before any of the below functions are used. */
 extern void	dynarr_init(void);
 
+/* Make sharing arrays safe between threads, see dynarr_new_share(). Off by default, turned on if
+ * worker threads are started.
+*/
+extern void	dynarr_threads_set(int enabled);
+
 /* Create a new dynamic array with the given element and page sizes. Arrays hold actual
- * elements, not just pointers to them, and grow by <page_size> elements at a time.
+ * elements, not just pointers to them. They grow by doubling, with the allocated size
+ * always a multiple of <page_size> elements.
 */
 extern DynArr *	dynarr_new(size_t elem_size, size_t page_size);
 
@@ -31,6 +37,21 @@ extern DynArr *	dynarr_new(size_t elem_size, size_t page_size);
 */
 extern DynArr *	dynarr_new_copy(const DynArr *src, void (*element_copy)(void *dst, const void *src, void *user), void *user);
 
+/* Return a new reference to the <src> array, sharing its storage rather than copying it. This is
+ * for copy-on-write use: a shared array must not be modified, call dynarr_unshare() first. Each
+ * reference is released by dynarr_destroy(), the array itself goes away with the last one.
+*/
+extern DynArr *	dynarr_new_share(const DynArr *src);
+
+/* Returns non-zero if the array has more than one reference, i.e. it must not be modified. */
+extern int	dynarr_shared(const DynArr *da);
+
+/* Return an array that is safe to modify in place of <da>. If <da> is shared, this drops one
+ * reference to it and returns a private copy, else it simply returns <da>. Elements are copied
+ * byte for byte, so arrays holding pointers to owned data should not be shared.
+*/
+extern DynArr *	dynarr_unshare(DynArr *da);
+
 /* Return elem_size from creation. Handy for external indexing. */
 extern size_t	dynarr_get_elem_size(const DynArr *da);
 
@@ -53,9 +74,15 @@ extern void *	dynarr_index(const DynArr *da, unsigned index);
  * will not be initialized to the default. This limiting *ONLY* affects "simple" arrays,
  * i.e. arrays that do not use a a defaulting function. Defaulting functions are always
  * called as new elements are allocated, regardless of the <default_at_index> value.
+ * Does nothing if <index> is already allocated.
 */
 extern void	dynarr_grow(DynArr *da, unsigned int index, int default_at_index);
 
+/* Make room for at least <size> elements, so that setting indices below that doesn't have to
+ * re-allocate. Newly allocated elements are defaulted. Does not change the array's size.
+*/
+extern void	dynarr_reserve(DynArr *da, size_t size);
+
 /* Set the given index to the given content. Causes the array to re-allocate itself if
  * the indicated position is outside its current bounds. Returns pointer to element in
  * array. The initializer <element> may be NULL to do allocation only.
@@ -74,7 +101,7 @@ extern void	dynarr_sort(DynArr *da, int (*cmp)(const void *el1, const void *el2)
 /* Clear an existing dynamic array, freeing all the stored data, making append start at 0. */
 extern void	dynarr_clear(DynArr *da);
 
-/* Destroy an array and all the elements held in it. */
+/* Destroy an array and all the elements held in it. If the array is shared, this just drops a reference. */
 extern void	dynarr_destroy(DynArr *da);
 
 #endif		/* DYNARR_H */
@@ -91,6 +91,7 @@
 
 <purple-plugins>
 <plug-in id="1" name="node-input">
+ <flag name="side-effects" value="true"/>
  <inputs>
   <input type="string">
    <name>name</name>
@@ -245,6 +246,8 @@
  *   - \c mod_set_r64m16(uint32 graph_id, uint32 module_id, uint8 input_id, real64_mat16 value) -- Set an input to a 4x4 matrix of 64-bit floating point values.
  *   - \c mod_set_string(uint32 graph_id, uint32 module_id, uint8 input_id, string value) -- Set an input to a text string.
  *   - \c mod_set_module(uint32 graph_id, uint32 module_id, uint8 input_id, uint32 value) -- Set an input to reference another module's output. Creates graph edges.
+ * - Batched editing
+ *   - \c batch(uint32 graph_id, string ops) -- Apply a sequence of module edits to a graph, all at once.
  * 
  * The methods are defined using the types from the Verse specification; the above are not C prototypes. The type names have been slightly
  * simplified to keep the method list readable (lower-cased, and the prefix \c VN_O_METHOD_PTYPE_ has been removed). How to map the methods into whatever
@@ -282,6 +285,20 @@
  *     -# If the input index is valid, the internal representation is modified according to the method call.
  *     -# The module is scheduled for re-computation, since an input changed.
  *     -# The change is made public by updating the user-supplied graph text buffer, editing (or removing) a \c set element.
+ * -# The \c batch() method carries any number of the module edits above, packed as text with one edit per line:
+ *     - <tt>c PLUGIN</tt> -- Create an instance of a plug-in, like \c mod_create().
+ *     - <tt>d MODULE</tt> -- Destroy a module, like \c mod_destroy().
+ *     - <tt>x MODULE INPUT</tt> -- Clear an input, like \c mod_input_clear().
+ *     - <tt>s MODULE INPUT TYPE VALUE</tt> -- Set an input. \c TYPE is a value type name as used in the plug-ins XML, such as \c real32_vec3
+ *       or \c module, and \c VALUE is written like in a \c set element, e.g. <tt>[1 2 3]</tt>. String values extend to the end of the line.
+ *     .
+ *    A \c MODULE (including the \c VALUE of a \c module input) written as <tt>\@N</tt> refers to the N:th module created earlier in the
+ *    same batch, counting from zero. The whole batch is checked before any of it is applied; if any line is malformed, refers to a module
+ *    or plug-in that doesn't exist (or to a module destroyed earlier in the batch), or sets a link that would make the graph cyclic given
+ *    the edits before it, nothing happens. The same goes if a module can't be created. Otherwise the edits are applied in order, after
+ *    which the graph text buffer is updated in one go, and all modules whose inputs changed are scheduled together. This is cheaper than
+ *    sending the edits one by one, and means the published XML never shows a half-done edit. The text is sent as a single string, and can
+ *    be at most 1400 bytes long; larger edits must be split into several batches, at points where no \c \@N reference crosses over.
  * 
  * Basically, "all" a Purple user interface client has to do is parse all the related XML, figure out ways to present
  * the information to a user, and allow interaction with it. Interaction needs to result in methods being called, which
@@ -315,6 +332,7 @@
 #include "log.h"
 #include "mem.h"
 #include "memchunk.h"
+#include "outbuf.h"
 #include "value.h"
 #include "nodeset.h"
 #include "plugins.h"
@@ -355,8 +373,17 @@ typedef struct
 	boolean	changed;	/* Output changed recently? Don't notify all the time... */
 	ONodes	nodes;		/* Output nodes. Caches between invocations, using 'label' on create(). */
 	List	*resume;	/* Information about output nodes, from resume parse of old XML. */
+	uint32	version;	/* Identifies the output's contents, new whenever they change. */
+	uint32	recall;		/* Version to go back to on end(), if output was restored from memo cache. */
+	uint32	prev;		/* Version before begin(), kept by end() if contents turn out to be the same. */
+	PValue	last;		/* Value as of the last notifying end(), compared to the new one. */
+	NdbHash	fingerprint;	/* Hash of nodes as of the last notifying end(), see output_fingerprint(). */
+	boolean	fingerprinted;	/* Set when last and fingerprint are valid; not all node types can be hashed. */
+	unsigned long suppressed; /* Number of end()s that found the output unchanged, and didn't notify. */
 } Output;
 
+typedef struct Module	Module;
+
 struct Graph
 {
 	char	name[32];
@@ -366,11 +393,18 @@ struct Graph
 	VNodeID	node;
 	uint16	buffer;
 	uint32	desc_start;		/* Base location in graph XML buffer, first module starts here. */
+	uint32	*desc_tree;		/* Fenwick tree of module description lengths, see desc_tree_prefix(). */
+	uint32	desc_size;		/* Number of module IDs covered by the tree. */
+	uint32	*dirty;			/* IDs of modules whose descriptions need publishing. */
+	size_t	dirty_num, dirty_alloc;
 	IdSet	*modules;
+	Module	**topo;			/* All modules, in topological order. Indexed by Module.order. */
+	uint32	topo_size, topo_alloc;
+	boolean	batch;			/* Set while a batch is applied. Defers scheduling. */
 };
 
 /* A module is an instance of a plug-in, i.e. a node in a Graph. Can't call it "node", collides w/ Verse. */
-typedef struct
+struct Module
 {
 	uint32		id;
 	Graph		*graph;		/* Which graph does this module belong to? */
@@ -378,8 +412,13 @@ typedef struct
 	PInstance	instance;	/* Input values, state data. */
 	Output		out;		/* Things having to do with output/result, see above. */
 
-	uint32		start, length;	/* Region in graph XML buffer used for this module. */
-} Module;
+	char		*desc;		/* Description as currently published in graph XML buffer, or NULL. */
+	uint32		length;		/* Length of the above. Region starts at sum of all lower IDs' lengths. */
+	boolean		dirty;		/* Set when description needs publishing, see graph_update(). */
+	uint32		order;		/* Topological position in graph; sources always come first. */
+	uint32		visit;		/* Traversal marker, compared against graph_info.visit. */
+	boolean		pending;	/* Needs scheduling once the current batch is done. */
+};
 
 /* Bookkeeping structure used to keep track of the various methods used to control the Purple engine. */
 typedef struct
@@ -400,6 +439,7 @@ enum
 	MOD_INPUT_SET_REAL64, MOD_INPUT_SET_REAL64_VEC2, MOD_INPUT_SET_REAL64_VEC3, MOD_INPUT_SET_REAL64_VEC4, MOD_INPUT_SET_REAL64_MAT16,
 	MOD_INPUT_SET_STRING,
 	MOD_INPUT_SET_MODULE,
+	BATCH
 };
 
 /* Create name of input-setting method. */
@@ -441,7 +481,8 @@ static MethodInfo method_info[] = {
 	MI_INPUT_VEC(r64, REAL64, 4),
 	MI_INPUT(r64m16, REAL64_MAT16),
 	MI_INPUT(string, STRING),
-	MI_INPUT(module, UINT32)
+	MI_INPUT(module, UINT32),
+	{ "batch", 2, { VN_O_METHOD_PTYPE_UINT32, VN_O_METHOD_PTYPE_STRING }, { "graph_id", "ops" } }
 };
 
 static struct
@@ -451,11 +492,18 @@ static struct
 	Hash		*graphs_name;	/* Graphs hashed on name. */
 
 	MemChunk	*chunk_module;
+
+	unsigned int	order_serial;	/* Incremented whenever modules in any graph change order. */
+	uint32		visit;		/* Serial number of current traversal, for Module.visit. */
+	Module		**scratch;	/* Search stack, followed by found modules. See order_search(). */
+	uint32		*slot;		/* Order positions being handed out, by graph_order_link(). */
+	size_t		scratch_alloc;
+	uint32		output_version;	/* Source of Output.version numbers. */
 } graph_info = { sizeof method_info / sizeof *method_info };
 
 /* ----------------------------------------------------------------------------------------- */
 
-static void	module_create(unsigned int module_id, uint32 graph_id, uint32 plugin_id);
+static Module *	module_create(unsigned int module_id, uint32 graph_id, uint32 plugin_id);
 static void	module_input_set_from_string(Graph *g, uint32 module_id, uint8 input_index, PValueType type, ...);
 static void	module_input_clear_links_to(Graph *g, uint32 module_id, uint32 rm);
 static void	module_describe(Module *m);
@@ -592,7 +640,14 @@ static Graph * graph_create(unsigned int id, VNodeID node_id, uint16 buffer_id,
 		}
 	}
 	g->desc_start = 0;
+	g->desc_tree = NULL;
+	g->desc_size = 0;
+	g->dirty = NULL;
+	g->dirty_num = g->dirty_alloc = 0;
 	g->modules = NULL;		/* Be a bit lazy. */
+	g->topo = NULL;
+	g->topo_size = g->topo_alloc = 0;
+	g->batch = FALSE;
 
 	for(i = 0, pos = client_info.graphs.start; i < id; i++)
 	{
@@ -607,7 +662,7 @@ static Graph * graph_create(unsigned int id, VNodeID node_id, uint16 buffer_id,
 	verse_send_t_text_set(client_info.meta, client_info.graphs.buffer, me->index_start, 0, xml);
 	hash_insert(graph_info.graphs_name, me->name, me);
 	snprintf(xml, sizeof xml, "<graph>\n</graph>\n");
-	verse_send_t_text_set(me->node, me->buffer, 0, ~0u, xml);
+	outbuf_t_text_set(me->node, me->buffer, 0, ~0u, xml, strlen(xml));
 	me->desc_start = strchr(xml, '/') - xml - 1;
 
 	return me;
@@ -784,6 +839,9 @@ static void graph_destroy(uint32 id)
 	g->name[0] = '\0';
 	hash_remove(graph_info.graphs_name, g->name);
 	idset_remove(graph_info.graphs, id);
+	mem_free(g->topo);
+	mem_free(g->desc_tree);
+	mem_free(g->dirty);
 	mem_free(g);
 	verse_send_t_text_set(client_info.meta, client_info.graphs.buffer, g->index_start, g->index_length, NULL);
 	graph_index_renumber();
@@ -791,17 +849,206 @@ static void graph_destroy(uint32 id)
 
 /* ----------------------------------------------------------------------------------------- */
 
-static void module_dep_add(const Graph *g, uint32 module_id, uint32 dep_new)
+/* The modules of each graph are kept in topological order at all times, in the graph's topo
+ * array, with each module's position in Module.order. The order is maintained incrementally, as
+ * described by Pearce and Kelly: a new link that already points forward in the order costs nothing,
+ * otherwise only the modules ordered between its two ends are searched, and then shuffled around.
+ * Removing a link never breaks the order. Searches use an explicit stack rather than recursion.
+*/
+
+/* Make sure the scratch arrays have room for <num> modules. */
+static boolean order_scratch_grow(size_t num)
+{
+	Module	**ns;
+	uint32	*nslot;
+
+	if(num <= graph_info.scratch_alloc)
+		return TRUE;
+	if((ns = mem_realloc(graph_info.scratch, 2 * num * sizeof *ns)) == NULL)
+		return FALSE;
+	graph_info.scratch = ns;
+	if((nslot = mem_realloc(graph_info.slot, num * sizeof *nslot)) == NULL)
+		return FALSE;
+	graph_info.slot = nslot;
+	graph_info.scratch_alloc = num;
+	return TRUE;
+}
+
+/* Push <m> onto search stack, unless already visited or outside the order range being searched. */
+static void order_search_push(Module *m, uint32 lo, uint32 hi, size_t *top)
+{
+	if(m->visit == graph_info.visit || m->order < lo || m->order > hi)
+		return;
+	m->visit = graph_info.visit;
+	graph_info.scratch[(*top)++] = m;
+}
+
+/* Find the modules reachable from <start> whose order is in [lo,hi], following links downstream
+ * if <forward> is set, upstream otherwise. They are appended to the found-array at <*num>. Stops
+ * and returns FALSE if <goal> is reached. Caller must bump graph_info.visit, and grow scratch.
+*/
+static boolean order_search(const Graph *g, Module *start, boolean forward, uint32 lo, uint32 hi, const Module *goal, size_t *num)
+{
+	Module		**found = graph_info.scratch + graph_info.scratch_alloc, *m, *next;
+	size_t		top = 0, i, ni;
+	IdListIter	iter;
+	uint32		id;
+
+	start->visit = graph_info.visit;
+	graph_info.scratch[top++] = start;
+	while(top > 0)
+	{
+		m = graph_info.scratch[--top];
+		found[(*num)++] = m;
+		if(forward)
+		{
+			for(idlist_foreach_init(&m->out.dependants, &iter); idlist_foreach_step(&m->out.dependants, &iter); )
+			{
+				if((next = idset_lookup(g->modules, iter.id)) == NULL)
+					continue;
+				if(next == goal)
+					return FALSE;
+				order_search_push(next, lo, hi, &top);
+			}
+		}
+		else
+		{
+			ni = plugin_portset_size(m->instance.inputs);
+			for(i = 0; i < ni; i++)
+			{
+				if(!plugin_portset_get_module(m->instance.inputs, i, &id) || (next = idset_lookup(g->modules, id)) == NULL)
+					continue;
+				if(next == goal)
+					return FALSE;
+				order_search_push(next, lo, hi, &top);
+			}
+		}
+	}
+	return TRUE;
+}
+
+/* Answer TRUE if <to> depends, directly or indirectly, on <from>. Only modules ordered between
+ * the two can be on a path connecting them, so the search stays within that region.
+*/
+static boolean module_reaches(const Graph *g, Module *from, const Module *to)
+{
+	size_t	num = 0;
+
+	if(from == to || from->order >= to->order)
+		return FALSE;
+	if(!order_scratch_grow(g->topo_size))
+		return TRUE;		/* Can't tell, so assume the worst. */
+	graph_info.visit++;
+	return !order_search(g, from, TRUE, from->order, to->order, to, &num);
+}
+
+static int cmp_module_order(const void *a, const void *b)
+{
+	const Module	*m1 = *(const Module **) a, *m2 = *(const Module **) b;
+
+	return m1->order < m2->order ? -1 : m1->order > m2->order;
+}
+
+static int cmp_slot(const void *a, const void *b)
+{
+	const uint32	s1 = *(const uint32 *) a, s2 = *(const uint32 *) b;
+
+	return s1 < s2 ? -1 : s1 > s2;
+}
+
+/* Add a newly created module last in its graph's order. It has no links yet, so that is fine. */
+static void graph_order_append(Graph *g, Module *m)
+{
+	if(g->topo_size >= g->topo_alloc)
+	{
+		uint32	na = g->topo_alloc > 0 ? 2 * g->topo_alloc : 16;
+		Module	**nt;
+
+		if((nt = mem_realloc(g->topo, na * sizeof *nt)) == NULL)
+		{
+			LOG_ERR(("Couldn't grow order of graph %s to %u modules", g->name, na));
+			return;
+		}
+		g->topo = nt;
+		g->topo_alloc = na;
+	}
+	m->order = g->topo_size;
+	g->topo[g->topo_size++] = m;
+}
+
+/* Remove a module that is going away from the order. Everything after it moves up one step. */
+static void graph_order_remove(Graph *g, Module *m)
+{
+	uint32	i;
+
+	if(m->order >= g->topo_size || g->topo[m->order] != m)
+		return;
+	for(i = m->order + 1; i < g->topo_size; i++)
+	{
+		g->topo[i - 1] = g->topo[i];
+		g->topo[i - 1]->order = i - 1;
+	}
+	g->topo_size--;
+	graph_info.order_serial++;
+}
+
+/* A link was added, making <to> depend on <from>. If <to> was ordered before <from>, find the
+ * modules downstream of <to> and upstream of <from> within that range, and reassign their
+ * positions so that all the upstream ones come first. Each set keeps its internal order.
+*/
+static void graph_order_link(Graph *g, Module *from, Module *to)
+{
+	Module	**found;
+	size_t	nf = 0, num, i, j;
+	uint32	lb, ub;
+
+	if(to == NULL || from == to)
+		return;
+	if((lb = to->order) > (ub = from->order))	/* Already in order, which is the common case. */
+		return;
+	if(!order_scratch_grow(g->topo_size))
+		return;
+	graph_info.visit++;
+	if(!order_search(g, to, TRUE, lb, ub, from, &nf))
+	{
+		LOG_WARN(("Link from module %u to %u in graph %s is cyclic, order not updated", from->id, to->id, g->name));
+		return;
+	}
+	num = nf;
+	graph_info.visit++;
+	order_search(g, from, FALSE, lb, ub, NULL, &num);
+
+	found = graph_info.scratch + graph_info.scratch_alloc;
+	qsort(found, nf, sizeof *found, cmp_module_order);
+	qsort(found + nf, num - nf, sizeof *found, cmp_module_order);
+	for(i = 0; i < num; i++)
+		graph_info.slot[i] = found[i]->order;
+	qsort(graph_info.slot, num, sizeof *graph_info.slot, cmp_slot);
+	for(i = 0, j = nf; j < num; j++, i++)		/* Upstream set first. */
+	{
+		found[j]->order = graph_info.slot[i];
+		g->topo[graph_info.slot[i]] = found[j];
+	}
+	for(j = 0; j < nf; j++, i++)			/* Then downstream. */
+	{
+		found[j]->order = graph_info.slot[i];
+		g->topo[graph_info.slot[i]] = found[j];
+	}
+	graph_info.order_serial++;
+}
+
+static void module_dep_add(Graph *g, uint32 module_id, uint32 dep_new)
 {
 	Module	*m;
 
 	if((m = idset_lookup(g->modules, module_id)) == NULL)
 		return;
 	idlist_insert(&m->out.dependants, dep_new);
+	graph_order_link(g, m, idset_lookup(g->modules, dep_new));
 	printf("dep %u added\n", dep_new);
 }
 
-static void module_dep_remove(const Graph *g, uint32 module_id, uint32 dep_old)
+static void module_dep_remove(Graph *g, uint32 module_id, uint32 dep_old)
 {
 	Module	*m;
 
@@ -839,6 +1086,9 @@ void graph_port_output_begin(PPOutput port)
 
 	port_clear(port);
 	m->out.changed = FALSE;
+	m->out.prev    = m->out.version;
+	m->out.version = ++graph_info.output_version;	/* Contents are in flux until end(). */
+	m->out.recall = 0;
 }
 
 void graph_port_output_set(PPOutput port, PValueType type, ...)
@@ -984,22 +1234,97 @@ PONode * graph_port_output_node_copy(PPOutput port, PINode *node, uint32 label)
 	return NULL;
 }
 
+/* Compute a fingerprint of an output's nodes. They are included both by identity, since dependants
+ * hold on to them, and by content. Fails if a node's type can't be hashed. The value is not part
+ * of it, it's small enough to simply be kept and compared.
+*/
+static boolean output_fingerprint(const Output *out, NdbHash *fingerprint)
+{
+	const PNode	*n;
+	unsigned int	i;
+	NdbHash		h = NDB_HASH_INIT, nh;
+
+	for(i = 0; (n = nodeset_retrieve_nth(out->port.nodes, i)) != NULL; i++)
+	{
+		if(!nodedb_hash(n, &nh))
+			return FALSE;
+		h = (h ^ (NdbHash) (size_t) n) * NDB_HASH_CONST(1099511628211);
+		h = (h ^ nh) * NDB_HASH_CONST(1099511628211);
+	}
+	*fingerprint = h;
+	return TRUE;
+}
+
 void graph_port_output_end(PPOutput port)
 {
 	Module		*m = MODULE_FROM_PORT(port), *dep;
 	IdListIter	iter;
+	NdbHash		fp;
 
-	if(m->out.changed)
+	if(!m->out.changed)
 	{
-		/* Our output changed, so ask scheduler to compute() any dependant modules. */
-		for(idlist_foreach_init(&m->out.dependants, &iter); idlist_foreach_step(&m->out.dependants, &iter); )
+		m->out.fingerprinted = FALSE;	/* Port was cleared by begin(), fingerprint is stale. */
+		return;
+	}
+	if(output_fingerprint(&m->out, &fp))
+	{
+		if(m->out.fingerprinted && fp == m->out.fingerprint && value_equal(&m->out.port.value, &m->out.last))
 		{
-			if((dep = idset_lookup(m->graph->modules, iter.id)) != NULL)
-				sched_add(&dep->instance);
-			else
-				printf("Couldn't find module %u in graph %s, a dependant of module %u\n", iter.id, m->graph->name, m->id);
+			/* Same output as last time, so keep its version and let dependants be. */
+			m->out.version = m->out.prev;
+			m->out.suppressed++;
+			return;
+		}
+		m->out.fingerprint = fp;
+		value_copy(&m->out.last, &m->out.port.value);
+		m->out.fingerprinted = TRUE;
+	}
+	else
+		m->out.fingerprinted = FALSE;
+	m->out.version = m->out.recall != 0 ? m->out.recall : ++graph_info.output_version;
+	/* Our output changed, so ask scheduler to compute() any dependant modules. */
+	for(idlist_foreach_init(&m->out.dependants, &iter); idlist_foreach_step(&m->out.dependants, &iter); )
+	{
+		if((dep = idset_lookup(m->graph->modules, iter.id)) != NULL)
+			sched_add(&dep->instance);
+		else
+			printf("Couldn't find module %u in graph %s, a dependant of module %u\n", iter.id, m->graph->name, m->id);
+	}
+}
+
+uint32 graph_port_output_version(PPOutput port)
+{
+	return (MODULE_FROM_PORT(port))->out.version;
+}
+
+/* Set output's values to a copy of <value>, and have it go back to <version> when done. Nodes are
+ * restored separately, through the ordinary node output calls.
+*/
+void graph_port_output_recall(PPOutput port, const PValue *value, uint32 version)
+{
+	Module	*m = MODULE_FROM_PORT(port);
+
+	value_copy(&port->value, value);
+	m->out.changed = TRUE;
+	m->out.recall  = version;
+}
+
+/* Find the label of <node>, if it is one of the nodes created by the module owning <port>. */
+boolean graph_port_output_node_label(PPOutput port, const PNode *node, uint32 *label)
+{
+	Module	*m = MODULE_FROM_PORT(port);
+	PNode	**n;
+	uint32	i;
+
+	for(i = 0; i < m->out.nodes.next; i++)
+	{
+		if((n = dynarr_index(m->out.nodes.node, i)) != NULL && *n == node)
+		{
+			*label = i;
+			return TRUE;
 		}
 	}
+	return FALSE;
 }
 
 static void cb_node_output_notify(PNode *node, NodeNotifyEvent e, void *user)
@@ -1019,68 +1344,47 @@ void graph_port_output_create_notify(const PNode *local)
 
 /* ----------------------------------------------------------------------------------------- */
 
-/* Information used while traversing modules checking for cycles, helps keep argument count down. */
-struct traverse_info
+unsigned int graph_order_serial(void)
 {
-	uint32	module_id;
-	uint8	input;
-	uint32	source;
-};
+	return graph_info.order_serial;
+}
 
-/* Traverse module links from <module_id>, looking for <source_id>. Returns FALSE if cyclic link found. */
-static boolean traverse_module(const Graph *g, uint32 module_id, uint32 source_id, const struct traverse_info *ti)
+void graph_port_output_order(PPOutput port, const Graph **graph, unsigned int *order)
 {
-	const Module	*m;
+	Module	*m = MODULE_FROM_PORT(port);
 
-	if((m = idset_lookup(g->modules, module_id)) != NULL)
-	{
-		unsigned int	i;
+	if(graph != NULL)
+		*graph = m->graph;
+	if(order != NULL)
+		*order = m->order;
+}
 
-		for(i = plugin_portset_size(m->instance.inputs); i-- > 0;)
-		{
-			uint32	link;
+boolean graph_port_output_reaches(PPOutput from, PPOutput to)
+{
+	Module	*mf = MODULE_FROM_PORT(from), *mt = MODULE_FROM_PORT(to);
 
-			if(module_id == ti->module_id && i == ti->input)
-				link = ti->source;
-			else if(plugin_portset_get_module(m->instance.inputs, i, &link) && idset_lookup(g->modules, link))
-				;
-			else
-				continue;
-			if(link == source_id)
-				return FALSE;
-			if(!traverse_module(g, link, source_id, ti))
-				return FALSE;
-		}
-	}
-	return TRUE;
+	if(mf->graph != mt->graph)
+		return FALSE;
+	return module_reaches(mf->graph, mf, mt);
 }
 
-/* Answer the fairly specific question: does the graph <graph_id> become cyclic if module
- * <module_id>'s <input>:th input is set to be <source>? Used to disallow such setting.
- * This implementation is totally naive, and requires O(n^2) for a graph with n nodes.
+/* ----------------------------------------------------------------------------------------- */
+
+/* Answer the fairly specific question: does the graph <graph_id> become cyclic if one of module
+ * <module_id>'s inputs is set to be <source>? Used to disallow such setting. That happens exactly
+ * when <source> already depends on the module; an existing link being replaced can't be part of
+ * such a path, since the graph is acyclic. Only modules ordered between the two are searched.
 */
-static boolean graph_cyclic_after(uint32 graph_id, uint32 module_id, uint8 input, uint32 source)
+static boolean graph_cyclic_after(uint32 graph_id, uint32 module_id, uint32 source)
 {
 	const Graph	*g;
-	unsigned int	i;
-	size_t		num;
-	struct traverse_info	ti;
+	Module		*m, *src;
 
 	if((g = idset_lookup(graph_info.graphs, graph_id)) == NULL)
 		return FALSE;
-
-	num = idset_size(g->modules);
-
-	ti.module_id = module_id;
-	ti.input     = input;
-	ti.source    = source;
-
-	for(i = 0; i < num; i++)
-	{
-		if(!traverse_module(g, i, i, &ti))
-			return TRUE;
-	}
-	return FALSE;
+	if((m = idset_lookup(g->modules, module_id)) == NULL || (src = idset_lookup(g->modules, source)) == NULL)
+		return FALSE;
+	return m == src || module_reaches(g, m, src);
 }
 
 /* ----------------------------------------------------------------------------------------- */
@@ -1110,34 +1414,199 @@ static DynStr * module_build_desc(const Module *m)
 	return d;
 }
 
-/* Update start positions of module descriptions. Handy when one changes/appears. */
-static void graph_modules_desc_start_update(Graph *g)
+/* Module descriptions are laid out in the graph XML buffer in order of module ID. Their lengths
+ * are held in a Fenwick tree indexed by ID, so that finding where a module's description starts,
+ * and changing its length, both take O(log n) time. Index i (from 1) holds the sum of lengths for
+ * the IDs i - (i & -i) to i - 1.
+*/
+
+/* Make the tree cover <id>. Rebuilt from the modules' lengths, since new nodes cover old IDs too. */
+static boolean desc_tree_grow(Graph *g, uint32 id)
 {
-	unsigned int	id;
+	uint32		size, *tree, i, j;
+	unsigned int	mid;
 	Module		*m;
-	size_t		pos;
 
-	for(id = idset_foreach_first(g->modules), pos = g->desc_start;
-	    (m = idset_lookup(g->modules, id)) != NULL;
-	    id = idset_foreach_next(g->modules, id))
+	if(id < g->desc_size)
+		return TRUE;
+	for(size = g->desc_size > 0 ? g->desc_size : 16; size <= id; size *= 2)
+		;
+	if((tree = mem_realloc(g->desc_tree, (size + 1) * sizeof *tree)) == NULL)
+		return FALSE;
+	memset(tree, 0, (size + 1) * sizeof *tree);
+	for(mid = idset_foreach_first(g->modules); (m = idset_lookup(g->modules, mid)) != NULL && mid < size; mid = idset_foreach_next(g->modules, mid))
+		tree[mid + 1] = m->length;	/* Modules above the old size are unpublished, so that's all. */
+	for(i = 1; i <= size; i++)
 	{
-		m->start = pos;
-		pos += m->length;
+		if((j = i + (i & -i)) <= size)
+			tree[j] += tree[i];
 	}
+	g->desc_tree = tree;
+	g->desc_size = size;
+	return TRUE;
 }
 
-/* Update description of module <m>. */
-static void module_describe(Module *m)
+/* Add <delta> to length of module <id>, which must be covered by the tree. Wraps around to subtract. */
+static void desc_tree_add(Graph *g, uint32 id, uint32 delta)
+{
+	uint32	i;
+
+	for(i = id + 1; i <= g->desc_size; i += i & -i)
+		g->desc_tree[i] += delta;
+}
+
+/* Return total length of descriptions of all modules with IDs below <id>. */
+static uint32 desc_tree_prefix(const Graph *g, uint32 id)
+{
+	uint32	i, sum = 0;
+
+	for(i = id < g->desc_size ? id : g->desc_size; i > 0; i -= i & -i)
+		sum += g->desc_tree[i];
+	return sum;
+}
+
+/* Replace <len> characters at <pos> in graph's XML buffer with <text>. The output buffer splits it, if needed. */
+static void graph_text_set(const Graph *g, uint32 pos, uint32 len, const char *text, size_t text_len)
+{
+	if(text_len > 0 || len > 0)
+		outbuf_t_text_set(g->node, g->buffer, pos, len, text, text_len);
+}
+
+/* A pending edit of a graph's XML buffer. Consecutive edits that touch are merged, before sending. */
+typedef struct
+{
+	uint32	pos, len;
+	DynStr	*text;		/* Replaces <len> characters at <pos>. NULL if there is no edit. */
+} TextEdit;
+
+static void text_edit_flush(const Graph *g, TextEdit *edit)
+{
+	if(edit->text == NULL)
+		return;
+	graph_text_set(g, edit->pos, edit->len, dynstr_string(edit->text), dynstr_length(edit->text));
+	dynstr_destroy(edit->text, 1);
+	edit->text = NULL;
+}
+
+static void text_edit_add(const Graph *g, TextEdit *edit, uint32 pos, uint32 len, const char *text, size_t text_len)
 {
-	DynStr	*desc;
+	if(edit->text != NULL && pos == edit->pos + dynstr_length(edit->text))	/* Starts where last one ended? */
+	{
+		edit->len += len;
+		dynstr_append_len(edit->text, text, text_len);
+		return;
+	}
+	text_edit_flush(g, edit);
+	edit->pos  = pos;
+	edit->len  = len;
+	edit->text = dynstr_new_sized(text_len + 1);
+	dynstr_append_len(edit->text, text, text_len);
+}
+
+/* Publish description of module <m>. Only the part that differs from what is already there is sent. */
+static void module_publish(Module *m, TextEdit *edit)
+{
+	Graph		*g = m->graph;
+	DynStr		*desc;
+	const char	*od = m->desc != NULL ? m->desc : "", *nd;
+	size_t		ol = m->length, nl, pre, suf;
 
 	desc = module_build_desc(m);
-	verse_send_t_text_set(m->graph->node, m->graph->buffer, m->start, m->length, dynstr_string(desc));
-	m->length = dynstr_length(desc);
-	dynstr_destroy(desc, 1);
-	graph_modules_desc_start_update(m->graph);
+	nd = dynstr_string(desc);
+	nl = dynstr_length(desc);
+	for(pre = 0; pre < ol && pre < nl && od[pre] == nd[pre]; pre++)
+		;
+	if((pre == ol && pre == nl) || !desc_tree_grow(g, m->id))
+	{
+		dynstr_destroy(desc, 1);
+		return;
+	}
+	for(suf = 0; suf < ol - pre && suf < nl - pre && od[ol - 1 - suf] == nd[nl - 1 - suf]; suf++)
+		;
+	text_edit_add(g, edit, g->desc_start + desc_tree_prefix(g, m->id) + pre, ol - pre - suf, nd + pre, nl - pre - suf);
+	desc_tree_add(g, m->id, (uint32) nl - m->length);
+	mem_free(m->desc);
+	m->desc = dynstr_destroy(desc, 0);
+	m->length = nl;
 }
 
+/* Note that the description of module <m> needs updating. Done by graph_update(), so that a module
+ * that changes many times between updates is only published once.
+*/
+static void module_describe(Module *m)
+{
+	Graph	*g = m->graph;
+
+	if(m->dirty)
+		return;
+	if(g->dirty_num >= g->dirty_alloc)
+	{
+		size_t	na = g->dirty_alloc > 0 ? 2 * g->dirty_alloc : 16;
+		uint32	*nd;
+
+		if((nd = mem_realloc(g->dirty, na * sizeof *nd)) == NULL)
+		{
+			TextEdit	edit = { 0, 0, NULL };
+
+			module_publish(m, &edit);
+			text_edit_flush(g, &edit);
+			return;
+		}
+		g->dirty = nd;
+		g->dirty_alloc = na;
+	}
+	g->dirty[g->dirty_num++] = m->id;
+	m->dirty = TRUE;
+}
+
+static int cmp_id(const void *a, const void *b)
+{
+	const uint32	*ia = a, *ib = b;
+
+	return *ia < *ib ? -1 : *ia > *ib;
+}
+
+/* Publish all module descriptions in <g> that have changed. Done in ID order, i.e. from the start
+ * of the buffer and on, so that edits of neighboring modules can be merged.
+*/
+static void graph_publish(Graph *g)
+{
+	TextEdit	edit = { 0, 0, NULL };
+	Module		*m;
+	size_t		i;
+
+	if(g->dirty_num == 0)
+		return;
+	qsort(g->dirty, g->dirty_num, sizeof *g->dirty, cmp_id);
+	for(i = 0; i < g->dirty_num; i++)
+	{
+		if((m = idset_lookup(g->modules, g->dirty[i])) != NULL && m->dirty)	/* Might be gone, or a new one. */
+		{
+			m->dirty = FALSE;
+			module_publish(m, &edit);
+		}
+	}
+	text_edit_flush(g, &edit);
+	g->dirty_num = 0;
+}
+
+void graph_update(void)
+{
+	unsigned int	id;
+	Graph		*g;
+
+	for(id = idset_foreach_first(graph_info.graphs); (g = idset_lookup(graph_info.graphs, id)) != NULL; id = idset_foreach_next(graph_info.graphs, id))
+		graph_publish(g);
+}
+
+/* Schedule module for computation. During a batch, this is deferred until the batch is done. */
+static void module_schedule(Module *m)
+{
+	if(m->graph->batch)
+		m->pending = TRUE;
+	else
+		sched_add(&m->instance);
+}
 
 static PPOutput cb_module_lookup(uint32 module_id, void *data)
 {
@@ -1151,28 +1620,27 @@ static PPOutput cb_module_lookup(uint32 module_id, void *data)
 /* Create a new module, i.e. a plug-in instance, in a graph. If <module_id> is not ~0,
  * the module is created with it as its ID. Very handy during resume.
 */
-static void module_create(unsigned int module_id, uint32 graph_id, uint32 plugin_id)
+static Module * module_create(unsigned int module_id, uint32 graph_id, uint32 plugin_id)
 {
 	Plugin	*p;
 	Graph	*g;
 	Module	*m;
-	DynStr	*desc;
 
 	if((p = plugin_lookup(plugin_id)) == NULL)
 	{
 		LOG_WARN(("Attempted to instantiate plug-in %u; not found", plugin_id));
-		return;
+		return NULL;
 	}
 	if((g = idset_lookup(graph_info.graphs, graph_id)) == NULL)
 	{
 		LOG_WARN(("Attempted to instantiate plug-in %u in unknown graph %u, aborting", plugin_id, graph_id));
-		return;
+		return NULL;
 	}
 	m = memchunk_alloc(graph_info.chunk_module);
 	if(m == NULL)
 	{
 		LOG_WARN(("Module allocation failed in graph %u, plug-in %u", graph_id, plugin_id));
-		return;
+		return NULL;
 	}
 	m->graph = g;
 	m->plugin = p;
@@ -1184,13 +1652,24 @@ static void module_create(unsigned int module_id, uint32 graph_id, uint32 plugin
 	m->out.nodes.node = NULL;
 	m->out.nodes.next = 0;
 	m->out.resume = NULL;
-	m->start = m->length = 0;
+	m->out.version = ++graph_info.output_version;
+	m->out.recall = 0;
+	m->out.prev = m->out.version;
+	value_init(&m->out.last);
+	m->out.fingerprinted = FALSE;
+	m->out.suppressed = 0;
+	m->desc = NULL;
+	m->length = 0;
+	m->dirty = FALSE;
+	m->visit = 0;
+	m->pending = FALSE;
 	if(g->modules == NULL)
 		g->modules = idset_new(0);
 	if(module_id == ~0u)
 		m->id = idset_insert(g->modules, m);
 	else
 		m->id = idset_insert_with_id(g->modules, module_id, m);
+	graph_order_append(g, m);
 	LOG_MSG(("Module %u.%u is plug-in %u (%s) in graph at %p", graph_id, m->id, plugin_id, plugin_name(p), g));
 /*	{
 		Module	*m2;
@@ -1202,15 +1681,12 @@ static void module_create(unsigned int module_id, uint32 graph_id, uint32 plugin
 			exit(EXIT_FAILURE);
 		}
 	}
-*/	desc = module_build_desc(m);
-	m->length = dynstr_length(desc);
-	graph_modules_desc_start_update(g);
-	verse_send_t_text_set(g->node, g->buffer, m->start, 0, dynstr_string(desc));
-	dynstr_destroy(desc, 1);
+*/	module_describe(m);
 
 	/* Newly created plug-in might be ready to run right away, thanks to defaults. Check, and schedule if so. */
 	if(plugin_instance_inputs_ready(&m->instance))
-		sched_add(&m->instance);
+		module_schedule(m);
+	return m;
 }
 
 /* Release all labeled nodes created by an instance. */
@@ -1248,19 +1724,24 @@ static void module_destroy(uint32 graph_id, uint32 module_id)
 	}
 	module_dep_destroy_warning(m);
 	idset_remove(g->modules, module_id);
-	verse_send_t_text_set(g->node, g->buffer, m->start, m->length, NULL);
+	graph_order_remove(g, m);
+	if(m->length > 0)
+	{
+		graph_text_set(g, g->desc_start + desc_tree_prefix(g, m->id), m->length, NULL, 0);
+		desc_tree_add(g, m->id, -m->length);
+	}
+	mem_free(m->desc);
 	idlist_destruct(&m->out.dependants);
 	plugin_instance_free(&m->instance);
 	port_clear(&m->out.port);
+	value_clear(&m->out.last);
 	output_nodes_clear(&m->out);
 	memchunk_free(graph_info.chunk_module, m);
-	graph_modules_desc_start_update(g);
 }
 
 static void do_module_input_set(Graph *g, uint32 module_id, uint8 input_index, PValueType type, int string, va_list arg)
 {
 	Module	*m;
-	DynStr	*desc;
 	uint32	old_link;
 
 	if((m = idset_lookup(g->modules, module_id)) == NULL)
@@ -1279,11 +1760,7 @@ static void do_module_input_set(Graph *g, uint32 module_id, uint8 input_index, P
 		plugin_portset_set_from_string(m->instance.inputs, input_index, type, va_arg(arg, const char *));
 	else
 		plugin_portset_set_va(m->instance.inputs, input_index, type, arg);
-	desc = module_build_desc(m);
-	verse_send_t_text_set(g->node, g->buffer, m->start, m->length, dynstr_string(desc));
-	m->length = dynstr_length(desc);
-	dynstr_destroy(desc, 1);
-	graph_modules_desc_start_update(g);
+	module_describe(m);
 
 	/* Did we just set a link to someone? Then notify that someone about new dependant. */
 	if(type == P_VALUE_MODULE)
@@ -1293,7 +1770,7 @@ static void do_module_input_set(Graph *g, uint32 module_id, uint8 input_index, P
 		plugin_portset_get_module(m->instance.inputs, input_index, &other);
 		module_dep_add(g, other, m->id);
 	}
-	sched_add(&m->instance);
+	module_schedule(m);
 }
 
 /* Set a module input to a value. The value might be either a literal, or a reference to another module's output. */
@@ -1327,7 +1804,6 @@ static void module_input_clear(uint32 graph_id, uint32 module_id, uint8 input_in
 {
 	Graph	*g;
 	Module	*m;
-	DynStr	*desc;
 	boolean	was_link;
 	uint32	old_link;
 
@@ -1343,12 +1819,7 @@ static void module_input_clear(uint32 graph_id, uint32 module_id, uint8 input_in
 	}
 	was_link = plugin_portset_get_module(m->instance.inputs, input_index, &old_link);
 	plugin_portset_clear(m->instance.inputs, input_index);
-
-	desc = module_build_desc(m);
-	verse_send_t_text_set(g->node, g->buffer, m->start, m->length, dynstr_string(desc));
-	m->length = dynstr_length(desc);
-	dynstr_destroy(desc, 1);
-	graph_modules_desc_start_update(g);
+	module_describe(m);
 
 	/* If a link was cleared, notify other end it has one less dependants. */
 	if(was_link)
@@ -1358,7 +1829,7 @@ static void module_input_clear(uint32 graph_id, uint32 module_id, uint8 input_in
 	 * it to a default value, and all other inputs are ready.
 	*/
 	if(plugin_instance_inputs_ready(&m->instance))
-		sched_add(&m->instance);
+		module_schedule(m);
 }
 
 /* Go through module's inputs, and clear any inputs that refer to module <rm>. This typically happens
@@ -1383,15 +1854,327 @@ static void module_input_clear_links_to(Graph *g, uint32 module_id, uint32 rm)
 		}
 	}
 	if(refresh)
+		module_describe(m);
+}
+
+/* ----------------------------------------------------------------------------------------- */
+
+/* A single edit in a batch, as parsed from one line of text. See \ref results for the syntax. */
+typedef struct
+{
+	char		op;		/* One of 'c', 'd', 'x' or 's'. */
+	uint32		module;		/* Module to edit. Might be GRAPH_BATCH_NEW(n). */
+	uint32		arg;		/* Plug-in ID for 'c', input index for 'x' and 's'. */
+	PValueType	type;		/* Type of value to set, for 's'. */
+	const char	*value;		/* Value as text. Points into the batch's copy of the text. */
+	uint32		link;		/* Module to link to, if type is P_VALUE_MODULE. */
+} BatchOp;
+
+/* Parse a module reference, either an existing module's ID or "@N" for one of the <created> so far. */
+static boolean batch_parse_module(const Graph *g, const char *text, uint32 created, uint32 *module)
+{
+	unsigned long	n;
+	char		*end;
+
+	if(*text == '@')
 	{
-		DynStr	*desc;
+		n = strtoul(text + 1, &end, 10);
+		if(end == text + 1 || *end != '\0' || n >= created)
+			return FALSE;
+		*module = GRAPH_BATCH_NEW(n);
+		return TRUE;
+	}
+	n = strtoul(text, &end, 10);
+	if(end == text || *end != '\0' || idset_lookup(g->modules, n) == NULL)
+		return FALSE;
+	*module = n;
+	return TRUE;
+}
 
-		desc = module_build_desc(m);
-		verse_send_t_text_set(g->node, g->buffer, m->start, m->length, dynstr_string(desc));
-		m->length = dynstr_length(desc);
-		dynstr_destroy(desc, 1);
-		graph_modules_desc_start_update(g);
+/* Parse and check a single line of a batch. Values are parsed too, but only to see that they can be. */
+static boolean batch_parse_op(const Graph *g, const char *line, uint32 created, BatchOp *op)
+{
+	char	mod[16], type[32];
+	int	used = 0;
+
+	op->op = line[0];
+	op->module = op->arg = 0;
+	switch(op->op)
+	{
+	case 'c':
+		return sscanf(line, "c %u", &op->arg) == 1 && plugin_lookup(op->arg) != NULL;
+	case 'd':
+		return sscanf(line, "d %15s", mod) == 1 && batch_parse_module(g, mod, created, &op->module);
+	case 'x':
+		return sscanf(line, "x %15s %u", mod, &op->arg) == 2 && batch_parse_module(g, mod, created, &op->module);
+	case 's':
+		if(sscanf(line, "s %15s %u %31s %n", mod, &op->arg, type, &used) != 3 || used == 0)
+			return FALSE;
+		if(!batch_parse_module(g, mod, created, &op->module))
+			return FALSE;
+		if((op->type = value_type_from_name(type)) == P_VALUE_NONE)
+			return FALSE;
+		op->value = line + used;
+		if(op->type == P_VALUE_MODULE)
+			return batch_parse_module(g, op->value, created, &op->link);
+		else
+		{
+			PValue	tmp;
+			int	ok;
+
+			value_init(&tmp);
+			ok = value_set_from_string(&tmp, op->type, op->value);
+			value_clear(&tmp);
+			return ok;
+		}
+	}
+	return FALSE;
+}
+
+/* Map a module reference from a batch to an actual module ID, using IDs of modules <made> by it. */
+static uint32 batch_module(uint32 module, const uint32 *made)
+{
+	if(module & GRAPH_BATCH_NEW(0))
+		return made[module & ~GRAPH_BATCH_NEW(0)];
+	return module;
+}
+
+/* A link as it will be once the batch's edits up to the current one are done. Input ~0 marks
+ * a module destroyed by the batch; source ~0 an input that no longer holds a link.
+*/
+typedef struct
+{
+	uint32	module;
+	uint32	input;
+	uint32	source;
+} BatchLink;
+
+/* Has <module> been destroyed by the edits simulated so far? */
+static boolean batch_gone(const BatchLink *link, size_t num, uint32 module)
+{
+	while(num-- > 0)
+	{
+		if(link[num].module == module && link[num].input == ~0u)
+			return TRUE;
 	}
+	return FALSE;
+}
+
+/* Find what module <m>'s input <input> links to, as it will be after the simulated edits. */
+static boolean batch_input_link(const BatchLink *link, size_t num, const Module *m, uint32 input, uint32 *source)
+{
+	size_t	i;
+
+	for(i = num; i-- > 0;)
+	{
+		if(link[i].module == m->id && link[i].input == input)
+		{
+			*source = link[i].source;
+			return link[i].source != ~0u && !batch_gone(link, num, *source);
+		}
+	}
+	return plugin_portset_get_module(m->instance.inputs, input, source) && !batch_gone(link, num, *source);
+}
+
+/* Answer TRUE if <to> depends on <from> as the graph will be after the simulated edits. The
+ * topological order doesn't reflect those, so this is a plain search upstream from <to>.
+*/
+static boolean batch_reaches(const Graph *g, const BatchLink *link, size_t num, const Module *from, Module *to)
+{
+	Module	*m, *next;
+	size_t	top = 0, i, ni;
+	uint32	id;
+
+	if(!order_scratch_grow(g->topo_size))
+		return TRUE;		/* Can't tell, so assume the worst. */
+	graph_info.visit++;
+	to->visit = graph_info.visit;
+	graph_info.scratch[top++] = to;
+	while(top > 0)
+	{
+		m = graph_info.scratch[--top];
+		ni = plugin_portset_size(m->instance.inputs);
+		for(i = 0; i < ni; i++)
+		{
+			if(!batch_input_link(link, num, m, i, &id) || (next = idset_lookup(g->modules, id)) == NULL)
+				continue;
+			if(next == from)
+				return TRUE;
+			if(next->visit != graph_info.visit)
+			{
+				next->visit = graph_info.visit;
+				graph_info.scratch[top++] = next;
+			}
+		}
+	}
+	return FALSE;
+}
+
+/* Check that the <num> edits in <op> can all be applied to graph <g>, once modules have been <made>. Edits are
+ * simulated in order, so that a module destroyed by the batch can't be referred to later in it, and
+ * a link is tested for cycles against the links set before it by the batch.
+*/
+static boolean batch_check(const Graph *g, uint32 graph_id, const BatchOp *op, size_t num, const uint32 *made)
+{
+	BatchLink	*link;
+	size_t		i, num_links = 0;
+	uint32		mid, src;
+	Module		*m, *s;
+	boolean		ok = TRUE;
+
+	if(num == 0)
+		return TRUE;
+	if((link = mem_alloc(num * sizeof *link)) == NULL)
+		return FALSE;
+	for(i = 0; ok && i < num; i++)
+	{
+		if(op[i].op == 'c')
+			continue;
+		mid = batch_module(op[i].module, made);
+		if(batch_gone(link, num_links, mid))
+		{
+			LOG_WARN(("Batch refers to module %u in graph %u after destroying it, ignoring entire batch", mid, graph_id));
+			ok = FALSE;
+			break;
+		}
+		link[num_links].module = mid;
+		link[num_links].input  = op[i].op == 'd' ? ~0u : op[i].arg;
+		link[num_links].source = ~0u;
+		if(op[i].op == 's' && op[i].type == P_VALUE_MODULE)
+		{
+			src = batch_module(op[i].link, made);
+			if(batch_gone(link, num_links, src))
+			{
+				LOG_WARN(("Batch links to module %u in graph %u after destroying it, ignoring entire batch", src, graph_id));
+				ok = FALSE;
+				break;
+			}
+			m = idset_lookup(g->modules, mid);
+			s = idset_lookup(g->modules, src);
+			if(m == NULL || s == NULL || m == s || batch_reaches(g, link, num_links, m, s))
+			{
+				LOG_WARN(("Batch link from module %u to %u in graph %u would be cyclic, ignoring entire batch", src, mid, graph_id));
+				ok = FALSE;
+				break;
+			}
+			link[num_links].source = src;
+		}
+		num_links++;
+	}
+	mem_free(link);
+	return ok;
+}
+
+/* Apply a batch of edits to a graph. The entire text is parsed before anything is done, so a
+ * malformed batch has no effect. The batch's modules are created first, and then the rest of
+ * it is checked against them; if a create fails or an edit can't be done, the new modules are
+ * destroyed again, and nothing else happens. While edits are applied, the graph is flagged, which
+ * makes the module functions hold back scheduling. Once all are done, the changed module
+ * descriptions are published, and every module with changed inputs is scheduled.
+*/
+static void graph_batch_apply(uint32 graph_id, const char *text)
+{
+	Graph		*g;
+	Module		*m;
+	BatchOp		*op = NULL;
+	char		*copy, *line, *next, buf[16];
+	size_t		num = 0, alloc = 0, i;
+	uint32		created = 0, *made, mid;
+	boolean		ok = TRUE;
+
+	if((g = idset_lookup(graph_info.graphs, graph_id)) == NULL)
+	{
+		LOG_WARN(("Attempted to apply batch to non-existant graph %u", graph_id));
+		return;
+	}
+	if(text == NULL || (copy = stu_strdup(text)) == NULL)
+		return;
+	for(line = copy; ok && line != NULL && *line != '\0'; line = next)
+	{
+		if((next = strchr(line, '\n')) != NULL)
+			*next++ = '\0';
+		if(*line == '\0')
+			continue;
+		if(num >= alloc)
+		{
+			size_t	na = alloc > 0 ? 2 * alloc : 16;
+			BatchOp	*no;
+
+			if((no = mem_realloc(op, na * sizeof *op)) == NULL)
+			{
+				ok = FALSE;
+				break;
+			}
+			op = no;
+			alloc = na;
+		}
+		if((ok = batch_parse_op(g, line, created, op + num)))
+		{
+			if(op[num++].op == 'c')
+				created++;
+		}
+		else
+			LOG_WARN(("Couldn't parse \"%s\" in batch for graph %u, ignoring entire batch", line, graph_id));
+	}
+	if(ok && (made = mem_alloc((created + 1) * sizeof *made)) != NULL)
+	{
+		g->batch = TRUE;
+		for(i = 0, created = 0; ok && i < num; i++)
+		{
+			if(op[i].op != 'c')
+				continue;
+			if((m = module_create(~0u, graph_id, op[i].arg)) != NULL)
+				made[created++] = m->id;
+			else
+			{
+				LOG_WARN(("Couldn't create module in batch for graph %u, ignoring entire batch", graph_id));
+				ok = FALSE;
+			}
+		}
+		if(ok && !batch_check(g, graph_id, op, num, made))
+			ok = FALSE;
+		if(!ok)
+		{
+			for(i = 0; i < created; i++)
+				module_destroy(graph_id, made[i]);
+			num = 0;
+		}
+		for(i = 0; i < num; i++)
+		{
+			mid = batch_module(op[i].module, made);
+			switch(op[i].op)
+			{
+			case 'd':
+				module_destroy(graph_id, mid);
+				break;
+			case 'x':
+				module_input_clear(graph_id, mid, op[i].arg);
+				break;
+			case 's':
+				if(op[i].type != P_VALUE_MODULE)
+				{
+					module_input_set_from_string(g, mid, op[i].arg, op[i].type, op[i].value);
+					break;
+				}
+				snprintf(buf, sizeof buf, "%u", batch_module(op[i].link, made));
+				module_input_set_from_string(g, mid, op[i].arg, P_VALUE_MODULE, buf);
+				break;
+			}
+		}
+		g->batch = FALSE;
+		graph_publish(g);
+		for(i = 0; i < g->topo_size; i++)
+		{
+			if(g->topo[i]->pending)
+			{
+				g->topo[i]->pending = FALSE;
+				sched_add(&g->topo[i]->instance);
+			}
+		}
+		mem_free(made);
+	}
+	mem_free(op);
+	mem_free(copy);
 }
 
 /* ----------------------------------------------------------------------------------------- */
@@ -1571,6 +2354,93 @@ void graph_method_send_call_mod_input_clear(uint32 graph_id, uint32 module_id, u
 	send_method_call(MOD_INPUT_CLEAR, param);
 }
 
+/* Append a module reference to a batch, using the "@N" notation for modules created by it. */
+static void batch_append_module(DynStr *ops, uint32 module_id)
+{
+	if(module_id & GRAPH_BATCH_NEW(0))
+		dynstr_append_printf(ops, "@%u", module_id & ~GRAPH_BATCH_NEW(0));
+	else
+		dynstr_append_printf(ops, "%u", module_id);
+}
+
+void graph_batch_append_mod_create(DynStr *ops, uint32 plugin_id)
+{
+	dynstr_append_printf(ops, "c %u\n", plugin_id);
+}
+
+void graph_batch_append_mod_destroy(DynStr *ops, uint32 module_id)
+{
+	dynstr_append(ops, "d ");
+	batch_append_module(ops, module_id);
+	dynstr_append_c(ops, '\n');
+}
+
+void graph_batch_append_mod_input_set(DynStr *ops, uint32 module_id, uint32 index, PValueType vtype, const PValue *value)
+{
+	PValue		v;
+	char		buf[512];
+	const char	*text;
+
+	if(vtype == P_VALUE_MODULE)
+		text = NULL;
+	else
+	{
+		v.v = value->v;			/* Only the field for the type is used, like the other calls do. */
+		v.set = 1 << vtype;
+		if((text = value_as_string(&v, buf, sizeof buf, NULL)) == NULL || strchr(text, '\n') != NULL)
+		{
+			LOG_WARN(("Can't add input setting of type %s to batch", value_type_to_name(vtype)));
+			return;
+		}
+	}
+	dynstr_append(ops, "s ");
+	batch_append_module(ops, module_id);
+	dynstr_append_printf(ops, " %u %s ", index, value_type_to_name(vtype));
+	if(text != NULL)
+		dynstr_append(ops, text);
+	else
+		batch_append_module(ops, value->v.vmodule);
+	dynstr_append_c(ops, '\n');
+}
+
+void graph_batch_append_mod_input_clear(DynStr *ops, uint32 module_id, uint32 input)
+{
+	dynstr_append(ops, "x ");
+	batch_append_module(ops, module_id);
+	dynstr_append_printf(ops, " %u\n", input);
+}
+
+void graph_method_send_call_batch(uint32 graph_id, const DynStr *ops)
+{
+	VNOParam	param[2];
+
+	if(dynstr_length(ops) > GRAPH_BATCH_SIZE_MAX)
+	{
+		LOG_WARN(("Batch of %u bytes is too large to send in one method call (max %u), split it",
+			  (unsigned int) dynstr_length(ops), GRAPH_BATCH_SIZE_MAX));
+		return;
+	}
+	param[0].vuint32 = graph_id;
+	param[1].vstring = (char *) dynstr_string(ops);
+	send_method_call(BATCH, param);
+}
+
+void graph_stats_print(uint32 graph_id)
+{
+	Graph		*g;
+	Module		*m;
+	unsigned int	id;
+
+	if((g = idset_lookup(graph_info.graphs, graph_id)) == NULL)
+	{
+		printf("There is no graph with ID %u\n", graph_id);
+		return;
+	}
+	printf("Graph %u (\"%s\"):\n", graph_id, g->name);
+	for(id = idset_foreach_first(g->modules); (m = idset_lookup(g->modules, id)) != NULL; id = idset_foreach_next(g->modules, id))
+		printf(" %3u %-20s %lu unchanged outputs not propagated\n", m->id, plugin_name(m->plugin), m->out.suppressed);
+}
+
 void graph_method_receive_call(uint16 id, const VNOPackedParams *param)
 {
 	VNOParam	arg[8];
@@ -1632,12 +2502,15 @@ void graph_method_receive_call(uint16 id, const VNOPackedParams *param)
 			module_input_set(arg[0].vuint32, arg[1].vuint32, arg[2].vuint8, P_VALUE_REAL64_MAT16, &arg[3].vreal64_mat);
 			break;
 		case MOD_INPUT_SET_MODULE:
-			if(!graph_cyclic_after(arg[0].vuint32, arg[1].vuint32, arg[2].vuint8, arg[3].vuint32))
+			if(!graph_cyclic_after(arg[0].vuint32, arg[1].vuint32, arg[3].vuint32))
 				module_input_set(arg[0].vuint32, arg[1].vuint32, arg[2].vuint8, P_VALUE_MODULE, arg[3].vuint32);
 			break;
 		case MOD_INPUT_SET_STRING:
 			module_input_set(arg[0].vuint32, arg[1].vuint32, arg[2].vuint8, P_VALUE_STRING, arg[3].vstring);
 			break;
+		case BATCH:
+			graph_batch_apply(arg[0].vuint32, arg[1].vstring);
+			break;
 		}
 		return;
 	}
@@ -8,6 +8,7 @@
  * exported below, and then processed internally by calling various other modules.
 */
 
+#include "dynstr.h"
 #include "xmlnode.h"
 
 /* Initialize graph module. Must be called before module is used. */
@@ -27,16 +28,44 @@ extern void	graph_method_send_call_mod_input_set(uint32 graph_id, uint32 mod_id,
 						     PValueType type, const PValue *value);
 extern void	graph_method_send_call_mod_input_clear(uint32 graph_id, uint32 mod_id, uint32 input);
 
+/* Batches are built by appending edits to a dynamic string, and then sent as a single call. Modules
+ * created earlier in the same batch are referred to as GRAPH_BATCH_NEW(n), with n counting from 0.
+ * The call, with its parameters, must fit in one Verse packet of 1500 bytes; GRAPH_BATCH_SIZE_MAX
+ * is the longest batch text that leaves room for the packet and call headers and the graph ID.
+*/
+#define	GRAPH_BATCH_NEW(n)	((1u << 31) | (n))
+#define	GRAPH_BATCH_SIZE_MAX	1400
+extern void	graph_batch_append_mod_create(DynStr *ops, uint32 plugin_id);
+extern void	graph_batch_append_mod_destroy(DynStr *ops, uint32 module_id);
+extern void	graph_batch_append_mod_input_set(DynStr *ops, uint32 mod_id, uint32 index,
+						 PValueType type, const PValue *value);
+extern void	graph_batch_append_mod_input_clear(DynStr *ops, uint32 mod_id, uint32 input);
+extern void	graph_method_send_call_batch(uint32 graph_id, const DynStr *ops);
+/* Print per-module statistics, such as how many times an unchanged output was not propagated. */
+extern void	graph_stats_print(uint32 graph_id);
+
 /* Check if the graph editing API has been created yet. Called from nodedb notification callback. */
 extern void	graph_method_check_created(NodeObject *node);
 
 /* A method call was received, check if it's one of the graph editing calls, and if so take action. */
 extern void	graph_method_receive_call(uint16 id, const VNOPackedParams *param);
 
+/* Publish changes to graph XML. Changes are collected, and sent as small edits once per main loop. */
+extern void	graph_update(void);
+
 typedef struct Graph	Graph;
 
 extern Graph *	graph_create_resume(const XmlNode *gdesc, const unsigned int *pmap);
 
+/* Scheduler support. Modules in a graph are kept in topological order, so that a module always
+ * comes after all modules it takes input from. The order is updated incrementally as links are
+ * added, and the serial number is bumped each time modules move so cached orderings can be refreshed.
+*/
+extern unsigned int	graph_order_serial(void);
+extern void		graph_port_output_order(PPOutput port, const Graph **graph, unsigned int *order);
+/* Answer TRUE if the module owning <to> depends, directly or indirectly, on the one owning <from>. */
+extern boolean		graph_port_output_reaches(PPOutput from, PPOutput to);
+
 /* Output API uses this to set the output port. Gives us a chance to notify graph. */
 extern void	graph_port_output_begin(PPOutput port);
 extern void	graph_port_output_set(PPOutput port, PValueType type, ...);
@@ -45,5 +74,10 @@ extern PONode *	graph_port_output_node_create(PPOutput port, VNodeType type, uin
 extern PONode *	graph_port_output_node_copy(PPOutput port, PINode *node, uint32 label);
 extern void	graph_port_output_end(PPOutput port);
 
+/* Used by the memo cache, to identify outputs and restore remembered ones. */
+extern uint32	graph_port_output_version(PPOutput port);
+extern void	graph_port_output_recall(PPOutput port, const PValue *value, uint32 version);
+extern boolean	graph_port_output_node_label(PPOutput port, const PNode *node, uint32 *label);
+
 /* This is called by the synchronizer once it learns the server-side identity of a created node. */
 extern void	graph_port_output_create_notify(const PNode *local);
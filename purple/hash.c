@@ -4,6 +4,13 @@
  * Copyright (C) 2004 PDC, KTH. See COPYING for license details.
  * 
  * A hash table data type. Always handy to have around.
+ *
+ * This is an open addressing table, with linear probing. Keys and data are stored right
+ * in the slot array, which has a power of two capacity and is doubled when it gets too
+ * full, so there is no per-element allocation and no limit on size. Each slot remembers
+ * the full hash of its key, which saves calling the key comparison function on most
+ * probes that don't match, and lets the table grow without re-hashing keys. Removal
+ * shifts following elements back, so there are no "deleted" markers to clean up.
 */
 
 #include <stdlib.h>
@@ -11,67 +18,29 @@
 
 #include "log.h"
 #include "mem.h"
-#include "memchunk.h"
 
 #include "hash.h"
 
 /* ----------------------------------------------------------------------------------------- */
 
-typedef struct HashEl	HashEl;
-
-struct HashEl {
+typedef struct
+{
 	const void	*key;
 	void		*data;
-	HashEl		*next;
-};
-
-static MemChunk	*the_chunk = NULL;
+	unsigned int	hash;		/* Hash of key, never zero. Zero marks an empty slot. */
+} HashSlot;
 
 struct Hash
 {
-	HashEl		**vector;
-	size_t		length;
+	HashSlot	*slot;
+	size_t		mask;		/* Capacity minus one. Capacity is zero, or a power of two. */
 	size_t		size;
-	HashFunc	hfunc;
+	HashFunc	hfunc;		/* Both NULL for integer-keyed tables, see hash_new_int(). */
 	HashKeyEqFunc	kefunc;
 };
 
-/* Some prime numbers. Picked from <http://www.utm.edu/research/primes/lists/small/1000.txt>. */
-static const unsigned int the_primes[] = {
-     11,     13,     17,     19,     23,     29,
-     31,     37,     41,     43,     47,     53,     59,     61,     67,     71, 
-     73,     79,     83,     89,     97,    101,    103,    107,    109,    113, 
-    127,    131,    137,    139,    149,    151,    157,    163,    167,    173, 
-    179,    181,    191,    193,    197,    199,    211,    223,    227,    229, 
-    233,    239,    241,    251,    257,    263,    269,    271,    277,    281, 
-    283,    293,    307,    311,    313,    317,    331,    337,    347,    349, 
-    353,    359,    367,    373,    379,    383,    389,    397,    401,    409, 
-    419,    421,    431,    433,    439,    443,    449,    457,    461,    463, 
-    467,    479,    487,    491,    499,    503,    509,    521,    523,    541, 
-    547,    557,    563,    569,    571,    577,    587,    593,    599,    601, 
-    607,    613,    617,    619,    631,    641,    643,    647,    653,    659, 
-    661,    673,    677,    683,    691,    701,    709,    719,    727,    733, 
-    739,    743,    751,    757,    761,    769,    773,    787,    797,    809, 
-    811,    821,    823,    827,    829,    839,    853,    857,    859,    863, 
-    877,    881,    883,    887,    907,    911,    919,    929,    937,    941,
-   1069,   1223,   1373,   1511,   2053,   2531,   2903,   3511,   4297,   5179,
-   5521,   6571,   7561,   7919
-};
-
-/* ----------------------------------------------------------------------------------------- */
-
-/* Return the closest prime n such that x <= n. Breaks horribly for x larger than table above indicates. */
-static unsigned int get_prime(unsigned int x)
-{
-	unsigned int	j;
-
-	for(j = 0; j < sizeof the_primes / sizeof *the_primes; j++)
-	{
-		if(x <= the_primes[j])
-			return the_primes[j];
-	}
-	return the_primes[sizeof the_primes / sizeof *the_primes - 1];
-}
+#define	CAPACITY_MIN	16
+#define	LOAD_MAX(c)	((c) - (c) / 4)		/* Grow when more than 3/4 full. */
 
 /* ----------------------------------------------------------------------------------------- */
 
@@ -95,11 +64,62 @@ static int string_key_eq(const void *key1, const void *key2)
 	return strcmp(key1, key2) == 0;
 }
 
+/* Hash a key. Integer keys are folded to 32 bits, results of hash functions are used as they
+ * are. Either is then mixed, because only the low bits are used to pick a slot, and hashes like
+ * "identity" or "pointer divided by eight" would cluster badly otherwise. Sequential keys are
+ * worst of all for linear probing, as they'd form a single run. The mixing is the finalizer
+ * from MurmurHash3.
+*/
+static unsigned int key_hash(const Hash *hash, const void *key)
+{
+	unsigned int	h;
+
+	if(hash->hfunc == NULL)
+	{
+		unsigned long	k = (unsigned long) key;
+
+		if(sizeof k > 4)
+			k ^= k >> 16 >> 16;	/* Fold in the high half of 64-bit keys. */
+		h = (unsigned int) k;
+	}
+	else
+		h = hash->hfunc(key);
+	h ^= h >> 16;
+	h *= 0x85ebca6bu;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35u;
+	h ^= h >> 16;
+	return h != 0 ? h : 1;		/* Zero means empty. */
+}
+
+/* Find the slot holding <key>, or the empty slot where it would go. Needs a non-empty table. */
+static HashSlot * slot_find(const Hash *hash, const void *key, unsigned int h)
+{
+	size_t		i = h & hash->mask;
+	HashSlot	*s;
+
+	if(hash->kefunc == NULL)
+	{
+		for(;; i = (i + 1) & hash->mask)
+		{
+			s = hash->slot + i;
+			if(s->hash == 0 || s->key == key)
+				return s;
+		}
+	}
+	for(;; i = (i + 1) & hash->mask)
+	{
+		s = hash->slot + i;
+		if(s->hash == 0 || (s->hash == h && hash->kefunc(key, s->key)))
+			return s;
+	}
+}
+
 /* ----------------------------------------------------------------------------------------- */
 
 void hash_init(void)
 {
-	the_chunk = memchunk_new("HashEl", sizeof (HashEl), 16);
+	/* Nothing to do, elements are no longer allocated individually. */
 }
 
 /* ----------------------------------------------------------------------------------------- */
@@ -110,14 +130,11 @@ Hash * hash_new(HashFunc hfunc, HashKeyEqFunc kefunc)
 
 	if(hfunc == NULL || kefunc == NULL)
 		return NULL;
-
-	hash = mem_alloc(sizeof *hash);
-	hash->vector = NULL;
-	hash->length = 0;
-	hash->size   = 0;
-	hash->hfunc  = hfunc;
-	hash->kefunc = kefunc;
-
+	if((hash = hash_new_int()) != NULL)
+	{
+		hash->hfunc  = hfunc;
+		hash->kefunc = kefunc;
+	}
 	return hash;
 }
 
@@ -126,99 +143,106 @@ Hash * hash_new_string(void)
 	return hash_new(hash_hash_string, string_key_eq);
 }
 
-static void resize(Hash *hash)
+Hash * hash_new_int(void)
+{
+	Hash	*hash;
+
+	if((hash = mem_alloc(sizeof *hash)) == NULL)
+		return NULL;
+	hash->slot   = NULL;
+	hash->mask   = 0;
+	hash->size   = 0;
+	hash->hfunc  = NULL;
+	hash->kefunc = NULL;
+
+	return hash;
+}
+
+static int resize(Hash *hash)
 {
-	size_t	new_len, i, h;
-	HashEl	**nv, *iter, *next;
+	size_t		cap = hash->slot != NULL ? 2 * (hash->mask + 1) : CAPACITY_MIN, i, j;
+	HashSlot	*ns;
 
-	new_len = get_prime(hash->length + 1);
-	nv = mem_alloc(new_len * sizeof *nv);
-	if(nv != NULL)
+	if((ns = mem_alloc(cap * sizeof *ns)) == NULL)
 	{
-		for(i = 0; i < new_len; i++)
-			nv[i] = NULL;
-/*		LOG_MSG(("Growing from %u to %u elements", hash->length, new_len));*/
-		for(i = 0; i < hash->length; i++)
+		LOG_ERR(("Hash resize failed, out of memory"));
+		return 0;
+	}
+	for(i = 0; i < cap; i++)
+		ns[i].hash = 0;
+	if(hash->slot != NULL)
+	{
+		for(i = 0; i <= hash->mask; i++)
 		{
-			for(iter = hash->vector[i]; iter != NULL; iter = next)
-			{
-				next = iter->next;
-				h = hash->hfunc(iter->key) % new_len;
-				iter->next = nv[h];
-				nv[h] = iter;
-			}
+			if(hash->slot[i].hash == 0)
+				continue;
+			for(j = hash->slot[i].hash & (cap - 1); ns[j].hash != 0; j = (j + 1) & (cap - 1))
+				;
+			ns[j] = hash->slot[i];
 		}
-		mem_free(hash->vector);
-		hash->vector = nv;
-		hash->length = new_len;
+		mem_free(hash->slot);
 	}
-	else
-		LOG_ERR(("Hash resize failed, out of memory"));
+	hash->slot = ns;
+	hash->mask = cap - 1;
+	return 1;
 }
 
 void hash_insert(Hash *hash, const void *key, void *data)
 {
 	unsigned int	h;
-	HashEl		*el;
+	HashSlot	*s;
 
 	if(hash == NULL)
 		return;
-
-	if(hash->size >= hash->length)
-		resize(hash);
-
-	h = hash->hfunc(key);
-	h %= hash->length;
-	el = memchunk_alloc(the_chunk);
-	if(el != NULL)
+	if(hash->slot == NULL || hash->size >= LOAD_MAX(hash->mask + 1))
 	{
-		el->key  = key;
-		el->data = data;
-		el->next = hash->vector[h];
-		hash->vector[h] = el;
-		hash->size++;
+		if(!resize(hash))
+			return;
 	}
-	else
-		LOG_WARN(("Hash element allocation failed"));
+	h = key_hash(hash, key);
+	s = slot_find(hash, key, h);
+	if(s->hash == 0)
+		hash->size++;
+	s->key  = key;
+	s->data = data;
+	s->hash = h;
 }
 
 void * hash_lookup(const Hash *hash, const void *key)
 {
-	unsigned int	h;
-	const HashEl	*el;
+	const HashSlot	*s;
 
 	if(hash == NULL || hash->size == 0)
 		return NULL;
-	h = hash->hfunc(key) % hash->length;
-	for(el = hash->vector[h]; el != NULL; el = el->next)
-	{
-		if(hash->kefunc(key, el->key))
-			return el->data;
-	}
-	return NULL;
+	s = slot_find(hash, key, key_hash(hash, key));
+	return s->hash != 0 ? s->data : NULL;
 }
 
 void hash_remove(Hash *hash, const void *key)
 {
-	unsigned int	h;
-	HashEl		*prev, *iter;
+	size_t		i, j, home;
+	HashSlot	*s;
 
-	if(hash == NULL)
+	if(hash == NULL || hash->size == 0)
+		return;
+	s = slot_find(hash, key, key_hash(hash, key));
+	if(s->hash == 0)
 		return;
-	h = hash->hfunc(key) % hash->length;
-	for(prev = NULL, iter = hash->vector[h]; iter != NULL; prev = iter, iter = iter->next)
+	/* Shift back any following elements that would no longer be found across the hole. */
+	for(i = j = s - hash->slot;;)
 	{
-		if(hash->kefunc(key, iter->key))
+		j = (j + 1) & hash->mask;
+		if(hash->slot[j].hash == 0)
+			break;
+		home = hash->slot[j].hash & hash->mask;
+		if(((j - home) & hash->mask) >= ((j - i) & hash->mask))
 		{
-			if(prev != NULL)
-				prev->next = iter->next;
-			else
-				hash->vector[h] = iter->next;
-			memchunk_free(the_chunk, iter);
-			hash->size--;
-			return;
+			hash->slot[i] = hash->slot[j];
+			i = j;
 		}
 	}
+	hash->slot[i].hash = 0;
+	hash->size--;
 }
 
 size_t hash_size(const Hash *hash)
@@ -230,20 +254,17 @@ size_t hash_size(const Hash *hash)
 
 void hash_foreach(const Hash *hash, int (*func)(void *data, void *user), void *user)
 {
-	unsigned int	i;
+	size_t	i;
 
-	if(hash == NULL || func == NULL)
+	if(hash == NULL || func == NULL || hash->slot == NULL)
 		return;
 
-	for(i = 0; i < hash->length; i++)
+	for(i = 0; i <= hash->mask; i++)
 	{
-		const HashEl	*iter;
-
-		for(iter = hash->vector[i]; iter != NULL; iter = iter->next)
-		{
-			if(!func(iter->data, user))
-				return;
-		}
+		if(hash->slot[i].hash == 0)
+			continue;
+		if(!func(hash->slot[i].data, user))
+			return;
 	}
 }
 
@@ -251,19 +272,7 @@ void hash_destroy(Hash *hash)
 {
 	if(hash != NULL)
 	{
-		unsigned int	i;
-
-		for(i = 0; i < hash->length; i++)
-		{
-			HashEl	*iter, *next;
-
-			for(iter = hash->vector[i]; iter != NULL; iter = next)
-			{
-				next = iter->next;
-				memchunk_free(the_chunk, iter);
-			}
-		}
-		mem_free(hash->vector);
+		mem_free(hash->slot);
 		mem_free(hash);
 	}
 }
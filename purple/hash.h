@@ -24,12 +24,20 @@ extern Hash *	hash_new(HashFunc hfunc, HashKeyEqFunc kefunc);
 
 /* Return a hash table for strings. Inserted elements must begin with a zero-terminated string. */
 extern Hash *	hash_new_string(void);
+
+/* Return a hash table for integer keys, such as node IDs, cast to pointers. Keys are hashed and
+ * compared by value, without calling any functions. This works for keying on pointers, too.
+*/
+extern Hash *	hash_new_int(void);
+
+/* Insert <data> under <key>. If the key is already present, its data is replaced. */
 extern void	hash_insert(Hash *hash, const void *key, void *data);
 extern void *	hash_lookup(const Hash *hash, const void *key);
 extern void	hash_remove(Hash *hash, const void *key);
 
 extern size_t	hash_size(const Hash *hash);
 
+/* Call <func> with each element's data, until it returns 0. The table must not be modified meanwhile. */
 extern void	hash_foreach(const Hash *hash, int (*func)(void *data, void *user), void *user);
 
 extern void	hash_destroy(Hash *hash);
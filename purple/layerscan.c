@@ -0,0 +1,467 @@
+/*
+ * layerscan.c
+ * 
+ * Copyright (C) 2004 PDC, KTH. See COPYING for license details.
+ * 
+ * Layer comparison kernels. Equal data is first skipped with wide vector compares. Elements are
+ * then compared in blocks of at most BLOCK_WORDS 32-bit words, a whole number of 32-byte vectors:
+ * a kernel computes bit masks over the block's words, saying which differ and which hold deletion
+ * sentinels, and those are turned into one bit per element. A run that reaches the end of its
+ * block is extended one element at a time. Whatever doesn't fill a block is compared likewise.
+*/
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined __GNUC__ && (defined __i386__ || defined __x86_64__)
+#define	LAYERSCAN_X86
+#include <immintrin.h>
+#endif
+
+#include "verse.h"
+
+#include "log.h"
+
+#include "layerscan.h"
+
+/* ----------------------------------------------------------------------------------------- */
+
+#define	BLOCK_WORDS	32	/* Most words in a block, one bit each in the masks. */
+#define	VECTOR_WORDS	8	/* Words per 32-byte vector. */
+#define	DELETED_REAL	1e300	/* Vertices with an X coordinate beyond this are deleted. */
+
+typedef struct
+{
+	uint32	diff;		/* Words that differ. */
+	uint32	a_ones, b_ones;	/* Words that are ~0, in <a> and <b>. Polygons only. */
+	uint32	a_huge, b_huge;	/* real64s (pairs of words) beyond DELETED_REAL in magnitude. Vertices only. */
+} Masks;
+
+/* Compute the masks for a block of <vectors> 32-byte vectors. */
+typedef void (*Kernel)(const uint8 *a, const uint8 *b, unsigned int vectors, LayerScanKind kind, Masks *m);
+
+/* Return the number of leading bytes that are equal, rounded down to a whole number of vectors. */
+typedef size_t (*Skipper)(const uint8 *a, const uint8 *b, size_t size);
+
+/* ----------------------------------------------------------------------------------------- */
+
+static void kernel_c(const uint8 *a, const uint8 *b, unsigned int vectors, LayerScanKind kind, Masks *m)
+{
+	unsigned int	i, words = vectors * VECTOR_WORDS;
+	uint32		wa, wb, diff, a_ones, b_ones, a_huge, b_huge;
+	real64		da, db;
+
+	diff = a_ones = b_ones = a_huge = b_huge = 0;
+	for(i = 0; i < words; i++)
+	{
+		memcpy(&wa, a + i * sizeof wa, sizeof wa);
+		memcpy(&wb, b + i * sizeof wb, sizeof wb);
+		diff |= (uint32) (wa != wb) << i;
+		if(kind == LAYERSCAN_POLYGON_UINT32)
+		{
+			a_ones |= (uint32) (wa == ~0u) << i;
+			b_ones |= (uint32) (wb == ~0u) << i;
+		}
+	}
+	if(kind == LAYERSCAN_VERTEX_XYZ)
+	{
+		for(i = 0; i < words / 2; i++)
+		{
+			memcpy(&da, a + i * sizeof da, sizeof da);
+			memcpy(&db, b + i * sizeof db, sizeof db);
+			a_huge |= (uint32) (fabs(da) > DELETED_REAL) << i;
+			b_huge |= (uint32) (fabs(db) > DELETED_REAL) << i;
+		}
+	}
+	m->diff   = diff;
+	m->a_ones = a_ones;
+	m->b_ones = b_ones;
+	m->a_huge = a_huge;
+	m->b_huge = b_huge;
+}
+
+/* The library's memcmp() is usually vectorized already, just call it on large pieces. */
+static size_t skip_c(const uint8 *a, const uint8 *b, size_t size)
+{
+	size_t	i;
+
+	for(i = 0; i + 256 <= size && memcmp(a + i, b + i, 256) == 0; i += 256)
+		;
+	for(; i + 32 <= size && memcmp(a + i, b + i, 32) == 0; i += 32)
+		;
+	return i;
+}
+
+#if defined LAYERSCAN_X86
+
+__attribute__((target("sse2")))
+static size_t skip_sse2(const uint8 *a, const uint8 *b, size_t size)
+{
+	const __m128i	*va = (const __m128i *) a, *vb = (const __m128i *) b;
+	size_t		i;
+	__m128i		x;
+
+	for(i = 0; 4 * (i + 8) <= size / 4; i += 8)
+	{
+		x = _mm_and_si128(_mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128(va + i),     _mm_loadu_si128(vb + i)),
+						_mm_cmpeq_epi8(_mm_loadu_si128(va + i + 1), _mm_loadu_si128(vb + i + 1))),
+				  _mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128(va + i + 2), _mm_loadu_si128(vb + i + 2)),
+						_mm_cmpeq_epi8(_mm_loadu_si128(va + i + 3), _mm_loadu_si128(vb + i + 3))));
+		x = _mm_and_si128(x, _mm_and_si128(_mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128(va + i + 4), _mm_loadu_si128(vb + i + 4)),
+								 _mm_cmpeq_epi8(_mm_loadu_si128(va + i + 5), _mm_loadu_si128(vb + i + 5))),
+						   _mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128(va + i + 6), _mm_loadu_si128(vb + i + 6)),
+								 _mm_cmpeq_epi8(_mm_loadu_si128(va + i + 7), _mm_loadu_si128(vb + i + 7)))));
+		if(_mm_movemask_epi8(x) != 0xffff)
+			break;
+	}
+	for(; 16 * (i + 2) <= size; i += 2)
+	{
+		x = _mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128(va + i),     _mm_loadu_si128(vb + i)),
+				  _mm_cmpeq_epi8(_mm_loadu_si128(va + i + 1), _mm_loadu_si128(vb + i + 1)));
+		if(_mm_movemask_epi8(x) != 0xffff)
+			break;
+	}
+	return 16 * i;
+}
+
+__attribute__((target("sse2")))
+static void kernel_sse2(const uint8 *a, const uint8 *b, unsigned int vectors, LayerScanKind kind, Masks *m)
+{
+	const __m128i	ones = _mm_set1_epi32(-1);
+	const __m128d	abs = _mm_castsi128_pd(_mm_set1_epi64x(0x7fffffffffffffffLL)), huge = _mm_set1_pd(DELETED_REAL);
+	uint32		diff, a_ones, b_ones, a_huge, b_huge;
+	unsigned int	i;
+	__m128i		va, vb;
+
+	diff = a_ones = b_ones = a_huge = b_huge = 0;
+	for(i = 0; i < 2 * vectors; i++)
+	{
+		va = _mm_loadu_si128((const __m128i *) a + i);
+		vb = _mm_loadu_si128((const __m128i *) b + i);
+		diff |= (uint32) (~_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(va, vb))) & 15) << 4 * i;
+		if(kind == LAYERSCAN_POLYGON_UINT32)
+		{
+			a_ones |= (uint32) _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(va, ones))) << 4 * i;
+			b_ones |= (uint32) _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(vb, ones))) << 4 * i;
+		}
+		else if(kind == LAYERSCAN_VERTEX_XYZ)
+		{
+			a_huge |= (uint32) _mm_movemask_pd(_mm_cmpgt_pd(_mm_and_pd(_mm_castsi128_pd(va), abs), huge)) << 2 * i;
+			b_huge |= (uint32) _mm_movemask_pd(_mm_cmpgt_pd(_mm_and_pd(_mm_castsi128_pd(vb), abs), huge)) << 2 * i;
+		}
+	}
+	m->diff   = diff;
+	m->a_ones = a_ones;
+	m->b_ones = b_ones;
+	m->a_huge = a_huge;
+	m->b_huge = b_huge;
+}
+
+__attribute__((target("avx2")))
+static void kernel_avx2(const uint8 *a, const uint8 *b, unsigned int vectors, LayerScanKind kind, Masks *m)
+{
+	const __m256i	ones = _mm256_set1_epi32(-1);
+	const __m256d	abs = _mm256_castsi256_pd(_mm256_set1_epi64x(0x7fffffffffffffffLL)), huge = _mm256_set1_pd(DELETED_REAL);
+	uint32		diff, a_ones, b_ones, a_huge, b_huge;
+	unsigned int	i;
+	__m256i		va, vb;
+
+	diff = a_ones = b_ones = a_huge = b_huge = 0;
+	for(i = 0; i < vectors; i++)
+	{
+		va = _mm256_loadu_si256((const __m256i *) a + i);
+		vb = _mm256_loadu_si256((const __m256i *) b + i);
+		diff |= (uint32) (~_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(va, vb))) & 255) << 8 * i;
+		if(kind == LAYERSCAN_POLYGON_UINT32)
+		{
+			a_ones |= (uint32) _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(va, ones))) << 8 * i;
+			b_ones |= (uint32) _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(vb, ones))) << 8 * i;
+		}
+		else if(kind == LAYERSCAN_VERTEX_XYZ)
+		{
+			a_huge |= (uint32) _mm256_movemask_pd(_mm256_cmp_pd(_mm256_and_pd(_mm256_castsi256_pd(va), abs), huge, _CMP_GT_OQ)) << 4 * i;
+			b_huge |= (uint32) _mm256_movemask_pd(_mm256_cmp_pd(_mm256_and_pd(_mm256_castsi256_pd(vb), abs), huge, _CMP_GT_OQ)) << 4 * i;
+		}
+	}
+	m->diff   = diff;
+	m->a_ones = a_ones;
+	m->b_ones = b_ones;
+	m->a_huge = a_huge;
+	m->b_huge = b_huge;
+}
+
+__attribute__((target("avx2")))
+static size_t skip_avx2(const uint8 *a, const uint8 *b, size_t size)
+{
+	const __m256i	*va = (const __m256i *) a, *vb = (const __m256i *) b;
+	size_t		i;
+	__m256i		x;
+
+	for(i = 0; 32 * (i + 4) <= size; i += 4)
+	{
+		x = _mm256_or_si256(_mm256_or_si256(_mm256_xor_si256(_mm256_loadu_si256(va + i),     _mm256_loadu_si256(vb + i)),
+						    _mm256_xor_si256(_mm256_loadu_si256(va + i + 1), _mm256_loadu_si256(vb + i + 1))),
+				    _mm256_or_si256(_mm256_xor_si256(_mm256_loadu_si256(va + i + 2), _mm256_loadu_si256(vb + i + 2)),
+						    _mm256_xor_si256(_mm256_loadu_si256(va + i + 3), _mm256_loadu_si256(vb + i + 3))));
+		if(!_mm256_testz_si256(x, x))
+			break;
+	}
+	for(; 32 * (i + 1) <= size; i++)
+	{
+		x = _mm256_xor_si256(_mm256_loadu_si256(va + i), _mm256_loadu_si256(vb + i));
+		if(!_mm256_testz_si256(x, x))
+			break;
+	}
+	return 32 * i;
+}
+
+static int supported_sse2(void)
+{
+	return __builtin_cpu_supports("sse2");
+}
+
+static int supported_avx2(void)
+{
+	return __builtin_cpu_supports("avx2");
+}
+
+#endif		/* LAYERSCAN_X86 */
+
+static int supported_c(void)
+{
+	return 1;
+}
+
+/* Best first. The plain C kernel must be last, it's the default. */
+static const struct
+{
+	const char	*name;
+	Kernel		kernel;
+	Skipper		skip;
+	int		(*supported)(void);
+} kernel_list[] = {
+#if defined LAYERSCAN_X86
+	{ "avx2", kernel_avx2, skip_avx2, supported_avx2 },
+	{ "sse2", kernel_sse2, skip_sse2, supported_sse2 },
+#endif
+	{ "c", kernel_c, skip_c, supported_c }
+};
+
+#define	KERNEL_NUM	(sizeof kernel_list / sizeof *kernel_list)
+
+static unsigned int	kernel_index = KERNEL_NUM - 1;
+
+void layerscan_init(void)
+{
+	unsigned int	i;
+
+	for(i = 0; !kernel_list[i].supported(); i++)
+		;
+	kernel_index = i;
+	LOG_MSG(("Comparing layers using %s kernel", kernel_list[i].name));
+}
+
+int layerscan_kernel_set(const char *name)
+{
+	unsigned int	i;
+
+	for(i = 0; i < KERNEL_NUM; i++)
+	{
+		if(strcmp(kernel_list[i].name, name) == 0 && kernel_list[i].supported())
+		{
+			kernel_index = i;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+const char * layerscan_kernel(void)
+{
+	return kernel_list[kernel_index].name;
+}
+
+/* ----------------------------------------------------------------------------------------- */
+
+/* Compare single elements. Returns 0 if equal, 1 if not, and 2 for a polygon deleted in <a> only. */
+static int element_compare(LayerScanKind kind, const uint8 *a, const uint8 *b, size_t esize)
+{
+	real64	xa, xb;
+	uint32	wa, wb;
+
+	if(memcmp(a, b, esize) == 0)
+		return 0;
+	if(kind == LAYERSCAN_VERTEX_XYZ)
+	{
+		memcpy(&xa, a, sizeof xa);
+		memcpy(&xb, b, sizeof xb);
+		return !(fabs(xa) > DELETED_REAL && fabs(xb) > DELETED_REAL);
+	}
+	else if(kind == LAYERSCAN_POLYGON_UINT32)
+	{
+		memcpy(&wa, a, sizeof wa);
+		memcpy(&wb, b, sizeof wb);
+		return wa == ~0u && wb != ~0u ? 2 : 1;
+	}
+	return 1;
+}
+
+/* Return the number of <esize>-byte elements in a block, or 0 if they don't fit the kernels. */
+static unsigned int block_elements(size_t esize)
+{
+	unsigned int	e = esize / sizeof (uint32), per = 0;
+
+	if(e > 0 && esize % sizeof (uint32) == 0 && e <= BLOCK_WORDS)
+	{
+		for(per = BLOCK_WORDS / e; per > 0 && (per * e) % VECTOR_WORDS != 0; per--)
+			;
+	}
+	return per;
+}
+
+/* Compare up to <num> elements, starting at <a> and <b>, in blocks of <per>. Sets a bit in <diff>
+ * for each element that differs, and in <del> for each polygon deleted in <a> only. Returns the
+ * number compared, which is at least one and at most 32.
+*/
+static unsigned int block_compare(LayerScanKind kind, const uint8 *a, const uint8 *b, size_t esize, unsigned int per,
+				  size_t num, uint32 *diff, uint32 *del)
+{
+	unsigned int	e = esize / sizeof (uint32), j, k;
+	uint32		any, both, dl, d = 0, x = 0;
+	Masks		m;
+	int		r;
+
+	if(per > 0 && per <= num)
+	{
+		kernel_list[kernel_index].kernel(a, b, per * e / VECTOR_WORDS, kind, &m);
+		if(m.diff != 0)
+		{
+			/* Gather each element's words onto its first one, then pick those out. */
+			for(any = m.diff, j = 1; j < e; j++)
+				any |= m.diff >> j;
+			for(k = 0; k < per; k++)
+				d |= ((any >> k * e) & 1) << k;
+			if(kind == LAYERSCAN_VERTEX_XYZ)
+			{
+				for(both = m.a_huge & m.b_huge, k = 0; k < per; k++)
+					x |= ((both >> 3 * k) & 1) << k;
+				d &= ~x;
+				x = 0;
+			}
+			else if(kind == LAYERSCAN_POLYGON_UINT32)
+			{
+				for(dl = m.a_ones & ~m.b_ones, k = 0; k < per; k++)
+					x |= ((dl >> 4 * k) & 1) << k;
+				x &= d;
+			}
+		}
+	}
+	else	/* Not enough left to fill a block, or elements that don't fit one. */
+	{
+		per = num < 32 ? num : 32;
+		for(k = 0; k < per; k++)
+		{
+			r = element_compare(kind, a + k * esize, b + k * esize, esize);
+			d |= (uint32) (r != 0) << k;
+			x |= (uint32) (r == 2) << k;
+		}
+	}
+	*diff = d;
+	*del  = x;
+	return per;
+}
+
+/* Return the first element from <i> on that doesn't compare as <want> (see element_compare()), or
+ * <end>. This is element_compare() again, unrolled into the loop since it's where long runs go.
+*/
+static size_t run_extend(LayerScanKind kind, const uint8 *a, const uint8 *b, size_t esize, size_t i, size_t end, int want)
+{
+	const uint8	*pa, *pb;
+	real64		xa, xb;
+	uint32		wa, wb;
+
+	for(; i < end; i++)
+	{
+		pa = a + i * esize;
+		pb = b + i * esize;
+		if(kind == LAYERSCAN_VERTEX_XYZ)	/* Constant sizes let the compiler inline memcmp(). */
+		{
+			if(memcmp(pa, pb, 3 * sizeof xa) == 0)
+				break;
+			memcpy(&xa, pa, sizeof xa);
+			memcpy(&xb, pb, sizeof xb);
+			if(fabs(xa) > DELETED_REAL && fabs(xb) > DELETED_REAL)
+				break;
+		}
+		else if(kind == LAYERSCAN_POLYGON_UINT32)
+		{
+			if(memcmp(pa, pb, 4 * sizeof wa) == 0)
+				break;
+			memcpy(&wa, pa, sizeof wa);
+			memcpy(&wb, pb, sizeof wb);
+			if((wa == ~0u && wb != ~0u ? 2 : 1) != want)
+				break;
+		}
+		else if(memcmp(pa, pb, esize) == 0)
+			break;
+	}
+	return i;
+}
+
+/* Returns the index of the lowest set bit in <x>, which must not be zero. */
+static unsigned int lowest_bit(uint32 x)
+{
+#if defined __GNUC__
+	return __builtin_ctz(x);
+#else
+	unsigned int	i;
+
+	for(i = 0; (x & 1) == 0; x >>= 1)
+		i++;
+	return i;
+#endif
+}
+
+size_t layerscan_next(LayerScanKind kind, const void *a, const void *b, size_t esize,
+		      size_t start, size_t end, size_t *run_end, int *deleted)
+{
+	const uint8	*pa = a, *pb = b;
+	size_t		i, first;
+	unsigned int	per, n = 0, k;
+	uint32		diff = 0, del = 0, same;
+	int		d;
+
+	if((kind == LAYERSCAN_VERTEX_XYZ && esize != 3 * sizeof (real64)) ||
+	   (kind == LAYERSCAN_POLYGON_UINT32 && esize != 4 * sizeof (uint32)))
+		kind = LAYERSCAN_PLAIN;
+	per = block_elements(esize);
+	/* Find the first element that differs. Skip quickly over equal data, then look closer. */
+	for(i = start; i < end; i += n)
+	{
+		if((i += kernel_list[kernel_index].skip(pa + i * esize, pb + i * esize, (end - i) * esize) / esize) >= end)
+			break;
+		n = block_compare(kind, pa + i * esize, pb + i * esize, esize, per, end - i, &diff, &del);
+		if(diff != 0)
+			break;
+	}
+	if(i >= end)
+	{
+		*run_end = end;
+		return end;
+	}
+	k = lowest_bit(diff);
+	first = i + k;
+	d = (del >> k) & 1;
+	/* Extend the run through the block's masks, then over any following elements that differ in
+	 * the same way. Long runs are rare, and each element in one has to be handled anyway.
+	*/
+	same = d ? diff & del : diff & ~del;
+	for(k++; k < n && ((same >> k) & 1); k++)
+		;
+	i = k < n ? i + k : run_extend(kind, pa, pb, esize, i + n, end, 1 + d);
+	*run_end = i;
+	if(deleted != NULL)
+		*deleted = d;
+	return first;
+}
@@ -0,0 +1,45 @@
+/*
+ * layerscan.h
+ * 
+ * Copyright (C) 2004 PDC, KTH. See COPYING for license details.
+ * 
+ * Comparison of two arrays of fixed-size elements, such as a geometry layer and its remote
+ * copy, that finds runs of differing elements in one pass rather than calling memcmp() once
+ * per element. There are SSE2 and AVX2 kernels, picked at run-time by layerscan_init(), and a
+ * plain C one that is used everywhere else. The kernels know about the synchronizer's special
+ * cases for deleted vertices and polygons, so those don't need to be checked separately.
+*/
+
+#if !defined LAYERSCAN_H
+#define	LAYERSCAN_H
+
+typedef enum
+{
+	LAYERSCAN_PLAIN = 0,		/* Elements are compared bytewise. */
+	LAYERSCAN_VERTEX_XYZ,		/* Three real64s. Vertices deleted in both (|x| > 1e300) are equal. */
+	LAYERSCAN_POLYGON_UINT32	/* Four uint32s. Runs separate polygons deleted (first corner ~0) in <a> only. */
+} LayerScanKind;
+
+/* Pick the fastest kernel the CPU supports. Until this is called, the plain C one is used. */
+extern void		layerscan_init(void);
+
+/* Use the named kernel ("c", "sse2" or "avx2"). Returns 0 if it isn't supported here. */
+extern int		layerscan_kernel_set(const char *name);
+extern const char *	layerscan_kernel(void);
+
+/* Find the first run of differing elements at or after <start> and before <end>, in the arrays
+ * <a> and <b> of <esize>-byte elements. Returns the index of the run's first element, or <end>
+ * if there is none, and sets <run_end> to one past its last element. For polygons, <deleted>
+ * is set if the run is of polygons that are deleted in <a> but not in <b>, and can be NULL for
+ * other kinds. Use as follows:
+ * 
+ * for(i = layerscan_next(k, a, b, esize, 0, size, &end, &del); i < size;
+ *     i = layerscan_next(k, a, b, esize, end, size, &end, &del))
+ * {
+ * 	Elements <i> up to, but not including, <end> differ.
+ * }
+*/
+extern size_t		layerscan_next(LayerScanKind kind, const void *a, const void *b, size_t esize,
+				       size_t start, size_t end, size_t *run_end, int *deleted);
+
+#endif		/* LAYERSCAN_H */
@@ -9,6 +9,10 @@
 
 #include <stdlib.h>
 
+#if !defined _WIN32
+#include <pthread.h>
+#endif
+
 #include "log.h"
 #include "mem.h"
 #include "strutil.h"
@@ -37,6 +41,21 @@ struct MemChunk
 	size_t	num_alloc;
 };
 
+/* A single lock shared by all chunks is plenty; allocations are short, and rarely contended. */
+#if !defined _WIN32
+static struct
+{
+	int		enabled;
+	pthread_mutex_t	lock;
+} memchunk_sync = { 0, PTHREAD_MUTEX_INITIALIZER };
+
+#define	LOCK()		do { if(memchunk_sync.enabled) pthread_mutex_lock(&memchunk_sync.lock); } while(0)
+#define	UNLOCK()	do { if(memchunk_sync.enabled) pthread_mutex_unlock(&memchunk_sync.lock); } while(0)
+#else
+#define	LOCK()
+#define	UNLOCK()
+#endif
+
 /* ----------------------------------------------------------------------------------------- */
 
 /* We're fresh out of chunks, so allocate more. */
@@ -100,22 +119,26 @@ void * memchunk_alloc(MemChunk *chunk)
 
 	if(chunk == NULL)
 		return NULL;
+	LOCK();
 	if(chunk->next == NULL)
 		grow(chunk);
-	if(chunk->next == NULL)
-		return NULL;
-	b = chunk->next;
-	chunk->next = b->next;
-	b->next = NULL;
-	return (char *) b + sizeof *b;
+	if((b = chunk->next) != NULL)
+	{
+		chunk->next = b->next;
+		b->next = NULL;
+	}
+	UNLOCK();
+	return b != NULL ? (char *) b + sizeof *b : NULL;
 }
 
 void memchunk_free(MemChunk *chunk, void *ptr)
 {
 	Block	*b = (Block *) ((char *) ptr - sizeof *b);
 
+	LOCK();
 	b->next = chunk->next;
 	chunk->next = b;
+	UNLOCK();
 }
 
 void memchunk_destroy(MemChunk *chunk)
@@ -132,3 +155,10 @@ void memchunk_destroy(MemChunk *chunk)
 		mem_free(chunk);
 	}
 }
+
+void memchunk_threads_set(int enabled)
+{
+#if !defined _WIN32
+	memchunk_sync.enabled = enabled;
+#endif
+}
@@ -22,3 +22,8 @@ extern size_t		memchunk_growth(const MemChunk *chunk);
 extern void *		memchunk_alloc(MemChunk *chunk);
 extern void		memchunk_free(MemChunk *chunk, void *ptr);
 extern void		memchunk_destroy(MemChunk *chunk);
+
+/* Make allocation and freeing safe to call from several threads at once. Off by default,
+ * since it costs a mutex operation per call. Turned on if worker threads are started.
+*/
+extern void		memchunk_threads_set(int enabled);
@@ -0,0 +1,326 @@
+/*
+ * memo.c
+ * 
+ * Copyright (C) 2004 PDC, KTH. See COPYING for license details.
+ * 
+ * Memoization of pure plug-in outputs. Each entry holds a packed copy of the inputs an
+ * instance computed from, and copies of the values and nodes it output. Entries are kept
+ * in a hash for lookup, and on a doubly linked list in least recently used order so the
+ * oldest ones can be evicted when the size limit is reached.
+*/
+
+#include <stdarg.h>
+#include <string.h>
+
+#include "purple.h"
+
+#include "hash.h"
+#include "mem.h"
+#include "value.h"
+#include "nodeset.h"
+#include "plugins.h"
+#include "port.h"
+
+#include "nodedb.h"
+#include "graph.h"
+
+#include "memo.h"
+
+#define	MEMO_LIMIT_DEFAULT	(16 << 20)	/* Default size limit, in bytes. */
+
+typedef struct
+{
+	PNode	*node;		/* Private copy of an output node, with the original's name. */
+	uint32	label;		/* Label used to create it in its module, or ~0 if it has none. */
+} MemoNode;
+
+typedef struct MemoEntry	MemoEntry;
+
+struct MemoEntry
+{
+	const PInstance	*inst;
+	unsigned int	hash;
+	size_t		key_size;
+	unsigned char	*key;		/* Packed inputs, see key_build(). Co-allocated with entry. */
+
+	PValue		value;		/* Simple values of the output. */
+	uint32		version;	/* Version the output had, restored along with it. */
+	size_t		node_num;
+	MemoNode	*node;
+
+	size_t		size;		/* Approximate memory use of entry, including node copies. */
+	MemoEntry	*prev, *next;	/* LRU list, most recently used first. */
+};
+
+static struct
+{
+	size_t		limit, bytes;
+	Hash		*entries;
+	MemoEntry	*head, *tail;
+
+	MemoEntry	probe;		/* Lookup key for the hash, refers to the key buffer below. */
+	unsigned char	*key;
+	size_t		key_alloc;
+
+	MemoStats	stats;
+} memo_info;
+
+/* ----------------------------------------------------------------------------------------- */
+
+static unsigned int entry_hash(const void *key)
+{
+	return ((const MemoEntry *) key)->hash;
+}
+
+static int entry_key_eq(const void *key1, const void *key2)
+{
+	const MemoEntry	*e1 = key1, *e2 = key2;
+
+	return e1->inst == e2->inst && e1->key_size == e2->key_size && memcmp(e1->key, e2->key, e1->key_size) == 0;
+}
+
+void memo_init(void)
+{
+	memo_info.limit = MEMO_LIMIT_DEFAULT;
+	memo_info.entries = hash_new(entry_hash, entry_key_eq);
+}
+
+/* ----------------------------------------------------------------------------------------- */
+
+static void key_append(const void *data, size_t size)
+{
+	if(memo_info.probe.key_size + size > memo_info.key_alloc)
+	{
+		size_t		na = 2 * (memo_info.probe.key_size + size);
+		unsigned char	*nk;
+
+		if((nk = mem_realloc(memo_info.key, na)) == NULL)
+			return;
+		memo_info.key = nk;
+		memo_info.key_alloc = na;
+	}
+	memcpy(memo_info.key + memo_info.probe.key_size, data, size);
+	memo_info.probe.key_size += size;
+}
+
+#define	KEY_FIELD(v, t, f)	if((v)->set & (1 << P_VALUE_ ##t)) key_append(&(v)->v.f, sizeof (v)->v.f)
+
+/* Append the types set in <v>, and the values of only those types. */
+static void key_append_value(const PValue *v)
+{
+	key_append(&v->set, sizeof v->set);
+	KEY_FIELD(v, BOOLEAN, vboolean);
+	KEY_FIELD(v, INT32, vint32);
+	KEY_FIELD(v, UINT32, vuint32);
+	KEY_FIELD(v, REAL32, vreal32);
+	KEY_FIELD(v, REAL32_VEC2, vreal32_vec2);
+	KEY_FIELD(v, REAL32_VEC3, vreal32_vec3);
+	KEY_FIELD(v, REAL32_VEC4, vreal32_vec4);
+	KEY_FIELD(v, REAL32_MAT16, vreal32_mat16);
+	KEY_FIELD(v, REAL64, vreal64);
+	KEY_FIELD(v, REAL64_VEC2, vreal64_vec2);
+	KEY_FIELD(v, REAL64_VEC3, vreal64_vec3);
+	KEY_FIELD(v, REAL64_VEC4, vreal64_vec4);
+	KEY_FIELD(v, REAL64_MAT16, vreal64_mat16);
+	KEY_FIELD(v, MODULE, vmodule);
+	if(v->set & (1 << P_VALUE_STRING))
+		key_append(v->v.vstring, strlen(v->v.vstring) + 1);
+}
+
+/* Build the lookup key for <inst>'s current inputs. Literal inputs are packed by value. Inputs
+ * linked to another module's output are packed as that output and its version, which changes
+ * whenever the output (including any nodes in it) does. Fails if the instance couldn't run.
+*/
+static boolean key_build(PInstance *inst)
+{
+	PPInput		*port;
+	size_t		num, i;
+	uint32		version;
+	unsigned int	h = 2166136261u;
+
+	memo_info.probe.inst = inst;
+	memo_info.probe.key_size = 0;
+	if((port = plugin_instance_inputs(inst, &num)) == NULL)
+		return FALSE;
+	for(i = 0; i < num; i++)
+	{
+		if(plugin_portset_get_module(inst->inputs, i, NULL))
+		{
+			version = graph_port_output_version(port[i]);
+			key_append(&port[i], sizeof port[i]);
+			key_append(&version, sizeof version);
+		}
+		else
+			key_append_value(&port[i]->value);
+	}
+	for(i = 0; i < memo_info.probe.key_size; i++)	/* FNV-1a. */
+		h = (h ^ memo_info.key[i]) * 16777619u;
+	memo_info.probe.hash = h;
+	memo_info.probe.key = memo_info.key;
+	return TRUE;
+}
+
+/* ----------------------------------------------------------------------------------------- */
+
+static void lru_unlink(MemoEntry *e)
+{
+	if(e->prev != NULL)
+		e->prev->next = e->next;
+	else
+		memo_info.head = e->next;
+	if(e->next != NULL)
+		e->next->prev = e->prev;
+	else
+		memo_info.tail = e->prev;
+}
+
+static void lru_push(MemoEntry *e)
+{
+	e->prev = NULL;
+	e->next = memo_info.head;
+	if(memo_info.head != NULL)
+		memo_info.head->prev = e;
+	else
+		memo_info.tail = e;
+	memo_info.head = e;
+}
+
+static void entry_destroy(MemoEntry *e)
+{
+	size_t	i;
+
+	for(i = 0; i < e->node_num; i++)
+		nodedb_destroy(e->node[i].node);
+	mem_free(e->node);
+	value_clear(&e->value);
+	mem_free(e);
+}
+
+static void entry_remove(MemoEntry *e)
+{
+	hash_remove(memo_info.entries, e);
+	lru_unlink(e);
+	memo_info.bytes -= e->size;
+	entry_destroy(e);
+}
+
+/* Drop least recently used entries until the cache fits in its limit. */
+static void evict(void)
+{
+	while(memo_info.bytes > memo_info.limit && memo_info.tail != NULL)
+	{
+		entry_remove(memo_info.tail);
+		memo_info.stats.evictions++;
+	}
+}
+
+void memo_limit_set(size_t bytes)
+{
+	memo_info.limit = bytes;
+	evict();
+}
+
+/* ----------------------------------------------------------------------------------------- */
+
+boolean memo_recall(PInstance *inst)
+{
+	MemoEntry	*e;
+	PNode		*n;
+	size_t		i;
+
+	if(memo_info.limit == 0 || memo_info.entries == NULL || !key_build(inst))
+		return FALSE;
+	if((e = hash_lookup(memo_info.entries, &memo_info.probe)) == NULL)
+	{
+		memo_info.stats.misses++;
+		return FALSE;
+	}
+	graph_port_output_recall(inst->output, &e->value, e->version);
+	for(i = e->node_num; i-- > 0;)		/* Node sets prepend, so go backwards to keep the order. */
+	{
+		if(e->node[i].label != ~0u)
+			n = graph_port_output_node_copy(inst->output, e->node[i].node, e->node[i].label);
+		else if((n = nodedb_new_copy(e->node[i].node)) != NULL)
+			graph_port_output_set_node(inst->output, n);
+		if(n != NULL)
+		{
+			nodedb_rename(n, e->node[i].node->name);
+			nodedb_tag_groups_set(n, e->node[i].node);
+		}
+	}
+	lru_unlink(e);
+	lru_push(e);
+	memo_info.stats.hits++;
+	return TRUE;
+}
+
+void memo_store(PInstance *inst)
+{
+	MemoEntry	*e;
+	const PNode	*n;
+	size_t		i, num;
+
+	if(memo_info.limit == 0 || memo_info.entries == NULL || !key_build(inst))
+		return;
+	if((e = hash_lookup(memo_info.entries, &memo_info.probe)) != NULL)
+		entry_remove(e);
+	for(num = 0; nodeset_retrieve_nth(inst->output->nodes, num) != NULL; num++)
+		;
+	if((e = mem_alloc(sizeof *e + memo_info.probe.key_size)) == NULL)
+		return;
+	e->inst = inst;
+	e->hash = memo_info.probe.hash;
+	e->key_size = memo_info.probe.key_size;
+	e->key = (unsigned char *) (e + 1);
+	memcpy(e->key, memo_info.probe.key, e->key_size);
+	value_init(&e->value);
+	value_copy(&e->value, &inst->output->value);
+	e->version = graph_port_output_version(inst->output);
+	e->node_num = 0;
+	e->node = num > 0 ? mem_alloc(num * sizeof *e->node) : NULL;
+	e->size = sizeof *e + e->key_size + num * sizeof *e->node;
+	if(e->value.set & (1 << P_VALUE_STRING))
+		e->size += strlen(e->value.v.vstring) + 1;
+	for(i = 0; i < num && e->node != NULL; i++)
+	{
+		n = nodeset_retrieve_nth(inst->output->nodes, i);
+		if((e->node[e->node_num].node = nodedb_new_copy(n)) == NULL)
+			break;
+		nodedb_rename(e->node[e->node_num].node, n->name);	/* Copies get a "copy of" name. */
+		if(!graph_port_output_node_label(inst->output, n, &e->node[e->node_num].label))
+			e->node[e->node_num].label = ~0u;
+		e->size += nodedb_size(e->node[e->node_num].node);
+		e->node_num++;
+	}
+	if(e->node_num < num || e->size > memo_info.limit)	/* Didn't copy, or won't ever fit. */
+	{
+		entry_destroy(e);
+		return;
+	}
+	hash_insert(memo_info.entries, e, e);
+	lru_push(e);
+	memo_info.bytes += e->size;
+	evict();
+}
+
+void memo_forget(const PInstance *inst)
+{
+	MemoEntry	*e, *next;
+
+	for(e = memo_info.head; e != NULL; e = next)
+	{
+		next = e->next;
+		if(e->inst == inst)
+			entry_remove(e);
+	}
+}
+
+void memo_stats_get(MemoStats *stats)
+{
+	if(stats == NULL)
+		return;
+	*stats = memo_info.stats;
+	stats->entries = memo_info.entries != NULL ? hash_size(memo_info.entries) : 0;
+	stats->bytes   = memo_info.bytes;
+	stats->limit   = memo_info.limit;
+}
@@ -0,0 +1,41 @@
+/*
+ * memo.h
+ * 
+ * Copyright (C) 2004 PDC, KTH. See COPYING for license details.
+ * 
+ * A memoization cache for the outputs of pure plug-ins. When an instance of a plug-in
+ * that has declared itself pure (P_PLUGIN_PURE) finishes computing, its output is stored
+ * here, keyed on the instance and the exact values of its inputs. If the instance later
+ * sees the very same inputs again, the output is restored from the cache instead of
+ * running compute(). Inputs linked to other modules are keyed on the version of that
+ * module's output, which covers any nodes it holds. The cache is a bounded LRU.
+*/
+
+/* Initialize the cache, with the default size limit. */
+extern void	memo_init(void);
+
+/* Set the maximum number of bytes held by the cache. Zero disables it. */
+extern void	memo_limit_set(size_t bytes);
+
+/* Look up the current inputs of <inst>, and if found, set its output to what was stored.
+ * Must be called between graph_port_output_begin() and _end(). Returns TRUE on a hit.
+*/
+extern boolean	memo_recall(PInstance *inst);
+
+/* Store the output of <inst>, which has just finished computing from its current inputs. */
+extern void	memo_store(PInstance *inst);
+
+/* Drop all entries for <inst>, which is going away. */
+extern void	memo_forget(const PInstance *inst);
+
+typedef struct
+{
+	unsigned long	hits;		/* Lookups that restored an output, saving a compute(). */
+	unsigned long	misses;		/* Lookups that found nothing. */
+	unsigned long	evictions;	/* Entries dropped to stay under the limit. */
+	size_t		entries;	/* Number of entries currently held. */
+	size_t		bytes;		/* Approximate size of those entries. */
+	size_t		limit;		/* Size limit, in bytes. */
+} MemoStats;
+
+extern void	memo_stats_get(MemoStats *stats);
@@ -49,12 +49,6 @@ static size_t block_size(VNABlockType type)
 	return size[type];
 }
 
-/* Compare audio blocks, for bintree. */
-static int block_compare(const void *key1, const void *key2)
-{
-	return key1 < key2 ? -1 : key1 > key2;
-}
-
 /* ----------------------------------------------------------------------------------------- */
 
 void nodedb_a_construct(NodeAudio *n)
@@ -74,18 +68,18 @@ static NdbABlk * block_new(const NdbABuffer *buffer)
 	return blk;
 }
 
-static void * block_copy(UNUSED(const void *key), const void *element, void *user)
+static void * block_copy(const void *element, void *user)
 {
 	const NdbABuffer	*ref = (NdbABuffer *) user;
 	NdbABlk		*blk;
 
-	blk = block_new(ref);
-	memcpy(blk->data, ((NdbABlk *) element)->data, block_size(ref->type));
+	if((blk = block_new(ref)) != NULL)
+		memcpy(blk->data, ((NdbABlk *) element)->data, block_size(ref->type));
 
 	return blk;
 }
 
-static void block_destroy(NdbABlk *blk)
+static void block_destroy(void *blk)
 {
 	mem_free(blk);
 }
@@ -99,7 +93,8 @@ static void cb_copy_buffer(void *d, const void *s, UNUSED(void *user))
 	strcpy(dst->name, src->name);
 	dst->type = src->type;
 	dst->frequency = src->frequency;
-	dst->blocks = bintree_new_copy(src->blocks, block_copy, dst);
+	dst->blocks = pagearr_new_copy(src->blocks, block_copy, dst);
+	dirty_init(&dst->dirty, 0);	/* Nothing is known about what a new copy is in sync with. */
 }
 
 void nodedb_a_copy(NodeAudio *n, const NodeAudio *src)
@@ -107,34 +102,76 @@ void nodedb_a_copy(NodeAudio *n, const NodeAudio *src)
 	n->buffers = dynarr_new_copy(src->buffers, cb_copy_buffer, NULL);
 }
 
-/* Set <n> to equal contents of <src>. */
-void nodedb_a_set(NodeAudio *n, const NodeAudio *src)
+static NdbABuffer * buffers_find(const DynArr *buffers, const char *name)
 {
-	/* FIXME: This can't quite claim to be efficent. :/ */
-	nodedb_a_destruct(n);
-	nodedb_a_copy(n, src);
-}
+	unsigned int	i;
+	NdbABuffer	*la;
 
-static void cb_block_destroy(UNUSED(const void *key), void *element)
-{
-	block_destroy(element);
+	for(i = 0; (la = dynarr_index(buffers, i)) != NULL; i++)
+	{
+		if(strcmp(la->name, name) == 0)
+			return la;
+	}
+	return NULL;
 }
 
-void nodedb_a_destruct(NodeAudio *n)
+static void buffers_destroy(DynArr *buffers)
 {
 	unsigned int	i, num;
+	NdbABuffer	*la;
 
-	num = dynarr_size(n->buffers);
+	num = dynarr_size(buffers);
 	for(i = 0; i < num; i++)
 	{
-		NdbABuffer	*la;
+		if((la = dynarr_index(buffers, i)) == NULL)
+			continue;
+		dirty_free(&la->dirty);
+		if(la->name[0] != '\0')
+			pagearr_destroy(la->blocks, block_destroy);
+	}
+	dynarr_destroy(buffers);
+}
 
-		if((la = dynarr_index(n->buffers, i)) != NULL && la->name[0] != '\0')
-		{
-			bintree_destroy(la->blocks, cb_block_destroy);
-		}
+/* Mark the blocks of <buffer> that differ from those in <old>, the same buffer as it was before. */
+static void buffer_dirty_diff(NdbABuffer *buffer, const NdbABuffer *old)
+{
+	size_t	index, end = pagearr_end(buffer->blocks);
+
+	for(index = pagearr_next(buffer->blocks, 0); index < end; index = pagearr_next(buffer->blocks, index + 1))
+	{
+		if(!nodedb_a_blocks_equal(buffer->type, pagearr_get(buffer->blocks, index), pagearr_get(old->blocks, index)))
+			dirty_mark(&buffer->dirty, index, 1);
+	}
+}
+
+/* Set <n> to equal contents of <src>. Buffers that were in <n> before keep their dirty state, plus
+ * whatever blocks the new contents differ in, so the synchronizer needn't compare them in full.
+*/
+void nodedb_a_set(NodeAudio *n, const NodeAudio *src)
+{
+	DynArr		*old = n->buffers;
+	unsigned int	i;
+	NdbABuffer	*la, *ol;
+
+	/* FIXME: This can't quite claim to be efficent. :/ */
+	n->buffers = NULL;
+	nodedb_a_copy(n, src);
+	for(i = 0; (la = dynarr_index(n->buffers, i)) != NULL; i++)
+	{
+		if(la->name[0] == '\0' || (ol = buffers_find(old, la->name)) == NULL || ol->type != la->type)
+			continue;
+		dirty_clear(&la->dirty);
+		dirty_merge(&la->dirty, &ol->dirty);
+		buffer_dirty_diff(la, ol);
 	}
-	dynarr_destroy(n->buffers);
+	if(old != NULL)
+		buffers_destroy(old);
+}
+
+void nodedb_a_destruct(NodeAudio *n)
+{
+	if(n->buffers != NULL)
+		buffers_destroy(n->buffers);
 	n->buffers = NULL;
 }
 
@@ -174,17 +211,9 @@ NdbABuffer * nodedb_a_buffer_nth(const NodeAudio *node, unsigned int n)
 
 NdbABuffer * nodedb_a_buffer_find(const NodeAudio *node, const char *name)
 {
-	unsigned int	i;
-	NdbABuffer	*la;
-
 	if(node == NULL || name == NULL || *name == '\0')
 		return NULL;
-	for(i = 0; (la = dynarr_index(node->buffers, i)) != NULL; i++)
-	{
-		if(strcmp(la->name, name) == 0)
-			return la;
-	}
-	return NULL;
+	return buffers_find(node->buffers, name);
 }
 
 static void cb_def_buffer(UNUSED(unsigned int index), void *element, UNUSED(void *user))
@@ -193,6 +222,7 @@ static void cb_def_buffer(UNUSED(unsigned int index), void *element, UNUSED(void
 
 	la->name[0] = '\0';
 	la->blocks  = NULL;
+	dirty_init(&la->dirty, 0);
 }
 
 NdbABuffer * nodedb_a_buffer_create(NodeAudio *node, VBufferID buffer_id, const char *name, VNABlockType type, real64 frequency)
@@ -215,9 +245,7 @@ NdbABuffer * nodedb_a_buffer_create(NodeAudio *node, VBufferID buffer_id, const
 			if(la->name[0] != '\0')
 			{
 				if(la->blocks != NULL)
-				{
-					/*bintree_destroy(); */
-				}
+					pagearr_destroy(la->blocks, block_destroy);
 			}
 		}
 	}
@@ -226,6 +254,8 @@ NdbABuffer * nodedb_a_buffer_create(NodeAudio *node, VBufferID buffer_id, const
 	la->type = type;
 	la->frequency = frequency;
 	la->blocks = NULL;
+	dirty_free(&la->dirty);
+	dirty_init(&la->dirty, 0);
 
 	return la;
 }
@@ -243,36 +273,107 @@ int nodedb_a_blocks_equal(VNABlockType type, const NdbABlk *blk1, const NdbABlk
 
 /* ----------------------------------------------------------------------------------------- */
 
-#define	READINT(bits)	\
+/* Convert <count> samples from <offset> in a block's data to real64. Each type gets a plain loop
+ * over the samples, with the scale factor known up front, so the compiler can vectorize it.
+*/
+#define	READINT(bits, scale)	\
 	{\
-		int ## bits	*get = blk->data;\
-		for(i = 0, get += offset; i < chunk; i++)\
-			*samples++ = ((real64) *get++) / (real64) (1 << (bits - 1));\
+		const int ## bits	*get = (const int ## bits *) data + offset;\
+		for(i = 0; i < count; i++)\
+			samples[i] = get[i] * (scale);\
 	}\
 	break
 
 #define	READREAL(bits)	\
 	{\
-		real ## bits	*get = blk->data;\
-		for(i = 0, get += offset; i < chunk; i++)\
-			*samples++ = *get++;\
+		const real ## bits	*get = (const real ## bits *) data + offset;\
+		for(i = 0; i < count; i++)\
+			samples[i] = get[i];\
 	}\
 	break
 
+static void block_read(VNABlockType type, const void *data, unsigned int offset, real64 *samples, unsigned int count)
+{
+	unsigned int	i;
+
+	switch(type)
+	{
+	case VN_A_BLOCK_INT8:
+		READINT(8, 1.0 / 128.0);
+	case VN_A_BLOCK_INT16:
+		READINT(16, 1.0 / 32768.0);
+	case VN_A_BLOCK_INT24:
+		{
+			const uint32	*get = (const uint32 *) data + offset;
+			for(i = 0; i < count; i++)
+				samples[i] = (get[i] >> 8) * (((real64) (1 << 24)) / 4294967296.0);
+		}
+		break;
+	case VN_A_BLOCK_INT32:
+		READINT(32, 1.0 / 2147483648.0);
+	case VN_A_BLOCK_REAL32:
+		READREAL(32);
+	case VN_A_BLOCK_REAL64:
+		READREAL(64);
+	}
+}
+
+/* Handy dandy macros for writing data back into blocks, and make my life a bit easier. */
+#define	WRITEINT(bits, scale)	\
+	{\
+		int ## bits	*put = (int ## bits *) data + offset;\
+		for(i = 0; i < count; i++)\
+			put[i] = samples[i] * (scale);\
+	}\
+	break
+
+#define	WRITEREAL(bits)	\
+	{\
+		real ## bits	*put = (real ## bits *) data + offset;\
+		for(i = 0; i < count; i++)\
+			put[i] = samples[i];\
+	}\
+	break
+
+static void block_write(VNABlockType type, void *data, unsigned int offset, const real64 *samples, unsigned int count)
+{
+	unsigned int	i;
+
+	switch(type)
+	{
+	case VN_A_BLOCK_INT8:
+		WRITEINT(8, 128.0);
+	case VN_A_BLOCK_INT16:
+		WRITEINT(16, 32768.0);
+	case VN_A_BLOCK_INT24:
+		printf("Can't write back 24-bit integer samples, code missing\n");	/* FIXME. */
+		break;
+	case VN_A_BLOCK_INT32:
+		WRITEINT(32, 2147483648.0);
+	case VN_A_BLOCK_REAL32:
+		WRITEREAL(32);
+	case VN_A_BLOCK_REAL64:
+		WRITEREAL(64);
+	default:	/* FIXME: Code missing here. */
+		LOG_ERR(("Unhandled buffer type %d in write_samples()", type));
+	}
+}
+
+/* Read samples, a block at a time. Blocks are found in constant time, and whole ones converted in one go. */
 unsigned int nodedb_a_buffer_read_samples(const NdbABuffer *buffer, unsigned int start, real64 *samples, unsigned int length)
 {
-	unsigned int	index, pos, offset, bl, i, chunk, to_go = length, max;
+	unsigned int	pos, offset, bl, i, chunk, to_go = length;
+	size_t		index, end;
 	const NdbABlk	*blk;
 
-	if(buffer == NULL || buffer == NULL || length == 0)
+	if(buffer == NULL || length == 0)
 		return 0;
-	bl = block_len(buffer->type);
+	bl  = block_len(buffer->type);
+	end = pagearr_end(buffer->blocks);
 
-	max = (unsigned long) bintree_key_maximum(buffer->blocks);
+/*	printf("Reading out %u samples from position %u (end=%u)\n", length, start, end);*/
 
-/*	printf("Reading out %u samples from position %u (max=%u)\n", length, start, max);*/
-
-	for(pos = start; pos < start + length; pos += chunk, to_go -= chunk)
+	for(pos = start; pos < start + length; pos += chunk, to_go -= chunk, samples += chunk)
 	{
 		index  = pos / bl;
 		offset = pos % bl;
@@ -281,76 +382,38 @@ unsigned int nodedb_a_buffer_read_samples(const NdbABuffer *buffer, unsigned int
 			chunk = to_go;
 
 /*		printf("Getting audio data from position %u -> block %u, offset %u, chunk %u\n", pos, index, offset, chunk);*/
-		if(index > max)
+		if(index >= end)
 		{
 /*			printf(" Block index too large, there is no more data. Aborting\n");*/
 			return pos - start;
 		}
-		if((blk = bintree_lookup(buffer->blocks, (void *) index)) != NULL)
-		{
-			switch(buffer->type)
-			{
-			case VN_A_BLOCK_INT8:
-				READINT(8);
-			case VN_A_BLOCK_INT16:
-				READINT(16);
-			case VN_A_BLOCK_INT24:
-				{
-					uint32	*get = blk->data;
-					for(i = 0, get += offset; i < chunk; i++)
-						*samples++ = (*get++ >> 8) * (((real64) (1 << 24)) / 4294967296.0);
-				}
-				break;
-			case VN_A_BLOCK_INT32:
-				READINT(32);
-			case VN_A_BLOCK_REAL32:
-				READREAL(32);
-			case VN_A_BLOCK_REAL64:
-				READREAL(64);
-			}
-		}
+		if((blk = pagearr_get(buffer->blocks, index)) != NULL)
+			block_read(buffer->type, blk->data, offset, samples, chunk);
 		else
 		{
-			printf(" Block is clear, setting %u zeroes\n", chunk);
+/*			printf(" Block is clear, setting %u zeroes\n", chunk);*/
 			for(i = 0; i < chunk; i++)
-				*samples++ = 0.0;
+				samples[i] = 0.0;
 		}
 	}
 	return pos - start;
 }
 
-/* Handy dandy macros for writing data back into blocks, and make my life a bit easier. */
-#define	WRITEINT(bits)	\
-	{\
-		int ## bits	*put = blk->data;\
-		for(i = 0, put += offset; i < chunk; i++)\
-			*put++ = *samples++ * (real64) (1 << (bits - 1));\
-	}\
-	break
-
-#define	WRITEREAL(bits)	\
-	{\
-		real ## bits	*put = blk->data;\
-		for(i = 0, put += offset; i < chunk; i++)\
-			*put++ = *samples++;\
-	}\
-	break
-
-
 void nodedb_a_buffer_write_samples(NdbABuffer *buffer, unsigned int start, const real64 *samples, unsigned int length)
 {
-	unsigned int	index, pos, offset, bl, i, chunk, to_go = length;
+	unsigned int	pos, offset, bl, chunk, to_go = length;
+	size_t		index;
 	NdbABlk		*blk;
 
-	if(buffer == NULL || buffer == NULL || length == 0)
+	if(buffer == NULL || length == 0)
 		return;
 	bl = block_len(buffer->type);
 
-	if(buffer->blocks == NULL)
-		buffer->blocks = bintree_new(block_compare);
+	if(buffer->blocks == NULL && (buffer->blocks = pagearr_new()) == NULL)
+		return;
 
 /*	printf("Writing back %u samples from position %u\n", length, start);*/
-	for(pos = start, to_go = length; pos < start + length; pos += chunk, to_go -= chunk)
+	for(pos = start, to_go = length; pos < start + length; pos += chunk, to_go -= chunk, samples += chunk)
 	{
 		index  = pos / bl;
 		offset = pos % bl;
@@ -359,29 +422,19 @@ void nodedb_a_buffer_write_samples(NdbABuffer *buffer, unsigned int start, const
 			chunk = to_go;
 		
 /*		printf("Setting audio data from position %u -> block %u, offset %u, chunk %u\n", pos, index, offset, chunk);*/
-		if((blk = bintree_lookup(buffer->blocks, (void *) index)) == NULL)
-		{
-			blk = block_new(buffer);
-			bintree_insert(buffer->blocks, (void *) index, blk);
-		}
-		switch(buffer->type)
+		if((blk = pagearr_get(buffer->blocks, index)) == NULL)
 		{
-		case VN_A_BLOCK_INT8:
-			WRITEINT(8);
-		case VN_A_BLOCK_INT16:
-			WRITEINT(16);
-		case VN_A_BLOCK_INT24:
-			printf("Can't write back 24-bit integer samples, code missing\n");	/* FIXME. */
-			break;
-		case VN_A_BLOCK_INT32:
-			WRITEINT(32);
-		case VN_A_BLOCK_REAL32:
-			WRITEREAL(32);
-		case VN_A_BLOCK_REAL64:
-			WRITEREAL(64);
-		default:	/* FIXME: Code missing here. */
-			LOG_ERR(("Unhandled buffer type %d in write_samples()", buffer->type));
+			if((blk = block_new(buffer)) == NULL)
+				return;
+			memset(blk->data, 0, block_size(buffer->type));	/* Only part of it might be written. */
+			if(!pagearr_set(buffer->blocks, index, blk))
+			{
+				block_destroy(blk);
+				return;
+			}
 		}
+		dirty_mark(&buffer->dirty, index, 1);
+		block_write(buffer->type, blk->data, offset, samples, chunk);
 	}
 }
 
@@ -421,6 +474,7 @@ static void cb_a_buffer_destroy(UNUSED(void *user), VNodeID node_id, VBufferID b
 		if((al = dynarr_index(n->buffers, buffer_id)) != NULL)
 		{
 			al->name[0] = '\0';
+			dirty_free(&al->dirty);
 			printf("Missing code to destroy audio buffer\n");	/* FIXME: Write more. */
 			NOTIFY(n, STRUCTURE);
 		}
@@ -440,11 +494,11 @@ static void cb_a_block_set(UNUSED(void *user), VNodeID node_id, VBufferID buffer
 		{
 			NdbABlk	*blk;
 
-			if(al->blocks == NULL)
-				al->blocks = bintree_new(block_compare);
+			if(al->blocks == NULL && (al->blocks = pagearr_new()) == NULL)
+				return;
 
 			/* Is there an existing block? */
-			if((blk = bintree_lookup(al->blocks, (void *) block_index)) != NULL)
+			if((blk = pagearr_get(al->blocks, block_index)) != NULL)
 			{
 				if(blk->type != type)
 				{
@@ -454,11 +508,17 @@ static void cb_a_block_set(UNUSED(void *user), VNodeID node_id, VBufferID buffer
 			}
 			else	/* Allocate and insert a new block. */
 			{
-				blk = block_new(al);
-				bintree_insert(al->blocks, (void *) block_index, blk);
+				if((blk = block_new(al)) == NULL)
+					return;
+				if(!pagearr_set(al->blocks, block_index, blk))
+				{
+					block_destroy(blk);
+					return;
+				}
 			}
 			/* Copy the data into the block, either replacing old or setting new. */
 			memcpy(blk->data, data, block_size(type));
+			dirty_mark(&al->dirty, block_index, 1);
 			NOTIFY(n, DATA);
 		}
 	}
@@ -477,10 +537,11 @@ static void cb_a_block_clear(UNUSED(void *user), VNodeID node_id, VBufferID buff
 			NdbABlk	*blk;
 
 			printf("Clearing audio block %u.%u.%u\n", node_id, buffer_id, block_index);
-			if((blk = bintree_lookup(al->blocks, (void *) block_index)) != NULL)
+			if((blk = pagearr_get(al->blocks, block_index)) != NULL)
 			{
-				bintree_remove(al->blocks, (void *) block_index);
-				mem_free(blk);
+				pagearr_set(al->blocks, block_index, NULL);
+				block_destroy(blk);
+				dirty_mark(&al->dirty, block_index, 1);
 				NOTIFY(n, DATA);
 			}
 			else
@@ -6,9 +6,9 @@
  * Audio node databasing module.
 */
 
-#include "bintree.h"
+#include "pagearr.h"
 
-/* Held in binary tree, indexed by block index which is not stored here but in tree. */
+/* Held in paged array, indexed by block index which is not stored here but in array. */
 typedef struct
 {
 	VNABlockType	type;
@@ -21,7 +21,8 @@ typedef struct
 	char		name[16];
 	VNABlockType	type;
 	real64		frequency;
-	BinTree		*blocks;
+	PageArr		*blocks;
+	Dirty		dirty;		/* Blocks that may differ from the synchronized version. */
 } NdbABuffer;
 
 typedef struct
@@ -3,19 +3,38 @@
  * 
  * Copyright (C) 2004 PDC, KTH. See COPYING for license details.
  * 
- * Bitmap node databasing. Bitmaps are stored by allocating separate contigious blocks of memory
- * for each required layer, nothing very fancy at all. One-bit-per-pixel layers are stored using
- * 8-bit bytes as the smallest unit of allocation, and never using any single byte for pixels
- * from two different rows, so a 10x10 layer requires 20 bytes.
+ * Bitmap node databasing. Layers are stored as Verse tiles, i.e. blocks of VN_B_TILE_SIZE by
+ * VN_B_TILE_SIZE pixels, laid out exactly like a VNBTile. That way, tiles can be compared, sent
+ * and received as they are, without gathering their rows from a larger framebuffer. Tiles are
+ * numbered in the order they're sent, i.e. row by row, and sheet by sheet, see tile_index().
  * 
- * Layers are stored with space for only the required number of pixels, which means that for
- * many widths, the final tile will be truncated.
+ * Tiles along the right and bottom edges are stored in full, but only hold the pixels that are
+ * inside the bitmap. The rest are kept clear, so whole tiles can be compared and hashed. Tiles of
+ * one-bit-per-pixel layers are eight bytes, with the leftmost pixel in the most significant bit.
+ * 
+ * After the tiles, each layer's store holds a hash per tile, computed when the node is hashed on
+ * the main thread, and forgotten when the tile is written. Tiles with different hashes can't be
+ * equal, which saves actually comparing most of the ones that aren't.
+ * 
+ * Stores are reference counted, so that a copy of a node can share them with the original.
+ * A shared store is copied before it is written to, see layer_write(). Copies can be used by
+ * plug-ins running on different worker threads, so counts are only changed under a lock.
+ * 
+ * Plug-ins that want to access a whole layer get a linear framebuffer, with rows of pixels
+ * following each other. It is made when access begins, and copied back into the tiles when it
+ * ends. Only tiles whose pixels actually changed are written then, see linear_scatter().
+ * 
+ * Each layer tracks which of its tiles have been written, for the synchronizer.
 */
 
 #include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
 
+#if !defined _WIN32
+#include <pthread.h>
+#endif
+
 #include "verse.h"
 #include "purple.h"
 
@@ -37,7 +56,9 @@
 
 #define	MIN(a,b)	(((a) < (b)) ? (a) : (b))	/* Handy in tile width computations. */
 
-static real64	layer_get_pixel(const NodeBitmap *node, const NdbBLayer *layer, const unsigned char *framebuffer, int x, int y, int z);
+static real64	layer_get_pixel(const NodeBitmap *node, const NdbBLayer *layer, int x, int y, int z);
+
+static const VNBTile	tile_clear;			/* All pixels zero. What a layer without a store holds. */
 
 /* ----------------------------------------------------------------------------------------- */
 
@@ -55,23 +76,37 @@ static size_t pixel_size(VNBLayerType type)
 	return 0;
 }
 
-static size_t tile_modulo(UNUSED(const NodeBitmap *node), const NdbBLayer *layer)
+/* Size of a row of pixels in a tile, in bytes. */
+static size_t tile_modulo(const NdbBLayer *layer)
 {
 	static const size_t	mod[] = { 1, VN_B_TILE_SIZE, 2 * VN_B_TILE_SIZE, 4 * VN_B_TILE_SIZE, 8 * VN_B_TILE_SIZE };
 
 	return mod[layer->type];
 }
 
-/* Compute width of tile in *bytes*, for copying. */
+/* Size of a whole tile, in bytes. Always a multiple of eight, so tiles stay aligned. */
+static size_t tile_size(const NdbBLayer *layer)
+{
+	return tile_modulo(layer) * VN_B_TILE_SIZE;
+}
+
+/* Compute width of the part of a tile that is inside the bitmap, in *bytes*, for copying. */
 static size_t tile_width(const NodeBitmap *node, const NdbBLayer *layer, uint16 tile_x)
 {
 	size_t	tw = MIN(VN_B_TILE_SIZE, node->width - tile_x * VN_B_TILE_SIZE);
 
-	tw *= pixel_size(layer->type);
-	tw /= 8;
-	return tw > 0 ? tw : 1;
+	if(layer->type == VN_B_LAYER_UINT1)
+		return (tw + 7) / 8;
+	return tw * pixel_size(layer->type) / 8;
+}
+
+/* Compute height of the part of a tile that is inside the bitmap, in pixels. */
+static size_t tile_height(const NodeBitmap *node, uint16 tile_y)
+{
+	return MIN(VN_B_TILE_SIZE, node->height - tile_y * VN_B_TILE_SIZE);
 }
 
+/* Size of a row of pixels in a linear framebuffer, in bytes. */
 static size_t layer_modulo(const NodeBitmap *node, const NdbBLayer *layer)
 {
 	static const size_t	bpp[] = { 0, 1, 2, 4, 8 };
@@ -81,6 +116,269 @@ static size_t layer_modulo(const NodeBitmap *node, const NdbBLayer *layer)
 	return node->width * bpp[layer->type];
 }
 
+/* Number the tile at (tile_x,tile_y,tile_z) in a bitmap of the given width and height. */
+static size_t tile_index_dim(uint16 width, uint16 height, uint16 tile_x, uint16 tile_y, uint16 tile_z)
+{
+	size_t	wit = (width  + VN_B_TILE_SIZE - 1) / VN_B_TILE_SIZE,
+		hit = (height + VN_B_TILE_SIZE - 1) / VN_B_TILE_SIZE;
+
+	return ((size_t) tile_z * hit + tile_y) * wit + tile_x;
+}
+
+static size_t tile_index(const NodeBitmap *node, uint16 tile_x, uint16 tile_y, uint16 tile_z)
+{
+	return tile_index_dim(node->width, node->height, tile_x, tile_y, tile_z);
+}
+
+/* Number of tiles in each layer of a bitmap with the given dimensions. */
+static size_t tile_count_dim(uint16 width, uint16 height, uint16 depth)
+{
+	return tile_index_dim(width, height, 0, 0, depth);
+}
+
+static size_t tile_count(const NodeBitmap *node)
+{
+	return tile_count_dim(node->width, node->height, node->depth);
+}
+
+/* Clear the pixels of a tile that are outside the bitmap, after copying in a whole one. */
+static void tile_crop(const NodeBitmap *node, const NdbBLayer *layer, uint16 tile_x, uint16 tile_y, uint8 *tile)
+{
+	size_t	mod = tile_modulo(layer), tw = tile_width(node, layer, tile_x), th = tile_height(node, tile_y), cw, y;
+
+	cw = MIN(VN_B_TILE_SIZE, node->width - tile_x * VN_B_TILE_SIZE);
+	for(y = 0; y < VN_B_TILE_SIZE; y++, tile += mod)
+	{
+		if(y >= th)
+			memset(tile, 0, mod);
+		else if(layer->type == VN_B_LAYER_UINT1)
+			*tile &= 0xff << (VN_B_TILE_SIZE - cw);
+		else
+			memset(tile + tw, 0, mod - tw);
+	}
+}
+
+/* ----------------------------------------------------------------------------------------- */
+
+/* Header placed before each tile store, holding its reference count. Keeps pixels aligned. */
+typedef union
+{
+	unsigned int	refs;
+	real64		align;
+} StoreHeader;
+
+#define	STORE_HEADER(s)	((StoreHeader *) (s) - 1)
+
+/* Protects the reference counts of all stores. Only held while a count is read or changed, which
+ * happens about once per layer copied or written, so it's simply always used.
+*/
+#if !defined _WIN32
+static pthread_mutex_t	store_lock = PTHREAD_MUTEX_INITIALIZER;
+
+#define	STORE_LOCK()	pthread_mutex_lock(&store_lock)
+#define	STORE_UNLOCK()	pthread_mutex_unlock(&store_lock)
+#else
+#define	STORE_LOCK()
+#define	STORE_UNLOCK()
+#endif
+
+/* Allocate a store for <count> tiles of <size> bytes, plus their hashes. All are cleared. */
+static void * store_alloc(size_t count, size_t size)
+{
+	StoreHeader	*h;
+
+	if((h = mem_alloc(sizeof *h + count * (size + sizeof (NdbHash)))) == NULL)
+		return NULL;
+	h->refs = 1;
+	memset(h + 1, 0, count * (size + sizeof (NdbHash)));
+	return h + 1;
+}
+
+static void * store_ref(void *store)
+{
+	if(store != NULL)
+	{
+		STORE_LOCK();
+		STORE_HEADER(store)->refs++;
+		STORE_UNLOCK();
+	}
+	return store;
+}
+
+static void store_unref(void *store)
+{
+	unsigned int	refs;
+
+	if(store == NULL)
+		return;
+	STORE_LOCK();
+	refs = --STORE_HEADER(store)->refs;
+	STORE_UNLOCK();
+	if(refs == 0)
+		mem_free(STORE_HEADER(store));
+}
+
+/* Check if <store> has more than one owner. Once this returns 0, it stays so for the caller. */
+static int store_shared(const void *store)
+{
+	int	shared;
+
+	STORE_LOCK();
+	shared = STORE_HEADER(store)->refs > 1;
+	STORE_UNLOCK();
+	return shared;
+}
+
+/* Return the tile numbered <index> in <layer>. Tiles of layers without a store read as clear. */
+static const uint8 * tile_get(const NdbBLayer *layer, size_t index)
+{
+	if(layer->tiles == NULL)
+		return (const uint8 *) &tile_clear;
+	return (const uint8 *) layer->tiles + index * tile_size(layer);
+}
+
+/* Return the hashes of <layer>'s tiles, which follow the tiles themselves. Zero means unknown. */
+static NdbHash * tile_hashes(const NodeBitmap *node, const NdbBLayer *layer)
+{
+	return (NdbHash *) ((uint8 *) layer->tiles + tile_count(node) * tile_size(layer));
+}
+
+/* Return the hash of a tile, computing it if needed. Hashes only depend on the pixels, so it's
+ * fine to remember them in a store that is shared between copies, or in a const layer. But
+ * remembering one is a write, and copies sharing a store can be read by several worker threads
+ * at once (plug-ins, and the synchronizer's diff stage). So this is only called on the main
+ * thread, while no workers run; code that can run on a worker uses known hashes only.
+*/
+static NdbHash tile_hash(const NodeBitmap *node, const NdbBLayer *layer, size_t index)
+{
+	NdbHash	*hash = tile_hashes(node, layer);
+
+	if(hash[index] == 0)
+	{
+		hash[index] = nodedb_internal_hash(NDB_HASH_INIT, tile_get(layer, index), tile_size(layer));
+		if(hash[index] == 0)
+			hash[index] = 1;
+	}
+	return hash[index];
+}
+
+/* Check if tile <index> holds the same pixels in two layers of the same type and dimensions. This
+ * runs on worker threads, so it doesn't compute hashes, see tile_hash(). If both are known and
+ * differ, the tiles do too; otherwise the pixels are compared, which costs about as much as
+ * hashing them would have.
+*/
+static int tile_equal(const NodeBitmap *node, const NdbBLayer *layer, const NodeBitmap *other, const NdbBLayer *olayer, size_t index)
+{
+	NdbHash	h, oh;
+
+	if(layer->tiles == olayer->tiles)
+		return 1;
+	if(layer->tiles != NULL && olayer->tiles != NULL)
+	{
+		h  = tile_hashes(node, layer)[index];
+		oh = tile_hashes(other, olayer)[index];
+		if(h != 0 && oh != 0 && h != oh)
+			return 0;
+	}
+	return memcmp(tile_get(layer, index), tile_get(olayer, index), tile_size(layer)) == 0;
+}
+
+/* Get <layer>'s store ready to be written, allocating a cleared one if there is none. If the
+ * current store is shared with a copy of the node, this gives the layer its own copy. Other
+ * owners don't write a shared store, so it can be copied without holding the lock, and if they
+ * all drop it meanwhile, store_unref() frees it.
+*/
+static void * layer_write(const NodeBitmap *node, NdbBLayer *layer)
+{
+	size_t	count = tile_count(node);
+	void	*store;
+
+	if(layer->tiles != NULL && !store_shared(layer->tiles))
+		return layer->tiles;
+	if((store = store_alloc(count, tile_size(layer))) == NULL)
+		return NULL;
+	if(layer->tiles != NULL)
+		memcpy(store, layer->tiles, count * (tile_size(layer) + sizeof (NdbHash)));
+	store_unref(layer->tiles);
+	return layer->tiles = store;
+}
+
+/* Get tile <index> of <layer> ready to be written, and mark it as such. Returns NULL if out of memory. */
+static uint8 * tile_write(const NodeBitmap *node, NdbBLayer *layer, size_t index)
+{
+	if(layer_write(node, layer) == NULL)
+		return NULL;
+	tile_hashes(node, layer)[index] = 0;
+	dirty_mark(&layer->dirty, index, 1);
+	return (uint8 *) layer->tiles + index * tile_size(layer);
+}
+
+/* ----------------------------------------------------------------------------------------- */
+
+/* Copy <layer>'s pixels into a linear framebuffer. */
+static void linear_gather(const NodeBitmap *node, const NdbBLayer *layer, uint8 *linear)
+{
+	size_t		mod = layer_modulo(node, layer), tmod = tile_modulo(layer), tw, th, y;
+	uint16		tx, ty, tz;
+	const uint8	*tile;
+	uint8		*put;
+
+	for(tz = 0; tz < node->depth; tz++)
+	{
+		for(ty = 0; ty * VN_B_TILE_SIZE < node->height; ty++)
+		{
+			th = tile_height(node, ty);
+			for(tx = 0; tx * VN_B_TILE_SIZE < node->width; tx++)
+			{
+				tile = tile_get(layer, tile_index(node, tx, ty, tz));
+				tw = tile_width(node, layer, tx);
+				put = linear + (tz * node->height + ty * VN_B_TILE_SIZE) * mod + tx * tmod;
+				for(y = 0; y < th; y++, tile += tmod, put += mod)
+					memcpy(put, tile, tw);
+			}
+		}
+	}
+}
+
+/* Copy pixels from a linear framebuffer back into <layer>. Tiles whose pixels didn't change are
+ * left alone, so a layer whose store is shared with a copy keeps sharing it if nothing changed.
+*/
+static void linear_scatter(const NodeBitmap *node, NdbBLayer *layer, const uint8 *linear)
+{
+	size_t		mod = layer_modulo(node, layer), tmod = tile_modulo(layer), tw, th, y, index;
+	uint16		tx, ty, tz;
+	const uint8	*tile, *get;
+	uint8		*put;
+
+	for(tz = 0; tz < node->depth; tz++)
+	{
+		for(ty = 0; ty * VN_B_TILE_SIZE < node->height; ty++)
+		{
+			th = tile_height(node, ty);
+			for(tx = 0; tx * VN_B_TILE_SIZE < node->width; tx++)
+			{
+				index = tile_index(node, tx, ty, tz);
+				tile  = tile_get(layer, index);
+				tw    = tile_width(node, layer, tx);
+				get   = linear + (tz * node->height + ty * VN_B_TILE_SIZE) * mod + tx * tmod;
+				for(y = 0; y < th; y++)
+				{
+					if(memcmp(tile + y * tmod, get + y * mod, tw) != 0)
+						break;
+				}
+				if(y == th)
+					continue;
+				if((put = tile_write(node, layer, index)) == NULL)
+					return;
+				for(y = 0; y < th; y++, put += tmod, get += mod)
+					memcpy(put, get, tw);
+				if(layer->type == VN_B_LAYER_UINT1)	/* Don't keep bits past the right edge. */
+					tile_crop(node, layer, tx, ty, put - th * tmod);
+			}
+		}
+	}
+}
+
 /* ----------------------------------------------------------------------------------------- */
 
 void nodedb_b_construct(NodeBitmap *n)
@@ -93,16 +391,14 @@ static void cb_copy_layer(void *d, const void *s, void *user)
 {
 	const NdbBLayer	*src = s;
 	NdbBLayer	*dst = d;
-	const NodeBitmap*node = user;
-	size_t		ps = pixel_size(src->type), layer_size;
 
 	dst->id = src->id;
 	strcpy(dst->name, src->name);
 	dst->type = src->type;
-
-	layer_size = ((node->width * ps + 7) / 8) * node->height * node->depth;
-	if((dst->framebuffer = mem_alloc(layer_size)) != NULL)
-		memcpy(dst->framebuffer, src->framebuffer, layer_size);
+	dst->tiles = store_ref(src->tiles);
+	dst->linear = NULL;
+	dst->linear_refs = 0;
+	dirty_init(&dst->dirty, 0);	/* Nothing is known about what a new copy is in sync with. */
 }
 
 void nodedb_b_copy(NodeBitmap *n, const NodeBitmap *src)
@@ -112,40 +408,187 @@ void nodedb_b_copy(NodeBitmap *n, const NodeBitmap *src)
 	n->depth  = src->depth;
 
 	if(src->layers != NULL)
-		n->layers = dynarr_new_copy(src->layers, cb_copy_layer, n);
+		n->layers = dynarr_new_copy(src->layers, cb_copy_layer, NULL);
+}
+
+static NdbBLayer * layers_find(const DynArr *layers, const char *name)
+{
+	size_t		i;
+	NdbBLayer	*layer;
+
+	for(i = 0; (layer = dynarr_index(layers, i)) != NULL; i++)
+	{
+		if(layer->name[0] == '\0')
+			continue;
+		if(strcmp(layer->name, name) == 0)
+			return layer;
+	}
+	return NULL;
+}
+
+/* Forget a layer's pixels, including any linear framebuffer still being accessed. */
+static void layer_clear(NdbBLayer *layer)
+{
+	store_unref(layer->tiles);
+	layer->tiles = NULL;
+	mem_free(layer->linear);
+	layer->linear = NULL;
+	layer->linear_refs = 0;
+}
+
+static void layers_destroy(DynArr *layers)
+{
+	unsigned int	i;
+	NdbBLayer	*layer;
+
+	for(i = 0; i < dynarr_size(layers); i++)
+	{
+		if((layer = dynarr_index(layers, i)) == NULL)
+			continue;
+		dirty_free(&layer->dirty);
+		if(layer->name[0] == '\0')
+			continue;
+		layer_clear(layer);
+	}
+	dynarr_destroy(layers);
 }
 
+/* Mark the tiles of <layer> whose pixels differ from <old>, which is what it held before. */
+static void layer_dirty_diff(const NodeBitmap *node, NdbBLayer *layer, const NdbBLayer *old)
+{
+	size_t	i, count = tile_count(node);
+
+	for(i = 0; i < count; i++)
+	{
+		if(!tile_equal(node, layer, node, old, i))
+			dirty_mark(&layer->dirty, i, 1);
+	}
+}
+
+/* Set <n> to equal <src>. If the dimensions didn't change, layers that were in <n> before keep
+ * their dirty state, plus whatever tiles the new pixels differ in. Module outputs are set over
+ * and over like this, and would otherwise need to be compared in full by the synchronizer.
+*/
 void nodedb_b_set(NodeBitmap *n, const NodeBitmap *src)
 {
-	nodedb_b_destruct(n);
+	DynArr		*old = n->layers;
+	int		same = n->width == src->width && n->height == src->height && n->depth == src->depth;
+	unsigned int	i;
+	NdbBLayer	*layer, *ol;
+
+	n->layers = NULL;
 	nodedb_b_copy(n, src);
+	for(i = 0; same && (layer = dynarr_index(n->layers, i)) != NULL; i++)
+	{
+		if(layer->name[0] == '\0' || (ol = layers_find(old, layer->name)) == NULL || ol->type != layer->type)
+			continue;
+		dirty_clear(&layer->dirty);
+		dirty_merge(&layer->dirty, &ol->dirty);
+		layer_dirty_diff(n, layer, ol);
+	}
+	if(old != NULL)
+		layers_destroy(old);
 }
-			   
+
 void nodedb_b_destruct(NodeBitmap *n)
 {
 	if(n->layers != NULL)
 	{
-		unsigned int	i;
-		NdbBLayer	*layer;
+		layers_destroy(n->layers);
+		n->layers = NULL;
+	}
+}
+
+/* Number of bytes held by layer tile stores. */
+size_t nodedb_b_size(const NodeBitmap *n)
+{
+	unsigned int	i;
+	const NdbBLayer	*layer;
+	size_t		size = 0;
+
+	for(i = 0; i < dynarr_size(n->layers); i++)
+	{
+		if((layer = dynarr_index(n->layers, i)) == NULL || layer->name[0] == '\0' || layer->tiles == NULL)
+			continue;
+		size += tile_count(n) * (tile_size(layer) + sizeof (NdbHash));
+	}
+	return size;
+}
 
-		for(i = 0; i < dynarr_size(n->layers); i++)
+/* Hash a node's pixels through the hashes of its tiles, most of which are usually known already.
+ * Remembers the ones that aren't, so this must be called on the main thread, see tile_hash().
+*/
+NdbHash nodedb_b_hash(const NodeBitmap *n, NdbHash h)
+{
+	unsigned int	i;
+	size_t		j, count = tile_count(n);
+	const NdbBLayer	*layer;
+	NdbHash		th;
+
+	h = NODEDB_HASH(h, n->width);
+	h = NODEDB_HASH(h, n->height);
+	h = NODEDB_HASH(h, n->depth);
+	for(i = 0; i < dynarr_size(n->layers); i++)
+	{
+		if((layer = dynarr_index(n->layers, i)) == NULL || layer->name[0] == '\0')
+			continue;
+		h = nodedb_internal_hash(h, layer->name, strlen(layer->name));
+		h = NODEDB_HASH(h, layer->type);
+		if(layer->tiles == NULL)
+			continue;
+		for(j = 0; j < count; j++)
 		{
-			if((layer = dynarr_index(n->layers, i)) == NULL || layer->name[0] == '\0')
-				continue;
-			mem_free(layer->framebuffer);
+			th = tile_hash(n, layer, j);
+			h = NODEDB_HASH(h, th);
 		}
-		dynarr_destroy(n->layers);
-		n->layers = NULL;
 	}
+	return h;
 }
 
 /* ----------------------------------------------------------------------------------------- */
 
+/* Copy the pixels that fit from <layer>'s store, for a bitmap of <node>'s dimensions, into a
+ * new store for one of the given dimensions. Tiles stay put, since the origin doesn't move.
+*/
+static void * store_resize(const NodeBitmap *node, const NdbBLayer *layer, uint16 width, uint16 height, uint16 depth)
+{
+	size_t		ts = tile_size(layer), tmod = tile_modulo(layer), cw, ch, tw, th, y;
+	uint16		tx, ty, tz;
+	const uint8	*get;
+	uint8		*store, *put;
+
+	if((store = store_alloc(tile_count_dim(width, height, depth), ts)) == NULL)
+		return NULL;
+	cw = MIN(node->width, width);
+	ch = MIN(node->height, height);
+	for(tz = 0; tz < MIN(node->depth, depth); tz++)
+	{
+		for(ty = 0; ty * VN_B_TILE_SIZE < ch; ty++)
+		{
+			th = MIN(VN_B_TILE_SIZE, ch - ty * VN_B_TILE_SIZE);
+			for(tx = 0; tx * VN_B_TILE_SIZE < cw; tx++)
+			{
+				tw = MIN(VN_B_TILE_SIZE, cw - tx * VN_B_TILE_SIZE);
+				get = tile_get(layer, tile_index(node, tx, ty, tz));
+				put = store + tile_index_dim(width, height, tx, ty, tz) * ts;
+				for(y = 0; y < th; y++, get += tmod, put += tmod)
+				{
+					if(layer->type == VN_B_LAYER_UINT1)
+						*put = *get & (0xff << (VN_B_TILE_SIZE - tw));
+					else
+						memcpy(put, get, tw * pixel_size(layer->type) / 8);
+				}
+			}
+		}
+	}
+	return store;
+}
+
 int nodedb_b_set_dimensions(NodeBitmap *node, uint16 width, uint16 height, uint16 depth)
 {
 	NdbBLayer	*layer;
-	size_t		i, y, z, ps, layer_size, dss, sss, cw, ch;
-	unsigned char	*fb;
+	size_t		i;
+	void		*store;
 
 	if(width == node->width && height == node->height && depth == node->depth)
 		return 0;
@@ -154,43 +597,21 @@ int nodedb_b_set_dimensions(NodeBitmap *node, uint16 width, uint16 height, uint1
 	{
 		if((layer = dynarr_index(node->layers, i)) == NULL || layer->name[0] == '\0')
 			continue;
-		if(layer->framebuffer == NULL)				/* Don't copy what's not there. */
+		if(layer->tiles == NULL)				/* Don't copy what's not there. */
 			continue;
-		ps = pixel_size(layer->type);
-		layer_size = ((width * ps + 7) / 8) * height * depth;	/* Convert to whole bytes, for uint1. */
-		fb = mem_alloc(layer_size);
-		memset(fb, 0, layer_size);
-		if(fb == NULL)
+		if((store = store_resize(node, layer, width, height, depth)) == NULL)
 		{
-			LOG_WARN(("Couldn't allocate new framebuffer for layer %u.%u (%s)--out of memory",
+			LOG_WARN(("Couldn't allocate new tiles for layer %u.%u (%s)--out of memory",
 				  node->node.id, layer->id, layer->name));
 			continue;
 		}
-		/* Copy scanlines from old buffer into new. */
-		cw = MIN(node->width, width);
-		ch = MIN(node->height, height);
-		if(layer->type == VN_B_LAYER_UINT1)
-		{
-			sss = (node->width * ps + 7) / 8;	/* Round sizes up to whole bytes. */
-			dss = (cw * ps + 7) / 8;
-		}
-		else
-		{
-			sss = node->width * ps / 8;
-			dss = cw * ps / 8;
-		}
-/*		printf("node is resizing from %ux%ux%u to %ux%ux%u -- copying\n",
-		       node->width, node->height, node->depth,
-		       width, height, depth);
-		printf(" common width is %u, common height is %u, source scanline size=%u dest scanline size=%u\n", cw, ch, sss, dss);
-*/		for(z = 0; z < depth; z++)
-		{
-			for(y = 0; y < ch; y++)
-				memcpy(fb + z * (dss * height) + y * dss,
-				       (char *) layer->framebuffer + z * sss * height + y * sss, dss);
-		}
-		mem_free(layer->framebuffer);
-		layer->framebuffer = fb;
+		store_unref(layer->tiles);
+		layer->tiles = store;
+	}
+	for(i = 0; i < dynarr_size(node->layers); i++)	/* Tiles have all moved, or changed size. */
+	{
+		if((layer = dynarr_index(node->layers, i)) != NULL && layer->name[0] != '\0')
+			dirty_mark_all(&layer->dirty);
 	}
 	node->width  = width;
 	node->height = height;
@@ -248,19 +669,9 @@ NdbBLayer * nodedb_b_layer_nth(const NodeBitmap *node, unsigned int n)
 
 NdbBLayer * nodedb_b_layer_find(const NodeBitmap *node, const char *name)
 {
-	size_t		i;
-	NdbBLayer	*layer;
-
 	if(node == NULL || name == NULL || *name == '\0')
 		return NULL;
-	for(i = 0; (layer = dynarr_index(node->layers, i)) != NULL; i++)
-	{
-		if(layer->name[0] == '\0')
-			continue;
-		if(strcmp(layer->name, name) == 0)
-			return layer;
-	}
-	return NULL;
+	return layers_find(node->layers, name);
 }
 
 static void cb_def_layer(UNUSED(unsigned int index), void *element, UNUSED(void *user))
@@ -268,7 +679,10 @@ static void cb_def_layer(UNUSED(unsigned int index), void *element, UNUSED(void
 	NdbBLayer	*layer = element;
 
 	layer->name[0] = '\0';
-	layer->framebuffer = NULL;
+	layer->tiles = NULL;
+	layer->linear = NULL;
+	layer->linear_refs = 0;
+	dirty_init(&layer->dirty, 0);
 }
 
 NdbBLayer * nodedb_b_layer_create(NodeBitmap *node, VLayerID layer_id, const char *name, VNBLayerType type)
@@ -291,17 +705,49 @@ NdbBLayer * nodedb_b_layer_create(NodeBitmap *node, VLayerID layer_id, const cha
 		layer->id   = layer_id;
 		stu_strncpy(layer->name, sizeof layer->name, name);
 		layer->type = type;
-		layer->framebuffer = NULL;
+		layer->tiles = NULL;
+		layer->linear = NULL;
+		layer->linear_refs = 0;
+		dirty_free(&layer->dirty);
+		dirty_init(&layer->dirty, 0);
 	}
 	return layer;
 }
 
+/* Find the byte holding pixel (x,y) in <tile>, which is the tile it's in. */
+static const uint8 * tile_pixel(const NdbBLayer *layer, const uint8 *tile, int x, int y)
+{
+	x %= VN_B_TILE_SIZE;
+	y %= VN_B_TILE_SIZE;
+	return tile + y * tile_modulo(layer) + x * pixel_size(layer->type) / 8;
+}
+
+/* This slows things down, but hey. */
+static real64 layer_get_pixel(const NodeBitmap *node, const NdbBLayer *layer, int x, int y, int z)
+{
+	const uint8	*p;
+
+	p = tile_get(layer, tile_index(node, x / VN_B_TILE_SIZE, y / VN_B_TILE_SIZE, z));
+	p = tile_pixel(layer, p, x, y);
+	if(layer->type == VN_B_LAYER_UINT1)
+		return *p & (128 >> (x % 8)) ? 1.0 : 0.0;
+	else if(layer->type == VN_B_LAYER_UINT8)
+		return (real64) *p / 255.0;
+	else if(layer->type == VN_B_LAYER_UINT16)
+		return (real64) *(const uint16 *) p / 65535.0;
+	else if(layer->type == VN_B_LAYER_REAL32)
+		return *(const real32 *) p;
+	else if(layer->type == VN_B_LAYER_REAL64)
+		return *(const real64 *) p;
+	return 0.0;
+}
+
 real64 nodedb_b_layer_pixel_read(const NodeBitmap *node, const NdbBLayer *layer, real64 x, real64 y, real64 z)
 {
 	uint32	ix = x, iy = y, iz = z;
-	if(node == NULL || layer == NULL || layer->framebuffer == NULL || ix >= node->width || iy >= node->height || z >= node->depth)
+	if(node == NULL || layer == NULL || layer->tiles == NULL || ix >= node->width || iy >= node->height || z >= node->depth)
 		return 0.0;
-	return layer_get_pixel(node, layer, layer->framebuffer, ix, iy, iz);
+	return layer_get_pixel(node, layer, ix, iy, iz);
 }
 
 real64 nodedb_b_layer_pixel_read_filtered(const NodeBitmap *node, const NdbBLayer *layer, UNUSED(NdbBFilterMode mode), real64 x, real64 y, real64 z)
@@ -313,70 +759,76 @@ real64 nodedb_b_layer_pixel_read_filtered(const NodeBitmap *node, const NdbBLaye
 	z *= node->depth;
 	if(x < 0 || y < 0 || z < 0 || x >= node->width || y >= node->height || z >= node->depth)
 		return 0.0;
-	return layer_get_pixel(node, layer, layer->framebuffer, x, y, z);
+	return layer_get_pixel(node, layer, x, y, z);
 }
 
 void nodedb_b_layer_pixel_write(NodeBitmap *node, NdbBLayer *layer, uint16 x, uint16 y, uint16 z, real64 pixel)
 {
-	void	*fb;
-	uint32	rw;
+	uint8	*tile, *p;
 
 	if(node == NULL || layer == NULL || x >= node->width || y >= node->height || z >= node->depth)
 		return;
-	if((fb = nodedb_b_layer_access_begin(node, layer)) != NULL)
+	if((tile = tile_write(node, layer, tile_index(node, x / VN_B_TILE_SIZE, y / VN_B_TILE_SIZE, z))) != NULL)
 	{
+		p = (uint8 *) tile_pixel(layer, tile, x, y);
 		switch(layer->type)
 		{
 		case VN_B_LAYER_UINT1:
-			rw = ((node->width + 7) / 8);
 			if(pixel <= 0)
-				((uint8 *) fb)[z * rw * node->height + y * rw + x / 8] &= ~(1 << (7 - (x % 8)));
+				*p &= ~(1 << (7 - (x % 8)));
 			else
-				((uint8 *) fb)[z * rw * node->height + y * rw + x / 8] |= 1 << (7 - (x % 8));
+				*p |= 1 << (7 - (x % 8));
 			break;
 		case VN_B_LAYER_UINT8:
 			if(pixel < 0)		/* Clamp 8-bit pixels. */
 				pixel = 0.0;
 			else if(pixel > 1.0)
 				pixel = 1.0;
-			((uint8 *) fb)[z * node->width * node->height + y * node->width + x] = 255.0 * pixel;
+			*p = 255.0 * pixel;
 			break;
 		case VN_B_LAYER_UINT16:
 			if(pixel < 0)		/* Clamp 16-bit pixels. */
 				pixel = 0.0;
 			else if(pixel > 1.0)
 				pixel = 1.0;
-			((uint16 *) fb)[z * node->width * node->height + y * node->width + x] = 65535.0 * pixel;
+			*(uint16 *) p = 65535.0 * pixel;
 			break;
 		case VN_B_LAYER_REAL32:
-			((real32 *) fb)[z * node->width * node->height + y * node->width + x] = pixel;
+			*(real32 *) p = pixel;
 			break;
 		case VN_B_LAYER_REAL64:
-			((real64 *) fb)[z * node->width * node->height + y * node->width + x] = pixel;
+			*(real64 *) p = pixel;
 			break;
 		}
-		nodedb_b_layer_access_end(node, layer, fb);
 	}
 }
 
+/* Give access to a linear framebuffer holding <layer>'s pixels. It's made on the first call, and
+ * further calls return the same one, until access ends as many times as it began.
+*/
 void * nodedb_b_layer_access_begin(NodeBitmap *node, NdbBLayer *layer)
 {
 	if(node == NULL || layer == NULL)
 		return NULL;
-	if(layer->framebuffer == NULL)
+	if(layer->linear == NULL)
 	{
-		size_t	ps, layer_size;
-
-		ps = pixel_size(layer->type);
-		layer_size = ((node->width * ps + 7) / 8) * node->height * node->depth;
-		layer->framebuffer = mem_alloc(layer_size);
+		if((layer->linear = mem_alloc(layer_modulo(node, layer) * node->height * node->depth)) == NULL)
+			return NULL;
+		linear_gather(node, layer, layer->linear);
 	}
-	return layer->framebuffer;
+	layer->linear_refs++;
+	return layer->linear;
 }
 
-void nodedb_b_layer_access_end(UNUSED(NodeBitmap *node), UNUSED(NdbBLayer *layer), UNUSED(void *framebuffer))
+void nodedb_b_layer_access_end(NodeBitmap *node, NdbBLayer *layer, UNUSED(void *framebuffer))
 {
-	/* Nothing much to do, here. */
+	if(node == NULL || layer == NULL || layer->linear == NULL)
+		return;
+	if(--layer->linear_refs > 0)
+		return;
+	linear_scatter(node, layer, layer->linear);
+	mem_free(layer->linear);
+	layer->linear = NULL;
 }
 
 /* ----------------------------------------------------------------------------------------- */
@@ -391,7 +843,7 @@ struct multi_info
 	NodeBitmap	*node;			/* Source node for the layers. */
 	size_t		num;			/* Number of layers in buffer, at least 1. */
 	NdbBLayer	*layer[16];		/* Source layer pointers. */
-	void		*access[16];		/* Source layer framebuffer pointers. */
+	void		*access[16];		/* Source layer linear framebuffers, when writing. */
 	size_t		row_size, sheet_size;	/* Handy sizes. */
 	int		y, z;			/* Current scanline coordinates. */
 	/* Framebuffer for multi-layer interleaved image goes here. */
@@ -407,27 +859,6 @@ static void multi_scanline_init(struct multi_info *mi, int y, int z)
 	mi->z = z;
 }
 
-/* This slows things down, but hey. */
-static real64 layer_get_pixel(const NodeBitmap *node, const NdbBLayer *layer, const unsigned char *framebuffer, int x, int y, int z)
-{
-	if(layer->type == VN_B_LAYER_UINT1)
-	{
-		size_t	row = (node->width + 7) / 8, off;
-
-		off = z * row * node->height + y * row + x / 8;
-		return ((uint8 *) framebuffer)[off] & (128 >> (x % 8)) ? 1.0 : 0.0;
-	}
-	else if(layer->type == VN_B_LAYER_UINT8)
-		return (real64) ((uint8 *) framebuffer)[z * node->width * node->height + y * node->width + x] / 255.0;
-	else if(layer->type == VN_B_LAYER_UINT16)
-		return (real64) ((uint16 *) framebuffer)[z * node->width * node->height + y * node->width + x] / 65535.0;
-	else if(layer->type == VN_B_LAYER_REAL32)
-		return ((real32 *) framebuffer)[z * node->width * node->height + y * node->width + x];
-	else if(layer->type == VN_B_LAYER_REAL64)
-		return ((real64 *) framebuffer)[z * node->width * node->height + y * node->width + x];
-	return 0.0;
-}
-
 /* Write <pixel> to <layer>'s <framebuffer> at (x,y,z), converting it to the layer's type as needed. */
 static void layer_put_pixel(const NodeBitmap *node, NdbBLayer *layer, unsigned char *framebuffer,
 			    int x, int y, int z, real64 pixel)
@@ -469,7 +900,7 @@ static void multi_put_pixel(struct multi_info *mi, int x)
 				mi->put++;
 				mi->mask = 0x80;
 			}
-			pix = layer_get_pixel(mi->node, mi->layer[i], mi->access[i], x, mi->y, mi->z);
+			pix = layer_get_pixel(mi->node, mi->layer[i], x, mi->y, mi->z);
 			*mi->put &= ~mi->mask;
 			if(pix > 0.0)
 				*mi->put |= mi->mask;
@@ -480,7 +911,7 @@ static void multi_put_pixel(struct multi_info *mi, int x)
 	{
 		for(i = 0; i < mi->num; i++)
 		{
-			pix = layer_get_pixel(mi->node, mi->layer[i], mi->access[i], x, mi->y, mi->z);
+			pix = layer_get_pixel(mi->node, mi->layer[i], x, mi->y, mi->z);
 			switch(mi->format)
 			{
 			case VN_B_LAYER_UINT8:
@@ -513,7 +944,10 @@ static void multi_put_pixel(struct multi_info *mi, int x)
 	}
 }
 
-const void * nodedb_b_layer_read_multi_begin(NodeBitmap *node, VNBLayerType format, va_list layers)
+/* Set up a multi-layer framebuffer. Pixels are read straight from the layers' tiles. If it's going
+ * to be written back, the layers are also accessed linearly, to have somewhere to put the pixels.
+*/
+static struct multi_info * multi_begin(NodeBitmap *node, VNBLayerType format, va_list layers, boolean write)
 {
 	const size_t		mul[] = { 1,  1,  2,  4,  8 };
 	size_t			num = 0, x, y, z, row_size, sheet_size;
@@ -560,7 +994,7 @@ const void * nodedb_b_layer_read_multi_begin(NodeBitmap *node, VNBLayerType form
 	for(x = 0; x < num; x++)
 	{
 		mi->layer[x] = layer[x];
-		mi->access[x] = nodedb_b_layer_access_begin(node, mi->layer[x]);
+		mi->access[x] = write ? nodedb_b_layer_access_begin(node, mi->layer[x]) : NULL;
 	}
 	mi->row_size = row_size;
 	mi->sheet_size = sheet_size;
@@ -573,12 +1007,21 @@ const void * nodedb_b_layer_read_multi_begin(NodeBitmap *node, VNBLayerType form
 				multi_put_pixel(mi, x);
 		}
 	}
-	return mi->fb;
+	return mi;
+}
+
+const void * nodedb_b_layer_read_multi_begin(NodeBitmap *node, VNBLayerType format, va_list layers)
+{
+	struct multi_info	*mi = multi_begin(node, format, layers, FALSE);
+
+	return mi != NULL ? mi->fb : NULL;
 }
 
 void * nodedb_b_layer_write_multi_begin(NodeBitmap *node, VNBLayerType format, va_list layers)
 {
-	return (void *) nodedb_b_layer_read_multi_begin(node, format, layers);
+	struct multi_info	*mi = multi_begin(node, format, layers, TRUE);
+
+	return mi != NULL ? mi->fb : NULL;
 }
 
 void nodedb_b_layer_read_multi_end(NodeBitmap *node, const void *framebuffer)
@@ -588,7 +1031,10 @@ void nodedb_b_layer_read_multi_end(NodeBitmap *node, const void *framebuffer)
 
 	/* Stop accessing layers. */
 	for(i = 0; i < mi->num; i++)
-		nodedb_b_layer_access_end(node, mi->layer[i], mi->access[i]);
+	{
+		if(mi->access[i] != NULL)
+			nodedb_b_layer_access_end(node, mi->layer[i], mi->access[i]);
+	}
 	mem_free(mi);
 }
 
@@ -702,32 +1148,22 @@ void nodedb_b_layer_foreach_set(NodeBitmap *node, NdbBLayer *layer,
 	}
 }
 
-void * nodedb_b_layer_tile_find(const NodeBitmap *node, const NdbBLayer *layer,
-			     uint16 tile_x, uint16 tile_y, uint16 tile_z)
+/* ----------------------------------------------------------------------------------------- */
+
+/* Return the tile at (tile_x,tile_y,tile_z), ready to be sent as it is. Never NULL. */
+const VNBTile * nodedb_b_tile_get(const NodeBitmap *node, const NdbBLayer *layer, uint16 tile_x, uint16 tile_y, uint16 tile_z)
 {
-	if(layer->framebuffer != NULL)
-	{
-		size_t	ps = pixel_size(layer->type),
-			mod = layer_modulo(node, layer),
-			size = (node->width * ps + 7 / 8) * node->height;
-		return (char *) layer->framebuffer + tile_y * VN_B_TILE_SIZE * mod +
-			(tile_x * VN_B_TILE_SIZE * ps + 7) / 8 + size * tile_z;
-	}
-	return NULL;
+	return (const VNBTile *) tile_get(layer, tile_index(node, tile_x, tile_y, tile_z));
 }
 
-void nodedb_b_tile_describe(const NodeBitmap *node, const NdbBLayer *layer, NdbBTileDesc *desc)
+/* Check if two layers of the same type, in bitmaps of the same dimensions, have equal tiles at
+ * (tile_x,tile_y,tile_z). Tiles are compared through their hashes, and only when those are equal
+ * are the pixels compared, too.
+*/
+int nodedb_b_tile_equal(const NodeBitmap *node, const NdbBLayer *layer, const NodeBitmap *other, const NdbBLayer *other_layer,
+			uint16 tile_x, uint16 tile_y, uint16 tile_z)
 {
-	desc->out.mod_row  = layer_modulo(node, layer);
-	desc->out.mod_tile = tile_modulo(node, layer);
-	desc->out.width    = MIN(VN_B_TILE_SIZE, node->width - desc->in.x * VN_B_TILE_SIZE);
-	if(layer->type == VN_B_LAYER_UINT1)
-		desc->out.width_bytes = (desc->out.width + 7) / 8;
-	else
-		desc->out.width_bytes = (desc->out.width * pixel_size(layer->type)) / 8;
-	desc->out.height   = (desc->in.y * VN_B_TILE_SIZE + 7 >= node->height) ?
-				node->height % VN_B_TILE_SIZE : VN_B_TILE_SIZE;
-	desc->out.ptr = nodedb_b_layer_tile_find(node, layer, desc->in.x, desc->in.y, desc->in.z);
+	return tile_equal(node, layer, other, other_layer, tile_index(node, tile_x, tile_y, tile_z));
 }
 
 /* ----------------------------------------------------------------------------------------- */
@@ -770,9 +1206,10 @@ static void cb_b_layer_destroy(UNUSED(void *user), VNodeID node_id, VLayerID lay
 		return;
 	if((layer = dynarr_index(node->layers, layer_id)) == NULL || layer->name[0] == '\0')
 		return;
+	layer_clear(layer);
 	layer->name[0] = '\0';
 	layer->type = -1;
-	mem_free(layer->framebuffer);
+	dirty_free(&layer->dirty);
 	NOTIFY(node, STRUCTURE);
 }
 
@@ -781,8 +1218,6 @@ static void cb_b_tile_set(UNUSED(void *user), VNodeID node_id, VLayerID layer_id
 {
 	NodeBitmap	*node;
 	NdbBLayer	*layer;
-	size_t		ps, tw, th, ht, y, mod_src, mod_dst;
-	const uint8	*get;
 	uint8		*put;
 
 /*	printf("got tile_set in %u.%u.(%u,%u,%u)\n", node_id, layer_id, tile_x, tile_y, tile_z);*/
@@ -795,56 +1230,16 @@ static void cb_b_tile_set(UNUSED(void *user), VNodeID node_id, VLayerID layer_id
 		LOG_WARN(("Received type %d data for type %d layer--ignoring", type, layer->type));
 		return;
 	}
-	ps = pixel_size(layer->type);
-	if(layer->framebuffer == NULL)
-	{
-		size_t	layer_size = layer_modulo(node, layer) * node->height * node->depth;
-		layer->framebuffer = mem_alloc(layer_size);
-		memset(layer->framebuffer, 0, layer_size);
-	}
-	if(layer->framebuffer == NULL)
+	if(tile_x * VN_B_TILE_SIZE >= node->width || tile_y * VN_B_TILE_SIZE >= node->height || tile_z >= node->depth)
+		return;
+	if((put = tile_write(node, layer, tile_index(node, tile_x, tile_y, tile_z))) == NULL)
 	{
-		LOG_WARN(("No framebuffer in layer %u (%s)--out of memory?", layer->id, layer->name));
+		LOG_WARN(("No tiles in layer %u (%s)--out of memory?", layer->id, layer->name));
 		return;
 	}
-
-	ht = (node->height + VN_B_TILE_SIZE - 1) / VN_B_TILE_SIZE;
-	th = (tile_y == ht - 1) && (node->height % VN_B_TILE_SIZE) != 0 ? node->height % VN_B_TILE_SIZE : VN_B_TILE_SIZE;
-	
-	get = (uint8 *) tile;		/* It's a union. */
-	put = nodedb_b_layer_tile_find(node, layer, tile_x, tile_y, tile_z);
-	mod_src = tile_modulo(node, layer);
-	tw = tile_width(node, layer, tile_x);
-	mod_dst = layer_modulo(node, layer);
-	for(y = 0; y < th; y++, get += mod_src, put += mod_dst)
-		memcpy(put, get, tw);
+	memcpy(put, tile, tile_size(layer));
+	tile_crop(node, layer, tile_x, tile_y, put);
 	NOTIFY(node, DATA);
-
-/*	if(layer->type == VN_B_LAYER_UINT1)
-	{
-		const uint8	*ptr = layer->framebuffer;
-		uint32		x, y;
-
-		for(y = 0; y < node->height; y++)
-		{
-			for(x = 0; x < mod_dst; x++)
-				printf(" %02X", *ptr++);
-			printf("\n");
-		}
-	}
-	else if(layer->type == VN_B_LAYER_REAL64)
-	{
-		const real64	*ptr = layer->framebuffer;
-		uint32		x, y;
-
-		for(y = 0; y < node->height; y++)
-		{
-			for(x = 0; x < node->width; x++)
-				printf(" %g", *ptr++);
-			printf("\n");
-		}
-	}
-*/
 }
 
 /* ----------------------------------------------------------------------------------------- */
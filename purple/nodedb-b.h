@@ -8,32 +8,15 @@
 
 #include <stdarg.h>
 
-/* This is used to avoid copying tiles back and forth when sychronizing, by
- * instead providing enough access information to let it at the bytes.
-*/
-typedef struct
-{
-	struct
-	{
-		uint16	x, y, z;
-	}	in;
-	struct
-	{
-		uint8	*ptr;
-		size_t	mod_row;
-		size_t	mod_tile;
-		size_t	width;		/* Effective width; last column can be cropped. In pixels. */
-		size_t	width_bytes;	/* Effective width, in bytes. Handy. */
-		size_t	height;		/* Effective height; last row can be cropped. */
-	}	out;
-} NdbBTileDesc;
-
 typedef struct
 {
 	uint16		id;
 	char		name[16];
 	VNBLayerType	type;
-	void		*framebuffer;
+	void		*tiles;		/* Reference counted, shared with copies of the node until written. */
+	void		*linear;	/* Linear framebuffer, only while being accessed as one. */
+	unsigned int	linear_refs;	/* Number of accesses begun but not yet ended. */
+	Dirty		dirty;		/* Tiles that may differ from the synchronized version. */
 } NdbBLayer;
 
 typedef enum {
@@ -51,6 +34,8 @@ extern void		nodedb_b_construct(NodeBitmap *n);
 extern void		nodedb_b_copy(NodeBitmap *n, const NodeBitmap *src);
 extern void		nodedb_b_set(NodeBitmap *n, const NodeBitmap *src);
 extern void		nodedb_b_destruct(NodeBitmap *n);
+extern size_t		nodedb_b_size(const NodeBitmap *n);
+extern NdbHash		nodedb_b_hash(const NodeBitmap *n, NdbHash h);
 
 extern int		nodedb_b_set_dimensions(NodeBitmap *node, uint16 width, uint16 height, uint16 depth);
 extern void		nodedb_b_get_dimensions(const NodeBitmap *node, uint16 *width, uint16 *height, uint16 *depth);
@@ -78,6 +63,8 @@ extern void		nodedb_b_layer_write_multi_end(NodeBitmap *node, void *framebuffer)
 extern void		nodedb_b_layer_foreach_set(NodeBitmap *node, NdbBLayer *layer,
 						real64 (*pixel)(uint32 x, uint32 y, uint32 z, void *user), void *user);
 
-extern void		nodedb_b_tile_describe(const NodeBitmap *node, const NdbBLayer *layer, NdbBTileDesc *desc);
+extern const VNBTile *	nodedb_b_tile_get(const NodeBitmap *node, const NdbBLayer *layer, uint16 tile_x, uint16 tile_y, uint16 tile_z);
+extern int		nodedb_b_tile_equal(const NodeBitmap *node, const NdbBLayer *layer, const NodeBitmap *other, const NdbBLayer *other_layer,
+					    uint16 tile_x, uint16 tile_y, uint16 tile_z);
 
 extern void		nodedb_b_register_callbacks(void);
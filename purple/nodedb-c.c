@@ -13,8 +13,8 @@
 #include "purple.h"
 
 #include "dynarr.h"
-#include "list.h"
 #include "log.h"
+#include "mem.h"
 #include "strutil.h"
 #include "textbuf.h"
 
@@ -35,37 +35,96 @@ static void cb_key_default(UNUSED(unsigned int index), void *element, UNUSED(voi
 	key->pos = V_REAL64_MAX;
 }
 
-/* Comparison function for inserting keys into lists, using list_insert_sorted(). */
-static int cb_key_compare(const void *d1, const void *d2)
+/* ----------------------------------------------------------------------------------------- */
+
+/* The sorted array holds key indices rather than pointers, so that it survives the keys array
+ * being reallocated as it grows, and can be copied as-is along with it.
+*/
+
+static NdbCKey * sorted_key(const NdbCCurve *curve, unsigned int n)
+{
+	return dynarr_index(curve->keys, curve->sorted[n]);
+}
+
+/* Return the lowest position in the sorted array whose key is at or after <pos>. Binary search. */
+static unsigned int sorted_lower(const NdbCCurve *curve, real64 pos)
+{
+	unsigned int	lo = 0, hi = curve->sorted_num, mid;
+
+	while(lo < hi)
+	{
+		mid = (lo + hi) / 2;
+		if(sorted_key(curve, mid)->pos < pos)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/* Insert the key at <index> in the keys array into the sorted array, by its position. */
+static int sorted_insert(NdbCCurve *curve, unsigned int index)
 {
-	const NdbCKey	*k1 = d1, *k2 = d2;
+	unsigned int	at;
+
+	if(curve->sorted_num == curve->sorted_alloc)
+	{
+		unsigned int	na = curve->sorted_alloc > 0 ? 2 * curve->sorted_alloc : 8, *ns;
 
-	return k1->pos < k2->pos ? -1 : k1->pos > k2->pos;
+		if((ns = mem_realloc(curve->sorted, na * sizeof *ns)) == NULL)
+			return 0;
+		curve->sorted = ns;
+		curve->sorted_alloc = na;
+	}
+	at = sorted_lower(curve, ((NdbCKey *) dynarr_index(curve->keys, index))->pos);
+	memmove(curve->sorted + at + 1, curve->sorted + at, (curve->sorted_num - at) * sizeof *curve->sorted);
+	curve->sorted[at] = index;
+	curve->sorted_num++;
+	return 1;
 }
 
-/* Compare data from list, <listdata>, against <data> which should be pointer to pos. Returns -1, 0 or 1. */
-static int cb_key_compare_find(const void *listdata, const void *data)
+/* Remove the key at <index> from the sorted array. Must be called before the key's position changes. */
+static void sorted_remove(NdbCCurve *curve, unsigned int index)
 {
-	const NdbCKey	*k = listdata;
-	real64		pos = *(real64 *) data;
+	unsigned int	at;
+	real64		pos = ((NdbCKey *) dynarr_index(curve->keys, index))->pos;
+
+	for(at = sorted_lower(curve, pos); at < curve->sorted_num && sorted_key(curve, at)->pos == pos; at++)
+	{
+		if(curve->sorted[at] == index)
+		{
+			memmove(curve->sorted + at, curve->sorted + at + 1, (curve->sorted_num - at - 1) * sizeof *curve->sorted);
+			curve->sorted_num--;
+			return;
+		}
+	}
+}
 
-	return k->pos < pos ? -1 : k->pos > pos;
+static void sorted_destroy(NdbCCurve *curve)
+{
+	mem_free(curve->sorted);
+	curve->sorted = NULL;
+	curve->sorted_num = curve->sorted_alloc = 0;
 }
 
+/* ----------------------------------------------------------------------------------------- */
+
 static void cb_copy_curve(void *d, const void *s, UNUSED(void *user))
 {
 	const NdbCCurve	*src = s;
 	NdbCCurve	*dst = d;
-	NdbCKey		*key;
-	unsigned int	i;
 
 	dst->id = src->id;
 	strcpy(dst->name, src->name);
 	dst->dimensions = src->dimensions;
 	dst->keys = dynarr_new_copy(src->keys, NULL, NULL);	/* Keys are trivially copyable. */
-	dst->curve = NULL;
-	for(i = 0; (key = dynarr_index(dst->keys, i)) != NULL; i++)
-		dst->curve = list_insert_sorted(dst->curve, key, cb_key_compare);
+	dst->sorted = NULL;
+	dst->sorted_num = dst->sorted_alloc = 0;
+	if(src->sorted_num > 0 && (dst->sorted = mem_alloc(src->sorted_num * sizeof *dst->sorted)) != NULL)
+	{
+		memcpy(dst->sorted, src->sorted, src->sorted_num * sizeof *dst->sorted);	/* Indices stay valid. */
+		dst->sorted_num = dst->sorted_alloc = src->sorted_num;
+	}
 }
 
 void nodedb_c_copy(NodeCurve *n, const NodeCurve *src)
@@ -92,13 +151,41 @@ void nodedb_c_destruct(NodeCurve *n)
 		{
 			printf("destroying curve %u\n", i);
 			dynarr_destroy(c->keys);
-			list_destroy(c->curve);
+			sorted_destroy(c);
 		}
 	}
 	dynarr_destroy(n->curves);
 	n->curves = NULL;
 }
 
+/* Hash curves, and their keys in position order. Only the used dimensions are included. */
+NdbHash nodedb_c_hash(const NodeCurve *n, NdbHash h)
+{
+	unsigned int	i;
+	const NdbCCurve	*curve;
+	const NdbCKey	*key;
+	unsigned int	j;
+
+	for(i = 0; (curve = dynarr_index(n->curves, i)) != NULL; i++)
+	{
+		if(curve->name[0] == '\0')
+			continue;
+		h = nodedb_internal_hash(h, curve->name, strlen(curve->name));
+		h = NODEDB_HASH(h, curve->dimensions);
+		for(j = 0; j < curve->sorted_num; j++)
+		{
+			key = sorted_key(curve, j);
+			h = NODEDB_HASH(h, key->pos);
+			h = nodedb_internal_hash(h, key->value, curve->dimensions * sizeof *key->value);
+			h = nodedb_internal_hash(h, key->pre.pos, curve->dimensions * sizeof *key->pre.pos);
+			h = nodedb_internal_hash(h, key->pre.value, curve->dimensions * sizeof *key->pre.value);
+			h = nodedb_internal_hash(h, key->post.pos, curve->dimensions * sizeof *key->post.pos);
+			h = nodedb_internal_hash(h, key->post.value, curve->dimensions * sizeof *key->post.value);
+		}
+	}
+	return h;
+}
+
 /* ----------------------------------------------------------------------------------------- */
 
 unsigned int nodedb_c_curve_num(const NodeCurve *node)
@@ -181,6 +268,8 @@ NdbCCurve * nodedb_c_curve_create(NodeCurve *node, VLayerID curve_id, const char
 		stu_strncpy(curve->name, sizeof curve->name, name);
 		curve->dimensions = dimensions;
 		curve->keys = NULL;
+		curve->sorted = NULL;
+		curve->sorted_num = curve->sorted_alloc = 0;
 		printf("Curve curve %u.%u %s created, dim=%u\n", node->node.id, curve_id, name, curve->dimensions);
 	}
 	return curve;
@@ -197,39 +286,88 @@ unsigned int nodedb_c_curve_key_num(const NdbCCurve *curve)
 {
 	if(curve == NULL)
 		return 0;
-	return list_length(curve->curve);
+	return curve->sorted_num;
 }
 
 NdbCKey * nodedb_c_curve_key_nth(const NdbCCurve *curve, unsigned int n)
 {
-	List	*iter;
-
-	if(curve == NULL)
+	if(curve == NULL || n >= curve->sorted_num)
 		return NULL;
-	for(iter = curve->curve; iter != NULL; iter = list_next(iter), n--)
-	{
-		if(n == 0)
-			return list_data(iter);
-	}
-	return NULL;
+	return sorted_key(curve, n);
 }
 
 NdbCKey * nodedb_c_curve_key_find(const NdbCCurve *curve, real64 pos)
 {
-	const List	*iter;
-	NdbCKey		*key;
+	unsigned int	at;
 
 	if(curve == NULL)
 		return NULL;
-	for(iter = curve->curve; iter != NULL; iter = list_next(iter))
+	if((at = sorted_lower(curve, pos)) < curve->sorted_num && sorted_key(curve, at)->pos == pos)
+		return sorted_key(curve, at);
+	return NULL;
+}
+
+/* Evaluate one dimension of the curve segment from <k0> to <k1> at <pos>, which is between them.
+ * The segment is a cubic Bezier through the keys, with the post-point of <k0> and the pre-point
+ * of <k1> as control points. Their positions are fractions (of 2^32) of the distance between
+ * the keys. The Bezier's parameter is found by bisection on its position polynomial.
+*/
+static real64 segment_evaluate(const NdbCKey *k0, const NdbCKey *k1, uint8 dimension, real64 pos)
+{
+	real64	x0 = k0->pos, x3 = k1->pos, x1, x2, lo = 0.0, hi = 1.0, t, u;
+	int	i;
+
+	x1 = x0 + (x3 - x0) * (k0->post.pos[dimension] / 4294967296.0);
+	x2 = x3 - (x3 - x0) * (k1->pre.pos[dimension] / 4294967296.0);
+	for(i = 0; i < 40; i++)
 	{
-		key = list_data(iter);
-		if(key->pos == pos)
-			return key;
-		if(key->pos > pos)	/* List is sorted, so we can exit a bit quicker. */
-			return NULL;
+		t = 0.5 * (lo + hi);
+		u = 1.0 - t;
+		if(u * u * u * x0 + 3.0 * u * u * t * x1 + 3.0 * u * t * t * x2 + t * t * t * x3 < pos)
+			lo = t;
+		else
+			hi = t;
 	}
-	return NULL;
+	t = 0.5 * (lo + hi);
+	u = 1.0 - t;
+	return u * u * u * k0->value[dimension] + 3.0 * u * u * t * k0->post.value[dimension] +
+	       3.0 * u * t * t * k1->pre.value[dimension] + t * t * t * k1->value[dimension];
+}
+
+/* Evaluate the curve at <pos>, which can be anywhere. Outside the keys, the curve is flat. If
+ * <hint> is non-NULL, it is used as a guess for the segment to look in first, and set to the
+ * one actually used, so evaluating at increasing positions needs no searching.
+*/
+real64 nodedb_c_curve_evaluate(const NdbCCurve *curve, uint8 dimension, real64 pos, unsigned int *hint)
+{
+	const NdbCKey	*k0, *k1;
+	unsigned int	seg, last;
+
+	if(curve == NULL || dimension >= curve->dimensions || curve->sorted_num == 0)
+		return 0.0;
+	last = curve->sorted_num - 1;
+	if(pos <= (k0 = sorted_key(curve, 0))->pos)
+		return k0->value[dimension];
+	if(pos >= (k1 = sorted_key(curve, last))->pos)
+		return k1->value[dimension];
+	seg = hint != NULL ? *hint : 0;
+	if(seg >= last || pos < sorted_key(curve, seg)->pos || pos >= sorted_key(curve, seg + 1)->pos)
+	{
+		if(seg + 1 < last && pos >= sorted_key(curve, seg + 1)->pos && pos < sorted_key(curve, seg + 2)->pos)
+			seg++;
+		else
+		{
+			seg = sorted_lower(curve, pos);		/* First key at or after pos, never the first. */
+			if(sorted_key(curve, seg)->pos > pos)
+				seg--;
+		}
+	}
+	if(hint != NULL)
+		*hint = seg;
+	k0 = sorted_key(curve, seg);
+	if(pos == k0->pos)
+		return k0->value[dimension];
+	return segment_evaluate(k0, sorted_key(curve, seg + 1), dimension, pos);
 }
 
 int nodedb_c_curve_key_equal(const NdbCCurve *curve, const NdbCKey *k1, const NdbCKey *k2)
@@ -261,8 +399,9 @@ NdbCKey * nodedb_c_key_create(NdbCCurve *curve, uint32 key_id,
 				     const uint32 *pre_pos, const real64 *pre_value,
 				     const uint32 *post_pos, const real64 *post_value)
 {
-	NdbCKey	*key;
-	int	insert = 0, sort = 0, i;
+	NdbCKey		*key;
+	unsigned int	index;
+	int		insert = 0, i;
 
 	if(curve->keys == NULL)
 	{
@@ -274,26 +413,26 @@ NdbCKey * nodedb_c_key_create(NdbCCurve *curve, uint32 key_id,
 	if(key_id == ~0u)
 	{
 		/* If creating a new key, make sure it's not clobbering an existing position. Search. */
-		List	*old;
-
-		if((old = list_find_sorted(curve->curve, &pos, cb_key_compare_find)) != NULL)
-			key = list_data(old);	/* Just re-use the same slot, since we're not changing position. */
-		else
+		if((key = nodedb_c_curve_key_find(curve, pos)) == NULL)
 		{
-			key = dynarr_append(curve->keys, NULL, NULL);
+			key = dynarr_append(curve->keys, NULL, &index);
 			insert = 1;
 		}
+		/* Else just re-use the same slot, since we're not changing position. */
 	}
 	else
 	{
-		key = dynarr_set(curve->keys, key_id, NULL);
-		sort = 1;	/* We might re-sort. Turned off if new pos equals old, below. */
+		index = key_id;
+		if((key = dynarr_set(curve->keys, index, NULL)) != NULL && key->pos != pos)
+		{
+			if(key->pos != V_REAL64_MAX)
+				sorted_remove(curve, index);	/* Moving, so take it out and re-insert below. */
+			insert = 1;
+		}
 	}
 	if(key == NULL)
 		return NULL;
 	key->id = key_id;
-	if(sort)
-		sort = key->pos != pos;	/* Only resort if new position differs from the one we're reusing. */
 	key->pos = pos;
 	for(i = 0; i < curve->dimensions; i++)
 	{
@@ -303,32 +442,20 @@ NdbCKey * nodedb_c_key_create(NdbCCurve *curve, uint32 key_id,
 		key->post.pos[i]   = post_pos[i];
 		key->post.value[i] = post_value[i];
 	}
-	if(insert)
-	{
-		printf("inserting key in list\n");
-		curve->curve = list_insert_sorted(curve->curve, key, cb_key_compare);
-	}
-	else if(sort)
+	if(insert && !sorted_insert(curve, index))
 	{
-		List	*nl = NULL, *iter;
-
-		printf("resorting list\n");
-		/* This is considered a rare event, so we can be a bit expensive. */
-		nl = list_insert_sorted(nl, key, cb_key_compare);	/* Get the new one in there. */
-		for(iter = curve->curve; iter != NULL; iter = list_next(iter))
-			nl = list_insert_sorted(nl, list_data(iter), cb_key_compare);
-		list_destroy(curve->curve);
-		curve->curve = nl;
-		printf("key list resorted\n");
+		LOG_ERR(("Couldn't insert curve key, out of memory"));
+		key->pos = V_REAL64_MAX;
+		return NULL;
 	}
 	return key;
 }
 
 void nodedb_c_key_destroy(NdbCCurve *curve, NdbCKey *key)
 {
-	if(curve == NULL || key == NULL)
+	if(curve == NULL || key == NULL || key->pos == V_REAL64_MAX)
 		return;
-	curve->curve = list_remove(curve->curve, key);
+	sorted_remove(curve, key - (NdbCKey *) dynarr_index(curve->keys, 0));
 	key->pos = V_REAL64_MAX;
 }
 
@@ -336,8 +463,9 @@ void nodedb_c_curve_destroy(NodeCurve *node, NdbCCurve *curve)
 {
 	if(node == NULL || curve == NULL)
 		return;
-	list_destroy(curve->curve);
+	sorted_destroy(curve);
 	dynarr_destroy(curve->keys);
+	curve->keys = NULL;
 	curve->name[0] = '\0';
 	curve->id = -1;
 }
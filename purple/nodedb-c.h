@@ -34,7 +34,8 @@ typedef struct
 	char		name[16];
 	uint8		dimensions;
 	DynArr		*keys;		/* Array of Keys, actual storage, arranged by ID/index. */
-	List		*curve;		/* List of Keys, ordered by pos. */
+	unsigned int	*sorted;	/* Indices into keys, ordered by key pos. */
+	unsigned int	sorted_num, sorted_alloc;
 	NodeCurve	*node;		/* Needed for notification on key destroy. */
 } NdbCCurve;
 
@@ -42,6 +43,7 @@ extern void		nodedb_c_construct(NodeCurve *n);
 extern void		nodedb_c_copy(NodeCurve *n, const NodeCurve *src);
 extern void		nodedb_c_set(NodeCurve *n, const NodeCurve *src);
 extern void		nodedb_c_destruct(NodeCurve *n);
+extern NdbHash		nodedb_c_hash(const NodeCurve *n, NdbHash h);
 
 extern unsigned int	nodedb_c_curve_num(const NodeCurve *curve);
 extern NdbCCurve *	nodedb_c_curve_nth(const NodeCurve *curve, unsigned int n);
@@ -52,6 +54,7 @@ extern uint8		nodedb_c_curve_dimensions_get(const NdbCCurve *curve);
 extern unsigned int	nodedb_c_curve_key_num(const NdbCCurve *curve);
 extern NdbCKey *	nodedb_c_curve_key_nth(const NdbCCurve *curve, unsigned int n);
 extern NdbCKey *	nodedb_c_curve_key_find(const NdbCCurve *curve, real64 pos);
+extern real64		nodedb_c_curve_evaluate(const NdbCCurve *curve, uint8 dimension, real64 pos, unsigned int *hint);
 extern int		nodedb_c_curve_key_equal(const NdbCCurve *curve, const NdbCKey *k1, const NdbCKey *k2);
 extern NdbCKey *	nodedb_c_key_create(NdbCCurve *curve, uint32 key_id,
 					    real64 pos, const real64 *value,
@@ -28,6 +28,8 @@
 
 static MemChunk	*the_chunk_bone = NULL;
 
+#define	LAYER_DIRTY_SHIFT	6	/* Layer slots are tracked for synchronization in blocks of 64. */
+
 /* ----------------------------------------------------------------------------------------- */
 
 void nodedb_g_construct(NodeGeometry *n)
@@ -49,12 +51,12 @@ static void cb_copy_layer(void *d, const void *s, void *user)
 	dst->id = src->id;
 	strcpy(dst->name, src->name);
 	dst->type = src->type;
-	dst->data = dynarr_new_copy(src->data, NULL, NULL);
+	dst->data = dynarr_new_share(src->data);	/* Copy-on-write, see layer_write(). */
 	dst->def  = src->def;
 	dst->def_uint = src->def_uint;
 	dst->def_real = src->def_real;
-	dynarr_set_default(dst->data, &dst->def);
 	dst->node = user;
+	dirty_init(&dst->dirty, LAYER_DIRTY_SHIFT);	/* Nothing is known about what a new copy is in sync with. */
 }
 
 void nodedb_g_copy(NodeGeometry *n, const NodeGeometry *src)
@@ -69,27 +71,92 @@ void nodedb_g_copy(NodeGeometry *n, const NodeGeometry *src)
 	n->crease_edge   = src->crease_edge;
 }
 
+static NdbGLayer * layers_find(const DynArr *layers, const char *name)
+{
+	unsigned int	i;
+	NdbGLayer	*layer;
+
+	for(i = 0; (layer = dynarr_index(layers, i)) != NULL; i++)
+	{
+		if(strcmp(layer->name, name) == 0)
+			return layer;
+	}
+	return NULL;
+}
+
+static void layers_destroy(DynArr *layers)
+{
+	unsigned int	i;
+	NdbGLayer	*layer;
+
+	for(i = 0; (layer = dynarr_index(layers, i)) != NULL; i++)
+	{
+		dirty_free(&layer->dirty);
+		if(layer->name[0] == '\0' || layer->data == NULL)
+			continue;
+		dynarr_destroy(layer->data);
+	}
+	dynarr_destroy(layers);
+}
+
+/* Mark the blocks of <layer> whose contents differ from <old>, which is what the layer held before. */
+static void layer_dirty_diff(NdbGLayer *layer, const DynArr *old)
+{
+	const uint8	*data, *odata;
+	size_t		i, n, size, osize, esize, block = (size_t) 1 << LAYER_DIRTY_SHIFT;
+
+	if(layer->data == old)		/* Still sharing the same data, so nothing changed. */
+		return;
+	size  = dynarr_size(layer->data);
+	osize = dynarr_size(old);
+	if(size > osize)
+	{
+		dirty_mark(&layer->dirty, osize, size - osize);
+		size = osize;
+	}
+	if(size == 0)
+		return;
+	esize = dynarr_get_elem_size(layer->data);
+	data  = dynarr_index(layer->data, 0);
+	odata = dynarr_index(old, 0);
+	for(i = 0; i < size; i += n)
+	{
+		n = size - i < block ? size - i : block;
+		if(memcmp(data + i * esize, odata + i * esize, n * esize) != 0)
+			dirty_mark(&layer->dirty, i, n);
+	}
+}
+
+/* Set <n> to equal <src>. Layers that were in <n> before keep their dirty state, plus whatever
+ * blocks the new contents differ in. Module outputs are set over and over like this, and would
+ * otherwise need to be compared in full by the synchronizer each time.
+*/
 void nodedb_g_set(NodeGeometry *n, const NodeGeometry *src)
 {
-	/* FIXME: This is very costly. */
+	DynArr		*old = n->layers;
+	unsigned int	i;
+	NdbGLayer	*layer, *ol;
+
+	n->layers = NULL;
 	nodedb_g_destruct(n);
 	nodedb_g_copy(n, src);
+	for(i = 0; (layer = dynarr_index(n->layers, i)) != NULL; i++)
+	{
+		if(layer->name[0] == '\0' || (ol = layers_find(old, layer->name)) == NULL || ol->type != layer->type || ol->data == NULL)
+			continue;
+		dirty_clear(&layer->dirty);
+		dirty_merge(&layer->dirty, &ol->dirty);
+		layer_dirty_diff(layer, ol->data);
+	}
+	if(old != NULL)
+		layers_destroy(old);
 }
 
 void nodedb_g_destruct(NodeGeometry *n)
 {
 	if(n->layers != NULL)
 	{
-		unsigned int	i;
-		NdbGLayer	*layer;
-
-		for(i = 0; (layer = dynarr_index(n->layers, i)) != NULL; i++)
-		{
-			if(layer->name[0] == '\0' || layer->data == NULL)
-				continue;
-			dynarr_destroy(layer->data);
-		}
-		dynarr_destroy(n->layers);
+		layers_destroy(n->layers);
 		n->layers = NULL;
 	}
 	if(n->bones != NULL)
@@ -99,6 +166,57 @@ void nodedb_g_destruct(NodeGeometry *n)
 	}
 }
 
+/* Approximate number of bytes held by layer data. Bones and such are ignored. */
+size_t nodedb_g_size(const NodeGeometry *n)
+{
+	unsigned int	i;
+	const NdbGLayer	*layer;
+	size_t		size = 0;
+
+	for(i = 0; (layer = dynarr_index(n->layers, i)) != NULL; i++)
+	{
+		if(layer->name[0] == '\0' || layer->data == NULL)
+			continue;
+		size += dynarr_size(layer->data) * dynarr_get_elem_size(layer->data);
+	}
+	return size;
+}
+
+/* Hash layer contents and bones. Layer data is arrays of plain numbers, so it's hashed directly. */
+NdbHash nodedb_g_hash(const NodeGeometry *n, NdbHash h)
+{
+	unsigned int	i;
+	const NdbGLayer	*layer;
+	const NdbGBone	*bone;
+
+	h = NODEDB_HASH(h, n->num_vertex);
+	h = NODEDB_HASH(h, n->num_polygon);
+	for(i = 0; (layer = dynarr_index(n->layers, i)) != NULL; i++)
+	{
+		if(layer->name[0] == '\0')
+			continue;
+		h = nodedb_internal_hash(h, layer->name, strlen(layer->name));
+		h = NODEDB_HASH(h, layer->type);
+		if(layer->data != NULL)
+			h = nodedb_internal_hash(h, dynarr_index(layer->data, 0), dynarr_size(layer->data) * dynarr_get_elem_size(layer->data));
+	}
+	for(i = idtree_foreach_first(n->bones); (bone = idtree_get(n->bones, i)) != NULL; i = idtree_foreach_next(n->bones, i))
+	{
+		h = NODEDB_HASH(h, bone->id);
+		h = nodedb_internal_hash(h, bone->weight, strlen(bone->weight));
+		h = nodedb_internal_hash(h, bone->reference, strlen(bone->reference));
+		h = NODEDB_HASH(h, bone->parent);
+		h = NODEDB_HASH(h, bone->pos);
+		h = nodedb_internal_hash(h, bone->pos_curve, strlen(bone->pos_curve));
+		h = NODEDB_HASH(h, bone->rot);
+		h = nodedb_internal_hash(h, bone->rot_curve, strlen(bone->rot_curve));
+	}
+	h = nodedb_internal_hash(h, n->crease_vertex.layer, strlen(n->crease_vertex.layer));
+	h = NODEDB_HASH(h, n->crease_vertex.def);
+	h = nodedb_internal_hash(h, n->crease_edge.layer, strlen(n->crease_edge.layer));
+	return NODEDB_HASH(h, n->crease_edge.def);
+}
+
 /* ----------------------------------------------------------------------------------------- */
 
 unsigned int nodedb_g_layer_num(const NodeGeometry *node)
@@ -136,17 +254,9 @@ NdbGLayer * nodedb_g_layer_nth(const NodeGeometry *node, unsigned int index)
 
 NdbGLayer * nodedb_g_layer_find(const NodeGeometry *node, const char *name)
 {
-	unsigned int	i;
-	NdbGLayer	*layer;
-
 	if(node == NULL)
 		return NULL;
-	for(i = 0; (layer = dynarr_index(node->layers, i)) != NULL; i++)
-	{
-		if(strcmp(layer->name, name) == 0)
-			return layer;
-	}
-	return NULL;
+	return layers_find(node->layers, name);
 }
 
 size_t nodedb_g_layer_get_size(const NdbGLayer *layer)
@@ -189,10 +299,47 @@ static void nodedb_g_layer_allocate(NodeGeometry *node, NdbGLayer *layer)
 	layer->data = dynarr_new(layer_element_size(layer->type), 16);
 	dynarr_set_default(layer->data, &layer->def);
 
-	if(VERTEX_LAYER(layer) && node->num_vertex > 0)
-		dynarr_grow(layer->data, node->num_vertex - 1, 1);
-	else if(POLYGON_LAYER(layer) && node->num_polygon > 0)
-		dynarr_grow(layer->data, node->num_polygon - 1, 1);
+	if(VERTEX_LAYER(layer))
+		dynarr_reserve(layer->data, node->num_vertex);
+	else if(POLYGON_LAYER(layer))
+		dynarr_reserve(layer->data, node->num_polygon);
+}
+
+/* Get <layer>'s data ready to have the <num> slots starting at <first> modified, and return it.
+ * Copies of a node share layer data with the original until either one writes to it, which is
+ * when it gets copied, here. The slots are marked dirty, along with any that appear between
+ * the current end of the layer and <first>, so the synchronizer knows to look at them.
+*/
+static DynArr * layer_write(NdbGLayer *layer, size_t first, size_t num)
+{
+	DynArr	*data;
+	size_t	size;
+
+	if(layer->data == NULL)
+		layer->data = dynarr_new(layer_element_size(layer->type), 16);
+	else if(dynarr_shared(layer->data))
+	{
+		if((data = dynarr_unshare(layer->data)) == NULL)
+			return NULL;
+		layer->data = data;
+	}
+	dynarr_set_default(layer->data, &layer->def);	/* Might point at the original's layer. */
+	if(num > 0)
+	{
+		if(first > (size = dynarr_size(layer->data)))
+		{
+			num  += first - size;
+			first = size;
+		}
+		dirty_mark(&layer->dirty, first, num);
+	}
+	return layer->data;
+}
+
+void nodedb_g_layer_reserve(NdbGLayer *layer, size_t size)
+{
+	if(layer != NULL)
+		dynarr_reserve(layer_write(layer, 0, 0), size);
 }
 
 void nodedb_g_layer_set_default(NdbGLayer *layer, uint32 def_uint, real64 def_real)
@@ -234,6 +381,7 @@ static void cb_def_layer(UNUSED(unsigned int index), void *element, UNUSED(void
 
 	layer->name[0] = '\0';
 	layer->data = NULL;
+	dirty_init(&layer->dirty, LAYER_DIRTY_SHIFT);
 }
 
 NdbGLayer * nodedb_g_layer_create(NodeGeometry *node, VLayerID layer_id, const char *name, VNGLayerType type, uint32 def_uint, real64 def_real)
@@ -262,6 +410,7 @@ NdbGLayer * nodedb_g_layer_create(NodeGeometry *node, VLayerID layer_id, const c
 					layer->data = NULL;
 				}
 			}
+			dirty_free(&layer->dirty);
 		}
 		layer = dynarr_set(node->layers, layer_id, NULL);
 	}
@@ -269,6 +418,7 @@ NdbGLayer * nodedb_g_layer_create(NodeGeometry *node, VLayerID layer_id, const c
 	stu_strncpy(layer->name, sizeof layer->name, name);
 	layer->type = type;
 	layer->node = node;
+	dirty_init(&layer->dirty, LAYER_DIRTY_SHIFT);
 	nodedb_g_layer_set_default(layer, def_uint, def_real);
 	nodedb_g_layer_allocate(node, layer);
 	printf("done, layer %s created\n", name);
@@ -282,7 +432,11 @@ void nodedb_g_layer_destroy(NodeGeometry *node, NdbGLayer *layer)
 		return;
 	layer->name[0] = '\0';
 	if(layer->data != NULL)
+	{
 		dynarr_destroy(layer->data);
+		layer->data = NULL;
+	}
+	dirty_free(&layer->dirty);
 }
 
 NdbGLayer * nodedb_g_layer_lookup_id(const NodeGeometry *node, VLayerID layer_id)
@@ -382,14 +536,61 @@ static void resize_vertex(NodeGeometry *node, uint32 size)
 			continue;
 		if(layer->type >= VN_G_LAYER_POLYGON_CORNER_UINT32)	/* Really skip polygon layers. */
 			continue;
-		if(layer->data == NULL)
-			layer->data = dynarr_new(layer_element_size(layer->type), 16);
-		if(dynarr_size(layer->data) < size)
+		if(dynarr_size(layer->data) < size && layer_write(layer, 0, 0) != NULL)
 			dynarr_grow(layer->data, size - 1, 1);
 	}
 	node->num_vertex = size;
 }
 
+/* Direct access to all of a layer's slots at once, for plug-ins that process whole layers. The slots
+ * are stored contiguously, one element of layer_element_size() bytes each, so this just hands out
+ * the layer's storage.
+*/
+const void * nodedb_g_layer_read_begin(const NodeGeometry *node, const NdbGLayer *layer, size_t *size)
+{
+	if(size != NULL)
+		*size = 0;
+	if(layer == NULL || layer->node != node || layer->data == NULL || dynarr_size(layer->data) == 0)
+		return NULL;
+	if(size != NULL)
+		*size = dynarr_size(layer->data);
+	return dynarr_index(layer->data, 0);
+}
+
+void nodedb_g_layer_read_end(UNUSED(const NodeGeometry *node), UNUSED(const NdbGLayer *layer), UNUSED(const void *data))
+{
+	/* Nothing much to do, here. */
+}
+
+/* Writable access to the first <size> slots of a layer, growing it if needed. Slots added are defaulted. Only
+ * the base vertex layer can add vertices, other vertex layers are limited to the node's vertex count.
+*/
+void * nodedb_g_layer_access_begin(NodeGeometry *node, NdbGLayer *layer, size_t size)
+{
+	DynArr	*data;
+
+	if(layer == NULL || layer->node != node || size == 0)
+		return NULL;
+	if(VERTEX_LAYER(layer) && layer->id != 0 && size > node->num_vertex)
+		return NULL;
+	if((data = layer_write(layer, 0, size)) == NULL)
+		return NULL;
+	if(size > dynarr_size(data))
+	{
+		dynarr_grow(data, size - 1, 1);
+		if(dynarr_set(data, size - 1, NULL) == NULL)	/* Just extends the size, the slot is already defaulted. */
+			return NULL;
+	}
+	if(layer->id == 0 && size > node->num_vertex)
+		resize_vertex(node, size);
+	return dynarr_index(data, 0);
+}
+
+void nodedb_g_layer_access_end(UNUSED(NodeGeometry *node), UNUSED(NdbGLayer *layer), UNUSED(void *data))
+{
+	/* Nothing much to do, here. */
+}
+
 void nodedb_g_vertex_set_xyz(NdbGLayer *layer, uint32 vertex_id, real64 x, real64 y, real64 z)
 {
 	real64	*vtx;
@@ -398,9 +599,7 @@ void nodedb_g_vertex_set_xyz(NdbGLayer *layer, uint32 vertex_id, real64 x, real6
 		return;
 	if(layer->id != 0 && vertex_id >= layer->node->num_vertex)
 		return;
-	if(layer->data == NULL)
-		layer->data = dynarr_new(3 * sizeof *vtx, 16);	/* FIXME: Should care about defaults. */\
-	if((vtx = dynarr_set(layer->data, vertex_id, NULL)) != NULL)
+	if((vtx = dynarr_set(layer_write(layer, vertex_id, 1), vertex_id, NULL)) != NULL)
 	{
 		vtx[0] = x;
 		vtx[1] = y;
@@ -418,7 +617,7 @@ void nodedb_g_vertex_delete(NdbGLayer *layer, uint32 vertex_id)
 		return;
 	if(vertex_id < dynarr_size(layer->data))
 	{
-		real64	*vtx = dynarr_index(layer->data, vertex_id);
+		real64	*vtx = dynarr_index(layer_write(layer, vertex_id, 1), vertex_id);
 
 		if(vtx != NULL)
 			vtx[0] = vtx[1] = vtx[2] = V_REAL64_MAX;
@@ -445,7 +644,7 @@ void nodedb_g_vertex_set_uint32(NdbGLayer *layer, uint32 vertex_id, uint32 value
 {
 	if(layer == NULL)
 		return;
-	dynarr_set(layer->data, vertex_id, &value);
+	dynarr_set(layer_write(layer, vertex_id, 1), vertex_id, &value);
 }
 
 uint32 nodedb_g_vertex_get_uint32(const NdbGLayer *layer, uint32 vertex_id)
@@ -461,7 +660,7 @@ void nodedb_g_vertex_set_real(NdbGLayer *layer, uint32 vertex_id, real64 value)
 {
 	if(layer == NULL || layer->type != VN_G_LAYER_VERTEX_REAL)
 		return;
-	dynarr_set(layer->data, vertex_id, &value);
+	dynarr_set(layer_write(layer, vertex_id, 1), vertex_id, &value);
 }
 
 real64 nodedb_g_vertex_get_real(const NdbGLayer *layer, uint32 vertex_id)
@@ -541,9 +740,7 @@ static void cb_g_vertex_set_real64(UNUSED(void *user), VNodeID node_id, VLayerID
 	{\
 		t	*v;\
 		\
-		if(layer->data == NULL)\
-			layer->data = dynarr_new(4 * sizeof *v, 16);	/* FIXME: Should care about defaults. */\
-		if((v = dynarr_set(layer->data, polygon_id, NULL)) != NULL)\
+		if((v = dynarr_set(layer_write(layer, polygon_id, 1), polygon_id, NULL)) != NULL)\
 		{\
 			v[0] = v0;\
 			v[1] = v1;\
@@ -582,9 +779,7 @@ static void cb_g_vertex_set_real64(UNUSED(void *user), VNodeID node_id, VLayerID
 			return;\
 		if((layer = nodedb_g_layer_lookup_id(node, layer_id)) == NULL || layer->name[0] == '\0')\
 			return;\
-		if(layer->data == NULL)\
-			layer->data = dynarr_new(4 * sizeof *v, 16);	/* FIXME: Should care about defaults. */\
-		if((v = dynarr_set(layer->data, polygon_id, NULL)) != NULL)\
+		if((v = dynarr_set(layer_write(layer, polygon_id, 1), polygon_id, NULL)) != NULL)\
 		{\
 			v[0] = v0;\
 			v[1] = v1;\
@@ -610,7 +805,7 @@ static void cb_g_polygon_delete(UNUSED(void *user), VNodeID node_id, uint32 poly
 		return;
 	if(layer->data == NULL)
 		return;
-	if((p = dynarr_set(layer->data, polygon_id, NULL)) != NULL)
+	if((p = dynarr_set(layer_write(layer, polygon_id, 1), polygon_id, NULL)) != NULL)
 	{
 		p[0] = p[1] = p[2] = p[3] = ~0u;
 		NOTIFY(node, DATA);
@@ -621,11 +816,7 @@ static void cb_g_polygon_delete(UNUSED(void *user), VNodeID node_id, uint32 poly
 #define POLYGON_FACE(t)	\
 	void nodedb_g_polygon_set_face_ ##t(NdbGLayer *layer, uint32 polygon_id, t value)\
 	{\
-		t	*v;\
-		\
-		if(layer->data == NULL)\
-			layer->data = dynarr_new(sizeof *v, 16);	/* FIXME: Should care about defaults. */\
-		dynarr_set(layer->data, polygon_id, &value);\
+		dynarr_set(layer_write(layer, polygon_id, 1), polygon_id, &value);\
 	}\
 	\
 	t nodedb_g_polygon_get_face_ ##t(const NdbGLayer *layer, uint32 polygon_id)\
@@ -647,9 +838,7 @@ static void cb_g_polygon_delete(UNUSED(void *user), VNodeID node_id, uint32 poly
 			return;\
 		if((layer = nodedb_g_layer_lookup_id(node, layer_id)) == NULL || layer->name[0] == '\0')\
 			return;\
-		if(layer->data == NULL)\
-			layer->data = dynarr_new(sizeof *v, 16);	/* FIXME: Should care about defaults. */\
-		if((v = dynarr_set(layer->data, polygon_id, NULL)) != NULL)\
+		if((v = dynarr_set(layer_write(layer, polygon_id, 1), polygon_id, NULL)) != NULL)\
 		{\
 			*v = value;\
 			NOTIFY(node, DATA);\
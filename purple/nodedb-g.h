@@ -13,7 +13,7 @@ typedef struct
 	VLayerID	id;
 	char		name[16];
 	VNGLayerType	type;
-	DynArr		*data;
+	DynArr		*data;		/* Shared with copies of the node, until written. */
 	union {				/* Default element as used by the dynamic array. Simply repeats the def values as needed. */
 	real64		v_xyz[3];
 	uint32		v_uint32;
@@ -27,6 +27,7 @@ typedef struct
 	uint32		def_uint;		/* Default values as known by the Verse server. */
 	real64		def_real;
 	NodeGeometry	*node;
+	Dirty		dirty;		/* Slots that may differ from the synchronized version. */
 } NdbGLayer;
 
 typedef struct NdbGBone	NdbGBone;
@@ -60,6 +61,8 @@ extern void		nodedb_g_construct(NodeGeometry *n);
 extern void		nodedb_g_copy(NodeGeometry *n, const NodeGeometry *src);
 extern void		nodedb_g_set(NodeGeometry *n, const NodeGeometry *src);
 extern void		nodedb_g_destruct(NodeGeometry *n);
+extern size_t		nodedb_g_size(const NodeGeometry *n);
+extern NdbHash		nodedb_g_hash(const NodeGeometry *n, NdbHash h);
 
 extern unsigned int	nodedb_g_layer_num(const NodeGeometry *n);
 extern NdbGLayer *	nodedb_g_layer_nth(const NodeGeometry *n, unsigned int i);
@@ -67,6 +70,11 @@ extern NdbGLayer *	nodedb_g_layer_find(const NodeGeometry *n, const char *name);
 
 extern size_t		nodedb_g_layer_get_size(const NdbGLayer *layer);
 extern const char *	nodedb_g_layer_get_name(const NdbGLayer *layer);
+extern void		nodedb_g_layer_reserve(NdbGLayer *layer, size_t size);
+extern const void *	nodedb_g_layer_read_begin(const NodeGeometry *node, const NdbGLayer *layer, size_t *size);
+extern void		nodedb_g_layer_read_end(const NodeGeometry *node, const NdbGLayer *layer, const void *data);
+extern void *		nodedb_g_layer_access_begin(NodeGeometry *node, NdbGLayer *layer, size_t size);
+extern void		nodedb_g_layer_access_end(NodeGeometry *node, NdbGLayer *layer, void *data);
 
 extern NdbGLayer *	nodedb_g_layer_create(NodeGeometry *node, VLayerID layer_id, const char *name, VNGLayerType type, uint32 def_uint, real64 def_real);
 extern void		nodedb_g_layer_destroy(NodeGeometry *node, NdbGLayer *layer);
@@ -77,6 +85,7 @@ extern void		nodedb_g_vertex_set_selected(NodeGeometry *node, uint32 vertex_id,
 extern real64		nodedb_g_vertex_get_selected(const NodeGeometry *node, uint32 vertex_id);
 
 extern void		nodedb_g_vertex_set_xyz(NdbGLayer *layer, uint32 vertex_id, real64 x, real64 y, real64 z);
+extern void		nodedb_g_vertex_delete(NdbGLayer *layer, uint32 vertex_id);
 extern void		nodedb_g_vertex_get_xyz(const NdbGLayer *layer, uint32 vertex_id, real64 *x, real64 *y, real64 *z);
 extern void		nodedb_g_vertex_set_uint32(NdbGLayer *layer, uint32 vertex_id, uint32 value);
 extern uint32		nodedb_g_vertex_get_uint32(const NdbGLayer *layer, uint32 vertex_id);
@@ -15,6 +15,10 @@
 extern void	nodedb_internal_notify_mine_check(PNode *n, NodeNotifyEvent ev);
 extern void	nodedb_internal_notify_node_check(PNode *n, NodeNotifyEvent ev);
 
+/* Mix <size> bytes at <data> into running content hash <h>. Used by the nodedb_X_hash() functions. */
+extern NdbHash	nodedb_internal_hash(NdbHash h, const void *data, size_t size);
+#define	NODEDB_HASH(h, v)	nodedb_internal_hash((h), &(v), sizeof (v))
+
 #if defined __GNUC__
 #define	UNUSED(a)	__attribute__((unused)) a
 #else
@@ -136,6 +136,55 @@ void nodedb_o_destruct(NodeObject *n)
 	n->method_groups = NULL;
 }
 
+/* Hash transform, links and method declarations. */
+NdbHash nodedb_o_hash(const NodeObject *n, NdbHash h)
+{
+	const List		*iter;
+	const NdbOLinkLocal	*ll;
+	const NdbOLink		*link;
+	const NdbOMethodGroup	*g;
+	const NdbOMethod	*m;
+	unsigned int		i, j;
+	size_t			k;
+
+	h = NODEDB_HASH(h, n->pos);
+	h = NODEDB_HASH(h, n->rot);
+	h = NODEDB_HASH(h, n->scale);
+	h = NODEDB_HASH(h, n->light);
+	h = NODEDB_HASH(h, n->hidden);
+	for(iter = n->links_local; iter != NULL; iter = list_next(iter))
+	{
+		ll = list_data(iter);
+		h = NODEDB_HASH(h, ll->link);
+		h = nodedb_internal_hash(h, ll->label, strlen(ll->label));
+		h = NODEDB_HASH(h, ll->target_id);
+	}
+	for(i = 0; i < dynarr_size(n->links); i++)
+	{
+		if((link = dynarr_index(n->links, i)) == NULL || link->deleted)
+			continue;
+		h = NODEDB_HASH(h, link->link);
+		h = nodedb_internal_hash(h, link->label, strlen(link->label));
+		h = NODEDB_HASH(h, link->target_id);
+	}
+	for(i = 0; i < dynarr_size(n->method_groups); i++)
+	{
+		if((g = dynarr_index(n->method_groups, i)) == NULL || g->name[0] == '\0')
+			continue;
+		h = nodedb_internal_hash(h, g->name, strlen(g->name));
+		for(j = 0; j < dynarr_size(g->methods); j++)
+		{
+			if((m = dynarr_index(g->methods, j)) == NULL || m->name[0] == '\0')
+				continue;
+			h = nodedb_internal_hash(h, m->name, strlen(m->name));
+			h = nodedb_internal_hash(h, m->param_type, m->param_count * sizeof *m->param_type);
+			for(k = 0; k < m->param_count; k++)
+				h = nodedb_internal_hash(h, m->param_name[k], strlen(m->param_name[k]));
+		}
+	}
+	return h;
+}
+
 void nodedb_o_pos_set(NodeObject *n, const real64 *pos)
 {
 	if(n != NULL && pos != NULL)
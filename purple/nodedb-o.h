@@ -55,6 +55,7 @@ extern void		nodedb_o_construct(NodeObject *n);
 extern void		nodedb_o_copy(NodeObject *n, const NodeObject *src);
 extern void		nodedb_o_set(NodeObject *n, const NodeObject *src);
 extern void		nodedb_o_destruct(NodeObject *n);
+extern NdbHash		nodedb_o_hash(const NodeObject *n, NdbHash h);
 
 extern void		nodedb_o_pos_set(NodeObject *n, const real64 *pos);
 extern void		nodedb_o_pos_get(const NodeObject *n, real64 *pos);
@@ -38,6 +38,8 @@ static void cb_copy_buffer(void *d, const void *s, UNUSED(void *user))
 	strcpy(dst->name, src->name);
 	dst->text = textbuf_new(textbuf_length(src->text));
 	textbuf_insert(dst->text, 0, textbuf_text(src->text));
+	dirty_init(&dst->dirty, 0);	/* Nothing is known about what a new copy is in sync with. */
+	dst->sync_head = dst->sync_tail = 0;
 }
 
 void nodedb_t_copy(NodeText *n, const NodeText *src)
@@ -46,30 +48,105 @@ void nodedb_t_copy(NodeText *n, const NodeText *src)
 	n->buffers = dynarr_new_copy(src->buffers, cb_copy_buffer, NULL);
 }
 
+static NdbTBuffer * buffers_find(const DynArr *buffers, const char *name)
+{
+	unsigned int	i;
+	NdbTBuffer	*b;
+
+	for(i = 0; (b = dynarr_index(buffers, i)) != NULL; i++)
+	{
+		if(strcmp(b->name, name) == 0)
+			return b;
+	}
+	return NULL;
+}
+
+static void buffers_destroy(DynArr *buffers)
+{
+	unsigned int	i, num;
+	NdbTBuffer	*b;
+
+	num = dynarr_size(buffers);
+	for(i = 0; i < num; i++)
+	{
+		if((b = dynarr_index(buffers, i)) == NULL)
+			continue;
+		dirty_free(&b->dirty);
+		if(b->name[0] != '\0')
+		{
+			printf("destroying buffer %u\n", i);
+			textbuf_destroy(b->text);
+		}
+	}
+	dynarr_destroy(buffers);
+}
+
+/* Set <n> to equal <src>. Buffers that were in <n> before, and whose text didn't change, keep their
+ * dirty state, so the synchronizer needn't compare them.
+*/
 void nodedb_t_set(NodeText *n, const NodeText *src)
 {
+	DynArr		*old = n->buffers;
+	unsigned int	i;
+	NdbTBuffer	*b, *ob;
+
 	/* FIXME: This could be quicker. */
-	nodedb_t_destruct(n);
+	n->buffers = NULL;
 	nodedb_t_copy(n, src);
+	for(i = 0; (b = dynarr_index(n->buffers, i)) != NULL; i++)
+	{
+		if(b->name[0] == '\0' || (ob = buffers_find(old, b->name)) == NULL)
+			continue;
+		if(ob->text != NULL && textbuf_length(b->text) == textbuf_length(ob->text) && strcmp(textbuf_text(b->text), textbuf_text(ob->text)) == 0)
+		{
+			dirty_clear(&b->dirty);
+			dirty_merge(&b->dirty, &ob->dirty);
+			b->sync_head = ob->sync_head;
+			b->sync_tail = ob->sync_tail;
+		}
+	}
+	if(old != NULL)
+		buffers_destroy(old);
 }
 
 void nodedb_t_destruct(NodeText *n)
+{
+	if(n->buffers != NULL)
+		buffers_destroy(n->buffers);
+	n->buffers = NULL;
+}
+
+/* Number of bytes of text held in buffers. */
+size_t nodedb_t_size(const NodeText *n)
 {
 	unsigned int	i, num;
+	const NdbTBuffer *b;
+	size_t		size = 0;
 
 	num = dynarr_size(n->buffers);
 	for(i = 0; i < num; i++)
 	{
-		NdbTBuffer	*b;
-
 		if((b = dynarr_index(n->buffers, i)) != NULL && b->name[0] != '\0')
-		{
-			printf("destroying buffer %u\n", i);
-			textbuf_destroy(b->text);
-		}
+			size += textbuf_length(b->text);
 	}
-	dynarr_destroy(n->buffers);
-	n->buffers = NULL;
+	return size;
+}
+
+NdbHash nodedb_t_hash(const NodeText *n, NdbHash h)
+{
+	unsigned int	i, num;
+	const NdbTBuffer *b;
+
+	h = nodedb_internal_hash(h, n->language, strlen(n->language));
+	num = dynarr_size(n->buffers);
+	for(i = 0; i < num; i++)
+	{
+		if((b = dynarr_index(n->buffers, i)) == NULL || b->name[0] == '\0')
+			continue;
+		h = nodedb_internal_hash(h, b->name, strlen(b->name));
+		h = nodedb_internal_hash(h, textbuf_text(b->text), textbuf_length(b->text));
+	}
+	return h;
 }
 
 const char * nodedb_t_language_get(const NodeText *node)
@@ -122,17 +199,9 @@ NdbTBuffer * nodedb_t_buffer_nth(const NodeText *node, unsigned int n)
 
 NdbTBuffer * nodedb_t_buffer_find(const NodeText *node, const char *name)
 {
-	unsigned int	i;
-	NdbTBuffer	*b;
-
 	if(node == NULL || name == NULL || *name == '\0')
 		return NULL;
-	for(i = 0; (b = dynarr_index(node->buffers, i)) != NULL; i++)
-	{
-		if(strcmp(b->name, name) == 0)
-			return b;
-	}
-	return NULL;
+	return buffers_find(node->buffers, name);
 }
 
 static void cb_def_buffer(UNUSED(unsigned int index), void *element, UNUSED(void *user))
@@ -141,6 +210,8 @@ static void cb_def_buffer(UNUSED(unsigned int index), void *element, UNUSED(void
 
 	buffer->name[0] = '\0';
 	buffer->text = NULL;
+	dirty_init(&buffer->dirty, 0);
+	buffer->sync_head = buffer->sync_tail = 0;
 }
 
 NdbTBuffer * nodedb_t_buffer_create(NodeText *node, VLayerID buffer_id, const char *name)
@@ -174,6 +245,9 @@ NdbTBuffer * nodedb_t_buffer_create(NodeText *node, VLayerID buffer_id, const ch
 	buffer->id = buffer_id;
 	stu_strncpy(buffer->name, sizeof buffer->name, name);
 	buffer->text = NULL;
+	dirty_free(&buffer->dirty);
+	dirty_init(&buffer->dirty, 0);
+	buffer->sync_head = buffer->sync_tail = 0;
 
 	return buffer;
 }
@@ -189,6 +263,7 @@ void nodedb_t_buffer_destroy(NodeText *node, NdbTBuffer *buffer)
 		textbuf_destroy(buffer->text);
 		buffer->text = NULL;
 	}
+	dirty_free(&buffer->dirty);
 }
 
 const char * nodedb_t_buffer_read_begin(NdbTBuffer *buffer)
@@ -248,13 +323,29 @@ char * nodedb_t_buffer_read_line(NdbTBuffer *buffer, unsigned int line, char *pu
 	return NULL;
 }
 
+/* Shrink the window of text known to be unchanged since the last sync, to leave out an edit at <pos>
+ * that has <after> of the old characters following it.
+*/
+static void sync_window_edit(NdbTBuffer *buffer, size_t pos, size_t after)
+{
+	if(pos < buffer->sync_head)
+		buffer->sync_head = pos;
+	if(after < buffer->sync_tail)
+		buffer->sync_tail = after;
+}
+
 void nodedb_t_buffer_insert(NdbTBuffer *buffer, size_t pos, const char *text)
 {
+	size_t	len;
+
 	if(buffer != NULL)
 	{
 		if(buffer->text == NULL)
 			buffer->text = textbuf_new(1024);
+		len = textbuf_length(buffer->text);
 		textbuf_insert(buffer->text, pos, text);
+		dirty_mark(&buffer->dirty, 0, 1);
+		sync_window_edit(buffer, pos, pos < len ? len - pos : 0);
 	}
 }
 
@@ -268,13 +359,23 @@ void nodedb_t_buffer_append(NdbTBuffer *buffer, const char *text)
 void nodedb_t_buffer_delete(NdbTBuffer *buffer, size_t pos, size_t length)
 {
 	if(buffer != NULL)
+	{
+		size_t	len = textbuf_length(buffer->text);
+
 		textbuf_delete(buffer->text, pos, length);
+		dirty_mark(&buffer->dirty, 0, 1);
+		sync_window_edit(buffer, pos, pos + length < len ? len - pos - length : 0);
+	}
 }
 
 void nodedb_t_buffer_clear(NdbTBuffer *buffer)
 {
 	if(buffer != NULL)
+	{
 		textbuf_truncate(buffer->text, 0);
+		dirty_mark(&buffer->dirty, 0, 1);
+		buffer->sync_head = buffer->sync_tail = 0;
+	}
 }
 
 /* ----------------------------------------------------------------------------------------- */
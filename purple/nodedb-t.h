@@ -13,6 +13,9 @@ typedef struct
 	uint16	id;
 	char	name[16];
 	TextBuf	*text;
+	Dirty	dirty;		/* A single slot, dirty if the text may differ from the synchronized version. */
+	size_t	sync_head;	/* Characters at the start that are unchanged since the text was last in sync. */
+	size_t	sync_tail;	/* The same, at the end. */
 } NdbTBuffer;
 
 typedef struct
@@ -26,6 +29,8 @@ extern void		nodedb_t_construct(NodeText *n);
 extern void		nodedb_t_copy(NodeText *n, const NodeText *src);
 extern void		nodedb_t_set(NodeText *n, const NodeText *src);
 extern void		nodedb_t_destruct(NodeText *n);
+extern size_t		nodedb_t_size(const NodeText *n);
+extern NdbHash		nodedb_t_hash(const NodeText *n, NdbHash h);
 
 extern const char *	nodedb_t_language_get(const NodeText *node);
 extern void		nodedb_t_language_set(NodeText *node, const char *language);
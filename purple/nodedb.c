@@ -9,6 +9,7 @@
 */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "verse.h"
@@ -35,12 +36,23 @@ typedef struct
 	void	*user;
 } NotifyInfo;
 
+/* Entry in the name index. Lists all known nodes with a given name, in increasing ID order. */
+typedef struct
+{
+	List	*nodes;
+	char	name[1];	/* Over-allocated to hold the entire name. */
+} NameEntry;
+
 static struct
 {
 	VNodeID		avatar;
 	MemChunk	*chunk_node[V_NT_NUM_TYPES];
 	Hash		*nodes;				/* Probably not efficient enough, but a start. */
 	Hash		*nodes_mine;			/* Duplicate links to nodes owned by this client. */
+	Hash		*names;				/* Name index, holds NameEntrys for nodes in the above. */
+	NameEntry	**sorted;			/* The same entries sorted on name, for prefix lookups. */
+	size_t		sorted_size, sorted_alloc;
+	boolean		sorted_stale;			/* Set when names come and go, sorting is lazy. */
 
 	List		*notify_mine;
 	MemChunk	*chunk_notify;			/* For allocating NotifyInfos. */
@@ -48,9 +60,56 @@ static struct
 
 /* ----------------------------------------------------------------------------------------- */
 
+static int cmp_node_id(const void *data1, const void *data2)
+{
+	const PNode	*n1 = data1, *n2 = data2;
+
+	return n1->id < n2->id ? -1 : n1->id > n2->id;
+}
+
+/* Add <n> to the name index, under its current name. Nameless nodes are not indexed. */
+static void name_index_add(PNode *n)
+{
+	NameEntry	*e;
+
+	if(n->name[0] == '\0')
+		return;
+	if((e = hash_lookup(nodedb_info.names, n->name)) == NULL)
+	{
+		if((e = mem_alloc(sizeof *e + strlen(n->name))) == NULL)
+			return;
+		strcpy(e->name, n->name);
+		e->nodes = NULL;
+		hash_insert(nodedb_info.names, e->name, e);
+		nodedb_info.sorted_stale = TRUE;
+	}
+	e->nodes = list_insert_sorted(e->nodes, n, cmp_node_id);
+}
+
+static void name_index_remove(PNode *n)
+{
+	NameEntry	*e;
+
+	if((e = hash_lookup(nodedb_info.names, n->name)) == NULL)
+		return;
+	if((e->nodes = list_remove(e->nodes, n)) == NULL)
+	{
+		hash_remove(nodedb_info.names, e->name);
+		mem_free(e);
+		nodedb_info.sorted_stale = TRUE;
+	}
+}
+
+/* Nodes are in the name index if they're in the database proper, i.e. not local copies. */
+static boolean name_indexed(const PNode *n)
+{
+	return n->id != ~0U && nodedb_lookup(n->id) == n;
+}
+
 void nodedb_register(PNode *n)
 {
 	hash_insert(nodedb_info.nodes, (void *) n->id, n);
+	name_index_add(n);
 }
 
 PNode * nodedb_lookup(VNodeID node_id)
@@ -67,22 +126,13 @@ PNode * nodedb_lookup_with_type(VNodeID node_id, VNodeType type)
 	return NULL;
 }
 
-static int cb_lookup_name(void *data, void *user)
-{
-	if(strcmp(((const PNode *) data)->name, ((void **) user)[0]) == 0)
-	{
-		((void **) user)[1] = (void *) data;
-		return 0;
-	}
-	return 1;
-}
-
 PNode * nodedb_lookup_by_name(const char *name)
 {
-	void	*data[2] = { (void *) name, NULL };	/* I'm too lazy for a struct. */
-	/* FIXME: This is completely inefficent. */
-	hash_foreach(nodedb_info.nodes, cb_lookup_name, data);
-	return data[1];
+	const NameEntry	*e;
+
+	if(name == NULL || (e = hash_lookup(nodedb_info.names, name)) == NULL)
+		return NULL;
+	return list_data(e->nodes);		/* Lowest ID wins, if the name is not unique. */
 }
 
 PNode * nodedb_lookup_by_name_with_type(const char *name, VNodeType type)
@@ -94,6 +144,101 @@ PNode * nodedb_lookup_by_name_with_type(const char *name, VNodeType type)
 	return NULL;
 }
 
+static int cb_sorted_append(void *data, UNUSED(void *user))
+{
+	nodedb_info.sorted[nodedb_info.sorted_size++] = data;
+	return 1;
+}
+
+static int cmp_name_entry(const void *p1, const void *p2)
+{
+	return strcmp((*(const NameEntry **) p1)->name, (*(const NameEntry **) p2)->name);
+}
+
+/* Bring the sorted array of names up to date, if names have been added or removed. */
+static void sorted_refresh(void)
+{
+	size_t	num = hash_size(nodedb_info.names);
+
+	if(!nodedb_info.sorted_stale)
+		return;
+	if(num > nodedb_info.sorted_alloc)
+	{
+		NameEntry	**ns;
+
+		if((ns = mem_realloc(nodedb_info.sorted, num * sizeof *ns)) == NULL)
+			return;
+		nodedb_info.sorted = ns;
+		nodedb_info.sorted_alloc = num;
+	}
+	nodedb_info.sorted_size = 0;
+	hash_foreach(nodedb_info.names, cb_sorted_append, NULL);
+	qsort(nodedb_info.sorted, nodedb_info.sorted_size, sizeof *nodedb_info.sorted, cmp_name_entry);
+	nodedb_info.sorted_stale = FALSE;
+}
+
+/* Match <name> against glob <pattern>, where '*' matches any run of characters and '?' any one. */
+static boolean glob_match(const char *pattern, const char *name)
+{
+	const char	*star = NULL, *resume = NULL;
+
+	while(*name != '\0')
+	{
+		if(*pattern == '*')
+		{
+			star = ++pattern;
+			resume = name;
+		}
+		else if(*pattern == '?' || *pattern == *name)
+		{
+			pattern++;
+			name++;
+		}
+		else if(star != NULL)		/* Let the last star eat one more character, and retry. */
+		{
+			pattern = star;
+			name = ++resume;
+		}
+		else
+			return FALSE;
+	}
+	while(*pattern == '*')
+		pattern++;
+	return *pattern == '\0';
+}
+
+unsigned int nodedb_lookup_by_name_glob(const char *pattern, int (*func)(PNode *node, void *user), void *user)
+{
+	size_t		lo, hi, mid, plen;
+	const List	*iter;
+	unsigned int	count = 0;
+
+	if(pattern == NULL || func == NULL)
+		return 0;
+	sorted_refresh();
+	plen = strcspn(pattern, "*?");		/* Only names starting with the literal prefix can match. */
+	for(lo = 0, hi = nodedb_info.sorted_size; lo < hi;)
+	{
+		mid = (lo + hi) / 2;
+		if(strncmp(nodedb_info.sorted[mid]->name, pattern, plen) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	for(; lo < nodedb_info.sorted_size && strncmp(nodedb_info.sorted[lo]->name, pattern, plen) == 0; lo++)
+	{
+		if(!glob_match(pattern + plen, nodedb_info.sorted[lo]->name + plen))
+			continue;
+		for(iter = nodedb_info.sorted[lo]->nodes; iter != NULL; iter = list_next(iter))
+		{
+			count++;
+			if(!func(list_data(iter), user))
+				return count;
+		}
+	}
+	return count;
+}
+
 NodeObject * nodedb_lookup_object(VNodeID node_id)
 {
 	PNode	*n;
@@ -321,6 +466,20 @@ PNode * nodedb_set(PNode *dst, const PNode *src)
 	return dst;
 }
 
+static void tag_groups_destroy(DynArr *groups)
+{
+	unsigned int	i, num;
+	NdbTagGroup	*tg;
+
+	num = dynarr_size(groups);
+	for(i = 0; i < num; i++)
+	{
+		if((tg = dynarr_index(groups, i)) != NULL && tg->name[0] != '\0')
+			dynarr_destroy(tg->tags);
+	}
+	dynarr_destroy(groups);
+}
+
 void nodedb_destroy(PNode *n)
 {
 	MemChunk	*ch;
@@ -330,8 +489,6 @@ void nodedb_destroy(PNode *n)
 
 	if((ch = nodedb_info.chunk_node[n->type]) != NULL)
 	{
-		unsigned int	i, num;
-
 		switch(n->type)
 		{
 		case V_NT_BITMAP:
@@ -352,17 +509,116 @@ void nodedb_destroy(PNode *n)
 		default:
 			LOG_WARN(("Node destruction not implemented for type %d\n", n->type));
 		}
-		num = dynarr_size(n->tag_groups);
-		for(i = 0; i < num; i++)
-		{
-			NdbTagGroup	*tg;
+		tag_groups_destroy(n->tag_groups);
+		memchunk_free(ch, n);
+	}
+}
+
+size_t nodedb_size(const PNode *n)
+{
+	size_t	size;
+
+	if(n == NULL)
+		return 0;
+	size = memchunk_chunk_size(nodedb_info.chunk_node[n->type]);
+	switch(n->type)
+	{
+	case V_NT_BITMAP:
+		return size + nodedb_b_size((const NodeBitmap *) n);
+	case V_NT_GEOMETRY:
+		return size + nodedb_g_size((const NodeGeometry *) n);
+	case V_NT_TEXT:
+		return size + nodedb_t_size((const NodeText *) n);
+	default:
+		return size;
+	}
+}
 
-			if((tg = dynarr_index(n->tag_groups, i)) != NULL && tg->name[0] != '\0')
-				dynarr_destroy(tg->tags);
+NdbHash nodedb_internal_hash(NdbHash h, const void *data, size_t size)
+{
+	const unsigned char	*p = data;
+
+	for(; size > 0; size--)		/* FNV-1a, 64-bit. */
+		h = (h ^ *p++) * NDB_HASH_CONST(1099511628211);
+	return h;
+}
+
+/* Hash tag values by type, since the VNTag union is only partly used. Blobs and strings by content. */
+static NdbHash tag_hash(NdbHash h, const NdbTag *tag)
+{
+	h = nodedb_internal_hash(h, tag->name, strlen(tag->name));
+	h = NODEDB_HASH(h, tag->type);
+	switch(tag->type)
+	{
+	case VN_TAG_BOOLEAN:
+		return NODEDB_HASH(h, tag->value.vboolean);
+	case VN_TAG_UINT32:
+		return NODEDB_HASH(h, tag->value.vuint32);
+	case VN_TAG_REAL64:
+		return NODEDB_HASH(h, tag->value.vreal64);
+	case VN_TAG_STRING:
+		if(tag->value.vstring != NULL)
+			h = nodedb_internal_hash(h, tag->value.vstring, strlen(tag->value.vstring));
+		return h;
+	case VN_TAG_REAL64_VEC3:
+		return NODEDB_HASH(h, tag->value.vreal64_vec3);
+	case VN_TAG_LINK:
+		return NODEDB_HASH(h, tag->value.vlink);
+	case VN_TAG_ANIMATION:
+		return NODEDB_HASH(h, tag->value.vanimation);
+	case VN_TAG_BLOB:
+		if(tag->value.vblob.blob != NULL)
+			h = nodedb_internal_hash(h, tag->value.vblob.blob, tag->value.vblob.size);
+		return h;
+	default:
+		return h;
+	}
+}
+
+boolean nodedb_hash(const PNode *n, NdbHash *hash)
+{
+	NdbHash			h = NDB_HASH_INIT;
+	unsigned int		i, j;
+	const NdbTagGroup	*tg;
+	const NdbTag		*tag;
+
+	if(n == NULL || hash == NULL)
+		return FALSE;
+	h = NODEDB_HASH(h, n->type);
+	h = nodedb_internal_hash(h, n->name, strlen(n->name));
+	for(i = 0; i < dynarr_size(n->tag_groups); i++)
+	{
+		if((tg = dynarr_index(n->tag_groups, i)) == NULL || tg->name[0] == '\0')
+			continue;
+		h = nodedb_internal_hash(h, tg->name, strlen(tg->name));
+		for(j = 0; j < dynarr_size(tg->tags); j++)
+		{
+			if((tag = dynarr_index(tg->tags, j)) != NULL && tag->name[0] != '\0')
+				h = tag_hash(h, tag);
 		}
-		dynarr_destroy(n->tag_groups);
-		memchunk_free(ch, n);
 	}
+	switch(n->type)
+	{
+	case V_NT_BITMAP:
+		h = nodedb_b_hash((const NodeBitmap *) n, h);
+		break;
+	case V_NT_CURVE:
+		h = nodedb_c_hash((const NodeCurve *) n, h);
+		break;
+	case V_NT_GEOMETRY:
+		h = nodedb_g_hash((const NodeGeometry *) n, h);
+		break;
+	case V_NT_OBJECT:
+		h = nodedb_o_hash((const NodeObject *) n, h);
+		break;
+	case V_NT_TEXT:
+		h = nodedb_t_hash((const NodeText *) n, h);
+		break;
+	default:
+		return FALSE;
+	}
+	*hash = h;
+	return TRUE;
 }
 
 /* ----------------------------------------------------------------------------------------- */
@@ -393,9 +649,15 @@ int nodedb_unref(PNode *node)
 
 void nodedb_rename(PNode *node, const char *name)
 {
+	boolean	indexed;
+
 	if(node == NULL || name == NULL)
 		return;
+	if((indexed = name_indexed(node)))
+		name_index_remove(node);
 	stu_strncpy(node->name, sizeof node->name, name);
+	if(indexed)
+		name_index_add(node);
 }
 
 VNodeType nodedb_type_get(const PNode *node)
@@ -500,6 +762,14 @@ void nodedb_tag_group_destroy(NdbTagGroup *group)
 	group->id = -1;
 }
 
+void nodedb_tag_groups_set(PNode *dst, const PNode *src)
+{
+	if(dst == NULL || src == NULL || dst == src)
+		return;
+	tag_groups_destroy(dst->tag_groups);
+	dst->tag_groups = dynarr_new_copy(src->tag_groups, cb_copy_tag_group, NULL);
+}
+
 static void cb_default_tag(UNUSED(unsigned int index), void *element, UNUSED(void *user))
 {
 	NdbTag	*tag = element;
@@ -724,7 +994,7 @@ static void cb_node_name_set(UNUSED(void *user), VNodeID node_id, const char *na
 
 	if((n = nodedb_lookup(node_id)) != NULL)
 	{
-		stu_strncpy(n->name, sizeof n->name, name);
+		nodedb_rename(n, name);
 		LOG_MSG(("Name of %u set to \"%s\"", n->id, n->name));
 		NOTIFY(n, NAME);
 	}
@@ -799,16 +1069,6 @@ static void cb_tag_destroy(UNUSED(void *user), VNodeID node_id, uint16 group_id,
 
 /* ----------------------------------------------------------------------------------------- */
 
-static unsigned int node_hash(const void *p)
-{
-	return (unsigned int) p;
-}
-
-static int node_key_eq(const void *key1, const void *key2)
-{
-	return key1 == key2;
-}
-
 void nodedb_register_callbacks(VNodeID avatar, uint32 mask)
 {
 	unsigned int	i;
@@ -825,8 +1085,9 @@ void nodedb_register_callbacks(VNodeID avatar, uint32 mask)
 	nodedb_info.chunk_node[V_NT_CURVE]    = memchunk_new("chunk-node-curve",    sizeof (NodeCurve), 16);
 	nodedb_info.chunk_node[V_NT_AUDIO]    = memchunk_new("chunk-node-audio",    sizeof (NodeAudio), 16);
 
-	nodedb_info.nodes      = hash_new(node_hash, node_key_eq);
-	nodedb_info.nodes_mine = hash_new(node_hash, node_key_eq);
+	nodedb_info.nodes      = hash_new_int();
+	nodedb_info.nodes_mine = hash_new_int();
+	nodedb_info.names      = hash_new_string();
 
 	nodedb_info.chunk_notify = memchunk_new("chunk-node-notify", sizeof (NotifyInfo), 16);
 
@@ -6,6 +6,7 @@
  * 
 */
 
+#include "dirty.h"
 #include "dynarr.h"
 #include "idtree.h"
 #include "list.h"
@@ -26,6 +27,18 @@ typedef struct
 	DynArr		*tags;
 } NdbTagGroup;
 
+/* Content hash of a node, see nodedb_hash(). It's 64 bits wide, so that two different contents
+ * hashing the same needn't be worried about.
+*/
+#if defined _MSC_VER
+typedef unsigned __int64	NdbHash;
+#define	NDB_HASH_CONST(c)	c ## ui64
+#else
+typedef unsigned long long	NdbHash;
+#define	NDB_HASH_CONST(c)	c ## ull
+#endif
+#define	NDB_HASH_INIT		NDB_HASH_CONST(14695981039346656037)	/* Starting value, FNV-1a's offset basis. */
+
 /* This is typedef:ed to PNode in the public purple.h header. */
 struct PNode
 {
@@ -48,6 +61,7 @@ struct PNode
 	/* Information owned by the synchronizer. Could live in there, but this is easier for now. */
 	struct {
 	unsigned int	busy : 1;	/* Is this node currently being synchronized? */
+	unsigned int	age;		/* Number of updates passed over for lack of budget. */
 	TimeVal		last_send;
 	}		sync;
 };
@@ -63,9 +77,18 @@ struct PNode
 extern void		nodedb_register_callbacks(VNodeID avatar, uint32 mask);
 
 extern PNode *		nodedb_lookup(VNodeID node_id);
+/* Look up a node by name, through an index. If several nodes share the name, the one with the
+ * lowest ID is returned, so the answer doesn't depend on the order nodes were created in.
+*/
 extern PNode *		nodedb_lookup_by_name(const char *name);
 extern PNode *		nodedb_lookup_with_type(VNodeID node_id, VNodeType type);
 extern PNode *		nodedb_lookup_by_name_with_type(const char *name, VNodeType type);
+/* Call <func> with each node whose name matches glob <pattern>, in which '*' matches any run of
+ * characters and '?' any single one. Names are visited in sorted order, nodes with the same name
+ * in increasing ID order. A pattern with a literal prefix only visits names with that prefix, so
+ * e.g. "box*" is cheap. Stops if <func> returns 0. Returns the number of nodes visited.
+*/
+extern unsigned int	nodedb_lookup_by_name_glob(const char *pattern, int (*func)(PNode *node, void *user), void *user);
 extern NodeObject *	nodedb_lookup_object(VNodeID node_id);
 extern NodeText *	nodedb_lookup_text(VNodeID node_id);
 
@@ -74,6 +97,16 @@ extern PNode *		nodedb_new_copy(const PNode *src);
 extern PNode *		nodedb_set(PNode *dst, const PNode *src);
 extern void		nodedb_destroy(PNode *n);
 
+/* Approximate number of bytes of memory used by a node, for cache size accounting. */
+extern size_t		nodedb_size(const PNode *n);
+
+/* Hash a node's name, tags and contents, to detect when it has really changed. Returns FALSE for
+ * node types that can't be hashed (audio and material, for now), which must be assumed changed.
+ * Parts of the hash are remembered in the node, possibly in data shared with copies of it, so
+ * this must only be called on the main thread, while no workers run.
+*/
+extern boolean		nodedb_hash(const PNode *n, NdbHash *hash);
+
 /* Nodes are reference counted. Users are supposed to call nodedb_new(), then immediately ref() the
  * created node on success (initial count is zero). Calling unref() will decrease count by one, and
  * automatically destroy the node if it went below one.
@@ -93,6 +126,8 @@ extern NdbTagGroup *	nodedb_tag_group_find(const PNode *node, const char *name);
 extern NdbTagGroup *	nodedb_tag_group_create(PNode *node, uint16 group_id, const char *name);
 extern NdbTagGroup *	nodedb_tag_group_lookup(const PNode *node, const char *name);
 extern void		nodedb_tag_group_destroy(NdbTagGroup *group);
+/* Replace all of <dst>'s tag groups with copies of <src>'s. */
+extern void		nodedb_tag_groups_set(PNode *dst, const PNode *src);
 
 extern unsigned int	nodedb_tag_group_tag_num(const NdbTagGroup *group);
 extern NdbTag *		nodedb_tag_group_tag_nth(const NdbTagGroup *group, unsigned int n);
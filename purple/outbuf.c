@@ -0,0 +1,347 @@
+/*
+ * outbuf.c
+ * 
+ * Copyright (C) 2004 PDC, KTH. See COPYING for license details.
+ * 
+ * Outgoing command buffer. Commands are kept on a list in the order they were given, and the
+ * most recent one for each geometry slot and text buffer is found through a hash. A slot set
+ * overwrites an earlier set of the same slot in place, since nothing that came in between can
+ * depend on it. Superseded commands that can't be overwritten are marked dead, and skipped on
+ * flush. Text edits are only ever merged into the last edit of the same buffer, which keeps
+ * positions valid.
+*/
+
+#include <string.h>
+
+#include "verse.h"
+
+#include "hash.h"
+#include "mem.h"
+#include "memchunk.h"
+
+#include "outbuf.h"
+
+/* ----------------------------------------------------------------------------------------- */
+
+typedef enum
+{
+	OUT_G_SLOT,
+	OUT_G_POLYGON_DELETE,
+	OUT_T_TEXT_SET
+} OutType;
+
+typedef struct OutCmd	OutCmd;
+
+struct OutCmd
+{
+	OutType		type;
+	VNodeID		node;
+	uint16		layer;		/* Geometry layer, or text buffer. */
+	uint32		index;		/* Geometry slot, always zero for text; edits are keyed on the buffer. */
+	int		dead;		/* Cancelled out by a later command, don't send. */
+	union
+	{
+	struct
+	{
+	VNGLayerType	type;
+	real64		data[4];	/* Room for the largest slot, four real64 corners. */
+	}		slot;
+	struct
+	{
+	uint32		pos, length;
+	char		*text;		/* Nul-terminated, or NULL if nothing is inserted. */
+	size_t		text_length;
+	}		text;
+	}		u;
+	OutCmd		*next;
+};
+
+static struct
+{
+	MemChunk	*chunk;
+	Hash		*latest;	/* Most recent command per slot or text buffer. */
+	OutCmd		*head, *tail;
+	unsigned long	queued;		/* Since the last flush. */
+	OutbufStats	stats;
+} outbuf_info;
+
+/* ----------------------------------------------------------------------------------------- */
+
+static unsigned int cmd_hash(const void *key)
+{
+	const OutCmd	*c = key;
+
+	return c->node * 2654435761u + c->layer * 40503u + c->index;
+}
+
+static int cmd_key_eq(const void *key1, const void *key2)
+{
+	const OutCmd	*c1 = key1, *c2 = key2;
+
+	return c1->node == c2->node && c1->layer == c2->layer && c1->index == c2->index &&
+		(c1->type == OUT_T_TEXT_SET) == (c2->type == OUT_T_TEXT_SET);
+}
+
+void outbuf_init(void)
+{
+	outbuf_info.chunk  = memchunk_new("outbuf/cmd", sizeof (OutCmd), 64);
+	outbuf_info.latest = hash_new(cmd_hash, cmd_key_eq);
+}
+
+/* Return the most recent command with the same key as the given one, or NULL. */
+static OutCmd * cmd_latest(OutType type, VNodeID node, uint16 layer, uint32 index)
+{
+	OutCmd	probe;
+
+	probe.type  = type;
+	probe.node  = node;
+	probe.layer = layer;
+	probe.index = index;
+	return hash_lookup(outbuf_info.latest, &probe);
+}
+
+/* Append a new command to the list, and make it the latest for its key. */
+static OutCmd * cmd_append(OutType type, VNodeID node, uint16 layer, uint32 index)
+{
+	OutCmd	*c;
+
+	if((c = memchunk_alloc(outbuf_info.chunk)) == NULL)
+		return NULL;
+	c->type  = type;
+	c->node  = node;
+	c->layer = layer;
+	c->index = index;
+	c->dead  = 0;
+	c->next  = NULL;
+	if(outbuf_info.tail != NULL)
+		outbuf_info.tail->next = c;
+	else
+		outbuf_info.head = c;
+	outbuf_info.tail = c;
+	hash_insert(outbuf_info.latest, c, c);
+	return c;
+}
+
+static size_t slot_size(VNGLayerType type)
+{
+	switch(type)
+	{
+	case VN_G_LAYER_VERTEX_XYZ:
+		return 3 * sizeof (real64);
+	case VN_G_LAYER_VERTEX_UINT32:
+	case VN_G_LAYER_POLYGON_FACE_UINT32:
+		return sizeof (uint32);
+	case VN_G_LAYER_VERTEX_REAL:
+	case VN_G_LAYER_POLYGON_FACE_REAL:
+		return sizeof (real64);
+	case VN_G_LAYER_POLYGON_CORNER_UINT32:
+		return 4 * sizeof (uint32);
+	case VN_G_LAYER_POLYGON_CORNER_REAL:
+		return 4 * sizeof (real64);
+	case VN_G_LAYER_POLYGON_FACE_UINT8:
+		return sizeof (uint8);
+	}
+	return 0;
+}
+
+void outbuf_g_slot_set(VNodeID node, VLayerID layer, VNGLayerType type, uint32 index, const void *data)
+{
+	OutCmd	*c;
+
+	outbuf_info.queued++;
+	if((c = cmd_latest(OUT_G_SLOT, node, layer, index)) == NULL || c->type != OUT_G_SLOT)
+	{
+		if((c = cmd_append(OUT_G_SLOT, node, layer, index)) == NULL)
+			return;
+	}
+	c->u.slot.type = type;
+	memcpy(c->u.slot.data, data, slot_size(type));
+}
+
+void outbuf_g_polygon_delete(VNodeID node, uint32 index)
+{
+	OutCmd	*c;
+
+	outbuf_info.queued++;
+	/* Polygons live in layer 1. An earlier set of this one would just be deleted again, but the
+	 * delete must still come after whatever was sent to its other layers in between.
+	*/
+	if((c = cmd_latest(OUT_G_SLOT, node, 1, index)) != NULL && c->type == OUT_G_SLOT)
+		c->dead = 1;
+	cmd_append(OUT_G_POLYGON_DELETE, node, 1, index);
+}
+
+/* Try to merge an edit into <last>, the previous one for the same buffer. Returns the number of
+ * characters of <text> merged, or <text_length> + 1 if the edit was merged completely.
+*/
+static size_t text_merge(OutCmd *last, uint32 pos, uint32 length, const char *text, size_t text_length)
+{
+	size_t	take;
+	char	*nt;
+
+	if(last->dead)
+		return 0;
+	if(length == 0 && text_length > 0 && pos == last->u.text.pos + last->u.text.text_length &&
+	   last->u.text.text_length < OUTBUF_TEXT_MAX)	/* Insert right after the last one's text. */
+	{
+		take = text_length;
+		if(last->u.text.text_length + take > OUTBUF_TEXT_MAX)
+			take = OUTBUF_TEXT_MAX - last->u.text.text_length;
+		if((nt = mem_realloc(last->u.text.text, last->u.text.text_length + take + 1)) == NULL)
+			return 0;
+		memcpy(nt + last->u.text.text_length, text, take);
+		last->u.text.text_length += take;
+		nt[last->u.text.text_length] = '\0';
+		last->u.text.text = nt;
+		return take < text_length ? take : text_length + 1;
+	}
+	if(text_length == 0 && last->u.text.text_length == 0 &&
+	   (pos == last->u.text.pos || pos + length == last->u.text.pos))	/* Deletes that touch. */
+	{
+		last->u.text.pos     = pos;
+		last->u.text.length += length;
+		return 1;
+	}
+	if(text_length == 0 && pos == last->u.text.pos && length == last->u.text.text_length && length > 0)
+	{
+		/* Deletes exactly what the last one inserted. */
+		mem_free(last->u.text.text);
+		last->u.text.text = NULL;
+		last->u.text.text_length = 0;
+		if(last->u.text.length == 0)
+			last->dead = 1;
+		return 1;
+	}
+	return 0;
+}
+
+/* Buffer a single edit, with no more than OUTBUF_TEXT_MAX characters of text. */
+static void text_add(VNodeID node, VBufferID buffer, uint32 pos, uint32 length, const char *text, size_t text_length)
+{
+	OutCmd	*c;
+	size_t	done;
+
+	outbuf_info.queued++;
+	if((c = cmd_latest(OUT_T_TEXT_SET, node, buffer, 0)) != NULL)
+	{
+		if((done = text_merge(c, pos, length, text, text_length)) > text_length)
+			return;
+		pos  += done;
+		text += done;
+		text_length -= done;
+	}
+	if((c = cmd_append(OUT_T_TEXT_SET, node, buffer, 0)) == NULL)
+		return;
+	c->u.text.pos = pos;
+	c->u.text.length = length;
+	c->u.text.text_length = text_length;
+	if(text_length > 0 && (c->u.text.text = mem_alloc(text_length + 1)) != NULL)
+	{
+		memcpy(c->u.text.text, text, text_length);
+		c->u.text.text[text_length] = '\0';
+	}
+	else
+	{
+		c->u.text.text = NULL;
+		c->u.text.text_length = 0;
+	}
+}
+
+void outbuf_t_text_set(VNodeID node, VBufferID buffer, uint32 pos, uint32 length, const char *text, size_t text_length)
+{
+	size_t	chunk;
+
+	for(;;)
+	{
+		chunk = text_length > OUTBUF_TEXT_MAX ? OUTBUF_TEXT_MAX : text_length;
+		text_add(node, buffer, pos, length, text, chunk);
+		if((text_length -= chunk) == 0)
+			break;
+		text   += chunk;
+		pos    += chunk;
+		length  = 0;
+	}
+}
+
+/* ----------------------------------------------------------------------------------------- */
+
+static void cmd_send(const OutCmd *c)
+{
+	const real64	*r = c->u.slot.data;
+	const uint32	*u = (const uint32 *) c->u.slot.data;
+
+	switch(c->type)
+	{
+	case OUT_G_SLOT:
+		switch(c->u.slot.type)
+		{
+		case VN_G_LAYER_VERTEX_XYZ:
+			verse_send_g_vertex_set_xyz_real64(c->node, c->layer, c->index, r[0], r[1], r[2]);
+			break;
+		case VN_G_LAYER_VERTEX_UINT32:
+			verse_send_g_vertex_set_uint32(c->node, c->layer, c->index, u[0]);
+			break;
+		case VN_G_LAYER_VERTEX_REAL:
+			verse_send_g_vertex_set_real64(c->node, c->layer, c->index, r[0]);
+			break;
+		case VN_G_LAYER_POLYGON_CORNER_UINT32:
+			verse_send_g_polygon_set_corner_uint32(c->node, c->layer, c->index, u[0], u[1], u[2], u[3]);
+			break;
+		case VN_G_LAYER_POLYGON_CORNER_REAL:
+			verse_send_g_polygon_set_corner_real64(c->node, c->layer, c->index, r[0], r[1], r[2], r[3]);
+			break;
+		case VN_G_LAYER_POLYGON_FACE_UINT8:
+			verse_send_g_polygon_set_face_uint8(c->node, c->layer, c->index, ((const uint8 *) c->u.slot.data)[0]);
+			break;
+		case VN_G_LAYER_POLYGON_FACE_UINT32:
+			verse_send_g_polygon_set_face_uint32(c->node, c->layer, c->index, u[0]);
+			break;
+		case VN_G_LAYER_POLYGON_FACE_REAL:
+			verse_send_g_polygon_set_face_real64(c->node, c->layer, c->index, r[0]);
+			break;
+		}
+		break;
+	case OUT_G_POLYGON_DELETE:
+		verse_send_g_polygon_delete(c->node, c->index);
+		break;
+	case OUT_T_TEXT_SET:
+		verse_send_t_text_set(c->node, c->layer, c->u.text.pos, c->u.text.length, c->u.text.text);
+		break;
+	}
+}
+
+void outbuf_flush(void)
+{
+	OutCmd		*c, *next;
+	unsigned long	sent = 0;
+
+	if(outbuf_info.head == NULL)
+		return;
+	for(c = outbuf_info.head; c != NULL; c = next)
+	{
+		next = c->next;
+		if(!c->dead)
+		{
+			cmd_send(c);
+			sent++;
+		}
+		if(hash_lookup(outbuf_info.latest, c) == c)
+			hash_remove(outbuf_info.latest, c);
+		if(c->type == OUT_T_TEXT_SET)
+			mem_free(c->u.text.text);
+		memchunk_free(outbuf_info.chunk, c);
+	}
+	outbuf_info.head = outbuf_info.tail = NULL;
+
+	outbuf_info.stats.queued     += outbuf_info.queued;
+	outbuf_info.stats.sent       += sent;
+	outbuf_info.stats.last_queued = outbuf_info.queued;
+	outbuf_info.stats.last_sent   = sent;
+	outbuf_info.queued = 0;
+}
+
+void outbuf_stats_get(OutbufStats *stats)
+{
+	if(stats != NULL)
+		*stats = outbuf_info.stats;
+}
@@ -0,0 +1,40 @@
+/*
+ * outbuf.h
+ * 
+ * Copyright (C) 2004 PDC, KTH. See COPYING for license details.
+ * 
+ * A buffer for outgoing Verse commands that are likely to be repeated or split within one
+ * main loop iteration. Commands are held until outbuf_flush(), and on the way a geometry
+ * slot that is set again only gets its last value sent, and consecutive text edits in a
+ * buffer are merged into as few commands as the protocol allows.
+*/
+
+#define	OUTBUF_TEXT_MAX	1023	/* Longest text a single text set command can carry. */
+
+extern void	outbuf_init(void);
+
+/* Set slot <index> of the geometry layer <layer>, of type <type>, to the value in <data>. */
+extern void	outbuf_g_slot_set(VNodeID node, VLayerID layer, VNGLayerType type, uint32 index, const void *data);
+
+/* Delete polygon <index>. Earlier sets of it are dropped, but a delete is never dropped. */
+extern void	outbuf_g_polygon_delete(VNodeID node, uint32 index);
+
+/* Replace <length> characters at <pos> in a text buffer with the <text_length> first of <text>,
+ * which need not be terminated and can be NULL if <text_length> is 0. Any length can be given,
+ * the text is split as needed.
+*/
+extern void	outbuf_t_text_set(VNodeID node, VBufferID buffer, uint32 pos, uint32 length,
+				  const char *text, size_t text_length);
+
+/* Send everything that has been buffered. Called once per main loop iteration. */
+extern void	outbuf_flush(void);
+
+typedef struct
+{
+	unsigned long	queued;		/* Commands that would have been sent without the buffer. */
+	unsigned long	sent;		/* Commands actually sent. */
+	unsigned long	last_queued;	/* The same, for the last flush that sent anything. */
+	unsigned long	last_sent;
+} OutbufStats;
+
+extern void	outbuf_stats_get(OutbufStats *stats);
@@ -0,0 +1,346 @@
+/*
+ * pagearr.c
+ * 
+ * Copyright (C) 2004 PDC, KTH. See COPYING for license details.
+ * 
+ * A paged array of pointers. Pages hold PAGE_SIZE consecutive slots. Page number p is found in
+ * the directory at index p, if p is below the directory's size. The directory is only grown to
+ * cover a new page if that keeps it at most DIR_SPARSE times as large as the number of pages
+ * in use. Pages beyond that are kept in a hash table, keyed on page number, until the directory
+ * has grown enough to take them in.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash.h"
+#include "log.h"
+#include "mem.h"
+
+#include "pagearr.h"
+
+/* ----------------------------------------------------------------------------------------- */
+
+#define	PAGE_BITS	8
+#define	PAGE_SIZE	(1 << PAGE_BITS)
+#define	DIR_MIN		16		/* Directories up to this size are always fine. */
+#define	DIR_SPARSE	4		/* Directory entries allowed per page actually in use. */
+
+typedef struct
+{
+	size_t	number;			/* Page number, i.e. index of first slot divided by PAGE_SIZE. */
+	size_t	used;			/* Number of non-NULL slots. */
+	void	*slot[PAGE_SIZE];
+} Page;
+
+struct PageArr
+{
+	Page	**dir;			/* Directory of pages, NULL where there is none. */
+	size_t	dir_size;
+	Hash	*far;			/* Pages at or beyond <dir_size>, by page number. */
+	size_t	pages;			/* Number of pages, in both directory and hash. */
+	size_t	size;			/* Number of elements. */
+	size_t	end;			/* One past highest index in use. */
+};
+
+/* ----------------------------------------------------------------------------------------- */
+
+static Page * page_find(const PageArr *pa, size_t number)
+{
+	if(number < pa->dir_size)
+		return pa->dir[number];
+	if(pa->far != NULL)
+		return hash_lookup(pa->far, (const void *) number);
+	return NULL;
+}
+
+static int cb_far_adopt(void *data, void *user)
+{
+	PageArr	*pa = user;
+	Page	*page = data;
+
+	if(page->number < pa->dir_size)
+		pa->dir[page->number] = page;
+	return 1;
+}
+
+/* Grow the directory to hold at least <size> pages, moving in pages from the hash table. */
+static int dir_grow(PageArr *pa, size_t size)
+{
+	Page	**nd;
+	size_t	old = pa->dir_size, i;
+
+	if(size < 2 * old)
+		size = 2 * old;
+	if((nd = mem_realloc(pa->dir, size * sizeof *nd)) == NULL)
+		return 0;
+	memset(nd + old, 0, (size - old) * sizeof *nd);
+	pa->dir = nd;
+	pa->dir_size = size;
+	if(pa->far != NULL)
+	{
+		hash_foreach(pa->far, cb_far_adopt, pa);
+		for(i = old; i < size; i++)
+		{
+			if(pa->dir[i] != NULL)
+				hash_remove(pa->far, (const void *) i);
+		}
+	}
+	return 1;
+}
+
+/* Add an empty page to hold page number <number>, in the directory if that isn't too sparse. */
+static Page * page_add(PageArr *pa, size_t number)
+{
+	Page	*page;
+
+	if((page = mem_alloc(sizeof *page)) == NULL)
+		return NULL;
+	page->number = number;
+	page->used   = 0;
+	memset(page->slot, 0, sizeof page->slot);
+	if(number >= pa->dir_size && (number < DIR_MIN || number < DIR_SPARSE * (pa->pages + 1)))
+		dir_grow(pa, number + 1);
+	if(number < pa->dir_size)
+		pa->dir[number] = page;
+	else
+	{
+		if(pa->far == NULL && (pa->far = hash_new_int()) == NULL)
+		{
+			mem_free(page);
+			return NULL;
+		}
+		hash_insert(pa->far, (const void *) number, page);
+		if(hash_lookup(pa->far, (const void *) number) != page)
+		{
+			mem_free(page);
+			return NULL;
+		}
+	}
+	pa->pages++;
+	return page;
+}
+
+static void page_remove(PageArr *pa, Page *page)
+{
+	if(page->number < pa->dir_size)
+		pa->dir[page->number] = NULL;
+	else
+		hash_remove(pa->far, (const void *) page->number);
+	mem_free(page);
+	pa->pages--;
+}
+
+/* Used to find the lowest-numbered far page at or after a given page number. */
+struct far_min
+{
+	size_t	number;
+	Page	*page;
+};
+
+static int cb_far_min(void *data, void *user)
+{
+	struct far_min	*fm = user;
+	Page		*page = data;
+
+	if(page->number >= fm->number && (fm->page == NULL || page->number < fm->page->number))
+		fm->page = page;
+	return 1;
+}
+
+/* Find the first page at or after page number <number>, or NULL if there is none. */
+static Page * page_next(const PageArr *pa, size_t number)
+{
+	struct far_min	fm;
+
+	for(; number < pa->dir_size; number++)
+	{
+		if(pa->dir[number] != NULL)
+			return pa->dir[number];
+	}
+	fm.number = number;
+	fm.page   = NULL;
+	hash_foreach(pa->far, cb_far_min, &fm);
+	return fm.page;
+}
+
+static int cb_far_max(void *data, void *user)
+{
+	Page	**max = user;
+	Page	*page = data;
+
+	if(*max == NULL || page->number > (*max)->number)
+		*max = page;
+	return 1;
+}
+
+/* Find the new end of the array, after the element at the old end has been removed. */
+static size_t end_find(const PageArr *pa)
+{
+	Page	*last = NULL;
+	size_t	i;
+
+	hash_foreach(pa->far, cb_far_max, &last);
+	for(i = pa->dir_size; last == NULL && i > 0; i--)
+		last = pa->dir[i - 1];
+	if(last == NULL)
+		return 0;
+	for(i = PAGE_SIZE; last->slot[i - 1] == NULL; i--)
+		;
+	return (last->number << PAGE_BITS) + i;
+}
+
+/* ----------------------------------------------------------------------------------------- */
+
+PageArr * pagearr_new(void)
+{
+	PageArr	*pa;
+
+	if((pa = mem_alloc(sizeof *pa)) != NULL)
+	{
+		pa->dir      = NULL;
+		pa->dir_size = 0;
+		pa->far      = NULL;
+		pa->pages    = 0;
+		pa->size     = 0;
+		pa->end      = 0;
+	}
+	return pa;
+}
+
+PageArr * pagearr_new_copy(const PageArr *src, void * (*element_copy)(const void *element, void *user), void *user)
+{
+	PageArr	*pa;
+	size_t	i;
+
+	if(src == NULL || element_copy == NULL)
+		return NULL;
+	if((pa = pagearr_new()) == NULL)
+		return NULL;
+	for(i = pagearr_next(src, 0); i < src->end; i = pagearr_next(src, i + 1))
+	{
+		if(!pagearr_set(pa, i, element_copy(pagearr_get(src, i), user)))
+		{
+			LOG_ERR(("Couldn't copy paged array, out of memory"));
+			break;
+		}
+	}
+	return pa;
+}
+
+int pagearr_set(PageArr *pa, size_t index, void *element)
+{
+	Page	*page;
+	void	**slot;
+
+	if(pa == NULL)
+		return 0;
+	if((page = page_find(pa, index >> PAGE_BITS)) == NULL)
+	{
+		if(element == NULL)
+			return 1;
+		if((page = page_add(pa, index >> PAGE_BITS)) == NULL)
+			return 0;
+	}
+	slot = page->slot + (index & (PAGE_SIZE - 1));
+	if(*slot == NULL && element != NULL)
+	{
+		page->used++;
+		pa->size++;
+		if(index >= pa->end)
+			pa->end = index + 1;
+	}
+	else if(*slot != NULL && element == NULL)
+	{
+		page->used--;
+		pa->size--;
+	}
+	*slot = element;
+	if(element == NULL)
+	{
+		if(page->used == 0)
+			page_remove(pa, page);
+		if(index + 1 == pa->end)
+			pa->end = end_find(pa);
+	}
+	return 1;
+}
+
+void * pagearr_get(const PageArr *pa, size_t index)
+{
+	const Page	*page;
+
+	if(pa == NULL || index >= pa->end)
+		return NULL;
+	if((page = page_find(pa, index >> PAGE_BITS)) != NULL)
+		return page->slot[index & (PAGE_SIZE - 1)];
+	return NULL;
+}
+
+size_t pagearr_size(const PageArr *pa)
+{
+	return pa != NULL ? pa->size : 0;
+}
+
+size_t pagearr_end(const PageArr *pa)
+{
+	return pa != NULL ? pa->end : 0;
+}
+
+size_t pagearr_next(const PageArr *pa, size_t index)
+{
+	const Page	*page;
+	size_t		i;
+
+	if(pa == NULL)
+		return 0;
+	while(index < pa->end && (page = page_next(pa, index >> PAGE_BITS)) != NULL)
+	{
+		i = page->number == index >> PAGE_BITS ? index & (PAGE_SIZE - 1) : 0;
+		for(; i < PAGE_SIZE; i++)
+		{
+			if(page->slot[i] != NULL)
+				return (page->number << PAGE_BITS) + i;
+		}
+		index = (page->number + 1) << PAGE_BITS;
+	}
+	return pa->end;
+}
+
+static void page_destroy(Page *page, void (*element_destroy)(void *element))
+{
+	size_t	i;
+
+	for(i = 0; element_destroy != NULL && i < PAGE_SIZE; i++)
+	{
+		if(page->slot[i] != NULL)
+			element_destroy(page->slot[i]);
+	}
+	mem_free(page);
+}
+
+static int cb_far_destroy(void *data, void *user)
+{
+	page_destroy(data, *(void (**)(void *)) user);
+	return 1;
+}
+
+void pagearr_destroy(PageArr *pa, void (*element_destroy)(void *element))
+{
+	size_t	i;
+
+	if(pa == NULL)
+		return;
+	for(i = 0; i < pa->dir_size; i++)
+	{
+		if(pa->dir[i] != NULL)
+			page_destroy(pa->dir[i], element_destroy);
+	}
+	mem_free(pa->dir);
+	if(pa->far != NULL)
+	{
+		hash_foreach(pa->far, cb_far_destroy, &element_destroy);
+		hash_destroy(pa->far);
+	}
+	mem_free(pa);
+}
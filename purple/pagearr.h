@@ -0,0 +1,47 @@
+/*
+ * pagearr.h
+ * 
+ * Copyright (C) 2004 PDC, KTH. See COPYING for license details.
+ * 
+ * A paged array of pointers, indexed by integer. Meant for things like audio blocks, which
+ * mostly arrive in order and fill the array densely, but may leave gaps. Elements are kept in
+ * pages of consecutive indices, so lookup is constant-time and walking the array in order is
+ * cheap. Pages are only allocated where there are elements, and pages far beyond the rest are
+ * kept in a hash table instead, so a few huge indices don't make a huge page directory.
+*/
+
+#if !defined PAGEARR_H
+#define	PAGEARR_H
+
+typedef struct PageArr	PageArr;
+
+extern PageArr *	pagearr_new(void);
+
+/* Create a new paged array holding copies of the elements in <src>. The <element_copy> function
+ * is called with each element, and should return the copy to put at the same index.
+*/
+extern PageArr *	pagearr_new_copy(const PageArr *src, void * (*element_copy)(const void *element, void *user), void *user);
+
+/* Set the element at <index>, replacing any previous one. Setting NULL removes the element.
+ * Returns 0 if out of memory, in which case nothing is changed.
+*/
+extern int		pagearr_set(PageArr *pa, size_t index, void *element);
+extern void *		pagearr_get(const PageArr *pa, size_t index);
+
+/* Return the number of elements in the array. */
+extern size_t		pagearr_size(const PageArr *pa);
+
+/* Return one more than the highest index holding an element, or 0 if the array is empty. */
+extern size_t		pagearr_end(const PageArr *pa);
+
+/* Return the lowest index at or after <index> that holds an element, or pagearr_end(). Use like:
+ * 
+ * for(i = pagearr_next(pa, 0); i < pagearr_end(pa); i = pagearr_next(pa, i + 1))
+ * 	Use pagearr_get(pa, i).
+*/
+extern size_t		pagearr_next(const PageArr *pa, size_t index);
+
+/* Destroy the array, calling <element_destroy> (if non-NULL) with each element first. */
+extern void		pagearr_destroy(PageArr *pa, void (*element_destroy)(void *element));
+
+#endif		/* PAGEARR_H */
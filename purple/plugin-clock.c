@@ -108,6 +108,7 @@ void plugin_clock_init(void)
 	p_init_meta("desc/purpose", "Built-in plug-in, creates a spontaneously changing \"clock\" signal");
 	p_init_state(sizeof (State), ctor, dtor);
 	p_init_compute(compute);
+	p_init_flags(P_PLUGIN_SIDE_EFFECTS);
 
 	api_init_end();
 }
@@ -121,6 +121,7 @@ void plugin_input_init(void)
 	p_init_meta("desc/purpose", "Built-in plug-in, outputs the single node whose name is given");
 	p_init_state(sizeof (State), ctor, dtor);
 	p_init_compute(compute);
+	p_init_flags(P_PLUGIN_SIDE_EFFECTS);
 
 	api_init_end();
 }
@@ -47,6 +47,7 @@ void plugin_output_init(void)
 	p_init_meta("authors", "Emil Brink");
 	p_init_meta("desc/purpose", "Built-in plug-in, writes input to Verse server.");
 	p_init_compute(compute);
+	p_init_flags(P_PLUGIN_SIDE_EFFECTS);
 
 	api_init_end();
 }
@@ -33,6 +33,7 @@
 #include "xmlutil.h"
 
 #include "plugins.h"
+#include "memo.h"
 
 #include "api-init.h"
 
@@ -89,6 +90,7 @@ struct Plugin
 	void		(*ctor)(void *state);
 	void		(*dtor)(void *state);
 	PComputeStatus	(*compute)(PPInput *input, PPOutput output, void *state);
+	uint32		flags;		/* PPluginFlags, describing how compute() behaves. */
 	MemChunk	*state;		/* Instance state blocks allocated from here. */
 };
 
@@ -131,6 +133,7 @@ Plugin * plugin_new(const char *name)
 		p->input = NULL;
 		p->meta = NULL;
 		p->compute = NULL;
+		p->flags = 0;
 		p->state = NULL;
 	}
 	return p;
@@ -270,6 +273,12 @@ void plugin_set_compute(Plugin *p, PComputeStatus (*compute)(PPInput *input, PPO
 	}
 }
 
+void plugin_set_flags(Plugin *p, uint32 flags)
+{
+	if(p != NULL)
+		p->flags = flags;
+}
+
 /* Check if a plug-in has at least on default value on one of its inputs.
  * FIXME: This could easily be buffered from creation-time.
 */
@@ -326,6 +335,14 @@ void plugin_describe_append(const Plugin *p, DynStr *d)
 	/* Head. */
 	dynstr_append_printf(d, "<plug-in id=\"%u\" name=\"%s\">\n", p->id, p->name);
 
+	/* Behaviour flags, if any were declared. */
+	if(p->flags & P_PLUGIN_PURE)
+		dynstr_append(d, " <flag name=\"pure\" value=\"true\"/>\n");
+	if(p->flags & P_PLUGIN_REENTRANT)
+		dynstr_append(d, " <flag name=\"reentrant\" value=\"true\"/>\n");
+	if(p->flags & P_PLUGIN_SIDE_EFFECTS)
+		dynstr_append(d, " <flag name=\"side-effects\" value=\"true\"/>\n");
+
 	/* Any inputs? */
 	if((num = dynarr_size(p->input)) > 0)
 	{
@@ -450,6 +467,23 @@ const char * plugin_name(const Plugin *p)
 	return p != NULL ? p->name : NULL;
 }
 
+uint32 plugin_flags(const Plugin *p)
+{
+	return p != NULL ? p->flags : 0;
+}
+
+/* Only plug-ins that have promised to be pure, and to have no side effects, have their outputs remembered. */
+boolean plugin_is_pure(const Plugin *p)
+{
+	return p != NULL && (p->flags & (P_PLUGIN_PURE | P_PLUGIN_SIDE_EFFECTS)) == P_PLUGIN_PURE;
+}
+
+/* Only plug-ins that have promised to be reentrant, and to have no side effects, are threaded. */
+boolean plugin_runs_threaded(const Plugin *p)
+{
+	return p != NULL && (p->flags & (P_PLUGIN_REENTRANT | P_PLUGIN_SIDE_EFFECTS)) == P_PLUGIN_REENTRANT;
+}
+
 void plugin_destroy(Plugin *p)
 {
 	if(p != NULL)
@@ -688,6 +722,56 @@ boolean plugin_instance_inputs_ready(const PInstance *inst)
 	return 1;
 }
 
+/* Check that all required inputs have values, and re-link ports to outputs for module-inputs.
+ * Returns -1 if a required input is missing, else the number of links that couldn't be resolved.
+*/
+static int instance_link(PInstance *inst)
+{
+	PPortSet	*ps = inst->inputs;
+	const Plugin	*p = inst->plugin;
+	size_t		i;
+	const Input	*in;
+	int		unresolved = 0;
+
+	for(i = 0; i < dynarr_size(p->input); i++)
+	{
+		uint32	module;
+
+		in = dynarr_index(p->input, i);
+		if(in->spec.req && port_is_unset(ps->input + i))
+			return -1;
+		if(plugin_portset_get_module(ps, i, &module))
+		{
+			PPOutput	o;
+
+			if((o = inst->resolver(module, inst->resolver_data)) != NULL)
+				ps->port[i] = o;
+			else
+			{
+				printf("Couldn't resolve port %u\n", (unsigned int) i);
+				unresolved++;
+			}
+		}
+		else
+			ps->port[i] = &ps->input[i];
+	}
+	return unresolved;
+}
+
+/* Return the input ports as compute() would see them, or NULL if it couldn't run or a link is broken. */
+PPInput * plugin_instance_inputs(PInstance *inst, size_t *num)
+{
+	PPInput	*port;
+
+	if(inst == NULL || inst->inputs == NULL)
+		return NULL;
+	if((port = plugin_portset_ports(inst->inputs)) == NULL || instance_link(inst) != 0)
+		return NULL;
+	if(num != NULL)
+		*num = inst->inputs->size;
+	return port;
+}
+
 PluginStatus plugin_instance_compute(PInstance *inst)
 {
 	PPortSet	*ps = inst->inputs;
@@ -699,29 +783,8 @@ PluginStatus plugin_instance_compute(PInstance *inst)
 	p = inst->plugin;
 	if((port = plugin_portset_ports(ps)) != NULL)
 	{
-		size_t		i;
-		const Input	*in;
-
-		/* Check that all required inputs have values, and re-link ports to outputs for module-inputs. */
-		for(i = 0; i < dynarr_size(p->input); i++)
-		{
-			uint32	module;
-
-			in = dynarr_index(p->input, i);
-			if(in->spec.req && port_is_unset(ps->input + i))
-				return PLUGIN_STOP_INPUT_MISSING;
-			if(plugin_portset_get_module(ps, i, &module))
-			{
-				PPOutput	o;
-
-				if((o = inst->resolver(module, inst->resolver_data)) != NULL)
-					ps->port[i] = o;
-				else
-					printf("Couldn't resolve port %u\n", (unsigned int) i);
-			}
-			else
-				ps->port[i] = &ps->input[i];
-		}
+		if(instance_link(inst) < 0)
+			return PLUGIN_STOP_INPUT_MISSING;
 		if(p->compute(port, inst->output, inst->state) == P_COMPUTE_DONE)
 			return PLUGIN_STOP_COMPLETE;
 		return PLUGIN_RETRY_INCOMPLETE;
@@ -733,6 +796,7 @@ void plugin_instance_free(PInstance *inst)
 {
 	if(inst == NULL)
 		return;
+	memo_forget(inst);
 	if(inst->inputs != NULL)
 	{
 		plugin_portset_destroy(inst->inputs);
@@ -40,6 +40,7 @@ extern void	plugin_set_input(Plugin *p, int index, PValueType type, const char *
 extern void	plugin_set_meta(Plugin *p, const char *category, const char *text);
 extern void	plugin_set_state(Plugin *p, size_t size, void (*ctor)(void *state), void (*dtor)(void *state));
 extern void	plugin_set_compute(Plugin *p, PComputeStatus (*compute)(PPInput *input, PPOutput output, void *state));
+extern void	plugin_set_flags(Plugin *p, uint32 flags);
 extern int	plugin_has_default_inputs(const Plugin *p);
 extern char *	plugin_describe(const Plugin *p);
 extern void	plugin_describe_append(const Plugin *p, DynStr *ds);
@@ -56,6 +57,11 @@ extern Plugin *		plugin_lookup(unsigned int id);
 extern Plugin *		plugin_lookup_by_name(const char *name);
 extern unsigned int	plugin_id(const Plugin *p);
 extern const char *	plugin_name(const Plugin *p);
+extern uint32		plugin_flags(const Plugin *p);
+/* Answer if the output of <p> depends on nothing but its inputs, so it can be remembered. */
+extern boolean		plugin_is_pure(const Plugin *p);
+/* Answer if instances of <p> may compute() on a worker thread, in parallel with other instances. */
+extern boolean		plugin_runs_threaded(const Plugin *p);
 
 /* Portset sub-API. A portset is a collection of (input) ports, always created by providing
  * a plug-in as a template. The portset contains as many value slots as the provided plug-in
@@ -90,5 +96,6 @@ extern void		plugin_instance_set_output(PInstance *inst, PPOutput output);
 extern void		plugin_instance_set_link_resolver(PInstance *inst,
 							  PPOutput (*get_output)(uint32 module_id, void *data), void *data);
 extern boolean		plugin_instance_inputs_ready(const PInstance *inst);
+extern PPInput *		plugin_instance_inputs(PInstance *inst, size_t *num);
 extern PluginStatus	plugin_instance_compute(PInstance *inst);
 extern void		plugin_instance_free(PInstance *inst);
@@ -56,4 +56,5 @@ PURPLE_PLUGIN void init(void)
 	p_init_input(0, P_VALUE_MODULE, "node",  P_INPUT_REQUIRED, P_INPUT_DONE);
 	p_init_input(1, P_VALUE_REAL32, "delay", P_INPUT_REQUIRED, P_INPUT_DONE);
 	p_init_compute(compute);
+	p_init_flags(P_PLUGIN_PURE | P_PLUGIN_REENTRANT);
 }
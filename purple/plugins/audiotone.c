@@ -51,4 +51,5 @@ PURPLE_PLUGIN void init(void)
 	p_init_input(2, P_VALUE_UINT32, "format",   P_INPUT_DEFAULT(VN_A_BLOCK_INT16), P_INPUT_DONE);
 	p_init_input(3, P_VALUE_REAL32, "samplefrequency", P_INPUT_DEFAULT(44100.0), P_INPUT_DONE);
 	p_init_compute(compute);
+	p_init_flags(P_PLUGIN_PURE | P_PLUGIN_REENTRANT);
 }
@@ -17,7 +17,8 @@ static PComputeStatus compute(PPInput *input, PPOutput output, void *state)
 {
 	PINode		*in;
 	size_t		i, j, k, size;
-	real64		min[4] = { 1E20, 1E20, 1E20, 0.0 }, max[3] = { -1E20, -1E20, -1E20 }, point[3];
+	real64		min[4] = { 1E20, 1E20, 1E20, 0.0 }, max[3] = { -1E20, -1E20, -1E20 };
+	const real64	*vtx, *point;
 
 	printf("computing bbox\n");
 	for(i = 0; (in = p_input_node_nth(input[0], i)) != NULL; i++)
@@ -33,13 +34,12 @@ static PComputeStatus compute(PPInput *input, PPOutput output, void *state)
 		if(p_node_get_type(in) != V_NT_GEOMETRY)
 			continue;
 		layer = p_node_g_layer_find(in, "vertex");
-		size = p_node_g_layer_get_size(layer);		/* Safely handles NULL layer. */
-		for(j = 0; j < size; j++)
+		vtx = p_node_g_layer_read_begin(in, layer, &size);	/* Safely handles NULL layer. */
+		for(j = 0, point = vtx; j < size; j++, point += 3)
 		{
-			p_node_g_vertex_get_xyz(layer, j, point, point + 1, point + 2);
 			if(vertex_deleted(point))
 				continue;
-			for(k = 0; k < sizeof point / sizeof *point; k++)
+			for(k = 0; k < 3; k++)
 			{
 				if(point[k] > max[k])
 					max[k] = point[k];
@@ -47,6 +47,7 @@ static PComputeStatus compute(PPInput *input, PPOutput output, void *state)
 					min[k] = point[k];
 			}
 		}
+		p_node_g_layer_read_end(in, layer, vtx);
 		p_output_real64_vec3(output, max);
 		p_output_real64_vec4(output, min);	/* Slightly hackish. */
 		printf("bbox computed: (%g,%g,%g)-(%g,%g,%g)\n",
@@ -65,4 +66,5 @@ PURPLE_PLUGIN void init(void)
 	p_init_meta("desc/purpose", "Compute bounding box (minimum and maximum vertex positions) for input geometry. Outputs these using the "
 		    		    "real64_vec4 and real64_vec3 output slots, respectively.");
 	p_init_compute(compute);
+	p_init_flags(P_PLUGIN_PURE | P_PLUGIN_REENTRANT);
 }
@@ -87,4 +87,5 @@ void init(void)
 	p_init_create("bmaverage");
 	p_init_input(0, P_VALUE_MODULE, "bitmap", P_INPUT_REQUIRED, P_INPUT_DONE);
 	p_init_compute(compute);
+	p_init_flags(P_PLUGIN_PURE | P_PLUGIN_REENTRANT);
 }
@@ -94,4 +94,5 @@ PURPLE_PLUGIN void init(void)
 	p_init_meta("desc/purpose", "Computes a straightforward \"alpha blend\" between two input images. Uses a third input, the alpha, to control "
 				    "how much of each is to appear on the output.");
 	p_init_compute(compute);
+	p_init_flags(P_PLUGIN_PURE | P_PLUGIN_REENTRANT);
 }
@@ -42,4 +42,5 @@ PURPLE_PLUGIN void init(void)
 	p_init_meta("desc/purpose", "Creates a \"checkered flag\" image in a bitmap node. Inputs "
 		    " control the size of the bitmap, as well as the size of each square in the pattern.");
 	p_init_compute(compute);
+	p_init_flags(P_PLUGIN_PURE | P_PLUGIN_REENTRANT);
 }
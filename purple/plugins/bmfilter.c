@@ -278,4 +278,5 @@ PURPLE_PLUGIN void init(void)
 	p_init_meta("authors", "Emil Brink");
 	p_init_meta("desc/purpose", "Computes bitmap filter operation, on two sources. Supports several \"modes\" that affect how the result will look.");
 	p_init_compute(compute);
+	p_init_flags(P_PLUGIN_PURE | P_PLUGIN_REENTRANT);
 }
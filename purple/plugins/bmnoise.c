@@ -135,6 +135,7 @@ PURPLE_PLUGIN void init(void)
 	p_init_meta("copyright", "2005 PDC, KTH");
 	p_init_meta("desc/purpose", "Creates a 2D bitmap of Perlin noise.");
 	p_init_compute(compute);
+	p_init_flags(P_PLUGIN_PURE | P_PLUGIN_REENTRANT);
 }
 
 #endif		/* ! STANDALONE */
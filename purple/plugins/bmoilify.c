@@ -103,4 +103,5 @@ PURPLE_PLUGIN void init(void)
 	p_init_meta("desc/purpose", "This plug-in applies an 'oilify' effect to a bitmap image. This causes the bitmap to be smoothed "
 		    "in a way that resembles an oil painting.");
 	p_init_compute(compute);
+	p_init_flags(P_PLUGIN_PURE | P_PLUGIN_REENTRANT);
 }
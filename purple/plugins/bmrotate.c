@@ -120,4 +120,5 @@ PURPLE_PLUGIN void init(void)
 	p_init_meta("authors", "Emil Brink");
 	p_init_meta("desc/purpose", "Rotates the input bitmap by the given amount, and outputs the result. Does not resize the bitmap.");
 	p_init_compute(compute);
+	p_init_flags(P_PLUGIN_PURE | P_PLUGIN_REENTRANT);
 }
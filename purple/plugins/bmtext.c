@@ -564,4 +564,5 @@ PURPLE_PLUGIN void init(void)
 		    "a built-in 8x8 pixel fixed-width font, in white on a black background.");
 	p_init_state(sizeof (State), ctor, dtor);
 	p_init_compute(compute);
+	p_init_flags(P_PLUGIN_PURE | P_PLUGIN_REENTRANT);
 }
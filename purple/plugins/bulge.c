@@ -12,8 +12,8 @@ static PComputeStatus compute(PPInput *input, PPOutput output, void *state)
 	PINode		*in, *ingeo;
 	PONode		*obj, *geo;
 	size_t		i, j, k, size;
-	const real64	*pos, *vec;
-	real64		radius, point[3], tmp[3], dist;
+	const real64	*pos, *vec, *src, *p;
+	real64		radius, tmp[3], dist, *dst, *q;
 
 	pos    = p_input_real64_vec3(input[1]);
 	vec    = p_input_real64_vec3(input[2]);
@@ -34,20 +34,24 @@ static PComputeStatus compute(PPInput *input, PPOutput output, void *state)
 
 		inlayer  = p_node_g_layer_find(ingeo, "vertex");
 		outlayer = p_node_g_layer_find(geo, "vertex");
-		size  = p_node_g_layer_get_size(inlayer);
-		for(j = 0; j < size; j++)
+		if((src = p_node_g_layer_read_begin(ingeo, inlayer, &size)) == NULL)	/* Safely handles NULL layer. */
+			break;
+		if((dst = p_node_g_layer_access_begin(geo, outlayer, size)) != NULL)
 		{
-			p_node_g_vertex_get_xyz(inlayer, j, point, point + 1, point + 2);
-			tmp[0] = (point[0] - pos[0]) / radius;
-			tmp[1] = (point[1] - pos[1]) / radius;
-			tmp[2] = (point[2] - pos[2]) / radius;
-			dist = tmp[0] * tmp[0] + tmp[1] * tmp[1] + tmp[2] * tmp[2];
-			dist = 1.0 / (1.0 + dist);
-			point[0] += vec[0] * dist;
-			point[1] += vec[1] * dist;
-			point[2] += vec[2] * dist;
-			p_node_g_vertex_set_xyz(outlayer, j, point[0], point[1], point[2]);								    
+			for(j = 0, p = src, q = dst; j < size; j++, p += 3, q += 3)
+			{
+				tmp[0] = (p[0] - pos[0]) / radius;
+				tmp[1] = (p[1] - pos[1]) / radius;
+				tmp[2] = (p[2] - pos[2]) / radius;
+				dist = tmp[0] * tmp[0] + tmp[1] * tmp[1] + tmp[2] * tmp[2];
+				dist = 1.0 / (1.0 + dist);
+				q[0] = p[0] + vec[0] * dist;
+				q[1] = p[1] + vec[1] * dist;
+				q[2] = p[2] + vec[2] * dist;
+			}
+			p_node_g_layer_access_end(geo, outlayer, dst);
 		}
+		p_node_g_layer_read_end(ingeo, inlayer, src);
 		break;
 	}
 	return P_COMPUTE_DONE;
@@ -65,4 +69,5 @@ PURPLE_PLUGIN void init(void)
 	p_init_meta("copyright", "2005 PDC, KTH");
 	p_init_meta("desc/purpose", "Applies a deform to the first input object that has a geometry.");
 	p_init_compute(compute);
+	p_init_flags(P_PLUGIN_PURE | P_PLUGIN_REENTRANT);
 }
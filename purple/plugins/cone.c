@@ -98,4 +98,5 @@ PURPLE_PLUGIN void init(void)
 	p_init_meta("desc/purpose", "Creates a cone primitive. The user can control the height of the cone, which is the distance between "
 				    "the base plane to the apex, as well as the number of subdivisions along both major axis.");
 	p_init_compute(compute);
+	p_init_flags(P_PLUGIN_PURE | P_PLUGIN_REENTRANT);
 }
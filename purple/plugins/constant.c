@@ -110,4 +110,5 @@ PURPLE_PLUGIN void init(void)
 		    "setting, and outputting the result. This is useful when the same value needs to be sent to several other plug-ins' "
 		    "inputs; an instance of constant can be used to 'buffer' the value and make it possible to change it in just one place.");
 	p_init_compute(compute);
+	p_init_flags(P_PLUGIN_PURE | P_PLUGIN_REENTRANT);
 }
@@ -64,4 +64,5 @@ PURPLE_PLUGIN void init(void)
 	p_init_input(3, P_VALUE_UINT32, "x",      P_INPUT_REQUIRED, P_INPUT_DEFAULT(1), P_INPUT_DONE);
 	p_init_input(4, P_VALUE_UINT32, "y",      P_INPUT_REQUIRED, P_INPUT_DEFAULT(1), P_INPUT_DONE);
 	p_init_compute(compute);
+	p_init_flags(P_PLUGIN_PURE | P_PLUGIN_REENTRANT);
 }
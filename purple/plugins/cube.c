@@ -84,6 +84,7 @@ static PComputeStatus compute(PPInput *input, PPOutput output, void *state)
 
 	/* Create topside polygons. Vertex references will dangle (for a while), but that's OK. */
 	lay = p_node_g_layer_find(geo, "polygon");
+	p_node_g_layer_reserve(lay, 6 * splits * splits);
 	for(y = poly = 0; y < splits; y++)
 	{
 		for(x = 0; x < splits; x++, poly++)
@@ -287,6 +288,7 @@ static PComputeStatus compute(PPInput *input, PPOutput output, void *state)
 	printf("Done, created %d polygons\n", poly);
 
 	lay = p_node_g_layer_find(geo, "vertex");
+	p_node_g_layer_reserve(lay, (splits + 1) * (splits + 1) * (splits + 1) - (splits - 1) * (splits - 1) * (splits - 1));
 	/* Create vertices. Compared with the polygons, this is really simple stuff. */
 	for(y = 0, vid = 0; y <= splits; y++)
 	{
@@ -349,4 +351,5 @@ PURPLE_PLUGIN void init(void)
 	p_init_meta("copyright", "2005 PDC, KTH");
 	p_init_meta("desc/purpose", "Creates a cube object.");
 	p_init_compute(compute);
+	p_init_flags(P_PLUGIN_PURE | P_PLUGIN_REENTRANT);
 }
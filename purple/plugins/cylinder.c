@@ -86,4 +86,5 @@ PURPLE_PLUGIN void init(void)
 	p_init_meta("copyright", "2005 PDC, KTH");
 	p_init_meta("desc/purpose", "Creates a cylinder object with matching geometry.");
 	p_init_compute(compute);
+	p_init_flags(P_PLUGIN_PURE | P_PLUGIN_REENTRANT);
 }
@@ -11,21 +11,22 @@
 
 /* --------------------------------------------------------------------------------------------- */
 
-static void project_2d(real64 *flat, real64 *point)
+static void project_2d(real64 *flat, const real64 *point)
 {
 	flat[0] = point[0];
 	flat[1] = point[2];	/* Make Y = Z. */
 }
 
 /* Returns polygon normal, from computing the cross product of the first two edge vectors. */
-static void polygon_normal(real64 *norm, const PNGLayer *vtx, uint32 v0, uint32 v1, uint32 v2, uint32 v3)
+static void polygon_normal(real64 *norm, const real64 *vtx, uint32 v0, uint32 v1, uint32 v2)
 {
-	real64	p0[3], p1[3], p2[3], e0[3], e1[3], f;
+	const real64	*p0, *p1, *p2;
+	real64		e0[3], e1[3], f;
 
 	/* Retreive first three corners. Assume quads are flat, and ignore fourth corner. */
-	p_node_g_vertex_get_xyz(vtx, v0, p0, p0 + 1, p0 + 2);
-	p_node_g_vertex_get_xyz(vtx, v1, p1, p1 + 1, p1 + 2);
-	p_node_g_vertex_get_xyz(vtx, v2, p2, p2 + 1, p2 + 2);
+	p0 = vtx + 3 * v0;
+	p1 = vtx + 3 * v1;
+	p2 = vtx + 3 * v2;
 
 	/* Form "edge vectors", i.e. vectors from v0 to v1 and from v0 to v2. */
 	e0[0] = p1[0] - p0[0];
@@ -48,13 +49,12 @@ static void polygon_normal(real64 *norm, const PNGLayer *vtx, uint32 v0, uint32
 	norm[2] *= f;
 }
 
-/* Create buffer holding the proper weighted normal for each vertex of <vertex>. */
-static real64 * normal_buffer(const PNGLayer *vertex, const PNGLayer *polygon)
+/* Create buffer holding the proper weighted normal for each of the <numv> vertices in <vtx>. */
+static real64 * normal_buffer(const real64 *vtx, size_t numv, const uint32 *poly, size_t nump)
 {
-	size_t	numv, nump, i;
-	real64	*norm, pn[3], vtx[3], *p, f;
+	size_t	i;
+	real64	*norm, pn[3], *p, f;
 
-	numv = p_node_g_layer_get_size(vertex);
 	norm = malloc(numv * 3 * sizeof *norm);
 	if(norm == NULL)
 	{
@@ -66,15 +66,13 @@ static real64 * normal_buffer(const PNGLayer *vertex, const PNGLayer *polygon)
 		norm[i] = 0.0;
 
 	/* Go through all *polygons*, and compute normals as they occur, adding to the right vertex bucket(s). */
-	nump = p_node_g_layer_get_size(polygon);
-	for(i = 0; i < nump; i++)
+	for(i = 0; i < nump; i++, poly += 4)
 	{
-		uint32	v0, v1, v2, v3;
+		uint32	v0 = poly[0], v1 = poly[1], v2 = poly[2], v3 = poly[3];
 
-		p_node_g_polygon_get_corner_uint32(polygon, i, &v0, &v1, &v2, &v3);
-		polygon_normal(pn, vertex, v0, v1, v2, v3);
-		if(v0 == ~0u || v1 == ~0u || v2 == ~0u)
+		if(v0 >= numv || v1 >= numv || v2 >= numv)	/* Catches unset corners, too. */
 			continue;
+		polygon_normal(pn, vtx, v0, v1, v2);
 		norm[3 * v0 + 0] += pn[0];
 		norm[3 * v0 + 1] += pn[1];
 		norm[3 * v0 + 2] += pn[2];
@@ -84,7 +82,7 @@ static real64 * normal_buffer(const PNGLayer *vertex, const PNGLayer *polygon)
 		norm[3 * v2 + 0] += pn[0];
 		norm[3 * v2 + 1] += pn[1];
 		norm[3 * v2 + 2] += pn[2];
-		if(v3 != ~0u)
+		if(v3 < numv)
 		{
 			norm[3 * v3 + 0] += pn[0];
 			norm[3 * v3 + 1] += pn[1];
@@ -106,8 +104,10 @@ static PComputeStatus compute(PPInput *input, PPOutput output, void *state)
 {
 	PINode		*in = NULL, *inobj = NULL, *ingeo = NULL, *inbm = NULL;
 	PONode		*obj, *geo;
-	size_t		i, size;
-	real64		min[2], max[2], point[3], flat[2], v, scale, xr, yr;
+	size_t		i, size, nump;
+	real64		min[2], max[2], flat[2], v, scale, xr, yr, *out;
+	const real64	*vtx, *point;
+	const uint32	*poly;
 	PNGLayer	*inlayer, *outlayer, *inpoly;
 	const uint8	*pixel;
 	uint16		dim[3], x, y;
@@ -154,14 +154,14 @@ static PComputeStatus compute(PPInput *input, PPOutput output, void *state)
 	inlayer  = p_node_g_layer_find(ingeo, "vertex");
 	inpoly   = p_node_g_layer_find(ingeo, "polygon");
 	outlayer = p_node_g_layer_find(geo, "vertex");
-	size     = p_node_g_layer_get_size(inlayer);		/* Safely handles NULL layer. */
+	vtx      = p_node_g_layer_read_begin(ingeo, inlayer, &size);	/* Safely handles NULL layer. */
+	poly     = p_node_g_layer_read_begin(ingeo, inpoly, &nump);
 
 	/* Compute projected bounding box. */
 	min[0] = min[1] = 1E300;
 	max[0] = max[1] = -1E300;
-	for(i = 0; i < size; i++)
+	for(i = 0, point = vtx; i < size; i++, point += 3)
 	{
-		p_node_g_vertex_get_xyz(inlayer, i, point, point + 1, point + 2);
 		project_2d(flat, point);
 		if(flat[0] < min[0])
 			min[0] = flat[0];
@@ -184,21 +184,23 @@ static PComputeStatus compute(PPInput *input, PPOutput output, void *state)
 
 		p_node_b_get_dimensions(inbm, dim, dim + 1, dim + 2);
 		printf("displace: computing for %ux%u bitmap, and %u vertices\n", dim[0], dim[1], size);
-		if((norm = normal_buffer(inlayer, inpoly)) != NULL)
+		if((norm = normal_buffer(vtx, size, poly, nump)) != NULL)
 		{
-			for(i = 0; i < size; i++)
+			if((out = p_node_g_layer_access_begin(geo, outlayer, size)) != NULL)
 			{
-				p_node_g_vertex_get_xyz(inlayer, i, point, point + 1, point + 2);
-				project_2d(flat, point);
-				flat[0] = (flat[0] - min[0]) / xr;		/* Convert to UV space. */
-				flat[1] = (flat[1] - min[1]) / yr;
-				x = flat[0] * (dim[0] - 1);			/* Compute integer UV coordinates. */
-				y = flat[1] * (dim[1] - 1);
-				v = pixel[y * dim[0] + x] / 255.0;		/* Read out pixel, and scale it to [0,1] range. */
-				p_node_g_vertex_set_xyz(outlayer, i,		/* Apply displacement. */
-							point[0] + norm[3 * i + 0] * scale * v,
-							point[1] + norm[3 * i + 1] * scale * v,
-							point[2] + norm[3 * i + 2] * scale * v);
+				for(i = 0, point = vtx; i < size; i++, point += 3)
+				{
+					project_2d(flat, point);
+					flat[0] = (flat[0] - min[0]) / xr;		/* Convert to UV space. */
+					flat[1] = (flat[1] - min[1]) / yr;
+					x = flat[0] * (dim[0] - 1);			/* Compute integer UV coordinates. */
+					y = flat[1] * (dim[1] - 1);
+					v = pixel[y * dim[0] + x] / 255.0;		/* Read out pixel, and scale it to [0,1] range. */
+					out[3 * i + 0] = point[0] + norm[3 * i + 0] * scale * v;	/* Apply displacement. */
+					out[3 * i + 1] = point[1] + norm[3 * i + 1] * scale * v;
+					out[3 * i + 2] = point[2] + norm[3 * i + 2] * scale * v;
+				}
+				p_node_g_layer_access_end(geo, outlayer, out);
 			}
 			free(norm);
 		}
@@ -206,6 +208,8 @@ static PComputeStatus compute(PPInput *input, PPOutput output, void *state)
 	}
 	else
 		printf("displace: couldn't access bitmap for reading\n");
+	p_node_g_layer_read_end(ingeo, inpoly, poly);
+	p_node_g_layer_read_end(ingeo, inlayer, vtx);
 	return P_COMPUTE_DONE;
 }
 
@@ -222,4 +226,5 @@ PURPLE_PLUGIN void init(void)
 	p_init_meta("copyright", "2005 PDC, KTH");
 	p_init_meta("desc/purpose", "Displaces geometry, using a bitmap as a displacement map.");
 	p_init_compute(compute);
+	p_init_flags(P_PLUGIN_PURE | P_PLUGIN_REENTRANT);
 }
@@ -48,4 +48,5 @@ PURPLE_PLUGIN void init(void)
 	p_init_state(sizeof (State), ctor, NULL);
 	p_init_input(0, P_VALUE_UINT32, "n", P_INPUT_REQUIRED, P_INPUT_DONE);
 	p_init_compute(compute);
+	p_init_flags(P_PLUGIN_REENTRANT);
 }
@@ -49,4 +49,5 @@ PURPLE_PLUGIN void init(void)
 	p_init_meta("copyright", "2005 PDC, KTH");
 	p_init_meta("desc/purpose", "Retrieves the color of a given pixel in a bitmap, and outputs it as a 3D vector. Inputs control which color channel(s) are to be included.");
 	p_init_compute(compute);
+	p_init_flags(P_PLUGIN_PURE | P_PLUGIN_REENTRANT);
 }
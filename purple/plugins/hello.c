@@ -27,4 +27,5 @@ PURPLE_PLUGIN void init(void)
 	p_init_meta("desc/purpose", "Say hello to the world.");
 	p_init_meta("authors", "Emil Brink");
 	p_init_compute(compute);
+	p_init_flags(P_PLUGIN_SIDE_EFFECTS);
 }
@@ -177,7 +177,9 @@ static PComputeStatus geometry_math(PINode *a, PINode *b, real64 c, real64 d, PP
 	PONode		*obj, *geo;
 	const PNGLayer	*va, *vb;
 	PNGLayer	*lay;
-	unsigned int	i, sa, sb, size;
+	size_t		i, sa, sb, size;
+	const real64	*pa, *pb;
+	real64		*out;
 
 	ga = p_node_o_link_get(a, "geometry", NULL);
 	gb = p_node_o_link_get(b, "geometry", NULL);
@@ -198,7 +200,7 @@ static PComputeStatus geometry_math(PINode *a, PINode *b, real64 c, real64 d, PP
 		return P_COMPUTE_DONE;
 	size = va != NULL ? sa : sb;
 
-	printf(" sizes: %u and %u -> %u\n", sa, sb, size);
+	printf(" sizes: %u and %u -> %u\n", (unsigned int) sa, (unsigned int) sb, (unsigned int) size);
 
 	obj = p_output_node_create(output, V_NT_OBJECT, 0);
 	/* Compute a pretty name for the result. */
@@ -213,25 +215,33 @@ static PComputeStatus geometry_math(PINode *a, PINode *b, real64 c, real64 d, PP
 	p_node_o_link_set(obj, geo, "geometry", 0u);
 
 	lay = p_node_g_layer_find(geo, "vertex");
-	for(i = 0; i < size; i++)
+	pa  = p_node_g_layer_read_begin(ga, va, &sa);
+	pb  = p_node_g_layer_read_begin(gb, vb, &sb);
+	if((out = p_node_g_layer_access_begin(geo, lay, size)) != NULL)
 	{
-		real64	n[3], xyza[3], xyzb[3];
-
-		if(va != NULL)
-			p_node_g_vertex_get_xyz(va, i, xyza, xyza + 1, xyza + 2);
-		else
-			xyza[0] = xyza[1] = xyzb[2] = c;
-		if(vb != NULL)
-			p_node_g_vertex_get_xyz(vb, i, xyzb, xyzb + 1, xyzb + 2);
-		else
-			xyzb[0] = xyzb[1] = xyzb[2] = d;
-		op(xyza, xyzb);
-		p_node_g_vertex_set_xyz(lay, i, xyza[0], xyza[1], xyza[2]);
-		printf(" got (%g,%g,%g) and (%g,%g,%g)\n",
-		       xyza[0], xyza[1], xyza[2],
-		       xyzb[0], xyzb[1], xyzb[2]);
-		printf("  emitting vertex %u: (%g,%g,%g)\n", i, xyza[0], xyza[1], xyza[2]);
+		for(i = 0; i < size; i++)
+		{
+			real64	xyza[3], xyzb[3];
+
+			if(pa != NULL)
+				memcpy(xyza, pa + 3 * i, sizeof xyza);
+			else
+				xyza[0] = xyza[1] = xyzb[2] = c;
+			if(pb != NULL)
+				memcpy(xyzb, pb + 3 * i, sizeof xyzb);
+			else
+				xyzb[0] = xyzb[1] = xyzb[2] = d;
+			op(xyza, xyzb);
+			memcpy(out + 3 * i, xyza, sizeof xyza);
+			printf(" got (%g,%g,%g) and (%g,%g,%g)\n",
+			       xyza[0], xyza[1], xyza[2],
+			       xyzb[0], xyzb[1], xyzb[2]);
+			printf("  emitting vertex %u: (%g,%g,%g)\n", (unsigned int) i, xyza[0], xyza[1], xyza[2]);
+		}
+		p_node_g_layer_access_end(geo, lay, out);
 	}
+	p_node_g_layer_read_end(gb, vb, pb);
+	p_node_g_layer_read_end(ga, va, pa);
 	return P_COMPUTE_DONE;
 }
 
@@ -359,6 +369,7 @@ PURPLE_PLUGIN void init(void)
 	p_init_meta("copyright", "2005 PDC, KTH");
 	p_init_meta("desc/purpose", "Computes addition of two terms. The terms can be either real numbers, bitmaps, or object nodes with geometry links.");
 	p_init_compute(compute_add);
+	p_init_flags(P_PLUGIN_PURE | P_PLUGIN_REENTRANT);
 
 	p_init_create("sub");
 	p_init_input(0, P_VALUE_MODULE, "a", P_INPUT_DESC("The first term in the subtraction."), P_INPUT_REQUIRED, P_INPUT_DONE);
@@ -367,6 +378,7 @@ PURPLE_PLUGIN void init(void)
 	p_init_meta("copyright", "2005 PDC, KTH");
 	p_init_meta("desc/purpose", "Computes difference of two terms. The terms can be either real numbers, bitmaps, or object nodes with geometry links.");
 	p_init_compute(compute_sub);
+	p_init_flags(P_PLUGIN_PURE | P_PLUGIN_REENTRANT);
 
 	p_init_create("mul");
 	p_init_input(0, P_VALUE_MODULE, "a", P_INPUT_DESC("The first factor in the multiplication."), P_INPUT_REQUIRED, P_INPUT_DONE);
@@ -375,6 +387,7 @@ PURPLE_PLUGIN void init(void)
 	p_init_meta("copyright", "2005 PDC, KTH");
 	p_init_meta("desc/purpose", "Computes product of two factors. The factors can be either real numbers, bitmaps, or object nodes with geometry links.");
 	p_init_compute(compute_mul);
+	p_init_flags(P_PLUGIN_PURE | P_PLUGIN_REENTRANT);
 
 	p_init_create("div");
 	p_init_input(0, P_VALUE_MODULE, "a", P_INPUT_DESC("The nominator in the division."), P_INPUT_REQUIRED, P_INPUT_DONE);
@@ -383,4 +396,5 @@ PURPLE_PLUGIN void init(void)
 	p_init_meta("copyright", "2005 PDC, KTH");
 	p_init_meta("desc/purpose", "Computes quotient of nominator and denominators. These can be either real numbers, bitmaps, or object nodes with geometry links.");
 	p_init_compute(compute_div);
+	p_init_flags(P_PLUGIN_PURE | P_PLUGIN_REENTRANT);
 }
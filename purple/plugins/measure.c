@@ -9,7 +9,8 @@ static PComputeStatus compute(PPInput *input, PPOutput output, void *state)
 {
 	PINode		*in;
 	size_t		i, j, k, size;
-	real64		min[3] = { 1E20, 1E20, 1E20 }, max[3] = { -1E20, -1E20, -1E20 }, point[3];
+	real64		min[3] = { 1E20, 1E20, 1E20 }, max[3] = { -1E20, -1E20, -1E20 };
+	const real64	*vtx, *point;
 
 	for(i = 0; (in = p_input_node_nth(input[0], i)) != NULL; i++)
 	{
@@ -18,11 +19,10 @@ static PComputeStatus compute(PPInput *input, PPOutput output, void *state)
 		if(p_node_get_type(in) != V_NT_GEOMETRY)
 			continue;
 		layer = p_node_g_layer_find(in, "vertex");
-		size = p_node_g_layer_get_size(layer);		/* Safely handles NULL layer. */
-		for(j = 0; j < size; j++)
+		vtx = p_node_g_layer_read_begin(in, layer, &size);	/* Safely handles NULL layer. */
+		for(j = 0, point = vtx; j < size; j++, point += 3)
 		{
-			p_node_g_vertex_get_xyz(layer, j, point, point + 1, point + 2);
-			for(k = 0; k < sizeof point / sizeof *point; k++)
+			for(k = 0; k < 3; k++)
 			{
 				if(point[k] > max[k])
 					max[k] = point[k];
@@ -30,6 +30,7 @@ static PComputeStatus compute(PPInput *input, PPOutput output, void *state)
 					min[k] = point[k];
 			}
 		}
+		p_node_g_layer_read_end(in, layer, vtx);
 		for(k = 0; k < sizeof max / sizeof *max; k++)
 			max[k] -= min[k];
 		p_output_real64_vec3(output, max);
@@ -43,4 +44,5 @@ PURPLE_PLUGIN void init(void)
 	p_init_create("measure");
 	p_init_input(0, P_VALUE_MODULE, "data", P_INPUT_REQUIRED, P_INPUT_DONE);
 	p_init_compute(compute);
+	p_init_flags(P_PLUGIN_PURE | P_PLUGIN_REENTRANT);
 }
@@ -20,21 +20,22 @@
 static void planar_scale(PONode *geo, real64 factor)
 {
 	PNGLayer	*xyz;
-	unsigned int	i, size;
-	real64		p[3];
+	size_t		i, size;
+	real64		*vtx, *p;
 
 	printf("rescaling by %g\n", factor);
 	xyz = p_node_g_layer_find(geo, "vertex");
 	if(xyz == NULL)
 		return;
 	size = p_node_g_layer_get_size(xyz);
-	for(i = 0; i < size; i++)
+	if((vtx = p_node_g_layer_access_begin(geo, xyz, size)) == NULL)
+		return;
+	for(i = 0, p = vtx; i < size; i++, p += 3)
 	{
-		p_node_g_vertex_get_xyz(xyz, i, p + 0, p + 1, p + 2);
 		p[0] *= factor;
 		p[1] *= factor;
-		p_node_g_vertex_set_xyz(xyz, i, p[0], p[1], p[2]);
 	}
+	p_node_g_layer_access_end(geo, xyz, vtx);
 }
 
 static PComputeStatus compute(PPInput *input, PPOutput output, void *state)
@@ -99,4 +100,5 @@ PURPLE_PLUGIN void init(void)
 	p_init_input(0, P_VALUE_MODULE, "upper", P_INPUT_REQUIRED, 0, P_INPUT_DONE);
 	p_init_input(1, P_VALUE_MODULE, "lower", P_INPUT_REQUIRED, 1, P_INPUT_DONE);
 	p_init_compute(compute);
+	p_init_flags(P_PLUGIN_PURE | P_PLUGIN_REENTRANT);
 }
@@ -69,4 +69,5 @@ PURPLE_PLUGIN void init(void)
 	p_init_input(5, P_VALUE_MODULE, "object",	P_INPUT_REQUIRED, P_INPUT_DESC("First object found here will be cloned and made to orbit."), P_INPUT_DONE);
 	p_init_input(6, P_VALUE_REAL32_VEC3, "origin",	P_INPUT_REQUIRED, P_INPUT_DEFAULT_VEC3(0.0, 0.0, 0.0), P_INPUT_DONE);
 	p_init_compute(compute);
+	p_init_flags(P_PLUGIN_PURE | P_PLUGIN_REENTRANT);
 }
@@ -16,18 +16,18 @@ static PComputeStatus compute(PPInput *input, PPOutput output, void *state)
 	{
 		PONode	*out;
 		PNGLayer *layer;
+		real64	*vtx;
 
 		if(p_node_get_type(in) != V_NT_GEOMETRY)
 			continue;
 		out   = p_output_node(output, in);
 		layer = p_node_g_layer_find(out, "vertex");
 		size  = p_node_g_layer_get_size(layer);	/* Safely handles NULL layer. */
-		for(j = 0; j < size; j++)
-		{
-			real64	x, y, z;
-			p_node_g_vertex_get_xyz(layer, j, &x, &y, &z);
-			p_node_g_vertex_set_xyz(layer, j, scale * x, scale * y, scale * z);
-		}
+		if((vtx = p_node_g_layer_access_begin(out, layer, size)) == NULL)
+			continue;
+		for(j = 0; j < 3 * size; j++)
+			vtx[j] *= scale;
+		p_node_g_layer_access_end(out, layer, vtx);
 	}
 	return P_COMPUTE_DONE;	/* Sleep until scale changes. */
 }
@@ -38,4 +38,5 @@ PURPLE_PLUGIN void init(void)
 	p_init_input(0, P_VALUE_MODULE, "data",  P_INPUT_REQUIRED, P_INPUT_DONE);
 	p_init_input(1, P_VALUE_REAL32, "scale", P_INPUT_REQUIRED, P_INPUT_DONE);
 	p_init_compute(compute);
+	p_init_flags(P_PLUGIN_PURE | P_PLUGIN_REENTRANT);
 }
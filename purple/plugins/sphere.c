@@ -54,6 +54,7 @@ static PComputeStatus compute(PPInput *input, PPOutput output, void *state)
 
 	/* Create outer vertices. */
 	lay = p_node_g_layer_find(geo, "vertex");
+	p_node_g_layer_reserve(lay, (quad_levels + 1) * end_splits + 2);
 	for(j = 0; j <= quad_levels; j++)
 	{
 		y = radius * sin(-M_PI/2 + M_PI * (j + 1) / side_splits);
@@ -70,6 +71,7 @@ static PComputeStatus compute(PPInput *input, PPOutput output, void *state)
 	p_node_g_vertex_set_xyz(lay, tc, 0.0, radius,  0.0);
 
 	lay = p_node_g_layer_find(geo, "polygon");
+	p_node_g_layer_reserve(lay, (quad_levels + 2) * end_splits);
 	/* Create bottom triangles. */
 	for(i = 0; i < end_splits; i++)
 		POLY("bottom triangle", lay, i, i, (i + 1) % end_splits, bc, ~0u);
@@ -154,4 +156,5 @@ PURPLE_PLUGIN void init(void)
 	p_init_meta("desc/purpose", "Creates a polygonal mesh representation of a sphere. Lets you control how finely the mesh should be "
 		    "tesselated along two axis.");
 	p_init_compute(compute);
+	p_init_flags(P_PLUGIN_PURE | P_PLUGIN_REENTRANT);
 }
@@ -79,12 +79,14 @@ PURPLE_PLUGIN void init(void)
 	p_init_input(0, P_VALUE_STRING, "str", P_INPUT_REQUIRED, P_INPUT_DONE);
 	p_init_meta("desc/purpose", "Compute length of string (number of characters)");
 	p_init_compute(strlength_compute);
+	p_init_flags(P_PLUGIN_PURE | P_PLUGIN_REENTRANT);
 
 	p_init_create("str-join");
 	p_init_input(0, P_VALUE_STRING, "str1", P_INPUT_REQUIRED, P_INPUT_DONE);
 	p_init_input(1, P_VALUE_STRING, "str2", P_INPUT_DONE);
 	p_init_meta("desc/purpose", "Join (concatenate) two strings, outputting the result.");
 	p_init_compute(strjoin_compute);
+	p_init_flags(P_PLUGIN_PURE | P_PLUGIN_REENTRANT);
 
 	p_init_create("str-cut");
 	p_init_input(0, P_VALUE_STRING, "str", P_INPUT_REQUIRED,
@@ -97,4 +99,5 @@ PURPLE_PLUGIN void init(void)
 				  "exceeds the number of characters available at the starting point, the substring will end at the input's end."), P_INPUT_DONE);
 	p_init_meta("desc/purpose", "Cut out a substring from a string, and output that.");
 	p_init_compute(strcut_compute);
+	p_init_flags(P_PLUGIN_PURE | P_PLUGIN_REENTRANT);
 }
@@ -60,4 +60,5 @@ PURPLE_PLUGIN void init(void)
 	p_init_create("tagtest");
 	p_init_input(0, P_VALUE_UINT32, "mode", P_INPUT_REQUIRED, P_INPUT_DONE);
 	p_init_compute(compute);
+	p_init_flags(P_PLUGIN_SIDE_EFFECTS);
 }
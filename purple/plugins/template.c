@@ -44,6 +44,8 @@ PURPLE_PLUGIN void init(void)
 	p_init_meta("desc/purpose", "Shows wanna-be developers how to use the Purple API.");
 	/* Register state structure size, and constructor/destructor functions. */
 	p_init_state(sizeof (State), ctor, dtor);
-	/* Finally register the compute() callback. */
+	/* Register the compute() callback. */
 	p_init_compute(compute);
+	/* Finally tell Purple it's safe to run in parallel. Not pure, since state carries over. */
+	p_init_flags(P_PLUGIN_REENTRANT);
 }
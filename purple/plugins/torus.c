@@ -39,6 +39,7 @@ static PComputeStatus compute(PPInput *input, PPOutput output, void *state)
 
 	/* First, generate the vertices. */
 	lay = p_node_g_layer_find(geo, "vertex");
+	p_node_g_layer_reserve(lay, s1 * s2);
 	for(i = 0; i < s1; i++)
 	{
 		real64	oa = i * (2 * M_PI / s1);
@@ -56,6 +57,7 @@ static PComputeStatus compute(PPInput *input, PPOutput output, void *state)
 
 	/* Then the polygons. This is pretty simple! */
 	lay = p_node_g_layer_find(geo, "polygon");
+	p_node_g_layer_reserve(lay, s1 * s2);
 	for(i = 0; i < s1; i++)
 	{
 		next = (i + 1) % s1;
@@ -114,4 +116,5 @@ PURPLE_PLUGIN void init(void)
 	p_init_meta("copyright", "2005 PDC, KTH");
 	p_init_meta("desc/purpose", "This plug-in generates a torus shape with the given parameters.");
 	p_init_compute(compute);
+	p_init_flags(P_PLUGIN_PURE | P_PLUGIN_REENTRANT);
 }
@@ -43,7 +43,7 @@ static PComputeStatus compute(PPInput *input, PPOutput output, void *state)
 	PONode		*obj, *geo;
 	size_t		i, j, k, size;
 	const real64	*min, *max;
-	real64		point[3], ytot, yrel, yrelprev, matrix[9], twist;
+	real64		*vtx, *point, ytot, yrel, yrelprev, matrix[9], twist;
 
 	max   = p_input_real64_vec3(input[1]);
 	min   = p_input_real64_vec4(input[1]);
@@ -56,7 +56,7 @@ static PComputeStatus compute(PPInput *input, PPOutput output, void *state)
 
 	for(i = 0; (in = p_input_node_nth(input[0], i)) != NULL; i++)
 	{
-		PNGLayer *inlayer, *outlayer;
+		PNGLayer *outlayer;
 
 		if(p_node_get_type(in) != V_NT_OBJECT)
 			continue;
@@ -67,20 +67,20 @@ static PComputeStatus compute(PPInput *input, PPOutput output, void *state)
 		geo = p_output_node_copy(output, ingeo, 1);
 		p_node_o_link_set(obj, geo, "geometry", 0);
 
-		inlayer  = p_node_g_layer_find(ingeo, "vertex");
-		outlayer = p_node_g_layer_find(geo, "vertex");
-		size  = p_node_g_layer_get_size(inlayer);		/* Safely handles NULL layer. */
-		for(j = 0, yrelprev = -1E20; j < size; j++, yrelprev = yrel)
+		outlayer = p_node_g_layer_find(geo, "vertex");	/* Output is a copy, so warp it in place. */
+		size  = p_node_g_layer_get_size(outlayer);		/* Safely handles NULL layer. */
+		if((vtx = p_node_g_layer_access_begin(geo, outlayer, size)) == NULL)
+			break;
+		for(j = 0, point = vtx, yrelprev = -1E20; j < size; j++, point += 3, yrelprev = yrel)
 		{
-			p_node_g_vertex_get_xyz(inlayer, j, point, point + 1, point + 2);
 			yrel = (point[1] - min[1]) / ytot;
 			if(yrel != yrelprev)
 				rot_matrix_build_y(matrix, yrel * twist);
 /*			printf(" point (%g,%g,%g) gets yrel=%g -> ", point[0], point[1], point[2], yrel);*/
 			point_rotate(point, matrix);
 /*			printf("warped into (%g,%g,%g)\n", point[0], point[1], point[2]);*/
-			p_node_g_vertex_set_xyz(outlayer, j, point[0], point[1], point[2]);								    
 		}
+		p_node_g_layer_access_end(geo, outlayer, vtx);
 		break;
 	}
 	return P_COMPUTE_DONE;
@@ -100,4 +100,5 @@ PURPLE_PLUGIN void init(void)
 		    "warping is done along the vertical (Y) axis, and goes from zero degrees at the bottom "
 		    "(lowest value of Y) to a configurable value at the top (highest value of Y).");
 	p_init_compute(compute);
+	p_init_flags(P_PLUGIN_PURE | P_PLUGIN_REENTRANT);
 }
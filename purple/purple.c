@@ -72,19 +72,25 @@
 #include "cron.h"
 #include "dynarr.h"
 #include "dynlib.h"
+#include "dynstr.h"
 #include "filelist.h"
 #include "hash.h"
 #include "idlist.h"
 #include "idset.h"
 #include "idtree.h"
+#include "layerscan.h"
 #include "log.h"
 #include "mem.h"
 #include "memchunk.h"
+#include "outbuf.h"
 #include "plugins.h"
+#include "memo.h"
 #include "scheduler.h"
 #include "synchronizer.h"
 #include "textbuf.h"
+#include "timeval.h"
 #include "value.h"
+#include "workers.h"
 #include "xmlnode.h"
 #include "xmlutil.h"
 
@@ -93,8 +99,53 @@
 #include "graph.h"
 #include "resume.h"
 
+#define	LOOP_WAIT_MAX	0.1	/* Longest sleep in seconds. Input on the console can't wake us up. */
+
+static struct
+{
+	unsigned long	iterations;
+	unsigned long	sleeps;		/* Iterations that were allowed to wait for Verse traffic. */
+	double		verse;		/* Seconds spent in Verse, waiting for or handling events. */
+	double		busy;		/* Seconds spent doing everything else. */
+} loop_info;
+
+/* Find how long the main loop can wait for Verse traffic, before anything else needs doing. */
+static double loop_timeout(void)
+{
+	double	wait = LOOP_WAIT_MAX, next;
+
+	if(sched_pending() > 0)
+		return 0.0;
+	if(cron_next(&next) && next < wait)
+		wait = next;
+	if(sync_next(&next) && next < wait)
+		wait = next;
+	return wait;
+}
+
 #if defined PURPLE_CONSOLE
 
+static void loop_stats_print(void)
+{
+	double	total = loop_info.verse + loop_info.busy;
+
+	printf("loop: %lu iterations, %lu allowed to sleep; %.1f s in Verse, %.1f s busy (%.1f%%)\n",
+	       loop_info.iterations, loop_info.sleeps, loop_info.verse, loop_info.busy,
+	       total > 0.0 ? 100.0 * loop_info.busy / total : 0.0);
+}
+
+/* Edits to a graph are collected here, rather than sent, between "bb" and "be" commands. */
+static struct
+{
+	DynStr	*ops;
+	uint32	graph;
+} console_batch;
+
+static boolean console_batching(uint32 graph_id)
+{
+	return console_batch.ops != NULL && graph_id == console_batch.graph;
+}
+
 static void console_parse_module_input_set(const char *line)
 {
 	char		tcode[4];
@@ -274,7 +325,9 @@ static void console_parse_module_input_set(const char *line)
 	default:
 		;
 	}
-	if(got == 1)
+	if(got == 1 && console_batching(g))
+		graph_batch_append_mod_input_set(console_batch.ops, m, i, type, &value);
+	else if(got == 1)
 		graph_method_send_call_mod_input_set(g, m, i, type, &value);
 	else
 		printf("mis couldn't parse %s as type %c (%d) literal\n", literal, tcode[0], type);
@@ -333,6 +386,12 @@ static int console_script(char *line, size_t line_size)
 	return 0;
 }
 
+static int cb_node_list(PNode *node, void *user)
+{
+	printf("%6u %-24s type %d\n", node->id, node->name, node->type);
+	return 1;
+}
+
 #endif		/* PURPLE_CONSOLE */
 
 static int console_update(void)
@@ -345,8 +404,8 @@ static int console_update(void)
 	fd = fileno(stdin);
 	FD_ZERO(&fds);
 	FD_SET(fd, &fds);
-	timeout.tv_sec  = 0;
-	timeout.tv_usec = 1000;
+	timeout.tv_sec  = 0;		/* Just poll, the main loop sleeps in Verse. */
+	timeout.tv_usec = 0;
 	if(select(fd + 1, &fds, NULL, NULL, &timeout))
 	{
 		char	line[1024];
@@ -379,14 +438,24 @@ static int console_update(void)
 				uint32	g, p;
 
 				if(sscanf(line, "mc %u %u", &g, &p) == 2)
-					graph_method_send_call_mod_create(g, p);
+				{
+					if(console_batching(g))
+						graph_batch_append_mod_create(console_batch.ops, p);
+					else
+						graph_method_send_call_mod_create(g, p);
+				}
 			}
 			else if(strncmp(line, "md ", 3) == 0)
 			{
 				uint32	g, p;
 
 				if(sscanf(line, "md %u %u", &g, &p) == 2)
-					graph_method_send_call_mod_destroy(g, p);
+				{
+					if(console_batching(g))
+						graph_batch_append_mod_destroy(console_batch.ops, p);
+					else
+						graph_method_send_call_mod_destroy(g, p);
+				}
 			}
 			else if(strncmp(line, "mis", 3) == 0)
 				console_parse_module_input_set(line);
@@ -395,7 +464,35 @@ static int console_update(void)
 				uint32	g, m, i;
 
 				if(sscanf(line, "mic %u %u %u", &g, &m, &i) == 3)
-					graph_method_send_call_mod_input_clear(g, m, i);
+				{
+					if(console_batching(g))
+						graph_batch_append_mod_input_clear(console_batch.ops, m, i);
+					else
+						graph_method_send_call_mod_input_clear(g, m, i);
+				}
+			}
+			else if(strncmp(line, "bb ", 3) == 0)
+			{
+				uint32	g;
+
+				if(console_batch.ops != NULL)
+					printf("Already building a batch for graph %u, use \"be\" to send it\n", console_batch.graph);
+				else if(sscanf(line, "bb %u", &g) == 1)
+				{
+					console_batch.ops = dynstr_new_sized(256);
+					console_batch.graph = g;
+				}
+			}
+			else if(strcmp(line, "be") == 0)
+			{
+				if(console_batch.ops != NULL)
+				{
+					graph_method_send_call_batch(console_batch.graph, console_batch.ops);
+					dynstr_destroy(console_batch.ops, 1);
+					console_batch.ops = NULL;
+				}
+				else
+					printf("No batch to send, use \"bb GRAPH\" to begin one\n");
 			}
 			else if(strncmp(line, "nc ", 3) == 0)
 			{
@@ -419,6 +516,8 @@ static int console_update(void)
 				if(sscanf(line, "nns %u %s", &node, name) == 2)
 					verse_send_node_name_set(node, name);
 			}
+			else if(strncmp(line, "nl ", 3) == 0)
+				printf("%u nodes\n", nodedb_lookup_by_name_glob(line + 3, cb_node_list, NULL));
 			else if(strncmp(line, "pl", 2) == 0)
 			{
 				unsigned int	i;
@@ -427,6 +526,40 @@ static int console_update(void)
 				for(i = 1; (p = plugin_lookup(i)) != NULL; i++)
 					printf("%2d: %s\n", i, plugin_name(p));
 			}
+			else if(strcmp(line, "ss") == 0)
+			{
+				SchedStats	ss;
+
+				sched_stats_get(&ss);
+				printf("scheduler: %lu added, %lu computes in %lu waves; avoided %lu (%lu coalesced, %lu deferred)\n",
+				       ss.added, ss.computes, ss.waves, ss.coalesced + ss.deferred, ss.coalesced, ss.deferred);
+			}
+			else if(strncmp(line, "gs ", 3) == 0)
+			{
+				uint32	id;
+
+				if(sscanf(line, "gs %u", &id) == 1)
+					graph_stats_print(id);
+			}
+			else if(strcmp(line, "ls") == 0)
+				loop_stats_print();
+			else if(strcmp(line, "os") == 0)
+			{
+				OutbufStats	os;
+
+				outbuf_stats_get(&os);
+				printf("outbuf: %lu commands sent of %lu, saved %lu; last flush sent %lu of %lu, saved %lu\n",
+				       os.sent, os.queued, os.queued - os.sent, os.last_sent, os.last_queued, os.last_queued - os.last_sent);
+			}
+			else if(strcmp(line, "ms") == 0)
+			{
+				MemoStats	ms;
+
+				memo_stats_get(&ms);
+				printf("memo: %lu hits, %lu misses, %lu evictions; %lu entries in %lu of %lu KB\n",
+				       ms.hits, ms.misses, ms.evictions, (unsigned long) ms.entries,
+				       (unsigned long) (ms.bytes + 1023) / 1024, (unsigned long) ms.limit / 1024);
+			}
 			else if(strncmp(line, "tbc ", 4) == 0)
 			{
 				VNodeID	node;
@@ -526,6 +659,7 @@ int main(int argc, char *argv[])
 	cron_init();
 	dynarr_init();
 	hash_init();
+	layerscan_init();
 	list_init();
 
 /*	{
@@ -549,6 +683,8 @@ int main(int argc, char *argv[])
 */
 	plugins_init("plugins");
 	graph_init();
+	memo_init();
+	outbuf_init();
 	
 	plugins_libraries_load();
 	plugins_libraries_init();
@@ -558,8 +694,19 @@ int main(int argc, char *argv[])
 	{
 		if(strncmp(argv[i], "-ip=", 4) == 0)
 			server = argv[i] + 4;
+		else if(strncmp(argv[i], "-threads=", 9) == 0)
+			workers_init(strtoul(argv[i] + 9, NULL, 10));
+		else if(strncmp(argv[i], "-memo=", 6) == 0)
+			memo_limit_set(1024 * strtoul(argv[i] + 6, NULL, 10));
 		else if(strcmp(argv[i], "-resume") == 0 || strncmp(argv[i], "-resume=", 9) == 0)
 			resume_init(argv[i][7] == '=' ? argv[i] + 8 : NULL);
+		else if(strncmp(argv[i], "-syncbudget=", 12) == 0)
+			sync_budget_set(1024 * strtoul(argv[i] + 12, NULL, 10));
+		else if(strncmp(argv[i], "-syncpriority=", 14) == 0)
+		{
+			if(!sync_priority_set(argv[i] + 14))
+				LOG_WARN(("Couldn't parse synchronizer priorities \"%s\", use e.g. \"object:0,geometry:2\"", argv[i] + 14));
+		}
 	}
 
 	client_init();
@@ -572,12 +719,24 @@ int main(int argc, char *argv[])
 		LOG_MSG(("Entering main loop"));
 		for(;;)
 		{
-			verse_callback_update(10000);
+			TimeVal	t;
+			double	wait = loop_timeout();
+
+			timeval_now(&t);
+			verse_callback_update((uint32) (1E6 * wait));
+			loop_info.verse += timeval_elapsed(&t, NULL);
+			if(wait > 0.0)
+				loop_info.sleeps++;
+			timeval_now(&t);
 			cron_update();
 			if(!console_update())
 				break;
 			sched_update();
+			graph_update();
 			sync_update(1.0);
+			outbuf_flush();
+			loop_info.busy += timeval_elapsed(&t, NULL);
+			loop_info.iterations++;
 		}
 	}
 	return EXIT_SUCCESS;
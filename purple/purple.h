@@ -167,6 +167,21 @@ typedef enum
 
 PURPLEAPI void		p_init_compute(PComputeStatus (*compute)(PPInput *input, PPOutput output, void *state));
 
+/** \brief Flags describing a plug-in's \c compute() callback.
+ *
+ * Values of this type are or:ed together and passed to \c p_init_flags(), to tell the Purple
+ * engine what it can safely do with a plug-in's computations. A plug-in that declares no flags
+ * is only ever run on the main thread, and its results are never re-used.
+*/
+typedef enum
+{
+	P_PLUGIN_PURE		= (1 << 0),	/* Output depends on nothing but the inputs. */
+	P_PLUGIN_REENTRANT	= (1 << 1),	/* compute() touches only inputs, output and state; no globals. */
+	P_PLUGIN_SIDE_EFFECTS	= (1 << 2)	/* compute() affects things beyond its output. Overrides the others. */
+} PPluginFlags;
+
+PURPLEAPI void		p_init_flags(uint32 flags);
+
 
 /* Read out inputs, registered earlier. One for each type. :/ If this wasn't in C, we could use meta
  * information to just say p_input(input) and have it return a value of the proper registered type.
@@ -198,6 +213,7 @@ PURPLEAPI VNodeType		p_node_get_type(PINode *node);
 
 PURPLEAPI const char *		p_node_get_name(const PNode *node);
 PURPLEAPI void			p_node_set_name(PONode *node, const char *name);
+PURPLEAPI unsigned int		p_node_find_glob(const char *pattern, int (*func)(PINode *node, void *user), void *user);
 
 /** An opaque data type. Use API functions to access it. */
 typedef void	PNTagGroup, PNTag;
@@ -251,6 +267,11 @@ PURPLEAPI PNGLayer *		p_node_g_layer_find(PINode *node, const char *name);
 PURPLEAPI size_t		p_node_g_layer_get_size(const PNGLayer *layer);
 PURPLEAPI const char *		p_node_g_layer_get_name(const PNGLayer *layer);
 PURPLEAPI VNGLayerType		p_node_g_layer_get_type(const PNGLayer *layer);
+PURPLEAPI void			p_node_g_layer_reserve(PNGLayer *layer, size_t size);
+PURPLEAPI const void *		p_node_g_layer_read_begin(PINode *node, const PNGLayer *layer, size_t *size);
+PURPLEAPI void			p_node_g_layer_read_end(PINode *node, const PNGLayer *layer, const void *data);
+PURPLEAPI void *		p_node_g_layer_access_begin(PONode *node, PNGLayer *layer, size_t size);
+PURPLEAPI void			p_node_g_layer_access_end(PONode *node, PNGLayer *layer, void *data);
 
 PURPLEAPI PNGLayer *		p_node_g_layer_create(PONode *node, const char *name, VNGLayerType type,
 						      uint32 def_int, real64 def_real);
@@ -379,6 +400,7 @@ PURPLEAPI real64		p_node_c_curve_key_get_pos(const PNCKey *key);
 PURPLEAPI real64		p_node_c_curve_key_get_value(const PNCKey *key, uint8 dimension);
 PURPLEAPI uint32		p_node_c_curve_key_get_pre(const PNCKey *key, uint8 dimension, real64 *value);
 PURPLEAPI uint32		p_node_c_curve_key_get_post(const PNCKey *key, uint8 dimension, real64 *value);
+PURPLEAPI real64		p_node_c_curve_evaluate(const PNCCurve *curve, uint8 dimension, real64 pos, unsigned int *hint);
 PURPLEAPI PNCKey *		p_node_c_curve_key_create(PNCCurve *curve, real64 pos, const real64 *value,
 							  const uint32 *pre_pos, const real64 *pre_value,
 							  const uint32 *post_pos, const real64 *post_value);
@@ -4,6 +4,17 @@
  * Copyright (C) 2004 PDC, KTH. See COPYING for license details.
  * 
  * A scheduler. Sounds a lot more sophisticated than it really is, at this point.
+ *
+ * Tasks are kept sorted on their module's topological position in its graph, and run
+ * in that order. A task is held back while any task it depends on is still pending,
+ * so that a change upstream causes each module downstream to compute once, not once
+ * per path the change travels along. One pass over the ready tasks is called a wave.
+ *
+ * If worker threads are running, consecutive runnable tasks are handed to them as a batch.
+ * Only compute() runs on the workers; results are committed in order on the main thread.
+ *
+ * Instances of pure plug-ins have their outputs remembered by the memo cache. Before such a
+ * task is first run, the cache is checked, and on a hit the task completes without compute().
 */
 
 #include <stdio.h>
@@ -12,13 +23,17 @@
 #include "purple.h"
 
 #include "dynarr.h"
+#include "hash.h"
 #include "list.h"
 #include "log.h"
+#include "mem.h"
 #include "memchunk.h"
 #include "plugins.h"
+#include "memo.h"
 #include "textbuf.h"
 #include "timeval.h"
 #include "value.h"
+#include "workers.h"
 
 #include "nodedb.h"
 #include "graph.h"
@@ -29,39 +44,260 @@ typedef struct
 {
 	PInstance	*inst;
 	unsigned long	count;		/* Counts number of times compute() has been run. */
+	const Graph	*graph;		/* Graph and topological position in it, the sort key. */
+	unsigned int	order;
+	boolean		done;		/* Set when compute() has stopped, task is freed on next compaction. */
+	boolean		deferred;	/* Set the first time the task is held back by an upstream task. */
+	PluginStatus	result;		/* Result of latest compute(), when run by a worker. */
 } Task;
 
 static struct
 {
 	MemChunk	*chunk_task;
-	List		*ready;
-	List		*ready_iter;	/* Remembers position in ready-list between update()s. */
+	Hash		*pending;	/* Tasks not yet done, hashed on instance. Catches duplicates. */
+	Task		**ready;	/* All tasks, sorted in dependency order. */
+	size_t		ready_size, ready_alloc;
+	size_t		ready_pos;	/* Remembers position in ready-array between update()s. */
+	boolean		resort;		/* Set when tasks have been added since the last sort. */
+	unsigned int	order_serial;	/* Graph order serial number at the time of the last sort. */
+	SchedStats	stats;
 } sched_info;
 
 /* ----------------------------------------------------------------------------------------- */
 
-static int cmp_task_by_inst(const void *listdata, const void *data)
-{
-	const Task	*t = listdata;
-
-	return t->inst < (PInstance *) data ? -1 : t->inst > (PInstance *) data;
-}
-
 void sched_add(PInstance *inst)
 {
 	Task	*t;
 
-	if(list_find_custom(sched_info.ready, inst, cmp_task_by_inst) != NULL)
+	if(sched_info.pending == NULL)
+		sched_info.pending = hash_new_int();
+	if((t = hash_lookup(sched_info.pending, inst)) != NULL)
+	{
+		if(t->count == 0)		/* Not run yet, so it will see the new input anyway. */
+			sched_info.stats.coalesced++;
 		return;
+	}
 	if(sched_info.chunk_task == NULL)
 		sched_info.chunk_task = memchunk_new("Task", sizeof (Task), 16);
 	if((t = memchunk_alloc(sched_info.chunk_task)) == NULL)
 		return;
-	t->inst  = inst;
-	t->count = 0;
-	sched_info.ready = list_append(sched_info.ready, t);
-	LOG_MSG(("Added %s to ready-list, there are now %u ready tasks", plugin_name(inst->plugin), list_length(sched_info.ready)));
-	sched_info.ready_iter = NULL;
+	if(sched_info.ready_size >= sched_info.ready_alloc)
+	{
+		size_t	na = sched_info.ready_alloc > 0 ? 2 * sched_info.ready_alloc : 16;
+		Task	**nr;
+
+		if((nr = mem_realloc(sched_info.ready, na * sizeof *nr)) == NULL)
+		{
+			memchunk_free(sched_info.chunk_task, t);
+			return;
+		}
+		sched_info.ready = nr;
+		sched_info.ready_alloc = na;
+	}
+	t->inst     = inst;
+	t->count    = 0;
+	t->done     = FALSE;
+	t->deferred = FALSE;
+	graph_port_output_order(inst->output, &t->graph, &t->order);
+	sched_info.ready[sched_info.ready_size++] = t;
+	hash_insert(sched_info.pending, inst, t);
+	sched_info.resort = TRUE;
+	sched_info.stats.added++;
+	LOG_MSG(("Added %s to ready-list, there are now %u ready tasks", plugin_name(inst->plugin), hash_size(sched_info.pending)));
+}
+
+unsigned int sched_pending(void)
+{
+	return sched_info.pending != NULL ? (unsigned int) hash_size(sched_info.pending) : 0;
+}
+
+void sched_stats_get(SchedStats *stats)
+{
+	if(stats != NULL)
+		*stats = sched_info.stats;
+}
+
+/* ----------------------------------------------------------------------------------------- */
+
+static int cmp_task_order(const Task *t1, const Task *t2)
+{
+	if(t1->graph != t2->graph)
+		return t1->graph < t2->graph ? -1 : 1;
+	return t1->order < t2->order ? -1 : t1->order > t2->order;
+}
+
+static int cmp_task(const void *p1, const void *p2)
+{
+	return cmp_task_order(*(const Task **) p1, *(const Task **) p2);
+}
+
+/* Drop finished tasks from the ready-array, adjusting the current position to match. */
+static void ready_compact(void)
+{
+	size_t	i, j, pos = sched_info.ready_pos;
+
+	for(i = j = 0; i < sched_info.ready_size; i++)
+	{
+		Task	*t = sched_info.ready[i];
+
+		if(t->done)
+		{
+			memchunk_free(sched_info.chunk_task, t);
+			if(i < sched_info.ready_pos)
+				pos--;
+		}
+		else
+			sched_info.ready[j++] = t;
+	}
+	sched_info.ready_size = j;
+	sched_info.ready_pos  = pos;
+}
+
+/* Re-sort the ready-array, if tasks were added or graph links changed. Keeps the wave
+ * going where it was, i.e. tasks ordered after <last> still get to run in this wave.
+*/
+static void ready_sort(const Task *last)
+{
+	size_t	i;
+
+	if(!sched_info.resort && sched_info.order_serial == graph_order_serial())
+		return;
+	ready_compact();
+	if(sched_info.order_serial != graph_order_serial())
+	{
+		for(i = 0; i < sched_info.ready_size; i++)
+			graph_port_output_order(sched_info.ready[i]->inst->output, &sched_info.ready[i]->graph, &sched_info.ready[i]->order);
+		sched_info.order_serial = graph_order_serial();
+	}
+	qsort(sched_info.ready, sched_info.ready_size, sizeof *sched_info.ready, cmp_task);
+	sched_info.resort = FALSE;
+
+	sched_info.ready_pos = 0;
+	if(last != NULL)
+	{
+		while(sched_info.ready_pos < sched_info.ready_size && cmp_task_order(sched_info.ready[sched_info.ready_pos], last) <= 0)
+			sched_info.ready_pos++;
+	}
+}
+
+/* Check if the task at <pos> must wait, because a task it depends on is still pending. Only
+ * tasks earlier in the same graph can be upstream, and those are right before it in the array.
+*/
+static boolean task_blocked(size_t pos)
+{
+	const Task	*t = sched_info.ready[pos], *up;
+
+	while(pos-- > 0)
+	{
+		up = sched_info.ready[pos];
+		if(up->graph != t->graph)
+			break;
+		if(!up->done && graph_port_output_reaches(up->inst->output, t->inst->output))
+			return TRUE;
+	}
+	return FALSE;
+}
+
+/* Check if the task at <pos> can run right now. Tasks that can't are stepped over. */
+static boolean task_runnable(size_t pos)
+{
+	Task	*task = sched_info.ready[pos];
+
+	if(task->done)
+		return FALSE;
+	if(task_blocked(pos))
+	{
+		if(!task->deferred)		/* Would have computed on stale input, and again later. */
+		{
+			task->deferred = TRUE;
+			sched_info.stats.deferred++;
+		}
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/* Run a single task's compute(), and time it. Called on worker threads, so mustn't touch scheduler state. */
+static void task_compute(void *job)
+{
+	Task	*task = job;
+	TimeVal	t1;
+
+	timeval_now(&t1);
+	task->result = plugin_instance_compute(task->inst);
+	printf("Spent %g seconds running compute() of %s\n", timeval_elapsed(&t1, NULL), plugin_name(task->inst->plugin));
+}
+
+/* Bookkeeping after a compute(). Must be done on main thread, since it notifies dependants. */
+static void task_commit(Task *task)
+{
+	if(task->result >= PLUGIN_STOP)
+	{
+		task->done = TRUE;
+		hash_remove(sched_info.pending, task->inst);
+		graph_port_output_end(task->inst->output);	/* Don't notify dependants until done. */
+		if(task->result == PLUGIN_STOP_COMPLETE && task->count > 0 && plugin_is_pure(task->inst->plugin))
+			memo_store(task->inst);
+		LOG_MSG(("Task removed, there are now %u ready tasks", hash_size(sched_info.pending)));
+	}
+}
+
+/* Prepare a task's output before its first compute(). If the plug-in is pure, and the memo
+ * cache knows the output for the current inputs, restore it and finish the task right away.
+ * Returns TRUE if that happened, in which case compute() must not be run.
+*/
+static boolean task_begin(Task *task)
+{
+	graph_port_output_begin(task->inst->output);
+	if(!plugin_is_pure(task->inst->plugin) || !memo_recall(task->inst))
+		return FALSE;
+	task->result = PLUGIN_STOP_COMPLETE;
+	task_commit(task);
+	return TRUE;
+}
+
+#define	BATCH_MAX	64	/* Maximum number of tasks handed to the workers at once. */
+
+/* Collect runnable tasks starting at the current position, and run them all in parallel. The
+ * batch ends at the first task that must run on the main thread, or when a task recalled from
+ * the memo cache adds new tasks that need sorting in. Returns number of tasks finished or run.
+*/
+static size_t batch_run(Task *last)
+{
+	Task	*batch[BATCH_MAX];
+	size_t	num = 0, recalled = 0, i;
+
+	for(; sched_info.ready_pos < sched_info.ready_size && num < BATCH_MAX; sched_info.ready_pos++)
+	{
+		Task	*task = sched_info.ready[sched_info.ready_pos];
+
+		if(!task_runnable(sched_info.ready_pos))
+			continue;
+		if(!plugin_runs_threaded(task->inst->plugin))
+			break;
+		if(task->count == 0 && task_begin(task))
+		{
+			*last = *task;
+			recalled++;
+			if(sched_info.resort)
+			{
+				sched_info.ready_pos++;
+				break;
+			}
+			continue;
+		}
+		task->count++;
+		batch[num++] = task;
+	}
+	if(num == 0)
+		return recalled;
+	sched_info.stats.computes += num;
+	workers_run(task_compute, (void **) batch, num);
+	for(i = 0; i < num; i++)
+		task_commit(batch[i]);
+	if(recalled == 0 || cmp_task_order(batch[num - 1], last) > 0)
+		*last = *batch[num - 1];
+	return num + recalled;
 }
 
 #define	RUNTIME_LIMIT	1.0	/* Lower bound on maximum time to spend running compute(). Merely co-operative. :/ */
@@ -69,38 +305,51 @@ void sched_add(PInstance *inst)
 void sched_update(void)
 {
 	TimeVal	t;
-	List	*iter, *next;
-	TimeVal	t1;
+	Task	last;		/* Sort key of most recently run task. Copied, the task might be freed. */
+	boolean	have_last = FALSE;
 
+	if(sched_info.ready_size == 0)		/* If no tasks need running, don't waste CPU here. */
+		return;
 	timeval_now(&t);
-	iter = sched_info.ready_iter;
 	while(timeval_elapsed(&t, NULL) < RUNTIME_LIMIT)
 	{
-		PluginStatus	res;
-		Task		*task;
+		Task	*task;
 
-		if(iter == NULL)
-			iter = sched_info.ready;	/* Restart if all computations done. */
-		if(iter == NULL)			/* If no tasks need running, don't waste CPU here. */
-			break;
-		next = list_next(iter);
-		task = list_data(iter);
-		if(task->count == 0)			/* First time we run it, make it prepare. */
-			graph_port_output_begin(task->inst->output);
-		task->count++;
-		timeval_now(&t1);
-		res = plugin_instance_compute(task->inst);
-		printf("Spent %g seconds running compute() of %s\n", timeval_elapsed(&t1, NULL), plugin_name(task->inst->plugin));
-		if(res >= PLUGIN_STOP)
+		ready_sort(have_last ? &last : NULL);
+		if(sched_info.ready_pos >= sched_info.ready_size)
+		{
+			ready_compact();
+			sched_info.ready_pos = 0;	/* Restart, beginning a new wave. */
+			sched_info.stats.waves++;
+			have_last = FALSE;
+			if(sched_info.ready_size == 0)
+				break;
+		}
+		task = sched_info.ready[sched_info.ready_pos];
+		if(!task_runnable(sched_info.ready_pos))
+		{
+			sched_info.ready_pos++;
+			continue;
+		}
+		if(workers_count() > 0 && plugin_runs_threaded(task->inst->plugin))
 		{
-			PPOutput	out = task->inst->output;	/* Buffer across free(). */
-			sched_info.ready = list_unlink(sched_info.ready, iter);
-			memchunk_free(sched_info.chunk_task, task);
-			list_destroy(iter);
-			graph_port_output_end(out);		/* Don't notify dependants until done. */
-			LOG_MSG(("Task removed, there are now %u ready tasks", list_length(sched_info.ready)));
+			if(batch_run(&last) > 0)
+				have_last = TRUE;
+			continue;
 		}
-		iter = next;
+		if(task->count == 0 && task_begin(task))	/* First time we run it, make it prepare. */
+		{
+			last = *task;
+			have_last = TRUE;
+			sched_info.ready_pos++;
+			continue;
+		}
+		task->count++;
+		sched_info.stats.computes++;
+		task_compute(task);
+		last = *task;
+		have_last = TRUE;
+		sched_info.ready_pos++;
+		task_commit(task);
 	}
-	sched_info.ready_iter = iter;
 }
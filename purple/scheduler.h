@@ -8,13 +8,32 @@
 */
 
 /* Add the <inst> instance to the set of plug-ins that need to be run. The only way to stop
- * running is to return P_COMPUTE_DONE from compute(), there is no remove().
+ * running is to return P_COMPUTE_DONE from compute(), there is no remove(). Adding an instance
+ * that is already waiting to run does nothing, it will see the latest inputs when it does run.
 */
 
 extern void	sched_add(PInstance *inst);
 
 /* Give the scheduler CPU time to spend running plug-ins. It will time itself and stop
  * running code after a (currently hard-coded) time has passed. This is only co-operative
- * however, no preemption is done.
+ * however, no preemption is done. Instances are run in dependency order within each graph.
 */
 extern void	sched_update(void);
+
+/* Answer the number of instances waiting to run. The main loop does not sleep while there are any. */
+extern unsigned int	sched_pending(void);
+
+/* Counters kept by the scheduler. The sum of <coalesced> and <deferred> is the number of
+ * redundant compute() calls avoided by running modules in dependency order, compared to
+ * simply running whatever is ready in the order it was added.
+*/
+typedef struct
+{
+	unsigned long	added;		/* Calls to sched_add() that created a new task. */
+	unsigned long	coalesced;	/* Calls to sched_add() for a task that had not yet run. */
+	unsigned long	deferred;	/* Tasks held back until a task they depend on was done. */
+	unsigned long	computes;	/* Total number of compute() calls made. */
+	unsigned long	waves;		/* Number of completed passes over the ready tasks. */
+} SchedStats;
+
+extern void	sched_stats_get(SchedStats *stats);
@@ -9,22 +9,24 @@
  * them go away. :)
 */
 
-#include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "verse.h"
 
 #include "dynarr.h"
 #include "diff.h"
+#include "layerscan.h"
 #include "list.h"
 #include "log.h"
 #include "mem.h"
 #include "plugins.h"
-#include "strutil.h"
 #include "textbuf.h"
 #include "nodedb.h"
+#include "outbuf.h"
 #include "value.h"
+#include "workers.h"
 
 #include "graph.h"
 
@@ -32,12 +34,72 @@
 
 /* ----------------------------------------------------------------------------------------- */
 
+#define	SYNC_INTERVAL	0.1	/* Minimum time between synchronization attempts of a node, in seconds. */
+#define	SYNC_BUDGET	65536	/* Default bytes of data to send per interval. */
+#define	SYNC_CMD_BYTES	16	/* Rough size of a Verse command, not counting its data. */
+#define	SYNC_AGE_STEP	4	/* Updates passed over that make up for one step of priority. */
+#define	SYNC_TEXT_DMAX	2048	/* Edit distance at which a changed piece of text is replaced rather than diffed. */
+
+/* Comparing the contents of large nodes, i.e. geometry and bitmap layers, and text and audio
+ * buffers, is done in a diff stage that handles many nodes at once, on the worker threads. It
+ * records what needs sending as a list of commands per node. The send stage then replays the
+ * lists on the main thread, since Verse is not thread-safe, and synchronizes everything else,
+ * which is small, directly.
+ * 
+ * The diff stage does write to the nodes: it moves dirty state from the target's layers and
+ * buffers to the local node's, cleans what it finds equal, and updates resume points and text
+ * sync marks. Each job has its own node and target, and that state is never shared by copies,
+ * so jobs don't write to the same memory. Everything else, such as pixel and vertex data, can
+ * be shared between nodes of different jobs, and is only read; see tile_hash() in nodedb-b.c
+ * for how bitmap tile hashes, which are remembered in shared stores, are kept out of this.
+*/
+typedef enum
+{
+	CMD_G_SLOT,		/* Set slot <index> of a geometry layer. */
+	CMD_G_POLYGON_DELETE,	/* Delete polygon <index>. */
+	CMD_B_TILE,		/* Set tile <index> of a bitmap layer. */
+	CMD_A_BLOCK,		/* Set block <index> of an audio buffer. */
+	CMD_T_EDITS		/* Apply the <edit> list to a text buffer. */
+} SyncCmdType;
+
+typedef struct
+{
+	SyncCmdType	type;
+	void		*layer, *tlayer;	/* Local and target layer or buffer. */
+	Dirty		*dirty;			/* Resumed at <index> if the budget runs out before this. */
+	size_t		index;
+	DynArr		*edit;
+} SyncCmd;
+
+typedef struct
+{
+	PNode		*node, *target;
+	int		sync;			/* Cleared by the diff stage if the contents differ. */
+	SyncCmd		*cmd;
+	size_t		cmd_num, cmd_alloc;
+} SyncJob;
+
 static struct
 {
 	List	*queue_create;
 	List	*queue_create_pend;
 	List	*queue_sync;
-} sync_info;
+	size_t	budget;				/* Bytes to send per SYNC_INTERVAL, 0 for no limit. */
+	size_t	left;				/* What remains of the budget right now. */
+	TimeVal	refill;				/* When <left> was last topped up. */
+	int	priority[V_NT_NUM_TYPES];	/* Lower goes first. Small, interactive types by default. */
+	SyncJob	**job;				/* Nodes to synchronize in this update, in order. */
+	size_t	job_alloc;
+} sync_info = { NULL, NULL, NULL, SYNC_BUDGET, 0, { 0 }, { 0, 2, 1, 2, 1, 1, 2 }, NULL, 0 };
+
+static const struct
+{
+	const char	*name;
+	VNodeType	type;
+} sync_type_names[] = {
+	{ "object", V_NT_OBJECT }, { "geometry", V_NT_GEOMETRY }, { "material", V_NT_MATERIAL },
+	{ "bitmap", V_NT_BITMAP }, { "text", V_NT_TEXT }, { "curve", V_NT_CURVE }, { "audio", V_NT_AUDIO }
+};
 
 /* ----------------------------------------------------------------------------------------- */
 
@@ -73,6 +135,113 @@ static void cb_notify(PNode *node, NodeNotifyEvent ev)
 void sync_init(void)
 {
 	nodedb_notify_add(NODEDB_OWNERSHIP_MINE, cb_notify);
+	sync_info.left = sync_info.budget;
+	timeval_now(&sync_info.refill);
+}
+
+void sync_budget_set(size_t bytes)
+{
+	sync_info.budget = sync_info.left = bytes;
+}
+
+boolean sync_priority_set(const char *spec)
+{
+	const char	*colon;
+	char		*end;
+	size_t		i, len;
+	long		pri;
+
+	for(; spec != NULL && *spec != '\0'; spec = *end == ',' ? end + 1 : end)
+	{
+		if((colon = strchr(spec, ':')) == NULL)
+			return FALSE;
+		len = colon - spec;
+		pri = strtol(colon + 1, &end, 10);
+		if(end == colon + 1 || (*end != ',' && *end != '\0'))
+			return FALSE;
+		for(i = 0; i < sizeof sync_type_names / sizeof *sync_type_names; i++)
+		{
+			if(strncmp(sync_type_names[i].name, spec, len) == 0 && sync_type_names[i].name[len] == '\0')
+				break;
+		}
+		if(i == sizeof sync_type_names / sizeof *sync_type_names)
+		{
+			LOG_WARN(("Unknown node type in synchronizer priority \"%s\"", spec));
+			return FALSE;
+		}
+		sync_info.priority[sync_type_names[i].type] = pri;
+	}
+	return TRUE;
+}
+
+/* ----------------------------------------------------------------------------------------- */
+
+/* The budget works like a bucket, filling up at <budget> bytes per SYNC_INTERVAL. */
+static void budget_refill(const TimeVal *now)
+{
+	double	left = sync_info.left + sync_info.budget * timeval_elapsed(&sync_info.refill, now) / SYNC_INTERVAL;
+
+	sync_info.left = left < sync_info.budget ? (size_t) left : sync_info.budget;
+	sync_info.refill = *now;
+}
+
+/* Returns non-zero if there is budget left to send more data. A last send can overdraw it. */
+static int budget_left(void)
+{
+	return sync_info.budget == 0 || sync_info.left > 0;
+}
+
+static void budget_spend(size_t bytes)
+{
+	sync_info.left = sync_info.left > bytes ? sync_info.left - bytes : 0;
+}
+
+/* ----------------------------------------------------------------------------------------- */
+
+/* Add a command to <job>'s list. If memory runs out it's simply lost, the part it's for is still
+ * dirty and will be found again next time.
+*/
+static SyncCmd * cmd_add(SyncJob *job, SyncCmdType type, void *layer, void *tlayer, Dirty *dirty, size_t index)
+{
+	SyncCmd	*cmd;
+
+	job->sync = 0;
+	if(job->cmd_num == job->cmd_alloc)
+	{
+		size_t	na = job->cmd_alloc > 0 ? 2 * job->cmd_alloc : 64;
+
+		if((cmd = mem_realloc(job->cmd, na * sizeof *cmd)) == NULL)
+			return NULL;
+		job->cmd = cmd;
+		job->cmd_alloc = na;
+	}
+	cmd = job->cmd + job->cmd_num++;
+	cmd->type   = type;
+	cmd->layer  = layer;
+	cmd->tlayer = tlayer;
+	cmd->dirty  = dirty;
+	cmd->index  = index;
+	cmd->edit   = NULL;
+	return cmd;
+}
+
+/* Empty <job>'s command list, of which the first <sent> were sent. Each layer with commands left
+ * resumes at the first of them next time, so no part is starved by the budget running out.
+*/
+static void job_finish(SyncJob *job, size_t sent)
+{
+	SyncCmd	*cmd;
+	size_t	i;
+
+	for(i = 0; i < job->cmd_num; i++)
+	{
+		cmd = job->cmd + i;
+		if(i >= sent && cmd->dirty != NULL && (i == sent || cmd[-1].dirty != cmd->dirty))
+			cmd->dirty->resume = cmd->index;
+		if(cmd->edit != NULL)
+			dynarr_destroy(cmd->edit);
+	}
+	job->cmd_num = 0;
 }
 
 /* ----------------------------------------------------------------------------------------- */
@@ -270,25 +439,38 @@ static int sync_object(NodeObject *n, const NodeObject *target)
 
 /* ----------------------------------------------------------------------------------------- */
 
-static int vertex_deleted(const real64 *data)
-{
-	return fabs(data[0]) > 1e300;
-}
-
-static int polygon_deleted(const uint32 *data)
+/* Pick how to compare a layer. The base vertex layer treats deleted vertices as equal, and
+ * the base polygon layer tells polygons that need deleting from those that need setting.
+*/
+static LayerScanKind geometry_scan_kind(const NdbGLayer *tlayer)
 {
-	return data != NULL && *data == ~0u;
+	if(tlayer->id == 0 && tlayer->type == VN_G_LAYER_VERTEX_XYZ)
+		return LAYERSCAN_VERTEX_XYZ;
+	else if(tlayer->id == 1 && tlayer->type == VN_G_LAYER_POLYGON_CORNER_UINT32)
+		return LAYERSCAN_POLYGON_UINT32;
+	return LAYERSCAN_PLAIN;
 }
 
-static int sync_geometry_layer(const NodeGeometry *node, const NdbGLayer *layer,
-				const NodeGeometry *target, const NdbGLayer *tlayer)
+/* Compare the dirty parts of <layer> to the target's version, and record commands for whatever
+ * differs. Changes that arrived in the target since last time are merged in first, that covers
+ * edits by others, echoes of what was sent, and resubscribes (a new layer starts out all dirty).
+ * Blocks found to be equal are cleaned, those that need sending stay dirty, to be checked again
+ * next time. The scan starts where the previous send ran out of budget, and wraps around, so a
+ * large layer is streamed over several updates. It starts at a block boundary though, since a
+ * block can only be cleaned if all of it was compared.
+*/
+static void diff_geometry_layer(SyncJob *job, NdbGLayer *layer, NdbGLayer *tlayer)
 {
 	const uint8	*data, *tdata;
-	size_t		i, size, tsize, esize;
-	int		send = 0;
+	size_t		i, start, end, run, size, tsize, esize, from, to, lim, mask;
+	int		leg, differs, deleted;
+	LayerScanKind	kind;
 
 /*	printf("synchronizing geometry layer '%s' against '%s'\n", layer->name, tlayer->name);*/
 
+	dirty_merge(&layer->dirty, &tlayer->dirty);
+	dirty_clear(&tlayer->dirty);
+
 	/* Basically break the dynarr abstraction, for speed. */
 	esize = dynarr_get_elem_size(layer->data);
 	size  = dynarr_size(layer->data);
@@ -296,88 +478,38 @@ static int sync_geometry_layer(const NodeGeometry *node, const NdbGLayer *layer,
 	data  = dynarr_index(layer->data, 0);
 	tdata = dynarr_index(tlayer->data, 0);
 /*	printf(" local geometry size: %u at %p, remote is %u at %p\n", size, data, tsize, tdata);*/
-	for(i = 0; i < size; i++)
+	kind  = geometry_scan_kind(tlayer);
+	mask  = ((size_t) 1 << layer->dirty.shift) - 1;
+	if(layer->dirty.resume >= size)
+		layer->dirty.resume = 0;
+	layer->dirty.resume &= ~mask;
+	for(leg = 0; leg < 2; leg++)
 	{
-		if(i >= tsize)					/* If data is not even in target, we must send it. */
-			send = 1;
-		else
+		from = leg == 0 ? layer->dirty.resume : 0;
+		to   = leg == 0 ? size : layer->dirty.resume;
+		for(start = dirty_next(&layer->dirty, from, to, &end); start < to; start = dirty_next(&layer->dirty, end, to, &end))
 		{
-			send = memcmp(data, tdata, esize) != 0;	/* If it fits, compare to see if send needed. */
-			/* If vertex layer, do more intelligent comparison for deleted vertices. */
-			if(tlayer->id == 0 && tlayer->type == VN_G_LAYER_VERTEX_XYZ && tdata != NULL)
-			{
-				if(vertex_deleted((real64 *) data))
-				{
-					if(vertex_deleted((real64 *) tdata))
-						send = 0;
-				}
-			}
-			else if(tlayer->id == 1 && tlayer->type == VN_G_LAYER_POLYGON_CORNER_UINT32 && tdata != NULL)	/* And for polygon layers, too. */
+			differs = 0;
+			lim = end < tsize ? end : tsize;
+			for(i = layerscan_next(kind, data, tdata, esize, start, lim, &run, &deleted); i < lim;
+			    i = layerscan_next(kind, data, tdata, esize, run, lim, &run, &deleted))
 			{
-/*				printf("base polygon %u: local delete is %d, remote is %d, send=%d (local=%p remote=%p)\n",
-				       i, polygon_deleted((uint32 *) data), polygon_deleted((uint32 *) tdata), send, data, tdata);
-*/				if(polygon_deleted((uint32 *) data) && !polygon_deleted((uint32 *) tdata))
-				{
-/*					printf("  deleting polygon %u.%u\n", target->node.id, i);*/
-					verse_send_g_polygon_delete(target->node.id, i);
-					send = 0;
-				}
+				for(; i < run; i++)
+					cmd_add(job, deleted ? CMD_G_POLYGON_DELETE : CMD_G_SLOT, layer, tlayer, &layer->dirty, i);
+				differs = 1;
 			}
-		}
-/*		if(send)
-			printf(" send %s %u in %u is %d\n", layer->name, i, node->node.id, send);
-*/		if(send)
-		{
-			switch(tlayer->type)
+			for(i = start > tsize ? start : tsize; i < end; i++)	/* If data is not even in target, we must send it. */
 			{
-			case VN_G_LAYER_VERTEX_XYZ:
-				verse_send_g_vertex_set_xyz_real64(target->node.id, tlayer->id, i,
-							      ((const real64 *) data)[0],
-							      ((const real64 *) data)[1], 
-							      ((const real64 *) data)[2]);
-				break;
-			case VN_G_LAYER_VERTEX_UINT32:
-				verse_send_g_vertex_set_uint32(target->node.id, tlayer->id, i, ((const uint32 *) data)[0]);
-				break;
-			case VN_G_LAYER_VERTEX_REAL:
-				verse_send_g_vertex_set_real64(target->node.id, tlayer->id, i, ((const real64 *) data)[0]);
-				break;
-			case VN_G_LAYER_POLYGON_CORNER_UINT32:
-				verse_send_g_polygon_set_corner_uint32(target->node.id, tlayer->id, i,
-								       ((const uint32 *) data)[0],
-								       ((const uint32 *) data)[1],
-								       ((const uint32 *) data)[2],
-								       ((const uint32 *) data)[3]);
-				break;
-			case VN_G_LAYER_POLYGON_CORNER_REAL:
-				verse_send_g_polygon_set_corner_real64(target->node.id, tlayer->id, i,
-								       ((const real64 *) data)[0],
-								       ((const real64 *) data)[1],
-								       ((const real64 *) data)[2],
-								       ((const real64 *) data)[3]);
-				break;
-			case VN_G_LAYER_POLYGON_FACE_UINT8:
-				verse_send_g_polygon_set_face_uint8(target->node.id, tlayer->id, i,
-								       ((const uint8 *) data)[0]);
-				break;
-			case VN_G_LAYER_POLYGON_FACE_UINT32:
-				verse_send_g_polygon_set_face_uint32(target->node.id, tlayer->id, i,
-								       ((const uint32 *) data)[0]);
-				break;
-			case VN_G_LAYER_POLYGON_FACE_REAL:
-				verse_send_g_polygon_set_face_real64(target->node.id, tlayer->id, i,
-								       ((const real64 *) data)[0]);
-				break;
-			default:
-				;
+				cmd_add(job, CMD_G_SLOT, layer, tlayer, &layer->dirty, i);
+				differs = 1;
 			}
+			if(!differs && (start & mask) == 0 && ((end & mask) == 0 || end == size))	/* Whole block compared? */
+				dirty_clean(&layer->dirty, start, end - start);
 		}
-		data  += esize;
-		tdata += esize;
 	}
 	if(size < tsize)	/* We have less data than the target, so delete remainder. */
 	{
-		send = 1;
+		job->sync = 0;
 		printf("** Target is too large, deleting -------------------------------------------------------\n");
 /*		if(layer->type >= VN_G_LAYER_VERTEX_XYZ && layer->type < VN_G_LAYER_POLYGON_CORNER_UINT32)
 		{
@@ -388,10 +520,26 @@ static int sync_geometry_layer(const NodeGeometry *node, const NdbGLayer *layer,
 		{
 			printf("deleting excess polygons\n");
 			for(i = size; i < tsize; i++)
-				verse_send_g_polygon_delete(target->node.id, i);
+				cmd_add(job, CMD_G_POLYGON_DELETE, layer, tlayer, NULL, i);
 		}
 	}
-	return send;
+}
+
+/* Diff stage of geometry nodes, comparing the contents of layers whose "envelope" matches. */
+static void diff_geometry(SyncJob *job, NodeGeometry *n, const NodeGeometry *target)
+{
+	unsigned int	i;
+	NdbGLayer	*layer, *tlayer;
+
+	for(i = 0; ((layer = dynarr_index(n->layers, i)) != NULL); i++)
+	{
+		if(layer->name[0] == '\0')
+			continue;
+		if((tlayer = nodedb_g_layer_find(target, layer->name)) == NULL)
+			continue;
+		if(layer->type == tlayer->type && layer->def_uint == tlayer->def_uint && layer->def_real == tlayer->def_real)
+			diff_geometry_layer(job, layer, tlayer);
+	}
 }
 
 static int sync_geometry_bones(const NodeGeometry *n, const NodeGeometry *target)
@@ -497,10 +645,10 @@ static int sync_geometry_creases(const NodeGeometry *n, const NodeGeometry *targ
 	return sync;
 }
 
-static int sync_geometry(const NodeGeometry *n, const NodeGeometry *target)
+static int sync_geometry(NodeGeometry *n, NodeGeometry *target)
 {
 	unsigned int	i, sync = 1;
-	const NdbGLayer	*layer, *tlayer;
+	NdbGLayer	*layer, *tlayer;
 
 	/* Step one: see if desired layers exist in target, else create them. */
 	for(i = 0; ((layer = dynarr_index(n->layers, i)) != NULL); i++)
@@ -517,8 +665,7 @@ static int sync_geometry(const NodeGeometry *n, const NodeGeometry *target)
 				printf("  but the default integer is wrong\n");
 			else if(layer->def_real != tlayer->def_real)
 				printf("  but the default real is wrong\n");
-			else	/* "Envelope" is fine, inspect contents. */
-				sync &= !sync_geometry_layer(n, layer, target, tlayer);
+			/* Else the "envelope" is fine, and the contents were compared by diff_geometry(). */
 		}
 		else
 		{
@@ -794,75 +941,76 @@ static int sync_bitmap_dimensions(const NodeBitmap *n, const NodeBitmap *target)
 	return 1;
 }
 
-static int sync_bitmap_layer(const NodeBitmap *n, const NdbBLayer *layer,
-			     const NodeBitmap *target, const NdbBLayer *tlayer)
+/* Compare the dirty tiles of <layer> to the target's, and record those that differ. Tiles written
+ * in the target are merged in first, like for geometry. Equal tiles are cleaned, differing ones
+ * stay dirty. Like for geometry, the scan resumes where the budget last ran out.
+*/
+static void diff_bitmap_layer(SyncJob *job, const NodeBitmap *n, NdbBLayer *layer,
+			      const NodeBitmap *target, NdbBLayer *tlayer)
 {
-	uint16		x, y, z, hit, wit, line, send;
-	NdbBTileDesc	tile, ttile;
-	int		sync = 1;
-
-	if(layer->type != tlayer->type)
-		return 1;		/* FIXME: This obviously isn't the proper thing to do. */
+	uint16		x, y, z, hit, wit;
+	size_t		i, end, num, from, to;
+	int		leg;
 
 /*	printf("syncing '%s' layers at %p and %p\n", layer->name, layer, tlayer);*/
+	dirty_merge(&layer->dirty, &tlayer->dirty);
+	dirty_clear(&tlayer->dirty);
 	wit = (n->width  + VN_B_TILE_SIZE - 1) / VN_B_TILE_SIZE;
 	hit = (n->height + VN_B_TILE_SIZE - 1) / VN_B_TILE_SIZE;
-	for(z = 0; z < n->depth; z++)
+	num = (size_t) wit * hit * n->depth;
+	if(layer->dirty.resume >= num)
+		layer->dirty.resume = 0;
+	for(leg = 0; leg < 2; leg++)
 	{
-		tile.in.z = ttile.in.z = z;
-		for(y = 0; y < hit; y++)
+		from = leg == 0 ? layer->dirty.resume : 0;
+		to   = leg == 0 ? num : layer->dirty.resume;
+		for(i = dirty_next(&layer->dirty, from, to, &end); i < to; i = dirty_next(&layer->dirty, end, to, &end))
 		{
-			tile.in.y = ttile.in.y = y;
-			for(x = 0; x < wit; x++)
-			{
-				tile.in.x = ttile.in.x = x;
-				nodedb_b_tile_describe(n, layer, &tile);
-				nodedb_b_tile_describe(target, tlayer, &ttile);
-				send = 0;
-				if(ttile.out.ptr == NULL)
-					send = 1;
-				else
-				{
-					const uint8	*p1 = tile.out.ptr, *p2 = ttile.out.ptr;
-
-					if(layer->type == VN_B_LAYER_UINT1)
-					{
-						tile.out.width = (tile.out.width + 7) / 8;
-						ttile.out.width = (ttile.out.width + 7) / 8;
-					}
-					for(line = 0;
-					    line < tile.out.height;
-					    line++, p1 += tile.out.mod_row, p2 += ttile.out.mod_row)
-					{
-						if(memcmp(p1, p2, tile.out.width_bytes) != 0)
-						{
-							send = 1;
-							break;
-						}
-					}
-				}
-				if(send)
-				{
-					VNBTile	out;
-					uint8	*put = (uint8 *) &out;
-
-					for(line = 0;
-					    line < tile.out.height;
-					    line++, put += tile.out.mod_tile, tile.out.ptr += tile.out.mod_row)
-						memcpy(put, tile.out.ptr, tile.out.width_bytes);
-					verse_send_b_tile_set(target->node.id, tlayer->id, x, y, z, tlayer->type, &out);
-					sync = 0;
-				}
-			}
+			x = i % wit;
+			y = (i / wit) % hit;
+			z = i / ((size_t) wit * hit);
+			if(nodedb_b_tile_equal(n, layer, target, tlayer, x, y, z))
+				dirty_clean(&layer->dirty, i, 1);
+			else
+				cmd_add(job, CMD_B_TILE, layer, tlayer, &layer->dirty, i);
 		}
 	}
-	return sync;
+}
+
+/* Diff stage of bitmap nodes. Nothing is compared until the dimensions match. */
+static void diff_bitmap(SyncJob *job, const NodeBitmap *n, const NodeBitmap *target)
+{
+	unsigned int	i;
+	NdbBLayer	*layer, *tlayer;
+
+	if(n->width != target->width || n->height != target->height || n->depth != target->depth)
+		return;
+	for(i = 0; ((layer = dynarr_index(n->layers, i)) != NULL); i++)
+	{
+		if(layer->name[0] == '\0')
+			continue;
+		if((tlayer = nodedb_b_layer_find(target, layer->name)) != NULL && layer->type == tlayer->type)
+			diff_bitmap_layer(job, n, layer, target, tlayer);
+	}
+}
+
+/* Send tile number <i> of <layer>. Tiles are stored just like Verse wants them, so no copying. */
+static void send_bitmap_tile(const NodeBitmap *n, const NdbBLayer *layer, const NodeBitmap *target, const NdbBLayer *tlayer, size_t i)
+{
+	uint16	wit, hit, x, y, z;
+
+	wit = (n->width  + VN_B_TILE_SIZE - 1) / VN_B_TILE_SIZE;
+	hit = (n->height + VN_B_TILE_SIZE - 1) / VN_B_TILE_SIZE;
+	x = i % wit;
+	y = (i / wit) % hit;
+	z = i / ((size_t) wit * hit);
+	verse_send_b_tile_set(target->node.id, tlayer->id, x, y, z, tlayer->type, nodedb_b_tile_get(n, layer, x, y, z));
 }
 
 static int sync_bitmap(const NodeBitmap *n, const NodeBitmap *target)
 {
 	unsigned int	i, sync = 1;
-	const NdbBLayer	*layer, *tlayer;
+	NdbBLayer	*layer, *tlayer;
 
 	if(!sync_bitmap_dimensions(n, target))
 		return 0;
@@ -874,8 +1022,6 @@ static int sync_bitmap(const NodeBitmap *n, const NodeBitmap *target)
 		{
 			if(layer->type != tlayer->type)
 				printf(" bitmap layer type mismatch\n");
-			else
-				sync &= sync_bitmap_layer(n, layer, target, tlayer);
 		}
 		else
 		{
@@ -899,77 +1045,107 @@ static int sync_bitmap(const NodeBitmap *n, const NodeBitmap *target)
 
 /* ----------------------------------------------------------------------------------------- */
 
-static int sync_text_buffer(const NodeText *n, const NdbTBuffer *buffer,
-			    const NodeText *target, const NdbTBuffer *tbuffer)
+/* Diff <buffer> against the target's, and record the edits that make them equal. Skipped entirely
+ * unless either buffer has been written since they were last found to be equal, and then only the
+ * part between the ends that neither has changed since is compared.
+*/
+static void diff_text_buffer(SyncJob *job, NdbTBuffer *buffer, NdbTBuffer *tbuffer)
 {
-	int		sync = 1, d;
+	int		d;
 	DynArr		*edit;
-	DiffEdit	*ed;
 	const char	*text, *ttext;
-	size_t		len, tlen;
+	size_t		len, tlen, head, tail;
+	SyncCmd		*cmd;
 
+	dirty_merge(&buffer->dirty, &tbuffer->dirty);
+	dirty_clear(&tbuffer->dirty);
+	if(!dirty_any(&buffer->dirty, 1))
+		return;
 	text  = textbuf_text(buffer->text);
 	len   = textbuf_length(buffer->text);
 	ttext = textbuf_text(tbuffer->text);
 	tlen  = textbuf_length(tbuffer->text);
-	if(len == tlen && strcmp(text, ttext) == 0)	/* Avoid allocating memory and running diff if equal. */
-		return sync;
+	head  = buffer->sync_head < tbuffer->sync_head ? buffer->sync_head : tbuffer->sync_head;
+	tail  = buffer->sync_tail < tbuffer->sync_tail ? buffer->sync_tail : tbuffer->sync_tail;
+	if(len == tlen && (head >= len || memcmp(text + head, ttext + head, len - head) == 0))	/* Avoid allocating memory and running diff if equal. */
+	{
+		dirty_clean(&buffer->dirty, 0, 1);
+		buffer->sync_head = buffer->sync_tail = len;
+		tbuffer->sync_head = tbuffer->sync_tail = len;
+		return;
+	}
 
-	edit  = dynarr_new(sizeof (*ed), 8);
+	edit  = dynarr_new(sizeof (DiffEdit), 8);
 
 /*	printf("  text: '%s' (%u)\n", text, len);
 	printf("target: '%s' (%u)\n", ttext, tlen);
-*/	d = diff_compare_simple(ttext, tlen, text, len, edit);
+*/	d = diff_compare_window(ttext, tlen, text, len, head, tail, SYNC_TEXT_DMAX, edit);
 /*	printf("Edit distance: %d\n", d);*/
-	if(d > 0)
-	{
-		unsigned int	i, pos = 0;
+	if(d > 0 && (cmd = cmd_add(job, CMD_T_EDITS, buffer, tbuffer, NULL, 0)) != NULL)
+		cmd->edit = edit;
+	else
+		dynarr_destroy(edit);
+}
 
-		for(i = 0; (ed = dynarr_index(edit, i)) != NULL; i++)
-		{
-			if(ed->op == DIFF_MATCH)
-			{
-				pos = ed->off + ed->len;
-			}
-			else if(ed->op == DIFF_DELETE)
-			{
-				verse_send_t_text_set(target->node.id, tbuffer->id, ed->off, ed->len, NULL);
-				pos = ed->off;
-			}
-			else if(ed->op == DIFF_INSERT)	/* Split inserts into something Verse can handle. */
-			{
-				char	temp[1024];
-				size_t	off, chunk;
+/* Send the edits found by diff_text_buffer(), which refer to <text>. Matches and deletes are at
+ * offsets into the target's text as it was before any edit, so they are moved by <shift>, the
+ * length change of the edits sent so far.
+*/
+static void send_text_edits(const NodeText *target, const NdbTBuffer *tbuffer, const char *text, const DynArr *edit)
+{
+	unsigned int	i, num, pos = 0;
+	long		shift = 0;
+	const DiffEdit	*ed;
 
-				for(off = ed->off, len = ed->len; len > 0; off += chunk, len -= chunk)
-				{
-					chunk = len > sizeof temp - 1 ? sizeof temp - 1 : len;
-					stu_strncpy(temp, chunk + 1, text + off);
-					temp[chunk] = '\0';
-					verse_send_t_text_set(target->node.id, tbuffer->id, pos, 0, temp);
-					pos += chunk - 1;
-				}
-			}
+	for(i = 0, num = dynarr_size(edit); i < num && (ed = dynarr_index(edit, i)) != NULL; i++)
+	{
+		if(ed->op == DIFF_MATCH)
+		{
+			pos = ed->off + shift + ed->len;
+		}
+		else if(ed->op == DIFF_DELETE)
+		{
+			pos = ed->off + shift;
+			outbuf_t_text_set(target->node.id, tbuffer->id, pos, ed->len, NULL, 0);
+			budget_spend(SYNC_CMD_BYTES);
+			shift -= ed->len;
+		}
+		else if(ed->op == DIFF_INSERT)	/* The buffer splits long inserts into something Verse can handle. */
+		{
+			outbuf_t_text_set(target->node.id, tbuffer->id, pos, 0, text + ed->off, ed->len);
+			budget_spend(SYNC_CMD_BYTES * ((ed->len + OUTBUF_TEXT_MAX - 1) / OUTBUF_TEXT_MAX) + ed->len);
+			pos   += ed->len;
+			shift += ed->len;
 		}
-		sync = 0;
 	}
-	dynarr_destroy(edit);
-	return sync;
+}
+
+/* Diff stage of text nodes. */
+static void diff_text(SyncJob *job, const NodeText *n, const NodeText *target)
+{
+	unsigned int	i;
+	NdbTBuffer	*buffer, *tbuffer;
+
+	for(i = 0; (buffer = dynarr_index(n->buffers, i)) != NULL; i++)
+	{
+		if(buffer->name[0] == '\0')
+			continue;
+		if((tbuffer = nodedb_t_buffer_find(target, buffer->name)) != NULL)
+			diff_text_buffer(job, buffer, tbuffer);
+	}
 }
 
 /* Alter <target> so it becomes copy of <n>. */
 static int sync_text(const NodeText *n, const NodeText *target)
 {
 	unsigned int		i, sync = 1;
-	const NdbTBuffer	*buffer, *tbuffer;
+	NdbTBuffer		*buffer;
 
 	for(i = 0; (buffer = dynarr_index(n->buffers, i)) != NULL; i++)
 	{
 		if(buffer->name[0] == '\0')
 			continue;
-		if((tbuffer = nodedb_t_buffer_find(target, buffer->name)) != NULL)
-			sync &= sync_text_buffer(n, buffer, target, tbuffer);
-		else
+		if(nodedb_t_buffer_find(target, buffer->name) == NULL)
 		{
 			printf(" sync sending create of text buffer '%s' in %u\n", buffer->name, target->node.id);
 			verse_send_t_buffer_create(target->node.id, ~0, buffer->name);
@@ -1007,6 +1183,7 @@ static int sync_curve_curve(const NodeCurve *n, const NdbCCurve *curve,
 						     (real64 *) key->pre.value, (uint32 *) key->pre.pos,
 						     (real64 *) key->value, key->pos,
 						     (real64 *) key->post.value, (uint32 *) key->post.pos);
+				budget_spend(SYNC_CMD_BYTES + sizeof *key);
 				sync = 0;
 			}
 		}
@@ -1017,6 +1194,7 @@ static int sync_curve_curve(const NodeCurve *n, const NdbCCurve *curve,
 					     (real64 *) key->pre.value, (uint32 *) key->pre.pos,
 					     (real64 *) key->value, key->pos,
 					     (real64 *) key->post.value, (uint32 *) key->post.pos);
+			budget_spend(SYNC_CMD_BYTES + sizeof *key);
 			sync = 0;
 		}
 	}
@@ -1058,41 +1236,58 @@ static int sync_curve(const NodeCurve *n, const NodeCurve *target)
 
 /* ----------------------------------------------------------------------------------------- */
 
-static int sync_audio_buffer(const NodeAudio *n, const NdbABuffer *buffer,
-			    const NodeAudio *target, const NdbABuffer *tbuffer)
+/* Compare the dirty blocks of <buffer> to the target's, and record those that differ. Blocks
+ * written in the target are merged in first. Equal blocks are cleaned, differing ones stay dirty.
+ * Like for geometry, the scan resumes where the budget last ran out.
+*/
+static void diff_audio_buffer(SyncJob *job, NdbABuffer *buffer, NdbABuffer *tbuffer)
 {
-	unsigned int	sync = 1, index;
-	BinTreeIter	iter;
-	const NdbABlk	*blk, *tblk;
+	size_t		index, end, num, from, to;
+	int		leg;
+	const NdbABlk	*blk;
 
 	printf("syncing audio buffer %s\n", buffer->name);
-	for(bintree_iter_init(buffer->blocks, &iter); bintree_iter_valid(iter); bintree_iter_next(&iter))
+	dirty_merge(&buffer->dirty, &tbuffer->dirty);
+	dirty_clear(&tbuffer->dirty);
+	num = pagearr_end(buffer->blocks);
+	if(buffer->dirty.resume >= num)
+		buffer->dirty.resume = 0;
+	for(leg = 0; leg < 2; leg++)
 	{
-		index = (unsigned int) bintree_iter_key(iter);
-		blk = bintree_iter_element(iter);
-		if((tblk = bintree_lookup(tbuffer->blocks, (void *) index)) != NULL)
-		{
-			if(!nodedb_a_blocks_equal(buffer->type, blk, tblk))
-			{
-/*				printf(" Block %u differs, sending new version\n", index);*/
-				verse_send_a_block_set(target->node.id, tbuffer->id, index, tbuffer->type, blk->data);
-				sync = 0;
-			}
-		}
-		else
+		from = leg == 0 ? buffer->dirty.resume : 0;
+		to   = leg == 0 ? num : buffer->dirty.resume;
+		for(index = dirty_next(&buffer->dirty, from, to, &end); index < to; index = dirty_next(&buffer->dirty, end, to, &end))
 		{
-/*			printf(" Target node missing block %u, setting it\n", index);*/
-			verse_send_a_block_set(target->node.id, tbuffer->id, index, tbuffer->type, blk->data);
+			blk = pagearr_get(buffer->blocks, index);
+			if(blk == NULL || nodedb_a_blocks_equal(buffer->type, blk, pagearr_get(tbuffer->blocks, index)))
+				dirty_clean(&buffer->dirty, index, 1);
+			else
+				cmd_add(job, CMD_A_BLOCK, buffer, tbuffer, &buffer->dirty, index);
 		}
 	}
-	printf(" block(s) sent\n");
-	return sync;
+}
+
+/* Diff stage of audio nodes. Buffers of mismatched type or frequency can't be compared. */
+static void diff_audio(SyncJob *job, const NodeAudio *n, const NodeAudio *target)
+{
+	unsigned int	i;
+	NdbABuffer	*buffer, *tbuffer;
+
+	for(i = 0; (buffer = dynarr_index(n->buffers, i)) != NULL; i++)
+	{
+		if(buffer->name[0] == '\0')
+			continue;
+		if((tbuffer = nodedb_a_buffer_find(target, buffer->name)) == NULL)
+			continue;
+		if(buffer->type == tbuffer->type && buffer->frequency == tbuffer->frequency)
+			diff_audio_buffer(job, buffer, tbuffer);
+	}
 }
 
 static int sync_audio(const NodeAudio *n, const NodeAudio *target)
 {
 	unsigned int	i, sync = 1;
-	const NdbABuffer	*buffer, *tbuffer;
+	NdbABuffer	*buffer, *tbuffer;
 
 	for(i = 0; (buffer = dynarr_index(n->buffers, i)) != NULL; i++)
 	{
@@ -1103,9 +1298,7 @@ static int sync_audio(const NodeAudio *n, const NodeAudio *target)
 			printf("buffer: type=%d freq=%g  target: type=%d freq=%g\n",
 			       buffer->type, buffer->frequency,
 			       tbuffer->type, tbuffer->frequency);
-			if(buffer->type == tbuffer->type && buffer->frequency == tbuffer->frequency)
-				sync &= sync_audio_buffer(n, buffer, target, tbuffer);
-			else
+			if(buffer->type != tbuffer->type || buffer->frequency != tbuffer->frequency)
 				printf("can't sync mismatched (type/freq) audio buffers!\n");	/* FIXME: Do it. */
 		}
 		else
@@ -1120,12 +1313,84 @@ static int sync_audio(const NodeAudio *n, const NodeAudio *target)
 
 /* ----------------------------------------------------------------------------------------- */
 
-static int sync_node(PNode *n)
+/* The diff stage for one node, run on a worker thread. */
+static void sync_diff(void *job)
 {
-	PNode	*target;
+	SyncJob	*j = job;
+
+	j->sync = 1;
+	if(j->target == NULL)
+		return;
+	switch(j->node->type)
+	{
+	case V_NT_GEOMETRY:
+		diff_geometry(j, (NodeGeometry *) j->node, (NodeGeometry *) j->target);
+		break;
+	case V_NT_BITMAP:
+		diff_bitmap(j, (NodeBitmap *) j->node, (NodeBitmap *) j->target);
+		break;
+	case V_NT_TEXT:
+		diff_text(j, (NodeText *) j->node, (NodeText *) j->target);
+		break;
+	case V_NT_AUDIO:
+		diff_audio(j, (NodeAudio *) j->node, (NodeAudio *) j->target);
+		break;
+	default:
+		;
+	}
+}
+
+/* Replay the commands found by the diff stage, for as long as the budget lasts. */
+static void sync_job_send(SyncJob *job)
+{
+	SyncCmd		*cmd;
+	NdbGLayer	*layer;
+	size_t		i;
+
+	for(i = 0; i < job->cmd_num && budget_left(); i++)
+	{
+		cmd = job->cmd + i;
+		switch(cmd->type)
+		{
+		case CMD_G_SLOT:
+			layer = cmd->layer;
+			outbuf_g_slot_set(job->target->id, ((NdbGLayer *) cmd->tlayer)->id, ((NdbGLayer *) cmd->tlayer)->type,
+					  cmd->index, dynarr_index(layer->data, cmd->index));
+			budget_spend(SYNC_CMD_BYTES + dynarr_get_elem_size(layer->data));
+			break;
+		case CMD_G_POLYGON_DELETE:
+/*			printf("  deleting polygon %u.%u\n", job->target->id, cmd->index);*/
+			outbuf_g_polygon_delete(job->target->id, cmd->index);
+			budget_spend(SYNC_CMD_BYTES);
+			break;
+		case CMD_B_TILE:
+			send_bitmap_tile((NodeBitmap *) job->node, cmd->layer, (NodeBitmap *) job->target, cmd->tlayer, cmd->index);
+			budget_spend(SYNC_CMD_BYTES + sizeof (VNBTile));
+			break;
+		case CMD_A_BLOCK:
+			verse_send_a_block_set(job->target->id, ((NdbABuffer *) cmd->tlayer)->id, cmd->index, ((NdbABuffer *) cmd->tlayer)->type,
+					       ((NdbABlk *) pagearr_get(((NdbABuffer *) cmd->layer)->blocks, cmd->index))->data);
+			budget_spend(SYNC_CMD_BYTES + sizeof (VNABlock));
+			break;
+		case CMD_T_EDITS:
+			send_text_edits((NodeText *) job->target, cmd->tlayer, textbuf_text(((NdbTBuffer *) cmd->layer)->text), cmd->edit);
+			break;
+		default:
+			;
+		}
+	}
+	job_finish(job, i);
+}
+
+/* The send stage for one node. Compares and sends everything except the contents covered by the
+ * diff stage, then sends what that found. Returns 1 if the node is in sync.
+*/
+static int sync_node(SyncJob *job)
+{
+	PNode	*n = job->node, *target = job->target;
 	int	sync = 1;
 
-	if((target = nodedb_lookup(n->id)) == NULL)
+	if(target == NULL)
 	{
 		LOG_WARN(("Couldn't look up existing (target) node for %u--aborting sync", n->id));
 		return 0;
@@ -1158,7 +1423,8 @@ static int sync_node(PNode *n)
 	default:
 		printf("Can't sync node of type %d\n", n->type);
 	}
-	return sync;
+	sync_job_send(job);
+	return sync && job->sync;
 }
 
 /* ----------------------------------------------------------------------------------------- */
@@ -1173,6 +1439,7 @@ void sync_node_add(PNode *node)
 		return;
 	}
 	timeval_jurassic(&node->sync.last_send);
+	node->sync.age = 0;
 	if(node->id == (VNodeID) ~0)	/* Locally created? */
 		sync_info.queue_create = list_prepend(sync_info.queue_create, (void *) node);
 	else
@@ -1181,11 +1448,24 @@ void sync_node_add(PNode *node)
 	node->sync.busy = 1;
 }
 
+/* Order nodes by priority, letting those that have been passed over catch up. */
+static int cmp_job_rank(const void *a, const void *b)
+{
+	const PNode	*na = (*(const SyncJob **) a)->node, *nb = (*(const SyncJob **) b)->node;
+	long		ra, rb;
+
+	ra = (long) SYNC_AGE_STEP * sync_info.priority[na->type] - (long) na->sync.age;
+	rb = (long) SYNC_AGE_STEP * sync_info.priority[nb->type] - (long) nb->sync.age;
+	return ra < rb ? -1 : ra > rb;
+}
+
 void sync_update(double slice)
 {
 	List	*iter, *next;
 	PNode	*n;
+	SyncJob	*job;
 	TimeVal	now;
+	size_t	i, num;
 
 	/* Create nodes that need to be created. */
 	for(iter = sync_info.queue_create; iter != NULL; iter = next)
@@ -1199,24 +1479,86 @@ void sync_update(double slice)
 		sync_info.queue_create_pend = list_prepend(sync_info.queue_create_pend, n);
 	}
 
-	/* Synchronize existing nodes. */
+	/* Pick the nodes that are due for synchronization, and put them in priority order. */
 	timeval_now(&now);
-	for(iter = sync_info.queue_sync; iter != NULL; iter = next)
+	budget_refill(&now);
+	for(iter = sync_info.queue_sync, num = 0; iter != NULL; iter = list_next(iter))
 	{
-		PNode	*n = list_data(iter);
+		n = list_data(iter);
+		if(timeval_elapsed(&n->sync.last_send, &now) < SYNC_INTERVAL)
+			continue;
+		if(num == sync_info.job_alloc)
+		{
+			size_t	na = num > 0 ? 2 * num : 16;
+			SyncJob	**nj;
 
-		next = list_next(iter);
+			if((nj = mem_realloc(sync_info.job, na * sizeof *nj)) == NULL)
+				break;
+			memset(nj + num, 0, (na - num) * sizeof *nj);
+			sync_info.job = nj;
+			sync_info.job_alloc = na;
+		}
+		if((job = sync_info.job[num]) == NULL)
+		{
+			if((job = mem_alloc(sizeof *job)) == NULL)
+				break;
+			job->cmd = NULL;
+			job->cmd_num = job->cmd_alloc = 0;
+			sync_info.job[num] = job;
+		}
+		job->node   = n;
+		job->target = nodedb_lookup(n->id);
+		num++;
+	}
+	qsort(sync_info.job, num, sizeof *sync_info.job, cmp_job_rank);
 
-		if(timeval_elapsed(&n->sync.last_send, &now) < 0.1)
-			continue;
+	/* Compare their contents in parallel. Skipped if there's no budget to send anything anyway. */
+	if(budget_left())
+		workers_run(sync_diff, (void **) sync_info.job, num);
+
+	/* Synchronize them, for as long as the budget lasts. The rest age, and get to go earlier. */
+	for(i = 0; i < num; i++)
+	{
+		job = sync_info.job[i];
+		n = job->node;
 		n->sync.last_send = now;
-		if(sync_node(n))
+		if(!budget_left())
+		{
+			job_finish(job, 0);
+			n->sync.age++;
+			continue;
+		}
+		n->sync.age = 0;
+		if(sync_node(job))
 		{
-			sync_info.queue_sync = list_unlink(sync_info.queue_sync, iter);
+			sync_info.queue_sync = list_remove(sync_info.queue_sync, n);
 			printf("removing node %u from sync queue, it's in sync\n", n->id);
 			nodedb_unref(n);
-			list_destroy(iter);
 			n->sync.busy = 0;
 		}
 	}
 }
+
+boolean sync_next(double *seconds)
+{
+	List	*iter;
+	TimeVal	now;
+	double	left, next = SYNC_INTERVAL;
+
+	if(sync_info.queue_create != NULL)
+	{
+		*seconds = 0.0;
+		return TRUE;
+	}
+	if(sync_info.queue_sync == NULL)
+		return FALSE;
+	timeval_now(&now);
+	for(iter = sync_info.queue_sync; iter != NULL; iter = list_next(iter))
+	{
+		left = SYNC_INTERVAL - timeval_elapsed(&((PNode *) list_data(iter))->sync.last_send, &now);
+		if(left < next)
+			next = left;
+	}
+	*seconds = next > 0.0 ? next : 0.0;
+	return TRUE;
+}
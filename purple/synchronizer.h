@@ -16,5 +16,21 @@ extern void	sync_init(void);
 */
 extern void	sync_node_add(PNode *node);
 
+/* Set how many bytes of data the synchronizer may send per update interval, 0 for no limit.
+ * Large layers are then streamed over several updates, picking up where they left off.
+*/
+extern void	sync_budget_set(size_t bytes);
+
+/* Set the priorities of node types, from a string like "object:0,geometry:3". Nodes with a
+ * lower number are synchronized first, as long as the budget lasts. Nodes passed over slowly
+ * gain priority, so nothing is starved. Returns FALSE if the string couldn't be parsed.
+*/
+extern boolean	sync_priority_set(const char *spec);
+
 /* Run the synchronizer, attempting not to spend more than <duration> seconds. */
 extern void	sync_update(double slice);
+
+/* Find how many seconds remain until sync_update() has something to do, zero if it has work
+ * right away. Returns FALSE if there are no nodes being synchronized.
+*/
+extern boolean	sync_next(double *seconds);
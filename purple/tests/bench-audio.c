@@ -0,0 +1,103 @@
+/*
+ * Benchmark of audio buffer sample access. Fills a ten minute 48 kHz buffer of each block type,
+ * then times reading it all back out in plugin-sized chunks, and writing it back in again. Not
+ * run as part of the tests, use "make bench" to build it.
+*/
+
+#include <stdio.h>
+#include <time.h>
+
+#include "verse.h"
+#include "purple.h"
+
+#include "dynarr.h"
+#include "hash.h"
+#include "list.h"
+#include "nodedb.h"
+#include "nodedb-internal.h"
+
+#define	FREQUENCY	48000
+#define	SECONDS		(10 * 60)
+#define	CHUNK		4096		/* Samples per call, like a plugin would use. */
+
+/* ----------------------------------------------------------------------------------------- */
+
+/* The audio node code refers to these, but the benchmark never causes them to be called. */
+
+void verse_callback_set(void *send_func, void *callback, void *user_data) {}
+void verse_send_a_buffer_create(VNodeID node_id, VBufferID buffer_id, const char *name, VNABlockType type, real64 frequency) {}
+void verse_send_a_buffer_destroy(VNodeID node_id, VBufferID buffer_id) {}
+void verse_send_a_buffer_subscribe(VNodeID node_id, VBufferID buffer_id) {}
+void verse_send_a_block_set(VNodeID node_id, VLayerID buffer_id, uint32 block_index, VNABlockType type, const VNABlock *samples) {}
+void verse_send_a_block_clear(VNodeID node_id, VLayerID buffer_id, uint32 block_index) {}
+
+PNode * nodedb_lookup_with_type(VNodeID node_id, VNodeType type)
+{
+	return NULL;
+}
+
+void nodedb_internal_notify_mine_check(PNode *n, NodeNotifyEvent ev) {}
+void nodedb_internal_notify_node_check(PNode *n, NodeNotifyEvent ev) {}
+
+/* ----------------------------------------------------------------------------------------- */
+
+static double rate(clock_t start, unsigned long samples)
+{
+	double	secs = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+	return secs > 0.0 ? samples / secs / 1E6 : 0.0;
+}
+
+static void bench(const char *label, VNABlockType type)
+{
+	NodeAudio	node;
+	NdbABuffer	*buffer;
+	real64		chunk[CHUNK], sum = 0.0;
+	unsigned int	pos, len, i, total = 0;
+	clock_t		t;
+	double		fill, read, write;
+
+	nodedb_a_construct(&node);
+	buffer = nodedb_a_buffer_create(&node, 0, "bench", type, FREQUENCY);
+
+	t = clock();
+	for(pos = 0; pos < FREQUENCY * SECONDS; pos += CHUNK)
+	{
+		for(i = 0; i < CHUNK; i++)
+			chunk[i] = ((int) ((pos + i) % 256) - 128) / 256.0;
+		nodedb_a_buffer_write_samples(buffer, pos, chunk, CHUNK);
+	}
+	fill = rate(t, pos);
+
+	t = clock();
+	for(pos = 0; (len = nodedb_a_buffer_read_samples(buffer, pos, chunk, CHUNK)) != 0; pos += len)
+	{
+		for(i = 0; i < len; i++)
+			sum += chunk[i];
+		total += len;
+	}
+	read = rate(t, total);
+
+	t = clock();
+	for(pos = 0; (len = nodedb_a_buffer_read_samples(buffer, pos, chunk, CHUNK)) != 0; pos += len)
+		nodedb_a_buffer_write_samples(buffer, pos, chunk, len);
+	write = rate(t, pos);
+
+	printf("%-7s %u samples: fill %7.2f, read %7.2f, read+write %7.2f Msamples/s%s\n",
+	       label, total, fill, read, write, total >= FREQUENCY * SECONDS && sum < 0.0 ? "" : " (WRONG)");
+	nodedb_a_destruct(&node);
+}
+
+int main(void)
+{
+	dynarr_init();
+	list_init();
+	hash_init();
+
+	bench("int8",   VN_A_BLOCK_INT8);
+	bench("int16",  VN_A_BLOCK_INT16);
+	bench("int32",  VN_A_BLOCK_INT32);
+	bench("real32", VN_A_BLOCK_REAL32);
+	bench("real64", VN_A_BLOCK_REAL64);
+	return 0;
+}
@@ -0,0 +1,151 @@
+/*
+ * Benchmark of the binary tree module. Inserts keys in sorted order (the worst case for an
+ * unbalanced tree) and in scrambled order, then looks them all up. Lookup depth is measured
+ * by counting key comparisons. For reference, the same is done with a plain unbalanced tree,
+ * like the one the module used to be, on the sizes where that finishes in reasonable time.
+ * Not run as part of the tests, use "make bench" to build it.
+*/
+
+#include <stdio.h>
+#include <time.h>
+
+#include "mem.h"
+
+#include "bintree.h"
+
+#define	PLAIN_MAX	20000		/* The plain tree is quadratic on sorted keys. */
+
+static unsigned long	compares;
+
+static int compare(const void *key1, const void *key2)
+{
+	compares++;
+	return key1 < key2 ? -1 : key1 > key2;
+}
+
+/* ----------------------------------------------------------------------------------------- */
+
+/* A plain binary search tree, for comparison. */
+typedef struct Plain	Plain;
+
+struct Plain
+{
+	const void	*key;
+	void		*element;
+	Plain		*left, *right;
+};
+
+static void plain_insert(Plain **root, const void *key, void *element)
+{
+	Plain	*n;
+
+	while(*root != NULL)
+		root = compare(key, (*root)->key) < 0 ? &(*root)->left : &(*root)->right;
+	n = mem_alloc(sizeof *n);
+	n->key = key;
+	n->element = element;
+	n->left = n->right = NULL;
+	*root = n;
+}
+
+static void * plain_lookup(const Plain *root, const void *key)
+{
+	int	cmp;
+
+	while(root != NULL)
+	{
+		if((cmp = compare(key, root->key)) == 0)
+			return root->element;
+		root = cmp < 0 ? root->left : root->right;
+	}
+	return NULL;
+}
+
+static void plain_destroy(Plain *root)
+{
+	Plain	*next;
+
+	for(; root != NULL; root = next)	/* Rotate left subtrees up, to avoid deep recursion. */
+	{
+		if(root->left != NULL)
+		{
+			next = root->left;
+			root->left = next->right;
+			next->right = root;
+			continue;
+		}
+		next = root->right;
+		mem_free(root);
+	}
+}
+
+/* ----------------------------------------------------------------------------------------- */
+
+static double rate(clock_t start, unsigned long ops)
+{
+	double	secs = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+	return secs > 0.0 ? ops / secs / 1E6 : 0.0;
+}
+
+/* Map 0..size-1 to keys, either in order or scrambled by a multiplier coprime with size. */
+static size_t key(size_t i, size_t size, int sorted)
+{
+	return sorted ? i : (i * 2654435761u) % size;
+}
+
+static void bench(size_t size, int sorted)
+{
+	BinTree		*bt;
+	Plain		*plain = NULL;
+	clock_t		t;
+	size_t		i;
+	unsigned long	found = 0;
+	double		insert, lookup, depth;
+
+	bt = bintree_new(compare);
+	t = clock();
+	for(i = 0; i < size; i++)
+		bintree_insert(bt, (const void *) key(i, size, sorted), (void *) (i + 1));
+	insert = rate(t, size);
+	compares = 0;
+	t = clock();
+	for(i = 0; i < size; i++)
+		found += bintree_lookup(bt, (const void *) i) != NULL;
+	lookup = rate(t, size);
+	depth  = (double) compares / size;
+	bintree_destroy(bt, NULL);
+	printf("%-9s %8lu: insert %7.2f, lookup %7.2f Mops/s, depth %8.1f%s\n", sorted ? "sorted" : "scrambled",
+	       (unsigned long) size, insert, lookup, depth, found == size ? "" : " (WRONG)");
+
+	if(size > PLAIN_MAX)
+		return;
+	found = 0;
+	t = clock();
+	for(i = 0; i < size; i++)
+		plain_insert(&plain, (const void *) key(i, size, sorted), (void *) (i + 1));
+	insert = rate(t, size);
+	compares = 0;
+	t = clock();
+	for(i = 0; i < size; i++)
+		found += plain_lookup(plain, (const void *) i) != NULL;
+	lookup = rate(t, size);
+	depth  = (double) compares / size;
+	plain_destroy(plain);
+	printf("  (plain) %8lu: insert %7.2f, lookup %7.2f Mops/s, depth %8.1f%s\n",
+	       (unsigned long) size, insert, lookup, depth, found == size ? "" : " (WRONG)");
+}
+
+int main(void)
+{
+	const size_t	size[] = { 1000, 20000, 1000000 };
+	size_t		i;
+
+	bintree_init();
+	for(i = 0; i < sizeof size / sizeof *size; i++)
+	{
+		bench(size[i], 1);
+		bench(size[i], 0);
+	}
+	return 0;
+}
@@ -0,0 +1,94 @@
+/*
+ * Microbenchmark of the hash table module. Times insert, lookup and remove of sequential
+ * integer keys (like node IDs) at a few table sizes, both through the generic interface
+ * with hashing and comparison callbacks, and through the integer-keyed variant. Not run
+ * as part of the tests, use "make bench" to build it.
+*/
+
+#include <stdio.h>
+#include <time.h>
+
+#include "hash.h"
+
+#define	OPS_MIN	4000000		/* Repeat lookups on small tables, to get measurable times. */
+
+static unsigned int int_hash(const void *key)
+{
+	return (unsigned int) (size_t) key;
+}
+
+static int int_key_eq(const void *key1, const void *key2)
+{
+	return key1 == key2;
+}
+
+static double rate(clock_t start, unsigned long ops)
+{
+	double	secs = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+	return secs > 0.0 ? ops / secs / 1E6 : 0.0;
+}
+
+static void bench(const char *label, Hash *(*create)(void), size_t size)
+{
+	Hash		*h;
+	clock_t		t;
+	size_t		i, round, rounds = size < OPS_MIN ? OPS_MIN / size : 1;
+	unsigned long	found = 0;
+	double		insert, lookup, miss, remove;
+
+	t = clock();
+	for(round = 0; round < rounds; round++)
+	{
+		h = create();
+		for(i = 1; i <= size; i++)
+			hash_insert(h, (const void *) i, (void *) i);
+		if(round + 1 < rounds)
+			hash_destroy(h);
+	}
+	insert = rate(t, rounds * size);
+
+	t = clock();
+	for(round = 0; round < rounds; round++)
+	{
+		for(i = 1; i <= size; i++)
+			found += hash_lookup(h, (const void *) i) != NULL;
+	}
+	lookup = rate(t, rounds * size);
+
+	t = clock();
+	for(round = 0; round < rounds; round++)
+	{
+		for(i = size + 1; i <= 2 * size; i++)
+			found += hash_lookup(h, (const void *) i) != NULL;
+	}
+	miss = rate(t, rounds * size);
+
+	t = clock();
+	for(i = 1; i <= size; i++)
+		hash_remove(h, (const void *) i);
+	remove = rate(t, size);
+
+	printf("%-8s %8lu: insert %7.2f, lookup %7.2f, miss %7.2f, remove %7.2f Mops/s%s\n",
+	       label, (unsigned long) size, insert, lookup, miss, remove,
+	       found == rounds * size && hash_size(h) == 0 ? "" : " (WRONG)");
+	hash_destroy(h);
+}
+
+static Hash * create_generic(void)
+{
+	return hash_new(int_hash, int_key_eq);
+}
+
+int main(void)
+{
+	const size_t	size[] = { 1000, 100000, 1000000 };
+	size_t		i;
+
+	hash_init();
+	for(i = 0; i < sizeof size / sizeof *size; i++)
+		bench("generic", create_generic, size[i]);
+	for(i = 0; i < sizeof size / sizeof *size; i++)
+		bench("int", hash_new_int, size[i]);
+	return 0;
+}
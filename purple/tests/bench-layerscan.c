@@ -0,0 +1,117 @@
+/*
+ * Benchmark of the layer comparison kernels. Compares a million-vertex XYZ layer to a copy with
+ * no, a few, and all vertices changed, both with the per-vertex memcmp() loop the synchronizer
+ * used to have, and with full-layer scans using each supported kernel. Not run as part of the
+ * tests, use "make bench" to build it.
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "verse.h"
+
+#include "layerscan.h"
+
+#define	VERTICES	1000000
+#define	ROUNDS		20
+
+static const char	*kernels[] = { "c", "sse2", "avx2" };
+
+static int vertex_deleted(const real64 *data)
+{
+	return fabs(data[0]) > 1e300;
+}
+
+/* The old way, one memcmp() per vertex. Returns the number of differing vertices. */
+static size_t scan_loop(const real64 *a, const real64 *b, size_t num)
+{
+	size_t	i, diff = 0;
+
+	for(i = 0; i < num; i++)
+	{
+		if(memcmp(a + 3 * i, b + 3 * i, 3 * sizeof *a) != 0 && !(vertex_deleted(a + 3 * i) && vertex_deleted(b + 3 * i)))
+			diff++;
+	}
+	return diff;
+}
+
+static size_t scan_layer(const real64 *a, const real64 *b, size_t num)
+{
+	size_t	i, end, diff = 0;
+
+	for(i = layerscan_next(LAYERSCAN_VERTEX_XYZ, a, b, 3 * sizeof *a, 0, num, &end, NULL); i < num;
+	    i = layerscan_next(LAYERSCAN_VERTEX_XYZ, a, b, 3 * sizeof *a, end, num, &end, NULL))
+		diff += end - i;
+	return diff;
+}
+
+static double rate(clock_t start, unsigned long vertices)
+{
+	double	secs = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+	return secs > 0.0 ? vertices / secs / 1E6 : 0.0;
+}
+
+static void bench(const char *label, const real64 *a, const real64 *b, size_t expect)
+{
+	clock_t		t;
+	size_t		diff = 0;
+	unsigned int	i, k;
+
+	t = clock();
+	for(i = 0; i < ROUNDS; i++)
+		diff = scan_loop(a, b, VERTICES);
+	printf("%-8s loop %8.1f", label, rate(t, ROUNDS * VERTICES));
+	if(diff != expect)
+		printf(" (WRONG)");
+	for(k = 0; k < sizeof kernels / sizeof *kernels; k++)
+	{
+		if(!layerscan_kernel_set(kernels[k]))
+			continue;
+		t = clock();
+		for(i = 0; i < ROUNDS; i++)
+			diff = scan_layer(a, b, VERTICES);
+		printf(", %s %8.1f", kernels[k], rate(t, ROUNDS * VERTICES));
+		if(diff != expect)
+			printf(" (WRONG)");
+	}
+	printf(" Mvertices/s\n");
+}
+
+int main(void)
+{
+	real64	*a, *b;
+	size_t	i, changed;
+
+	a = malloc(VERTICES * 3 * sizeof *a);
+	b = malloc(VERTICES * 3 * sizeof *b);
+	for(i = 0; i < 3 * VERTICES; i++)
+		a[i] = b[i] = i * 0.5;
+	for(i = 0; i < VERTICES; i += 97)	/* Some deleted in both, with different garbage. */
+	{
+		a[3 * i] = b[3 * i] = 1e301;
+		a[3 * i + 1] = -1.0;
+	}
+	bench("equal", a, b, 0);
+
+	for(i = changed = 0; i < VERTICES; i += 1000)
+	{
+		if(i % 97 != 0)
+		{
+			a[3 * i + 2] += 1.0;
+			changed++;
+		}
+	}
+	bench("sparse", a, b, changed);
+
+	for(i = 0; i < 3 * VERTICES; i++)	/* Deleted vertices stay deleted, and so equal. */
+		a[i] = -b[i] - 1.0;
+	bench("all", a, b, VERTICES - (VERTICES + 96) / 97);
+
+	free(a);
+	free(b);
+	return 0;
+}
@@ -16,6 +16,15 @@ static int compare(const void *k1, const void *k2)
 	return k1 < k2 ? -1 : k1 > k2;
 }
 
+static unsigned long	compares = 0;
+
+/* Same as compare(), but counts the calls so lookup depth can be checked. */
+static int compare_count(const void *k1, const void *k2)
+{
+	compares++;
+	return k1 < k2 ? -1 : k1 > k2;
+}
+
 int main(void)
 {
 	bintree_init();
@@ -90,5 +99,34 @@ int main(void)
 	}
 	test_end();
 
+	test_begin("Sorted insertion of 1M keys");
+	{
+		BinTree		*bt;
+		BinTreeIter	iter;
+		size_t		i, n = 1000000;
+		int		ok = 1;
+
+		bt = bintree_new(compare_count);
+		for(i = 0; i < n; i++)
+			bintree_insert(bt, (void *) i, (void *) (i + 1));
+		compares = 0;
+		for(i = 0; i < n; i++)
+			ok &= bintree_lookup(bt, (void *) i) == (void *) (i + 1);
+		/* A red-black tree is never deeper than 2 * log2(n + 1), which is 40 here. */
+		ok &= bintree_size(bt) == n && compares <= 40 * n &&
+		      bintree_key_minimum(bt) == (void *) 0 && bintree_key_maximum(bt) == (void *) (n - 1);
+		for(i = 0, bintree_iter_init(bt, &iter); bintree_iter_valid(iter); bintree_iter_next(&iter), i++)
+			ok &= bintree_iter_key(iter) == (void *) i;
+		ok &= i == n;
+		for(i = 0; i < n; i += 2)
+			bintree_remove(bt, (void *) i);
+		compares = 0;
+		for(i = 0; i < n; i++)
+			ok &= bintree_lookup(bt, (void *) i) == (i & 1 ? (void *) (i + 1) : NULL);
+		test_result(ok && bintree_size(bt) == n / 2 && compares <= 40 * n && bintree_key_minimum(bt) == (void *) 1);
+		bintree_destroy(bt, NULL);
+	}
+	test_end();
+
 	return test_package_end();
 }
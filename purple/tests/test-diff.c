@@ -3,6 +3,7 @@
 */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "test.h"
@@ -26,6 +27,49 @@ static void print_diff_edits(const DynArr *diff)
 	}
 }
 
+/* Apply <diff> to <a>, giving what should be <b>, in <out>. Returns the length of <out>. */
+static size_t apply_diff_edits(const DynArr *diff, const char *a, const char *b, char *out)
+{
+	const DiffEdit	*e;
+	unsigned int	i;
+	size_t		len = 0;
+
+	for(i = 0; i < dynarr_size(diff) && (e = dynarr_index(diff, i))->op != 0; i++)
+	{
+		if(e->op == DIFF_MATCH)
+			memcpy(out + len, a + e->off, e->len);
+		else if(e->op == DIFF_INSERT)
+			memcpy(out + len, b + e->off, e->len);
+		if(e->op != DIFF_DELETE)
+			len += e->len;
+	}
+	return len;
+}
+
+/* Make <b> a copy of <a> with <num> random single-character edits. Returns its length. */
+static size_t make_edited(const char *a, size_t n, char *b, unsigned int num)
+{
+	size_t	m = n, p;
+
+	memcpy(b, a, n);
+	while(num-- > 0)
+	{
+		p = rand() % (m + 1);
+		if(rand() & 1 && p < m)
+		{
+			memmove(b + p, b + p + 1, m - p - 1);
+			m--;
+		}
+		else
+		{
+			memmove(b + p + 1, b + p, m - p);
+			b[p] = 'a' + rand() % 4;
+			m++;
+		}
+	}
+	return m;
+}
+
 int main(void)
 {
 	int	d;
@@ -66,6 +110,70 @@ int main(void)
 	test_result(d == 5);
 	test_end();
 
+	test_begin("suffix trimmed");
+	d = diff_compare_simple("fine day", strlen("fine day"),  "day", strlen("day"),  diff);
+	test_result(d == 5 && dynarr_size(diff) >= 2 && ((DiffEdit *) dynarr_index(diff, 0))->op == DIFF_DELETE &&
+		    ((DiffEdit *) dynarr_index(diff, 1))->op == DIFF_MATCH && ((DiffEdit *) dynarr_index(diff, 1))->off == 5);
+	test_end();
+
+	test_begin("dmax gives replace");
+	{
+		char	out[64];
+		size_t	len;
+
+		dynarr_clear(diff);
+		d = diff_compare((const unsigned char *) "xxabcdefxx", 0, 10,  (const unsigned char *) "xxbadcfexx", 0, 10,  3, diff, NULL);
+		len = apply_diff_edits(diff, "xxabcdefxx", "xxbadcfexx", out);
+		test_result(d == 12 && len == 10 && memcmp(out, "xxbadcfexx", 10) == 0);
+	}
+	test_end();
+
+	test_begin("random edits");
+	{
+		char		a[4096], b[4200], out[4200];
+		size_t		n, m, i, len;
+		unsigned int	r;
+		int		ok = 1;
+
+		srand(4711);
+		for(r = 0; r < 200; r++)
+		{
+			n = rand() % sizeof a;
+			for(i = 0; i < n; i++)
+				a[i] = 'a' + rand() % 4;
+			m = make_edited(a, n, b, rand() % 40);
+			dynarr_clear(diff);
+			d = diff_compare_simple(a, n, b, m, diff);
+			len = apply_diff_edits(diff, a, b, out);
+			ok &= d >= 0 && len == m && memcmp(out, b, m) == 0;
+			dynarr_clear(diff);
+			d = diff_compare((unsigned char *) a, 0, n, (unsigned char *) b, 0, m, 1 + rand() % 16, diff, NULL);
+			len = apply_diff_edits(diff, a, b, out);
+			ok &= d >= 0 && len == m && memcmp(out, b, m) == 0;
+		}
+		test_result(ok);
+	}
+	test_end();
+
+	test_begin("window in large text");
+	{
+		static char	a[262144], b[262144 + 16], out[262144 + 16];
+		size_t		i, m, len;
+
+		for(i = 0; i < sizeof a; i++)
+			a[i] = 'a' + (i * 7919) % 26;
+		memcpy(b, a, sizeof a);
+		memcpy(b + 100000, "purple", 6);		/* Overwrite six characters ... */
+		memmove(b + 200006, b + 200000, sizeof a - 200000);
+		memcpy(b + 200000, "verse!", 6);		/* ... and insert six more. */
+		m = sizeof a + 6;
+		dynarr_clear(diff);
+		d = diff_compare_window(a, sizeof a, b, m, 90000, 50000, 1000, diff);
+		len = apply_diff_edits(diff, a, b, out);
+		test_result(d > 0 && d <= 18 && len == m && memcmp(out, b, m) == 0);
+	}
+	test_end();
+
 	dynarr_destroy(diff);
 
 	return test_package_end();
@@ -0,0 +1,143 @@
+/*
+ * Tests of the dirty-tracking module.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "test.h"
+
+#include "dirty.h"
+
+int main(void)
+{
+	test_package_begin("dirty", "Dirty-tracking of blocks of slots");
+
+	test_begin("New is all dirty");
+	{
+		Dirty	d;
+		size_t	end;
+
+		dirty_init(&d, 4);
+		test_result(dirty_any(&d, 1000) && dirty_next(&d, 0, 1000, &end) == 0 && end == 16 &&
+			    dirty_next(&d, 500, 1000, &end) == 500 && end == 512);
+		dirty_free(&d);
+	}
+	test_end();
+
+	test_begin("Clear");
+	{
+		Dirty	d;
+		size_t	end;
+
+		dirty_init(&d, 4);
+		dirty_clear(&d);
+		test_result(!dirty_any(&d, 1000) && dirty_next(&d, 0, 1000, &end) == 1000);
+		dirty_free(&d);
+	}
+	test_end();
+
+	test_begin("Mark");
+	{
+		Dirty	d;
+		size_t	end, i, n = 0, first = 0;
+
+		dirty_init(&d, 4);
+		dirty_clear(&d);
+		dirty_mark(&d, 100, 1);
+		dirty_mark(&d, 5000, 40);
+		for(i = dirty_next(&d, 0, 10000, &end); i < 10000; i = dirty_next(&d, end, 10000, &end), n++)
+		{
+			if(n == 0)
+				first = i;
+		}
+		/* Slot 100 is in block 96..111, 5000..5039 spans blocks 4992..5007, 5008..5023 and 5024..5039. */
+		test_result(first == 96 && n == 4);
+		dirty_free(&d);
+	}
+	test_end();
+
+	test_begin("Clean");
+	{
+		Dirty	d;
+		size_t	end;
+
+		dirty_init(&d, 0);
+		dirty_clean(&d, 10, 5);
+		test_result(dirty_next(&d, 0, 100, &end) == 0 && dirty_next(&d, 10, 100, &end) == 15 &&
+			    dirty_next(&d, 12, 14, &end) == 14);
+		dirty_clean(&d, 0, 100);
+		test_result(!dirty_any(&d, 100) && dirty_any(&d, 101));
+		dirty_free(&d);
+	}
+	test_end();
+
+	test_begin("Clean all of many");
+	{
+		Dirty	d;
+		size_t	end, i;
+
+		dirty_init(&d, 6);
+		for(i = dirty_next(&d, 0, 100000, &end); i < 100000; i = dirty_next(&d, end, 100000, &end))
+			dirty_clean(&d, i, end - i);
+		test_result(!dirty_any(&d, 100000));
+		dirty_mark(&d, 99999, 1);
+		test_result(dirty_next(&d, 0, 100000, &end) == 99968 && end == 100000);
+		dirty_free(&d);
+	}
+	test_end();
+
+	test_begin("Clean word past trailing dirt");
+	{
+		Dirty	d;
+		size_t	end;
+
+		dirty_init(&d, 0);
+		dirty_clear(&d);
+		dirty_mark(&d, 3, 1);		/* Allocates the first bits word. */
+		dirty_mark_all(&d);
+		dirty_clean(&d, 0, 5);		/* Word is clean now, and all from block 5 is dirty. */
+		test_result(dirty_next(&d, 0, 100, &end) == 5 && end == 6 && dirty_any(&d, 20));
+		dirty_free(&d);
+	}
+	test_end();
+
+	test_begin("Set bit beyond trailing dirt");
+	{
+		Dirty	d, s;
+		size_t	end;
+
+		dirty_init(&d, 0);
+		dirty_init(&s, 0);
+		dirty_clear(&d);
+		dirty_mark(&d, 40, 1);
+		dirty_clean(&s, 0, 35);		/* Dirty from block 35 on. */
+		dirty_merge(&d, &s);
+		test_result(dirty_next(&d, 0, 100, &end) == 35 && end == 36 && dirty_any(&d, 38));
+		dirty_free(&s);
+		dirty_free(&d);
+	}
+	test_end();
+
+	test_begin("Merge");
+	{
+		Dirty	d, s;
+		size_t	end;
+
+		dirty_init(&d, 2);
+		dirty_init(&s, 2);
+		dirty_clear(&d);
+		dirty_clear(&s);
+		dirty_mark(&s, 1000, 1);
+		dirty_merge(&d, &s);
+		test_result(dirty_next(&d, 0, 2000, &end) == 1000 && end == 1004);
+		dirty_mark_all(&s);
+		dirty_merge(&d, &s);
+		test_result(dirty_next(&d, 0, 2000, &end) == 0);
+		dirty_free(&s);
+		dirty_free(&d);
+	}
+	test_end();
+
+	return test_package_end();
+}
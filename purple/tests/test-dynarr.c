@@ -4,9 +4,12 @@
 
 #include <stdio.h>
 
+#include <pthread.h>
+
 #include "test.h"
 
 #include "dynarr.h"
+#include "memchunk.h"
 
 static void cb_copy(void *dst, const void *src, void *user)
 {
@@ -16,6 +19,24 @@ static void cb_copy(void *dst, const void *src, void *user)
 	*d = (*s) + 1;
 }
 
+/* Repeatedly share an array, and write to the share, like a node copy on a worker thread would. */
+static void * thread_share(void *arg)
+{
+	DynArr	*a = arg, *b;
+	int	i, *x;
+
+	for(i = 0; i < 10000; i++)
+	{
+		b = dynarr_new_share(a);
+		if((b = dynarr_unshare(b)) == NULL || b == a)
+			return NULL;
+		if((x = dynarr_index(b, 0)) != NULL)
+			*x = -1;
+		dynarr_destroy(b);
+	}
+	return arg;
+}
+
 int main(void)
 {
 	test_package_begin("dynarr", "Dynamic array data type");
@@ -129,6 +150,68 @@ int main(void)
 		test_result(ok == 10);
 	}
 	test_end();
+
+	test_begin("reserve()");
+	{
+		DynArr	*a;
+		int	def = 4711, *test, *first, ok, i;
+
+		a = dynarr_new(sizeof def, 1);
+		dynarr_set_default(a, &def);
+		dynarr_reserve(a, 1000);
+		first = dynarr_index(a, 0);
+		for(ok = 0, i = 0; i < 1000; i++)
+		{
+			if((test = dynarr_index(a, i)) != NULL)
+				ok += *test == def;
+			dynarr_set(a, i, &i);
+		}
+		test_result(ok == 1000 && dynarr_size(a) == 1000 && dynarr_index(a, 0) == first);
+		dynarr_destroy(a);
+	}
+	test_end();
+
+	test_begin("append many");
+	{
+		DynArr	*a;
+		int	*test, ok, i;
+
+		a = dynarr_new(sizeof i, 1);
+		for(i = 0; i < 100000; i++)
+			dynarr_append(a, &i, NULL);
+		for(ok = 0, i = 0; i < 100000; i++)
+		{
+			if((test = dynarr_index(a, i)) != NULL)
+				ok += *test == i;
+		}
+		test_result(ok == 100000 && dynarr_size(a) == 100000);
+		dynarr_destroy(a);
+	}
+	test_end();
+
+	test_begin("share between threads");
+	{
+		DynArr		*a;
+		pthread_t	th[4];
+		void		*ret;
+		int		i, ok = 1;
+
+		memchunk_threads_set(1);
+		dynarr_threads_set(1);
+		a = dynarr_new(sizeof i, 16);
+		for(i = 0; i < 100; i++)
+			dynarr_set(a, i, &i);
+		for(i = 0; i < 4; i++)
+			pthread_create(&th[i], NULL, thread_share, a);
+		for(i = 0; i < 4; i++)
+		{
+			pthread_join(th[i], &ret);
+			ok &= ret == a;
+		}
+		test_result(ok && !dynarr_shared(a) && *(int *) dynarr_index(a, 0) == 0 && *(int *) dynarr_index(a, 99) == 99);
+		dynarr_destroy(a);
+	}
+	test_end();
 	
 	return test_package_end();
 }
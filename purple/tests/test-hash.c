@@ -77,5 +77,62 @@ int main(void)
 	}
 	test_end();
 
+	test_begin("Integer keys");
+	{
+		Hash		*a;
+		size_t		i, ok = 1;
+
+		a = hash_new_int();
+		for(i = 0; i < 100000; i++)		/* Well past the size of the old prime table. */
+			hash_insert(a, (const void *) i, (void *) (i + 1));
+		for(i = 0; i < 100000 && ok; i++)
+			ok = hash_lookup(a, (const void *) i) == (void *) (i + 1);
+		test_result(ok && hash_size(a) == 100000 && hash_lookup(a, (const void *) 100000) == NULL);
+		hash_destroy(a);
+	}
+	test_end();
+
+	test_begin("Replace");
+	{
+		Hash	*a;
+
+		a = hash_new_int();
+		hash_insert(a, (const void *) 17, "foo");
+		hash_insert(a, (const void *) 17, "bar");
+		test_result(hash_size(a) == 1 && strcmp(hash_lookup(a, (const void *) 17), "bar") == 0);
+		hash_destroy(a);
+	}
+	test_end();
+
+	test_begin("Remove");
+	{
+		Hash		*a;
+		size_t		i, ok = 1;
+
+		a = hash_new(int_hash, int_key_eq);
+		for(i = 0; i < 1000; i++)
+			hash_insert(a, (const void *) i, (void *) (i + 1));
+		for(i = 0; i < 1000; i += 2)
+			hash_remove(a, (const void *) i);
+		for(i = 0; i < 1000 && ok; i++)
+			ok = hash_lookup(a, (const void *) i) == (i & 1 ? (void *) (i + 1) : NULL);
+		test_result(ok && hash_size(a) == 500);
+		hash_destroy(a);
+	}
+	test_end();
+
+	test_begin("String keys");
+	{
+		Hash	*a;
+
+		a = hash_new_string();
+		hash_insert(a, "foo", "1");
+		hash_insert(a, "bar", "2");
+		hash_remove(a, "foo");
+		test_result(hash_lookup(a, "foo") == NULL && strcmp(hash_lookup(a, "bar"), "2") == 0);
+		hash_destroy(a);
+	}
+	test_end();
+
 	return test_package_end();
 }
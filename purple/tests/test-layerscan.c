@@ -0,0 +1,152 @@
+/*
+ * Test the layer comparison module. Every kernel the CPU supports is checked against a plain
+ * per-element comparison, on arrays with scattered differences and deletion sentinels.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "verse.h"
+
+#include "test.h"
+
+#include "layerscan.h"
+
+#define	NUM	1000
+
+static const char	*kernels[] = { "c", "sse2", "avx2" };
+
+/* Reference comparison of element <i>: 0 if equal, 1 if not, 2 for a polygon deleted in <a> only. */
+static int element_ref(LayerScanKind kind, const uint8 *a, const uint8 *b, size_t esize, size_t i)
+{
+	const real64	*va = (const real64 *) (a + i * esize), *vb = (const real64 *) (b + i * esize);
+	const uint32	*pa = (const uint32 *) (a + i * esize), *pb = (const uint32 *) (b + i * esize);
+
+	if(memcmp(a + i * esize, b + i * esize, esize) == 0)
+		return 0;
+	if(kind == LAYERSCAN_VERTEX_XYZ && (va[0] > 1e300 || va[0] < -1e300) && (vb[0] > 1e300 || vb[0] < -1e300))
+		return 0;
+	if(kind == LAYERSCAN_POLYGON_UINT32 && pa[0] == ~0u && pb[0] != ~0u)
+		return 2;
+	return 1;
+}
+
+/* Scan the arrays, and check that the runs found cover exactly the differing elements. */
+static int check(LayerScanKind kind, const uint8 *a, const uint8 *b, size_t esize, size_t start, size_t end)
+{
+	size_t	i, j, run, next = start;
+	int	deleted = 0;
+
+	for(i = layerscan_next(kind, a, b, esize, start, end, &run, &deleted); i < end;
+	    i = layerscan_next(kind, a, b, esize, run, end, &run, &deleted))
+	{
+		if(i < next || run <= i || run > end)
+			return 0;
+		for(j = next; j < i; j++)
+			if(element_ref(kind, a, b, esize, j) != 0)
+				return 0;
+		for(j = i; j < run; j++)
+			if(element_ref(kind, a, b, esize, j) != 1 + deleted)
+				return 0;
+		if(run < end && element_ref(kind, a, b, esize, run) == 1 + deleted)
+			return 0;	/* Run should have been longer. */
+		next = run;
+	}
+	for(j = next; j < end; j++)
+		if(element_ref(kind, a, b, esize, j) != 0)
+			return 0;
+	return 1;
+}
+
+/* Fill <a> and <b> with equal elements, then change about one in <every>. */
+static void fill(LayerScanKind kind, uint8 *a, uint8 *b, size_t esize, int every)
+{
+	size_t	i, j;
+
+	for(i = 0; i < NUM * esize; i++)
+		a[i] = b[i] = rand();
+	for(i = 0; i < NUM; i++)
+	{
+		if(kind == LAYERSCAN_VERTEX_XYZ)
+		{
+			real64	*va = (real64 *) (a + i * esize), *vb = (real64 *) (b + i * esize);
+
+			va[0] = vb[0] = i;
+			if(rand() % every == 0)
+				va[0] = 1e301;
+			if(rand() % every == 0)
+				vb[0] = -1e302;
+		}
+		else if(kind == LAYERSCAN_POLYGON_UINT32)
+		{
+			if(rand() % every == 0)
+				((uint32 *) (a + i * esize))[0] = ~0u;
+			if(rand() % every == 0)
+				((uint32 *) (b + i * esize))[0] = ~0u;
+		}
+		if(rand() % every == 0)
+		{
+			j = rand() % esize;
+			a[i * esize + j] ^= 1 + rand() % 255;
+		}
+	}
+}
+
+int main(void)
+{
+	const struct
+	{
+		LayerScanKind	kind;
+		size_t		esize;
+	} layout[] = {
+		{ LAYERSCAN_PLAIN, 1 }, { LAYERSCAN_PLAIN, 4 }, { LAYERSCAN_PLAIN, 8 }, { LAYERSCAN_PLAIN, 12 },
+		{ LAYERSCAN_PLAIN, 32 }, { LAYERSCAN_PLAIN, 36 }, { LAYERSCAN_VERTEX_XYZ, 24 }, { LAYERSCAN_POLYGON_UINT32, 16 }
+	};
+	const int	every[] = { 1, 2, 7, 100, 100000 };
+	real64		abuf[NUM * 36 / sizeof (real64)], bbuf[NUM * 36 / sizeof (real64)];
+	uint8		*a = (uint8 *) abuf, *b = (uint8 *) bbuf;
+	unsigned int	k, l, e;
+
+	test_package_begin("layerscan", "Layer comparison kernels");
+
+	for(k = 0; k < sizeof kernels / sizeof *kernels; k++)
+	{
+		char	what[64];
+		int	ok = 1;
+
+		if(!layerscan_kernel_set(kernels[k]))
+		{
+			printf("Kernel %s not supported, skipping\n", kernels[k]);
+			continue;
+		}
+		sprintf(what, "Kernel %s", kernels[k]);
+		test_begin(what);
+		srand(4711);
+		for(l = 0; l < sizeof layout / sizeof *layout; l++)
+		{
+			for(e = 0; e < sizeof every / sizeof *every; e++)
+			{
+				fill(layout[l].kind, a, b, layout[l].esize, every[e]);
+				ok &= check(layout[l].kind, a, b, layout[l].esize, 0, NUM);
+				ok &= check(layout[l].kind, a, b, layout[l].esize, 3, NUM - 5);
+				ok &= check(layout[l].kind, a, b, layout[l].esize, 17, 18);
+				ok &= check(layout[l].kind, a, b, layout[l].esize, 40, 40);
+			}
+		}
+		test_result(ok);
+		test_end();
+	}
+
+	test_begin("Mismatched kind is plain");
+	{
+		uint32	pa[8] = { ~0u, 1, 2, 3, 4, 5, 6, 7 }, pb[8] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+		size_t	run;
+		int	deleted = 1;
+
+		test_result(layerscan_next(LAYERSCAN_POLYGON_UINT32, pa, pb, 8, 0, 4, &run, &deleted) == 0 && run == 1 && !deleted);
+	}
+	test_end();
+
+	return test_package_end();
+}
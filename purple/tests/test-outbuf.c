@@ -0,0 +1,246 @@
+/*
+ * Test the outgoing command buffer. The Verse send functions it calls are replaced by ones that
+ * record what was sent, and text edits are checked by applying them to a text buffer.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "verse.h"
+
+#include "test.h"
+
+#include "hash.h"
+#include "textbuf.h"
+#include "outbuf.h"
+
+static struct
+{
+	unsigned int	num;		/* Commands sent. */
+	uint32		index;		/* Slot of the last geometry command. */
+	real64		xyz[3];
+	int		deleted;	/* Last geometry command was a polygon delete. */
+	TextBuf		*text;		/* Text edits are applied here. */
+	size_t		longest;
+} sent;
+
+void verse_send_g_vertex_set_xyz_real64(VNodeID node_id, VLayerID layer_id, uint32 vertex_id, real64 x, real64 y, real64 z)
+{
+	sent.num++;
+	sent.index = vertex_id;
+	sent.xyz[0] = x;
+	sent.xyz[1] = y;
+	sent.xyz[2] = z;
+	sent.deleted = 0;
+}
+
+void verse_send_g_vertex_set_uint32(VNodeID node_id, VLayerID layer_id, uint32 vertex_id, uint32 value)
+{
+	sent.num++;
+}
+
+void verse_send_g_vertex_set_real64(VNodeID node_id, VLayerID layer_id, uint32 vertex_id, real64 value)
+{
+	sent.num++;
+}
+
+void verse_send_g_polygon_set_corner_uint32(VNodeID node_id, VLayerID layer_id, uint32 polygon_id, uint32 v0, uint32 v1, uint32 v2, uint32 v3)
+{
+	sent.num++;
+	sent.index = polygon_id;
+	sent.deleted = 0;
+}
+
+void verse_send_g_polygon_set_corner_real64(VNodeID node_id, VLayerID layer_id, uint32 polygon_id, real64 v0, real64 v1, real64 v2, real64 v3)
+{
+	sent.num++;
+}
+
+void verse_send_g_polygon_set_face_uint8(VNodeID node_id, VLayerID layer_id, uint32 polygon_id, uint8 value)
+{
+	sent.num++;
+}
+
+void verse_send_g_polygon_set_face_uint32(VNodeID node_id, VLayerID layer_id, uint32 polygon_id, uint32 value)
+{
+	sent.num++;
+}
+
+void verse_send_g_polygon_set_face_real64(VNodeID node_id, VLayerID layer_id, uint32 polygon_id, real64 value)
+{
+	sent.num++;
+}
+
+void verse_send_g_polygon_delete(VNodeID node_id, uint32 polygon_id)
+{
+	sent.num++;
+	sent.index = polygon_id;
+	sent.deleted = 1;
+}
+
+void verse_send_t_text_set(VNodeID node_id, VBufferID buffer_id, uint32 pos, uint32 length, const char *text)
+{
+	sent.num++;
+	if(length > 0)
+		textbuf_delete(sent.text, pos, length);
+	if(text != NULL)
+	{
+		textbuf_insert(sent.text, pos, text);
+		if(strlen(text) > sent.longest)
+			sent.longest = strlen(text);
+	}
+}
+
+/* Apply an edit both to <ref> directly, and through the buffer. */
+static void edit(TextBuf *ref, uint32 pos, uint32 length, const char *text, size_t text_length)
+{
+	char	temp[4096];
+
+	if(length > 0)
+		textbuf_delete(ref, pos, length);
+	if(text_length > 0)
+	{
+		memcpy(temp, text, text_length);
+		temp[text_length] = '\0';
+		textbuf_insert(ref, pos, temp);
+	}
+	outbuf_t_text_set(1, 0, pos, length, text, text_length);
+}
+
+int main(void)
+{
+	hash_init();
+	outbuf_init();
+
+	test_package_begin("outbuf", "Outgoing command buffer");
+
+	test_begin("Repeated vertex set");
+	{
+		real64		v[3] = { 1.0, 2.0, 3.0 };
+		OutbufStats	st;
+
+		outbuf_g_slot_set(1, 0, VN_G_LAYER_VERTEX_XYZ, 7, v);
+		v[0] = 4.0;
+		outbuf_g_slot_set(1, 0, VN_G_LAYER_VERTEX_XYZ, 7, v);
+		v[2] = 5.0;
+		outbuf_g_slot_set(1, 0, VN_G_LAYER_VERTEX_XYZ, 7, v);
+		sent.num = 0;
+		outbuf_flush();
+		outbuf_stats_get(&st);
+		test_result(sent.num == 1 && sent.index == 7 && sent.xyz[0] == 4.0 && sent.xyz[1] == 2.0 && sent.xyz[2] == 5.0 &&
+			    st.last_queued == 3 && st.last_sent == 1);
+	}
+	test_end();
+
+	test_begin("Distinct slots");
+	{
+		real64	v[3] = { 0.0 };
+		uint32	i;
+
+		for(i = 0; i < 10; i++)
+		{
+			outbuf_g_slot_set(1, 0, VN_G_LAYER_VERTEX_XYZ, i, v);
+			outbuf_g_slot_set(2, 0, VN_G_LAYER_VERTEX_XYZ, i, v);
+			outbuf_g_slot_set(1, 2, VN_G_LAYER_VERTEX_REAL, i, v);
+		}
+		sent.num = 0;
+		outbuf_flush();
+		test_result(sent.num == 30);
+	}
+	test_end();
+
+	test_begin("Polygon set, then delete");
+	{
+		uint32	c[4] = { 0, 1, 2, 3 };
+
+		outbuf_g_slot_set(1, 1, VN_G_LAYER_POLYGON_CORNER_UINT32, 3, c);
+		outbuf_g_polygon_delete(1, 3);
+		sent.num = 0;
+		outbuf_flush();
+		test_result(sent.num == 1 && sent.index == 3 && sent.deleted);
+		outbuf_g_polygon_delete(1, 3);
+		outbuf_g_slot_set(1, 1, VN_G_LAYER_POLYGON_CORNER_UINT32, 3, c);
+		sent.num = 0;
+		outbuf_flush();
+		test_result(sent.num == 2 && sent.index == 3 && !sent.deleted);
+	}
+	test_end();
+
+	test_begin("Text inserts merged");
+	{
+		char	big[2500];
+
+		memset(big, 'x', sizeof big);
+		sent.text = textbuf_new(0);
+		outbuf_t_text_set(1, 0, 0, 0, "foo", 3);
+		outbuf_t_text_set(1, 0, 3, 0, "bar", 3);
+		outbuf_t_text_set(1, 0, 6, 0, big, sizeof big);
+		sent.num = sent.longest = 0;
+		outbuf_flush();
+		test_result(sent.num == 3 && sent.longest == OUTBUF_TEXT_MAX && textbuf_length(sent.text) == 6 + sizeof big &&
+			    strncmp(textbuf_text(sent.text), "foobarxxx", 9) == 0);
+		textbuf_destroy(sent.text);
+	}
+	test_end();
+
+	test_begin("Text insert deleted again");
+	{
+		sent.text = textbuf_new(0);
+		outbuf_t_text_set(1, 0, 0, 0, "temporary", 9);
+		outbuf_t_text_set(1, 0, 0, 9, NULL, 0);
+		sent.num = 0;
+		outbuf_flush();
+		test_result(sent.num == 0 && textbuf_length(sent.text) == 0);
+		textbuf_destroy(sent.text);
+	}
+	test_end();
+
+	test_begin("Random edits");
+	{
+		const char	*words[] = { "a", "purple", " ", "verse\n", "<node/>" };
+		TextBuf		*ref;
+		size_t		len;
+		unsigned int	i, j, k;
+		int		ok = 1;
+
+		srand(4711);
+		for(i = 0; i < 100; i++)
+		{
+			ref = textbuf_new(0);
+			sent.text = textbuf_new(0);
+			for(j = 0; j < 50; j++)
+			{
+				len = textbuf_length(ref);
+				k = rand() % 4;
+				if(k == 0 && len > 0)		/* Random delete. */
+				{
+					uint32	p = rand() % len;
+
+					edit(ref, p, 1 + rand() % (len - p), NULL, 0);
+				}
+				else if(k == 1)			/* Append. */
+					edit(ref, len, 0, words[j % 5], strlen(words[j % 5]));
+				else if(k == 2 && len > 0)	/* Backspace. */
+					edit(ref, len - 1, 1, NULL, 0);
+				else				/* Insert or replace anywhere. */
+				{
+					uint32		p = len > 0 ? rand() % len : 0;
+					const char	*w = words[rand() % 5];
+
+					edit(ref, p, len > p ? rand() % (len - p + 1) : 0, w, strlen(w));
+				}
+				if(rand() % 10 == 0)
+					outbuf_flush();
+			}
+			outbuf_flush();
+			ok &= textbuf_length(ref) == textbuf_length(sent.text) && strcmp(textbuf_text(ref), textbuf_text(sent.text)) == 0;
+			textbuf_destroy(sent.text);
+			textbuf_destroy(ref);
+		}
+		test_result(ok);
+	}
+	test_end();
+
+	return test_package_end();
+}
@@ -0,0 +1,114 @@
+/*
+ * Test the paged array module.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "test.h"
+
+#include "hash.h"
+#include "pagearr.h"
+
+static void * element_copy(const void *element, void *user)
+{
+	return (void *) element;
+}
+
+int main(void)
+{
+	hash_init();
+
+	test_package_begin("pagearr", "Paged array");
+
+	test_begin("Creation");
+	{
+		PageArr	*pa;
+
+		pa = pagearr_new();
+		test_result(pa != NULL && pagearr_size(pa) == 0 && pagearr_end(pa) == 0 && pagearr_get(pa, 0) == NULL);
+		pagearr_destroy(pa, NULL);
+	}
+	test_end();
+
+	test_begin("Dense set and get");
+	{
+		PageArr	*pa;
+		size_t	i;
+		int	ok = 1;
+
+		pa = pagearr_new();
+		for(i = 0; i < 10000; i++)
+			ok &= pagearr_set(pa, i, (void *) (i + 1));
+		for(i = 0; i < 10000; i++)
+			ok &= pagearr_get(pa, i) == (void *) (i + 1);
+		test_result(ok && pagearr_size(pa) == 10000 && pagearr_end(pa) == 10000 && pagearr_get(pa, 10000) == NULL);
+		pagearr_destroy(pa, NULL);
+	}
+	test_end();
+
+	test_begin("Sparse set and iterate");
+	{
+		PageArr		*pa;
+		const size_t	index[] = { 3, 700, 701, 100000, 4000000000u };
+		size_t		i, j;
+		int		ok = 1;
+
+		pa = pagearr_new();
+		for(i = sizeof index / sizeof *index; i > 0; i--)
+			ok &= pagearr_set(pa, index[i - 1], (void *) index[i - 1]);
+		for(i = pagearr_next(pa, 0), j = 0; i < pagearr_end(pa); i = pagearr_next(pa, i + 1), j++)
+			ok &= j < sizeof index / sizeof *index && i == index[j] && pagearr_get(pa, i) == (void *) i;
+		test_result(ok && j == sizeof index / sizeof *index && pagearr_end(pa) == 4000000001u);
+		pagearr_destroy(pa, NULL);
+	}
+	test_end();
+
+	test_begin("Removal");
+	{
+		PageArr	*pa;
+
+		pa = pagearr_new();
+		pagearr_set(pa, 10, "ten");
+		pagearr_set(pa, 5000, "five thousand");
+		pagearr_set(pa, 5000, NULL);
+		test_result(pagearr_size(pa) == 1 && pagearr_end(pa) == 11 && pagearr_next(pa, 11) == 11);
+		pagearr_set(pa, 10, NULL);
+		test_result(pagearr_size(pa) == 0 && pagearr_end(pa) == 0);
+		pagearr_destroy(pa, NULL);
+	}
+	test_end();
+
+	test_begin("Gap filled in");
+	{
+		PageArr	*pa;
+		size_t	i;
+		int	ok = 1;
+
+		pa = pagearr_new();
+		pagearr_set(pa, 1 << 20, "far");
+		for(i = 0; i < (1 << 20); i += 64)
+			ok &= pagearr_set(pa, i, (void *) (i + 1));
+		for(i = 0; i < (1 << 20); i += 64)
+			ok &= pagearr_get(pa, i) == (void *) (i + 1) && pagearr_get(pa, i + 1) == NULL;
+		test_result(ok && pagearr_get(pa, 1 << 20) != NULL && pagearr_size(pa) == (1 << 20) / 64 + 1);
+		pagearr_destroy(pa, NULL);
+	}
+	test_end();
+
+	test_begin("Copy");
+	{
+		PageArr	*pa, *copy;
+
+		pa = pagearr_new();
+		pagearr_set(pa, 1, "one");
+		pagearr_set(pa, 1000000, "million");
+		copy = pagearr_new_copy(pa, element_copy, NULL);
+		pagearr_destroy(pa, NULL);
+		test_result(copy != NULL && pagearr_size(copy) == 2 && pagearr_get(copy, 1000000) != NULL && pagearr_next(copy, 2) == 1000000);
+		pagearr_destroy(copy, NULL);
+	}
+	test_end();
+
+	return test_package_end();
+}
@@ -13,6 +13,7 @@
 #include <sys/timeb.h>
 #else
 #include <sys/time.h>
+#include <time.h>
 #endif
 
 #include "timeval.h"
@@ -50,6 +51,25 @@ void timeval_now(TimeVal *tv)
 #endif
 }
 
+void timeval_monotonic(TimeVal *tv)
+{
+	if(tv == NULL)
+		return;
+#if defined CLOCK_MONOTONIC
+	{
+		struct timespec	now;
+
+		if(clock_gettime(CLOCK_MONOTONIC, &now) == 0)
+		{
+			tv->sec  = now.tv_sec;
+			tv->usec = now.tv_nsec / 1000;
+			return;
+		}
+	}
+#endif
+	timeval_now(tv);
+}
+
 void timeval_future(TimeVal *tv, double seconds)
 {
 	if(tv == NULL)
@@ -24,6 +24,11 @@ extern void	timeval_jurassic(TimeVal *tv);
 */
 extern void	timeval_now(TimeVal *tv);
 
+/* Like timeval_now(), but from a clock that is not affected by changes to the system time, if
+ * there is one. Don't mix the two kinds of time.
+*/
+extern void	timeval_monotonic(TimeVal *tv);
+
 /* Set <tv> to represent a time <seconds> seconds into the future from now. */
 extern void	timeval_future(TimeVal *tv, double seconds);
 
@@ -8,8 +8,10 @@
  * it is hopefully worth it.
 */
 
+#include <ctype.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "verse.h"
@@ -336,6 +338,23 @@ int value_set_defminmax_va(PValue *v, PValueType type, va_list *arg)
 }
 
 
+/* Parse <num> reals from a string, skipping any brackets and whitespace between them. */
+static int reals_from_string(const char *string, real64 *out, int num)
+{
+	char	*end;
+	int	i;
+
+	for(i = 0; i < num; i++, string = end)
+	{
+		while(*string == '[' || *string == ']' || isspace((unsigned char) *string))
+			string++;
+		out[i] = strtod(string, &end);
+		if(end == string)
+			return 0;
+	}
+	return 1;
+}
+
 int value_set_from_string(PValue *v, PValueType type, const char *value)
 {
 	if(v == NULL || value == NULL)
@@ -345,7 +364,7 @@ int value_set_from_string(PValue *v, PValueType type, const char *value)
 	case P_VALUE_BOOLEAN:
 		if(strcmp(value, "true") == 0)
 			return value_set(v, type, 1);
-		else if(strcmp(value, "false"))
+		else if(strcmp(value, "false") == 0)
 			return value_set(v, type, 0);
 		else
 			LOG_WARN(("Couldn't parse '%s' as boolean value", value));
@@ -386,6 +405,36 @@ int value_set_from_string(PValue *v, PValueType type, const char *value)
 				LOG_WARN(("Couldn't parse '%s' as real64 value", value));
 		}
 		break;
+	case P_VALUE_REAL32_VEC2:
+	case P_VALUE_REAL32_VEC3:
+	case P_VALUE_REAL32_VEC4:
+	case P_VALUE_REAL32_MAT16:
+		{
+			int	num = type == P_VALUE_REAL32_MAT16 ? 16 : 2 + type - P_VALUE_REAL32_VEC2, i;
+			real64	t[16];
+			real32	t32[16];
+
+			if(reals_from_string(value, t, num))
+			{
+				for(i = 0; i < num; i++)
+					t32[i] = t[i];
+				return value_set(v, type, t32);
+			}
+			LOG_WARN(("Couldn't parse '%s' as %s value", value, type_map_by_value[type].name));
+		}
+		break;
+	case P_VALUE_REAL64_VEC2:
+	case P_VALUE_REAL64_VEC3:
+	case P_VALUE_REAL64_VEC4:
+	case P_VALUE_REAL64_MAT16:
+		{
+			real64	t[16];
+
+			if(reals_from_string(value, t, type == P_VALUE_REAL64_MAT16 ? 16 : 2 + type - P_VALUE_REAL64_VEC2))
+				return value_set(v, type, t);
+			LOG_WARN(("Couldn't parse '%s' as %s value", value, type_map_by_value[type].name));
+		}
+		break;
 	case P_VALUE_STRING:
 		return value_set(v, type, value);
 	case P_VALUE_MODULE:
@@ -429,6 +478,42 @@ int value_set_from_default(PValue *v, const PValue *def)
 	return 1;
 }
 
+void value_copy(PValue *v, const PValue *src)
+{
+	if(v == NULL || src == NULL || v == src)
+		return;
+	value_clear(v);
+	v->v = src->v;
+	v->set = src->set;
+	if(VALUE_SETS(src, P_VALUE_STRING))
+		v->v.vstring = stu_strdup(src->v.vstring);
+}
+
+#define	EQUAL_FIELD(a, b, t, f)	(!VALUE_SETS(a, P_VALUE_ ##t) || memcmp(&(a)->v.f, &(b)->v.f, sizeof (a)->v.f) == 0)
+
+boolean value_equal(const PValue *a, const PValue *b)
+{
+	if(a->set != b->set)
+		return FALSE;
+	if(VALUE_SETS(a, P_VALUE_STRING) && (a->v.vstring == NULL || b->v.vstring == NULL ?
+					     a->v.vstring != b->v.vstring : strcmp(a->v.vstring, b->v.vstring) != 0))
+		return FALSE;
+	return EQUAL_FIELD(a, b, BOOLEAN, vboolean) &&
+	       EQUAL_FIELD(a, b, INT32, vint32) &&
+	       EQUAL_FIELD(a, b, UINT32, vuint32) &&
+	       EQUAL_FIELD(a, b, REAL32, vreal32) &&
+	       EQUAL_FIELD(a, b, REAL32_VEC2, vreal32_vec2) &&
+	       EQUAL_FIELD(a, b, REAL32_VEC3, vreal32_vec3) &&
+	       EQUAL_FIELD(a, b, REAL32_VEC4, vreal32_vec4) &&
+	       EQUAL_FIELD(a, b, REAL32_MAT16, vreal32_mat16) &&
+	       EQUAL_FIELD(a, b, REAL64, vreal64) &&
+	       EQUAL_FIELD(a, b, REAL64_VEC2, vreal64_vec2) &&
+	       EQUAL_FIELD(a, b, REAL64_VEC3, vreal64_vec3) &&
+	       EQUAL_FIELD(a, b, REAL64_VEC4, vreal64_vec4) &&
+	       EQUAL_FIELD(a, b, REAL64_MAT16, vreal64_mat16) &&
+	       EQUAL_FIELD(a, b, MODULE, vmodule);
+}
+
 /* ----------------------------------------------------------------------------------------- */
 
 #define	DO_SET(v,t)	VALUE_SET(v, P_VALUE_ ##t)
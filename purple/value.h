@@ -55,6 +55,12 @@ extern int		value_set_from_string(PValue *v, PValueType type, const char *string
 /* Set value to <def>, which is assumed to have only one type. Used to revert to a default. */
 extern int		value_set_from_default(PValue *v, const PValue *def);
 
+/* Make <v> an exact copy of <src>, with all the types it has set. */
+extern void		value_copy(PValue *v, const PValue *src);
+
+/* Check if <a> and <b> have the same types set, with the same values. Compares bit for bit. */
+extern boolean		value_equal(const PValue *a, const PValue *b);
+
 /* Check if the indicated value is present in the value. A present value is never returned from cache. */
 extern boolean		value_type_present(const PValue *v, PValueType type);
 
@@ -0,0 +1,153 @@
+/*
+ * workers.c
+ * 
+ * Copyright (C) 2004 PDC, KTH. See COPYING for license details.
+ * 
+ * Worker threads. Very basic fork-join style pool, with a shared job index protected
+ * by a mutex. Jobs are expected to be few and fairly heavy (plug-in computations), so
+ * there's no point in anything cleverer.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#if !defined _WIN32
+#include <pthread.h>
+#endif
+
+#include "dynarr.h"
+#include "log.h"
+#include "mem.h"
+#include "memchunk.h"
+
+#include "workers.h"
+
+/* ----------------------------------------------------------------------------------------- */
+
+#if !defined _WIN32
+
+static struct
+{
+	unsigned int	count;
+	pthread_t	*thread;
+
+	pthread_mutex_t	lock;
+	pthread_cond_t	cond_work;	/* Signalled when a new batch is available. */
+	pthread_cond_t	cond_done;	/* Signalled when the last job of a batch is done. */
+
+	unsigned long	batch;		/* Serial number of the current batch. */
+	void		(*func)(void *job);
+	void		**jobs;
+	size_t		num, next, done;
+} workers_info = { 0, NULL, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER };
+
+/* Grab and run jobs from the current batch until there are none left. Called with lock held. */
+static void batch_work(void)
+{
+	void	*job;
+
+	while(workers_info.next < workers_info.num)
+	{
+		job = workers_info.jobs[workers_info.next++];
+		pthread_mutex_unlock(&workers_info.lock);
+		workers_info.func(job);
+		pthread_mutex_lock(&workers_info.lock);
+		if(++workers_info.done == workers_info.num)
+			pthread_cond_signal(&workers_info.cond_done);
+	}
+}
+
+static void * worker_main(void *arg)
+{
+	unsigned long	seen = 0;
+
+	pthread_mutex_lock(&workers_info.lock);
+	for(;;)
+	{
+		while(workers_info.batch == seen)
+			pthread_cond_wait(&workers_info.cond_work, &workers_info.lock);
+		seen = workers_info.batch;
+		batch_work();
+	}
+	return NULL;
+}
+
+void workers_init(unsigned int count)
+{
+	unsigned int	i;
+
+	if(count == 0 || workers_info.count > 0)
+		return;
+	if((workers_info.thread = mem_alloc(count * sizeof *workers_info.thread)) == NULL)
+		return;
+	memchunk_threads_set(1);	/* Jobs allocate lists and arrays, so make that safe. */
+	dynarr_threads_set(1);		/* Node copies made by jobs share arrays with their inputs. */
+	for(i = 0; i < count; i++)
+	{
+		if(pthread_create(&workers_info.thread[i], NULL, worker_main, NULL) != 0)
+		{
+			LOG_WARN(("Couldn't create worker thread %u, continuing with %u", i + 1, i));
+			break;
+		}
+	}
+	workers_info.count = i;
+	LOG_MSG(("Started %u worker threads", workers_info.count));
+}
+
+unsigned int workers_count(void)
+{
+	return workers_info.count;
+}
+
+void workers_run(void (*func)(void *job), void **jobs, size_t num)
+{
+	size_t	i;
+
+	if(func == NULL || jobs == NULL || num == 0)
+		return;
+	if(workers_info.count == 0 || num == 1)
+	{
+		for(i = 0; i < num; i++)
+			func(jobs[i]);
+		return;
+	}
+	pthread_mutex_lock(&workers_info.lock);
+	workers_info.func = func;
+	workers_info.jobs = jobs;
+	workers_info.num  = num;
+	workers_info.next = 0;
+	workers_info.done = 0;
+	workers_info.batch++;
+	pthread_cond_broadcast(&workers_info.cond_work);
+	batch_work();
+	while(workers_info.done < workers_info.num)
+		pthread_cond_wait(&workers_info.cond_done, &workers_info.lock);
+	pthread_mutex_unlock(&workers_info.lock);
+}
+
+#else
+
+/* No threads on this platform (yet), so just run everything in the caller. */
+
+void workers_init(unsigned int count)
+{
+	if(count > 0)
+		LOG_WARN(("Worker threads not supported on this platform, ignoring request for %u", count));
+}
+
+unsigned int workers_count(void)
+{
+	return 0;
+}
+
+void workers_run(void (*func)(void *job), void **jobs, size_t num)
+{
+	size_t	i;
+
+	if(func == NULL || jobs == NULL)
+		return;
+	for(i = 0; i < num; i++)
+		func(jobs[i]);
+}
+
+#endif		/* !_WIN32 */
@@ -0,0 +1,22 @@
+/*
+ * workers.h
+ * 
+ * Copyright (C) 2004 PDC, KTH. See COPYING for license details.
+ * 
+ * A small pool of worker threads, used by the scheduler to run plug-in compute() calls
+ * in parallel. Work is handed out in batches, and the caller waits until the entire
+ * batch is done. All other engine activity (Verse I/O, graph editing, notification of
+ * dependants) thus stays on the main thread, as before.
+*/
+
+/* Start <count> worker threads. With a count of zero (the default), no threads are created
+ * and all work is done by the thread calling workers_run().
+*/
+extern void		workers_init(unsigned int count);
+
+extern unsigned int	workers_count(void);
+
+/* Call <func> once for each of the <num> pointers in <jobs>, spreading the calls over the
+ * worker threads. The calling thread helps out, and returns when all calls are done.
+*/
+extern void		workers_run(void (*func)(void *job), void **jobs, size_t num);